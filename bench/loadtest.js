@@ -0,0 +1,415 @@
+const fs = require("fs");
+const os = require("os");
+const { performance } = require("perf_hooks");
+const {
+  Worker,
+  isMainThread,
+  parentPort,
+  workerData,
+} = require("worker_threads");
+
+const { EnhanceStream, Model, Processor, getVersion } = require("..");
+const {
+  TEST_AUDIO_PATH,
+  getTestModelPath,
+  licenseKey,
+  loadWavAudio,
+} = require("../tests/common");
+const { version: packageVersion } = require("../package.json");
+const { summarize } = require("./stats");
+
+const MODES = ["sync", "async", "pool"];
+
+/**
+ * Creates `count` initialized processors, sharing one model unless `sharedModel` is false.
+ */
+function createProcessors(
+  count,
+  modelPath,
+  sampleRate,
+  numChannels,
+  sharedModel,
+) {
+  const model = Model.fromFile(modelPath);
+  const numFrames = model.getOptimalNumFrames(sampleRate);
+  const processors = [];
+  for (let i = 0; i < count; i++) {
+    const streamModel = sharedModel ? model : Model.fromFile(modelPath);
+    const processor = new Processor(streamModel, licenseKey());
+    processor.initialize(sampleRate, numChannels, numFrames, false);
+    processors.push(processor);
+  }
+  return { processors, numFrames };
+}
+
+/**
+ * Drives each processor at real-time pace: every `blockMs` one block of the test signal
+ * is due, starting at `startAt` plus an offset that spreads the streams over one block.
+ * Block latency is the time from when a block is due until its enhanced audio is back,
+ * so it includes time spent waiting behind other streams.
+ *
+ * Resolves with the latencies in milliseconds of all blocks due after the warmup.
+ *
+ * @param {Processor[]} processors - Initialized processors, one per stream
+ * @param {Object} options
+ * @param {"sync"|"async"} options.mode - Process on the event loop or the worker pool
+ * @returns {Promise<number[]>}
+ */
+function driveStreams(processors, options) {
+  const { mode, audio, numFrames, startAt, warmupMs, durationMs } = options;
+  const blockMs = (numFrames / audio.sampleRate) * 1000;
+  const blockSize = numFrames * audio.numChannels;
+  const numBlocks = Math.floor(audio.interleavedSamples.length / blockSize);
+  const measureFrom = startAt + warmupMs;
+  const stopAt = measureFrom + durationMs;
+  const latencies = [];
+
+  const streams = processors.map((processor, index) => {
+    const offset = (index / processors.length) * blockMs;
+    return new Promise((resolve, reject) => {
+      const block = new Float32Array(blockSize);
+      let position = index % numBlocks;
+      let due = startAt + offset;
+
+      let stream = null;
+      const pending = [];
+      if (mode === "async") {
+        stream = new EnhanceStream(processor);
+        stream.on("data", () => record(pending.shift()));
+        stream.on("error", reject);
+        stream.on("end", resolve);
+      }
+
+      function record(blockDue) {
+        if (blockDue >= measureFrom) {
+          latencies.push(performance.now() - blockDue);
+        }
+      }
+
+      function tick() {
+        if (due >= stopAt) {
+          if (stream) {
+            stream.end();
+          } else {
+            resolve();
+          }
+          return;
+        }
+
+        const start = position * blockSize;
+        block.set(audio.interleavedSamples.subarray(start, start + blockSize));
+        position = (position + 1) % numBlocks;
+
+        if (stream) {
+          pending.push(due);
+          stream.write(Buffer.from(block.buffer.slice(0)));
+        } else {
+          processor.processInterleaved(block);
+          record(due);
+        }
+
+        due += blockMs;
+        setTimeout(tick, Math.max(0, due - performance.now()));
+      }
+
+      setTimeout(tick, Math.max(0, due - performance.now()));
+    });
+  });
+
+  return Promise.all(streams).then(() => latencies);
+}
+
+/**
+ * Worker thread of the pool mode: runs its share of the streams synchronously on its own
+ * event loop and posts the latencies back.
+ */
+async function poolWorker() {
+  const { count, modelPath, sharedModel, warmupMs, durationMs } = workerData;
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const { processors, numFrames } = createProcessors(
+    count,
+    modelPath,
+    audio.sampleRate,
+    audio.numChannels,
+    sharedModel,
+  );
+
+  parentPort.postMessage({ type: "ready" });
+  const startAt = await new Promise((resolve) =>
+    parentPort.once("message", resolve),
+  );
+  const latencies = await driveStreams(processors, {
+    mode: "sync",
+    audio,
+    numFrames,
+    // Worker clocks have their own origin
+    startAt: startAt - performance.timeOrigin,
+    warmupMs,
+    durationMs,
+  });
+  parentPort.postMessage({ type: "done", latencies });
+}
+
+/**
+ * Runs `count` streams for one trial and measures latency, CPU and memory.
+ */
+async function runTrial(count, config) {
+  const { mode, audio, modelPath, sharedModel, warmupMs, durationMs } = config;
+  globalThis.gc?.();
+  const rssBefore = process.memoryUsage().rss;
+
+  let numFrames;
+  let start;
+  let collect;
+  if (mode === "pool") {
+    const numWorkers = Math.min(count, config.workers);
+    const workers = [];
+    for (let i = 0; i < numWorkers; i++) {
+      const share =
+        Math.floor(count / numWorkers) + (i < count % numWorkers ? 1 : 0);
+      workers.push(
+        new Worker(__filename, {
+          workerData: {
+            count: share,
+            modelPath,
+            sharedModel,
+            warmupMs,
+            durationMs,
+          },
+        }),
+      );
+    }
+    const messages = (type) =>
+      Promise.all(
+        workers.map(
+          (worker) =>
+            new Promise((resolve, reject) => {
+              const onMessage = (message) => {
+                if (message.type === type) {
+                  worker.off("message", onMessage);
+                  resolve(message);
+                }
+              };
+              worker.on("message", onMessage);
+              worker.once("error", reject);
+            }),
+        ),
+      );
+
+    await messages("ready");
+    numFrames = Model.fromFile(modelPath).getOptimalNumFrames(audio.sampleRate);
+    start = performance.now() + 100;
+    const done = messages("done");
+    for (const worker of workers) {
+      worker.postMessage(performance.timeOrigin + start);
+    }
+    collect = async () => {
+      const results = await done;
+      await Promise.all(workers.map((worker) => worker.terminate()));
+      return results.flatMap((result) => result.latencies);
+    };
+  } else {
+    const created = createProcessors(
+      count,
+      modelPath,
+      audio.sampleRate,
+      audio.numChannels,
+      sharedModel,
+    );
+    numFrames = created.numFrames;
+    start = performance.now() + 100;
+    const running = driveStreams(created.processors, {
+      mode,
+      audio,
+      numFrames,
+      startAt: start,
+      warmupMs,
+      durationMs,
+    });
+    collect = () => running;
+  }
+
+  const rssLoaded = process.memoryUsage().rss;
+  // CPU is sampled over the measured part only
+  await new Promise((resolve) =>
+    setTimeout(resolve, start + warmupMs - performance.now()),
+  );
+  const cpuBefore = process.cpuUsage();
+  const wallBefore = performance.now();
+  const latencies = await collect();
+  const cpu = process.cpuUsage(cpuBefore);
+  const wallMs = performance.now() - wallBefore;
+
+  const frameDurationMs = (numFrames / audio.sampleRate) * 1000;
+  const latencyMs = summarize(latencies);
+  const cpuPercent = ((cpu.user + cpu.system) / 1000 / wallMs) * 100;
+  return {
+    streams: count,
+    blocks: latencies.length,
+    latencyMs,
+    deadlineMisses: latencies.filter((latency) => latency > frameDurationMs)
+      .length,
+    withinDeadline: latencyMs.p99 <= frameDurationMs,
+    cpuPercentPerStream: cpuPercent / count,
+    rssBytesPerStream: Math.max(0, rssLoaded - rssBefore) / count,
+  };
+}
+
+async function main() {
+  const args = process.argv.slice(2);
+  let outputFile = null;
+  let mode = "sync";
+  let streamCounts = null;
+  let maxStreams = 256;
+  let durationMs = 10000;
+  let warmupMs = 1000;
+  let sharedModel = true;
+  let workers = os.availableParallelism?.() ?? os.cpus().length;
+
+  for (let i = 0; i < args.length; i++) {
+    if (args[i] === "--output" || args[i] === "-o") {
+      outputFile = args[++i];
+    } else if (args[i] === "--mode" || args[i] === "-m") {
+      mode = args[++i];
+    } else if (args[i] === "--streams" || args[i] === "-s") {
+      streamCounts = args[++i].split(",").map(Number);
+    } else if (args[i] === "--max-streams") {
+      maxStreams = parseInt(args[++i], 10);
+    } else if (args[i] === "--duration" || args[i] === "-d") {
+      durationMs = Number(args[++i]) * 1000;
+    } else if (args[i] === "--warmup") {
+      warmupMs = Number(args[++i]) * 1000;
+    } else if (args[i] === "--workers") {
+      workers = parseInt(args[++i], 10);
+    } else if (args[i] === "--no-shared-model") {
+      sharedModel = false;
+    } else if (args[i] === "--help" || args[i] === "-h") {
+      console.log(`
+Usage: npm run loadtest -- [options]
+
+Simulates concurrent real-time streams, each fed one block of tests/data audio per
+block duration, and measures the latency from when a block is due until it is enhanced.
+Without --streams, the stream count is doubled and then bisected to find the largest
+count whose p99 block latency stays within the block duration.
+
+Options:
+  -o, --output <file>     Write the JSON report to a file (default: stdout)
+  -m, --mode <mode>       sync: process on the event loop
+                          async: EnhanceStream on the Node.js worker pool
+                          pool: streams spread over worker threads (default: sync)
+  -s, --streams <list>    Only run these stream counts
+      --max-streams <n>   Upper bound of the search (default: 256)
+  -d, --duration <s>      Measured seconds per trial (default: 10)
+      --warmup <s>        Unmeasured seconds per trial (default: 1)
+      --workers <n>       Worker threads in pool mode (default: CPU count)
+      --no-shared-model   Load the model once per stream instead of sharing it
+  -h, --help              Show this help
+
+Requires AIC_SDK_LICENSE. Progress is written to stderr. Run node with --expose-gc
+for steadier memory numbers.
+`);
+      process.exit(0);
+    }
+  }
+
+  if (!MODES.includes(mode)) {
+    throw new Error(`Unknown mode: ${mode}`);
+  }
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const modelPath = getTestModelPath();
+  const model = Model.fromFile(modelPath);
+  const numFrames = model.getOptimalNumFrames(audio.sampleRate);
+  const frameDurationMs = (numFrames / audio.sampleRate) * 1000;
+  const config = {
+    mode,
+    audio,
+    modelPath,
+    sharedModel,
+    warmupMs,
+    durationMs,
+    workers,
+  };
+
+  const trials = new Map();
+  const trial = async (count) => {
+    if (!trials.has(count)) {
+      console.error(`Running: ${count} ${mode} streams`);
+      trials.set(count, await runTrial(count, config));
+    }
+    return trials.get(count);
+  };
+
+  let maxWithinDeadline = null;
+  if (streamCounts) {
+    for (const count of streamCounts) {
+      await trial(count);
+    }
+  } else {
+    // Double until the deadline is missed, then bisect between the last two counts
+    let good = 0;
+    let bad = null;
+    for (let count = 1; count <= maxStreams; count *= 2) {
+      if ((await trial(count)).withinDeadline) {
+        good = count;
+      } else {
+        bad = count;
+        break;
+      }
+    }
+    if (bad === null && good < maxStreams) {
+      if ((await trial(maxStreams)).withinDeadline) {
+        good = maxStreams;
+      } else {
+        bad = maxStreams;
+      }
+    }
+    while (bad !== null && bad - good > 1) {
+      const count = Math.floor((good + bad) / 2);
+      if ((await trial(count)).withinDeadline) {
+        good = count;
+      } else {
+        bad = count;
+      }
+    }
+    maxWithinDeadline = good;
+  }
+
+  const report = {
+    timestamp: new Date().toISOString(),
+    packageVersion,
+    sdkVersion: getVersion(),
+    node: process.version,
+    platform: process.platform,
+    arch: process.arch,
+    cpu: os.cpus()[0]?.model ?? "unknown",
+    cpuCount: os.cpus().length,
+    model: model.getId(),
+    mode,
+    sharedModel,
+    workers: mode === "pool" ? workers : undefined,
+    sampleRate: audio.sampleRate,
+    numChannels: audio.numChannels,
+    numFrames,
+    frameDurationMs,
+    maxStreamsWithinDeadline: maxWithinDeadline,
+    trials: [...trials.values()].sort((a, b) => a.streams - b.streams),
+  };
+
+  const json = JSON.stringify(report, null, 2);
+  if (outputFile) {
+    fs.writeFileSync(outputFile, json + "\n");
+    console.error(`Report written to: ${outputFile}`);
+  } else {
+    console.log(json);
+  }
+}
+
+if (isMainThread) {
+  main().catch((error) => {
+    console.error(error);
+    process.exit(1);
+  });
+} else {
+  poolWorker();
+}
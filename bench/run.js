@@ -0,0 +1,247 @@
+const fs = require("fs");
+const os = require("os");
+
+const { Model, Processor, getVersion } = require("..");
+const {
+  TEST_AUDIO_PATH,
+  getTestModelPath,
+  licenseKey,
+  loadWavAudio,
+  interleavedToSequential,
+  interleavedToPlanar,
+} = require("../tests/common");
+const { version: packageVersion } = require("../package.json");
+const { summarize } = require("./stats");
+
+// Parse command line arguments
+const args = process.argv.slice(2);
+let outputFile = null;
+let minCalls = 2000;
+let warmupCalls = 50;
+let frameMultiples = [0.5, 1, 2, 4];
+let channelCounts = [1, 2];
+let layouts = ["interleaved", "sequential", "planar"];
+
+for (let i = 0; i < args.length; i++) {
+  if (args[i] === "--output" || args[i] === "-o") {
+    outputFile = args[++i];
+  } else if (args[i] === "--calls" || args[i] === "-n") {
+    minCalls = parseInt(args[++i], 10);
+  } else if (args[i] === "--warmup") {
+    warmupCalls = parseInt(args[++i], 10);
+  } else if (args[i] === "--frames") {
+    frameMultiples = args[++i].split(",").map(Number);
+  } else if (args[i] === "--channels") {
+    channelCounts = args[++i].split(",").map(Number);
+  } else if (args[i] === "--layouts") {
+    layouts = args[++i].split(",");
+  } else if (args[i] === "--help" || args[i] === "-h") {
+    console.log(`
+Usage: npm run bench -- [options]
+
+Options:
+  -o, --output <file>     Write the JSON report to a file (default: stdout)
+  -n, --calls <n>         Measured process calls per case (default: 2000)
+      --warmup <n>        Unmeasured calls before each case (default: 50)
+      --frames <list>     Frame sizes as multiples of the optimal size
+                          (default: 0.5,1,2,4)
+      --channels <list>   Channel counts (default: 1,2)
+      --layouts <list>    Layouts (default: interleaved,sequential,planar)
+  -h, --help              Show this help
+
+Requires AIC_SDK_LICENSE. Progress is written to stderr.
+`);
+    process.exit(0);
+  }
+}
+
+/**
+ * Calls `fn(i)` `count` times after `warmup` unmeasured calls and returns the duration
+ * of each measured call in microseconds.
+ * @param {number} count - Number of measured calls
+ * @param {number} warmup - Number of unmeasured calls
+ * @param {function(number): void} fn - Function to measure
+ * @returns {Float64Array}
+ */
+function measure(count, warmup, fn) {
+  for (let i = 0; i < warmup; i++) {
+    fn(i);
+  }
+  const durations = new Float64Array(count);
+  for (let i = 0; i < count; i++) {
+    const start = process.hrtime.bigint();
+    fn(i);
+    durations[i] = Number(process.hrtime.bigint() - start) / 1000;
+  }
+  return durations;
+}
+
+/**
+ * Builds interleaved audio with `numChannels` channels from the test signal. Missing
+ * channels repeat the first channel.
+ * @param {Object} audio - Audio returned by loadWavAudio
+ * @param {number} numChannels - Channel count of the result
+ * @returns {Float32Array}
+ */
+function withChannels(audio, numChannels) {
+  const samples = new Float32Array(audio.numFrames * numChannels);
+  for (let frame = 0; frame < audio.numFrames; frame++) {
+    for (let ch = 0; ch < numChannels; ch++) {
+      const source = ch < audio.numChannels ? ch : 0;
+      samples[frame * numChannels + ch] =
+        audio.interleavedSamples[frame * audio.numChannels + source];
+    }
+  }
+  return samples;
+}
+
+/**
+ * Cuts the signal into blocks of `numFrames` frames in the given layout. Blocks are
+ * reused round robin, so the processor always sees real audio.
+ * @returns {Array<Float32Array|Float32Array[]>}
+ */
+function makeBlocks(interleaved, numChannels, numFrames, layout) {
+  const blockSize = numFrames * numChannels;
+  const blocks = [];
+  for (
+    let offset = 0;
+    offset + blockSize <= interleaved.length;
+    offset += blockSize
+  ) {
+    const block = interleaved.slice(offset, offset + blockSize);
+    if (layout === "sequential") {
+      blocks.push(interleavedToSequential(block, numChannels));
+    } else if (layout === "planar") {
+      blocks.push(interleavedToPlanar(block, numChannels));
+    } else {
+      blocks.push(block);
+    }
+  }
+  return blocks;
+}
+
+function benchmarkCase(model, audio, layout, numChannels, numFrames) {
+  const processor = new Processor(model, licenseKey());
+  processor.initialize(audio.sampleRate, numChannels, numFrames, false);
+
+  const interleaved = withChannels(audio, numChannels);
+  const blocks = makeBlocks(interleaved, numChannels, numFrames, layout);
+  const processBlock = {
+    interleaved: (block) => processor.processInterleaved(block),
+    sequential: (block) => processor.processSequential(block),
+    planar: (block) => processor.processPlanar(block),
+  }[layout];
+
+  // Blocks are processed in place, so later rounds enhance already enhanced audio.
+  // That does not change the per-call cost.
+  const durations = measure(minCalls, warmupCalls, (i) =>
+    processBlock(blocks[i % blocks.length]),
+  );
+
+  let totalUs = 0;
+  for (const duration of durations) {
+    totalUs += duration;
+  }
+  const audioUs = ((minCalls * numFrames) / audio.sampleRate) * 1e6;
+
+  return {
+    layout,
+    numChannels,
+    numFrames,
+    calls: minCalls,
+    latencyUs: summarize(durations),
+    realTimeFactor: totalUs / audioUs,
+  };
+}
+
+/**
+ * Measures the cost of crossing the binding layer without model inference: a native
+ * call taking the boxed processor context and returning a number, and the part of
+ * successful process calls spent outside the SDK. The SDK time of each call is read
+ * from getStats() after it, outside the timed interval, and subtracted from its
+ * duration.
+ */
+function benchmarkBindingOverhead(model, audio, numFrames) {
+  const processor = new Processor(model, licenseKey());
+  processor.initialize(audio.sampleRate, 1, numFrames, false);
+  const context = processor.getProcessorContext();
+  const blocks = makeBlocks(
+    withChannels(audio, 1),
+    1,
+    numFrames,
+    "interleaved",
+  );
+
+  const roundTrip = measure(minCalls, warmupCalls, () =>
+    context.getOutputDelay(),
+  );
+
+  for (let i = 0; i < warmupCalls; i++) {
+    processor.processInterleaved(blocks[i % blocks.length]);
+  }
+  const processOverhead = new Float64Array(minCalls);
+  let sdkTotalUs = processor.getStats().processTime.totalUs;
+  for (let i = 0; i < minCalls; i++) {
+    const start = process.hrtime.bigint();
+    processor.processInterleaved(blocks[i % blocks.length]);
+    const durationUs = Number(process.hrtime.bigint() - start) / 1000;
+    const { totalUs } = processor.getStats().processTime;
+    processOverhead[i] = durationUs - (totalUs - sdkTotalUs);
+    sdkTotalUs = totalUs;
+  }
+
+  return {
+    roundTripUs: summarize(roundTrip),
+    processOverheadUs: summarize(processOverhead),
+  };
+}
+
+function main() {
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const model = Model.fromFile(getTestModelPath());
+  const optimalFrames = model.getOptimalNumFrames(audio.sampleRate);
+
+  const frameSizes = frameMultiples
+    .map((multiple) => Math.round(optimalFrames * multiple))
+    .filter((numFrames) => numFrames > 0);
+
+  const results = [];
+  for (const layout of layouts) {
+    for (const numChannels of channelCounts) {
+      for (const numFrames of frameSizes) {
+        console.error(`Running: ${layout} ${numChannels}ch ${numFrames} frames`);
+        results.push(
+          benchmarkCase(model, audio, layout, numChannels, numFrames),
+        );
+      }
+    }
+  }
+
+  console.error("Running: binding overhead");
+  const bindingOverhead = benchmarkBindingOverhead(model, audio, optimalFrames);
+
+  const report = {
+    timestamp: new Date().toISOString(),
+    packageVersion,
+    sdkVersion: getVersion(),
+    node: process.version,
+    platform: process.platform,
+    arch: process.arch,
+    cpu: os.cpus()[0]?.model ?? "unknown",
+    model: model.getId(),
+    sampleRate: audio.sampleRate,
+    optimalNumFrames: optimalFrames,
+    results,
+    bindingOverhead,
+  };
+
+  const json = JSON.stringify(report, null, 2);
+  if (outputFile) {
+    fs.writeFileSync(outputFile, json + "\n");
+    console.error(`Report written to: ${outputFile}`);
+  } else {
+    console.log(json);
+  }
+}
+
+main();
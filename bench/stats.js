@@ -0,0 +1,35 @@
+/**
+ * Returns the nearest-rank percentile of sorted values.
+ * @param {Float64Array} sorted - Values in ascending order
+ * @param {number} p - Percentile in the range 0 to 100
+ * @returns {number}
+ */
+function percentile(sorted, p) {
+  const rank = Math.ceil((p / 100) * sorted.length);
+  return sorted[Math.min(sorted.length - 1, Math.max(0, rank - 1))];
+}
+
+/**
+ * Summarizes durations.
+ * @param {ArrayLike<number>} durations - Durations in any unit
+ * @returns {Object}
+ */
+function summarize(durations) {
+  const sorted = Float64Array.from(durations).sort();
+  let total = 0;
+  for (const duration of sorted) {
+    total += duration;
+  }
+  return {
+    mean: total / sorted.length,
+    p50: percentile(sorted, 50),
+    p99: percentile(sorted, 99),
+    p999: percentile(sorted, 99.9),
+    max: sorted[sorted.length - 1],
+  };
+}
+
+module.exports = {
+  percentile,
+  summarize,
+};
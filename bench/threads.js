@@ -0,0 +1,262 @@
+const fs = require("fs");
+const os = require("os");
+const { performance } = require("perf_hooks");
+const { Worker } = require("worker_threads");
+
+const { AudioRing, Model, Processor, getVersion } = require("..");
+const {
+  TEST_AUDIO_PATH,
+  getTestModelPath,
+  licenseKey,
+  loadWavAudio,
+} = require("../tests/common");
+const { version: packageVersion } = require("../package.json");
+const { summarize } = require("./stats");
+
+// Parse command line arguments
+const args = process.argv.slice(2);
+let outputFile = null;
+let cases = null;
+let durationMs = 10000;
+let warmupMs = 1000;
+let cpu = os.cpus().length - 1;
+let priority = 80;
+let nice = -10;
+let loadThreads = 0;
+let signal = "speech";
+
+for (let i = 0; i < args.length; i++) {
+  if (args[i] === "--output" || args[i] === "-o") {
+    outputFile = args[++i];
+  } else if (args[i] === "--cases" || args[i] === "-c") {
+    cases = args[++i].split(",");
+  } else if (args[i] === "--duration" || args[i] === "-d") {
+    durationMs = Number(args[++i]) * 1000;
+  } else if (args[i] === "--warmup") {
+    warmupMs = Number(args[++i]) * 1000;
+  } else if (args[i] === "--cpu") {
+    cpu = parseInt(args[++i], 10);
+  } else if (args[i] === "--priority") {
+    priority = parseInt(args[++i], 10);
+  } else if (args[i] === "--nice") {
+    nice = parseInt(args[++i], 10);
+  } else if (args[i] === "--load") {
+    loadThreads = parseInt(args[++i], 10);
+  } else if (args[i] === "--signal") {
+    signal = args[++i];
+  } else if (args[i] === "--help" || args[i] === "-h") {
+    console.log(`
+Usage: npm run bench:threads -- [options]
+
+Runs a ring worker per case, each with one of the worker thread settings of
+Processor.startRingWorker(), fed one block of tests/data audio per block duration.
+Block latency is the time from when a block is due until its enhanced audio is in
+the output ring. The native process time of every block is reported as well.
+
+Cases: baseline, affinity, realtime, nice, denormals, all (default: all of them)
+
+Options:
+  -o, --output <file>     Write the JSON report to a file (default: stdout)
+  -c, --cases <list>      Only run these cases
+  -d, --duration <s>      Measured seconds per case (default: 10)
+      --warmup <s>        Unmeasured seconds per case (default: 1)
+      --cpu <n>           CPU of the affinity case (default: the last one)
+      --priority <n>      SCHED_FIFO priority of the realtime case (default: 80)
+      --nice <n>          Nice level of the nice case (default: -10)
+      --load <n>          Threads spinning at normal priority during every case,
+                          to compete with the worker for CPU time (default: 0)
+      --signal <name>     speech: the test signal
+                          decay: the test signal alternating with stretches of
+                          near-silence, so that model state decays into denormal
+                          numbers (default: speech)
+  -h, --help              Show this help
+
+Requires AIC_SDK_LICENSE. Real-time priority and negative nice levels need
+CAP_SYS_NICE or a matching RLIMIT_RTPRIO / RLIMIT_NICE; settings that are not
+permitted are skipped and listed under threadReport.errors. Progress is written to
+stderr.
+`);
+    process.exit(0);
+  }
+}
+
+const CASES = {
+  baseline: {},
+  affinity: { cpus: [cpu] },
+  realtime: { realtimePriority: priority },
+  nice: { nice },
+  denormals: { flushDenormals: true },
+  all: {
+    cpus: [cpu],
+    realtimePriority: priority,
+    nice,
+    flushDenormals: true,
+  },
+};
+
+/**
+ * Builds the interleaved input signal. For `decay`, every second of the test signal is
+ * followed by a second of noise at about 1e-39, below the smallest normal float.
+ * @param {Object} audio - Audio returned by loadWavAudio
+ * @returns {Float32Array}
+ */
+function makeSignal(audio) {
+  if (signal === "speech") {
+    return audio.interleavedSamples;
+  }
+  if (signal !== "decay") {
+    throw new Error(`Unknown signal: ${signal}`);
+  }
+  const second = audio.sampleRate * audio.numChannels;
+  const samples = new Float32Array(audio.interleavedSamples.length * 2);
+  for (
+    let offset = 0;
+    offset < audio.interleavedSamples.length;
+    offset += second
+  ) {
+    const speech = audio.interleavedSamples.subarray(offset, offset + second);
+    samples.set(speech, offset * 2);
+    for (let i = 0; i < speech.length; i++) {
+      samples[offset * 2 + speech.length + i] = (Math.random() - 0.5) * 2e-39;
+    }
+  }
+  return samples;
+}
+
+/**
+ * Starts `count` threads that spin until terminated.
+ * @returns {Worker[]}
+ */
+function startLoad(count) {
+  const workers = [];
+  for (let i = 0; i < count; i++) {
+    workers.push(new Worker("for (;;) {}", { eval: true }));
+  }
+  return workers;
+}
+
+/**
+ * Feeds one block per block duration into a ring worker started with `threadOptions`
+ * and spins on the output ring until the block is back. Spinning keeps the measuring
+ * side from adding wake-up latency of its own.
+ */
+function runCase(name, model, audio, samples, numFrames) {
+  const { sampleRate, numChannels } = audio;
+  const processor = new Processor(model, licenseKey());
+  processor.initialize(sampleRate, numChannels, numFrames, false);
+  const input = new AudioRing(4 * numFrames, numChannels);
+  const output = new AudioRing(4 * numFrames, numChannels);
+  const threadReport = processor.startRingWorker(input, output, CASES[name]);
+
+  const blockMs = (numFrames / sampleRate) * 1000;
+  const blockSize = numFrames * numChannels;
+  const numBlocks = Math.floor(samples.length / blockSize);
+  const block = new Float32Array(blockSize);
+  const latencies = [];
+
+  const start = performance.now();
+  const measureFrom = start + warmupMs;
+  const stopAt = measureFrom + durationMs;
+  let measuring = false;
+  try {
+    for (let i = 0, due = start; due < stopAt; i++, due += blockMs) {
+      if (!measuring && due >= measureFrom) {
+        // Process times are only collected over the measured part
+        processor.resetStats();
+        measuring = true;
+      }
+      while (performance.now() < due) {
+        // Spin until the block is due
+      }
+      const offset = (i % numBlocks) * blockSize;
+      input.write(samples.subarray(offset, offset + blockSize));
+      while (output.availableFrames() < numFrames) {
+        if (performance.now() - due > 1000) {
+          throw new Error(`Ring worker of case ${name} stopped processing`);
+        }
+      }
+      if (measuring) {
+        latencies.push((performance.now() - due) * 1000);
+      }
+      output.read(block);
+    }
+  } finally {
+    processor.stopRingWorker();
+  }
+
+  const latencyUs = summarize(latencies);
+  const { processTime } = processor.getStats();
+  return {
+    case: name,
+    threadOptions: CASES[name],
+    threadReport,
+    blocks: latencies.length,
+    latencyUs,
+    processTimeUs: {
+      mean: processTime.meanUs,
+      p50: processTime.p50Us,
+      p99: processTime.p99Us,
+      p999: processTime.p999Us,
+      max: processTime.maxUs,
+    },
+    deadlineMisses: latencies.filter((latency) => latency > blockMs * 1000)
+      .length,
+  };
+}
+
+async function main() {
+  const names = cases ?? Object.keys(CASES);
+  for (const name of names) {
+    if (!(name in CASES)) {
+      throw new Error(`Unknown case: ${name}`);
+    }
+  }
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const samples = makeSignal(audio);
+  const model = Model.fromFile(getTestModelPath());
+  const numFrames = model.getOptimalNumFrames(audio.sampleRate);
+
+  const load = startLoad(loadThreads);
+  const results = [];
+  try {
+    for (const name of names) {
+      console.error(`Running: ${name}`);
+      results.push(runCase(name, model, audio, samples, numFrames));
+    }
+  } finally {
+    await Promise.all(load.map((worker) => worker.terminate()));
+  }
+
+  const report = {
+    timestamp: new Date().toISOString(),
+    packageVersion,
+    sdkVersion: getVersion(),
+    node: process.version,
+    platform: process.platform,
+    arch: process.arch,
+    cpu: os.cpus()[0]?.model ?? "unknown",
+    cpuCount: os.cpus().length,
+    model: model.getId(),
+    signal,
+    loadThreads,
+    sampleRate: audio.sampleRate,
+    numChannels: audio.numChannels,
+    numFrames,
+    frameDurationMs: (numFrames / audio.sampleRate) * 1000,
+    results,
+  };
+
+  const json = JSON.stringify(report, null, 2);
+  if (outputFile) {
+    fs.writeFileSync(outputFile, json + "\n");
+    console.error(`Report written to: ${outputFile}`);
+  } else {
+    console.log(json);
+  }
+}
+
+main().catch((error) => {
+  console.error(error);
+  process.exit(1);
+});
@@ -0,0 +1,67 @@
+const { EnhancementDaemon, Model, getVersion } = require("..");
+
+// Parse command line arguments
+const args = process.argv.slice(2);
+let socketPath = "/tmp/aic-sdk.sock";
+let modelId = "rook-l-48khz";
+
+for (let i = 0; i < args.length; i++) {
+  if (args[i] === "--socket" || args[i] === "-s") {
+    socketPath = args[++i];
+  } else if (args[i] === "--model" || args[i] === "-m") {
+    modelId = args[++i];
+  } else if (args[i] === "--help" || args[i] === "-h") {
+    console.log(`
+Usage: node daemon.js [options]
+
+Serves audio enhancement to all Node.js processes on this host. Clients connect
+with DaemonClient.connect(socketPath, options).
+
+Options:
+  -s, --socket <path>  Unix domain socket (default: /tmp/aic-sdk.sock)
+  -m, --model <id>     Model ID (default: rook-l-48khz)
+  -h, --help           Show this help
+`);
+    process.exit(0);
+  }
+}
+
+// Check for license key
+if (!process.env.AIC_SDK_LICENSE) {
+  console.error("Error: AIC_SDK_LICENSE environment variable not set");
+  console.error("Get your license key from https://developers.ai-coustics.io");
+  process.exit(1);
+}
+
+console.log("SDK Version:", getVersion());
+
+let model;
+try {
+  console.log("Loading model:", modelId);
+  const modelPath = Model.download(modelId, "/tmp/aic-models");
+  model = Model.fromFile(modelPath);
+} catch (error) {
+  console.error("Failed to load model:", error.message);
+  process.exit(1);
+}
+
+let daemon;
+try {
+  daemon = new EnhancementDaemon(model, process.env.AIC_SDK_LICENSE, socketPath);
+} catch (error) {
+  console.error("Failed to start daemon:", error.message);
+  process.exit(1);
+}
+console.log("Listening on", socketPath);
+
+const statusTimer = setInterval(() => {
+  console.log("Sessions:", daemon.getSessionCount());
+}, 10000);
+statusTimer.unref();
+
+for (const signal of ["SIGINT", "SIGTERM"]) {
+  process.on(signal, () => {
+    console.log("Shutting down");
+    daemon.close();
+  });
+}
@@ -107,11 +107,15 @@ const numFrames = model.getOptimalNumFrames(sampleRate);
 console.log("Sample Rate:", sampleRate);
 console.log("Chunk Size:", numFrames, "samples");
 
-// Create processor
+// Create processor. With compensateDelay the output is sample-aligned with
+// the input: the output delay is trimmed from the start and flush() returns
+// the tail.
 let processor;
 try {
   processor = new Processor(model, process.env.AIC_SDK_LICENSE);
-  processor.initialize(sampleRate, numChannels, numFrames, false);
+  processor.initialize(sampleRate, numChannels, numFrames, false, {
+    compensateDelay: true,
+  });
 } catch (error) {
   console.error("Failed to create processor:", error.message);
   process.exit(1);
@@ -120,7 +124,7 @@ try {
 // Get processor context and output delay
 const processorContext = processor.getProcessorContext();
 const outputDelay = processorContext.getOutputDelay();
-console.log("Output Delay:", outputDelay, "samples");
+console.log("Output Delay:", outputDelay, "samples (compensated)");
 
 // Get VAD context for speech detection
 const vadContext = processor.getVadContext();
@@ -137,42 +141,45 @@ try {
   console.error("Warning: Failed to set parameters:", error.message);
 }
 
-// Calculate padding and total samples
 const samplesPerChannel = samples.length / numChannels;
-const paddedLength = samplesPerChannel + outputDelay;
-const totalChunks = Math.ceil(paddedLength / numFrames);
-const totalPaddedSamples = totalChunks * numFrames;
-
-console.log("Original samples per channel:", samplesPerChannel);
-console.log("Padded samples per channel:", totalPaddedSamples);
+const totalChunks = Math.ceil(samplesPerChannel / numFrames);
 console.log("Total chunks to process:", totalChunks);
 
-// Create padded input buffer (interleaved format)
-const paddedInput = new Float32Array(totalPaddedSamples * numChannels);
-
-// Copy original audio to padded buffer
-paddedInput.set(samples);
-// Remaining samples are already zero (padding at the end to flush output delay)
-
-// Create output buffer
-const outputBuffer = new Float32Array(totalPaddedSamples * numChannels);
-
-// Process in chunks
+// Process in chunks, in place. Each call returns how many valid frames are at
+// the front of the chunk; they are moved to the write position, which trails
+// the read position by the part of the output delay trimmed so far. The
+// enhanced audio thus ends up in `samples` without a padded copy of the input.
 console.log("Processing...");
-const chunkBuffer = new Float32Array(numFrames * numChannels);
+const chunkSize = numFrames * numChannels;
+const lastChunk = new Float32Array(chunkSize);
+let writtenFrames = 0;
+
+function writeOutput(enhanced, numValidFrames) {
+  const numOutputFrames = Math.min(
+    numValidFrames,
+    samplesPerChannel - writtenFrames,
+  );
+  samples.set(
+    enhanced.subarray(0, numOutputFrames * numChannels),
+    writtenFrames * numChannels,
+  );
+  writtenFrames += numOutputFrames;
+}
 
 for (let chunk = 0; chunk < totalChunks; chunk++) {
-  const inputOffset = chunk * numFrames * numChannels;
-  const outputOffset = chunk * numFrames * numChannels;
+  const offset = chunk * chunkSize;
+  let chunkBuffer = samples.subarray(offset, offset + chunkSize);
 
-  // Copy chunk from padded input
-  for (let i = 0; i < chunkBuffer.length; i++) {
-    chunkBuffer[i] = paddedInput[inputOffset + i] || 0;
+  // The last chunk may be incomplete and is padded with silence
+  if (chunkBuffer.length < chunkSize) {
+    lastChunk.set(chunkBuffer);
+    chunkBuffer = lastChunk;
   }
 
   // Process chunk (in-place)
+  let numValidFrames;
   try {
-    processor.processInterleaved(chunkBuffer);
+    numValidFrames = processor.processInterleaved(chunkBuffer);
   } catch (error) {
     console.error(`Failed to process chunk ${chunk}:`, error.message);
     process.exit(1);
@@ -185,15 +192,15 @@ for (let chunk = 0; chunk < totalChunks; chunk++) {
     `Chunk ${chunk + 1}/${totalChunks} [${timeInSeconds.toFixed(2)}s]: Speech detected: ${speechDetected}`,
   );
 
-  // Copy processed chunk to output
-  outputBuffer.set(chunkBuffer, outputOffset);
+  writeOutput(chunkBuffer, numValidFrames);
 }
+
+// Feed silence to get the audio still held back by the output delay
+const tail = processor.flush();
+writeOutput(tail, tail.length / numChannels);
 console.log();
 
-// Remove output delay from the beginning
-const delayOffset = outputDelay * numChannels;
-const finalLength = samplesPerChannel * numChannels;
-const finalOutput = outputBuffer.slice(delayOffset, delayOffset + finalLength);
+const finalOutput = samples;
 
 // Write output file
 try {
@@ -1,6 +1,96 @@
-// Platform-specific binary loader
-let native;
-try {
+const diagnosticsChannel = require("diagnostics_channel");
+const fs = require("fs");
+const path = require("path");
+const { performance } = require("perf_hooks");
+const { Transform } = require("stream");
+const { TransformStream } = require("stream/web");
+
+// x86-64 microarchitecture levels with a binary of their own, most capable first, and
+// the /proc/cpuinfo flags each needs beyond the previous level. Each binary is built with
+// `-C target-cpu=<level>`, so the binding's own kernels use AVX2 and FMA or AVX-512.
+const X86_64_LEVELS = [
+  {
+    name: "x86-64-v4",
+    flags: ["avx512f", "avx512bw", "avx512cd", "avx512dq", "avx512vl"],
+  },
+  {
+    name: "x86-64-v3",
+    flags: [
+      "avx",
+      "avx2",
+      "bmi1",
+      "bmi2",
+      "f16c",
+      "fma",
+      "abm",
+      "movbe",
+      "xsave",
+      "cx16",
+      "lahf_lm",
+      "popcnt",
+      "sse4_1",
+      "sse4_2",
+      "ssse3",
+    ],
+  },
+];
+
+/**
+ * Returns the names of the x86-64 levels this CPU supports, most capable first, from
+ * the flags of the first processor in /proc/cpuinfo. Empty if they cannot be read.
+ */
+function detectX86Levels() {
+  let cpuinfo;
+  try {
+    // The flags of the first processor are within the first few kilobytes
+    const fd = fs.openSync("/proc/cpuinfo", "r");
+    try {
+      const buffer = Buffer.alloc(16384);
+      cpuinfo = buffer.toString("latin1", 0, fs.readSync(fd, buffer));
+    } finally {
+      fs.closeSync(fd);
+    }
+  } catch (e) {
+    return [];
+  }
+  const line = cpuinfo.split("\n").find((line) => line.startsWith("flags"));
+  if (!line) {
+    return [];
+  }
+  const flags = new Set(line.slice(line.indexOf(":") + 1).trim().split(/\s+/));
+  const supported = [];
+  for (let i = X86_64_LEVELS.length - 1; i >= 0; i--) {
+    if (!X86_64_LEVELS[i].flags.every((flag) => flags.has(flag))) {
+      break;
+    }
+    supported.unshift(X86_64_LEVELS[i].name);
+  }
+  return supported;
+}
+
+/**
+ * Returns the binary variants to try for this CPU, most capable first, ending with the
+ * baseline. AIC_SDK_NODE_CPU=baseline or a level name caps the selection.
+ */
+function binaryVariants(platformKey) {
+  if (
+    platformKey !== "linux-x64" ||
+    process.env.AIC_SDK_NODE_CPU === "baseline"
+  ) {
+    return ["baseline"];
+  }
+  const names = X86_64_LEVELS.map((level) => level.name);
+  const cap = names.indexOf(process.env.AIC_SDK_NODE_CPU || names[0]);
+  const levels = detectX86Levels().filter(
+    (level) => cap >= 0 && names.indexOf(level) >= cap,
+  );
+  return [...levels, "baseline"];
+}
+
+/**
+ * Loads the platform-specific binary. Returns the module and its variant.
+ */
+function loadBinary() {
   const platform = process.platform;
   const arch = process.arch;
 
@@ -16,21 +106,59 @@ try {
   const platformKey = `${platform}-${arch}`;
   const platformPackage = platformPackages[platformKey];
 
+  if (process.env.AIC_SDK_NODE_BINARY) {
+    // Explicit binary, e.g. a local build with the mock backend
+    const binary = require(path.resolve(process.env.AIC_SDK_NODE_BINARY));
+    return { binary, variant: "custom" };
+  }
   if (platformPackage) {
-    try {
-      native = require(platformPackage);
-    } catch (e) {
-      native = require("./index.node");
+    // Specialized binaries sit next to the baseline one; a platform package without
+    // them falls through to the baseline
+    for (const variant of binaryVariants(platformKey)) {
+      try {
+        const binary =
+          variant === "baseline"
+            ? require(platformPackage)
+            : require(`${platformPackage}/index-${variant}.node`);
+        return { binary, variant };
+      } catch (e) {
+        // Try the next variant
+      }
     }
-  } else {
-    native = require("./index.node");
-  }
-} catch (e) {
-  throw new Error(
-    `Failed to load native binary for platform ${process.platform}-${process.arch}. ` +
-      `Supported platforms: Linux (x64/ARM64, GNU libc), macOS (x64/ARM64), Windows (x64/ARM64, MSVC). ` +
-      `Error: ${e.message}`,
-  );
+  }
+  return { binary: require("./index.node"), variant: "local" };
+}
+
+// The native module is loaded on first use rather than on require, so that processes
+// which require the package but do not enhance audio yet start faster. Until then
+// `native` is a stand-in that loads the module and then replaces itself, so later
+// calls reach the module directly.
+let native = new Proxy({}, { get: (_, name) => loadNative()[name] });
+let nativeVariant = null;
+let nativeLoadMs = null;
+
+/**
+ * Loads the native module if it is not loaded yet, and returns it.
+ */
+function loadNative() {
+  if (nativeVariant !== null) {
+    return native;
+  }
+  const start = performance.now();
+  let loaded;
+  try {
+    loaded = loadBinary();
+  } catch (e) {
+    throw new Error(
+      `Failed to load native binary for platform ${process.platform}-${process.arch}. ` +
+        `Supported platforms: Linux (x64/ARM64, GNU libc), macOS (x64/ARM64), Windows (x64/ARM64, MSVC). ` +
+        `Error: ${e.message}`,
+    );
+  }
+  native = loaded.binary;
+  nativeVariant = loaded.variant;
+  nativeLoadMs = performance.now() - start;
+  return native;
 }
 
 /**
@@ -51,7 +179,9 @@ const ProcessorParameter = {
    *
    * Default: 0.0
    */
-  Bypass: native.PROCESSOR_PARAM_BYPASS,
+  get Bypass() {
+    return native.PROCESSOR_PARAM_BYPASS;
+  },
 
   /**
    * A tunable parameter to optimize for specific STT engines, deployment environments, and user experience requirements.
@@ -63,7 +193,37 @@ const ProcessorParameter = {
    *
    * Range: 0.0 to 1.0
    */
-  EnhancementLevel: native.PROCESSOR_PARAM_ENHANCEMENT_LEVEL,
+  get EnhancementLevel() {
+    return native.PROCESSOR_PARAM_ENHANCEMENT_LEVEL;
+  },
+};
+
+/**
+ * Entries of the status buffer returned by Processor.setPostProcess(). All entries but
+ * `TotalClipped` describe the last process call.
+ * @enum {number}
+ */
+const PostStatus = {
+  /** Largest absolute sample after the gain, before limiting. */
+  get Peak() {
+    return native.POST_STATUS_PEAK;
+  },
+  /** Samples beyond full scale after limiting, clamped in the PCM output. */
+  get Clipped() {
+    return native.POST_STATUS_CLIPPED;
+  },
+  /** Samples reduced by the limiter. */
+  get Limited() {
+    return native.POST_STATUS_LIMITED;
+  },
+  /** Frames post-processed, and packed to PCM if enabled. */
+  get Frames() {
+    return native.POST_STATUS_FRAMES;
+  },
+  /** Clipped samples since the stage was set. */
+  get TotalClipped() {
+    return native.POST_STATUS_TOTAL_CLIPPED;
+  },
 };
 
 /**
@@ -95,7 +255,9 @@ const VadParameter = {
    *
    * **Default:** 0.03 (30 ms)
    */
-  SpeechHoldDuration: native.VAD_PARAM_SPEECH_HOLD_DURATION,
+  get SpeechHoldDuration() {
+    return native.VAD_PARAM_SPEECH_HOLD_DURATION;
+  },
 
   /**
    * Controls the sensitivity of the VAD.
@@ -108,7 +270,9 @@ const VadParameter = {
    *
    * Default: model-specific.
    */
-  Sensitivity: native.VAD_PARAM_SENSITIVITY,
+  get Sensitivity() {
+    return native.VAD_PARAM_SENSITIVITY;
+  },
 
   /**
    * Controls for how long speech needs to be present in the audio signal before
@@ -122,18 +286,42 @@ const VadParameter = {
    * Range: 0.0 to 1.0 (value in seconds)
    * Default: 0.0
    */
-  MinimumSpeechDuration: native.VAD_PARAM_MINIMUM_SPEECH_DURATION,
+  get MinimumSpeechDuration() {
+    return native.VAD_PARAM_MINIMUM_SPEECH_DURATION;
+  },
 };
 
 /**
  * Context for managing processor state and parameters.
- * Created via Processor.getProcessorContext().
+ * Created via Processor.getProcessorContext(), or from any worker thread via
+ * ProcessorContext.fromSession().
  */
 class ProcessorContext {
   constructor(nativeContext) {
     this._context = nativeContext;
   }
 
+  /**
+   * Gets the context of the processor registered under a session ID with
+   * Processor.registerSession(). Works from any worker thread of the process, so a
+   * control thread can change parameters of a processor owned by an audio thread
+   * directly.
+   *
+   * The context follows the processor through Processor.swapModel(), and keeps its
+   * native state alive until the context is garbage-collected.
+   *
+   * @param {string} sessionId - ID the processor was registered under
+   * @returns {ProcessorContext} The context of the registered processor.
+   * @throws {Error} If no live processor is registered under the ID.
+   *
+   * @example
+   * const context = ProcessorContext.fromSession("call-42");
+   * context.setParameter(ProcessorParameter.EnhancementLevel, 0.5);
+   */
+  static fromSession(sessionId) {
+    return new ProcessorContext(native.processorContextFromSession(sessionId));
+  }
+
   /**
    * Clears all internal state and buffers.
    *
@@ -180,6 +368,61 @@ class ProcessorContext {
     return native.processorContextGetParameter(this._context, parameter);
   }
 
+  /**
+   * Schedules a parameter change at a frame of the stream, optionally as a linear
+   * ramp. The change is stored natively and applied by the processing path at block
+   * boundaries, wherever processing runs, so no timers or per-block calls are needed.
+   *
+   * Frames count from the last initialize() at the configured sample rate; see
+   * getStreamPosition(). A change applies from the block containing `atSample`, and
+   * during a ramp each block gets the value reached at its end.
+   * Changes in the past apply at the next block as if on time. Of several changes
+   * due for one parameter, the latest one wins. initialize() drops all scheduled
+   * changes, including those scheduled from another thread while it runs. Up to 64
+   * changes can be pending at once.
+   *
+   * While a real-time budget sheds load (see setRealtimeBudget()), changes are held so
+   * they do not undo the shedding steps. Once it recovers, they catch up: the latest
+   * due step applies, and a ramp continues at the value it has reached by then.
+   *
+   * This function can be called from any thread.
+   *
+   * @param {ProcessorParameter} parameter - Parameter to change
+   * @param {number} value - Target value, between 0 and 1
+   * @param {number} atSample - Stream frame the change starts at
+   * @param {number} [rampSamples=0] - Length of the ramp in frames, 0 for a step
+   * @throws {Error} If the value is out of range or too many changes are pending.
+   *
+   * @example
+   * // Fade enhancement in over 2 s from now
+   * const now = processorContext.getStreamPosition();
+   * processorContext.scheduleParameter(
+   *   ProcessorParameter.EnhancementLevel,
+   *   1.0,
+   *   now,
+   *   2 * sampleRate,
+   * );
+   */
+  scheduleParameter(parameter, value, atSample, rampSamples = 0) {
+    native.processorContextScheduleParameter(
+      this._context,
+      parameter,
+      value,
+      atSample,
+      rampSamples,
+    );
+  }
+
+  /**
+   * Returns the number of frames processed since the last initialize(), the
+   * position scheduleParameter() counts in.
+   *
+   * @returns {number} The stream position in frames.
+   */
+  getStreamPosition() {
+    return native.processorContextGetStreamPosition(this._context);
+  }
+
   /**
    * Returns the total output delay in samples for the current audio configuration.
    *
@@ -242,7 +485,8 @@ class ProcessorContext {
  *   - The latency of the VAD prediction is equal to the backing model's processing latency.
  *   - If the backing model stops being processed, the VAD will not update its speech detection prediction.
  *
- * Created via Processor.getVadContext().
+ * Created via Processor.getVadContext(), or from any worker thread via
+ * VadContext.fromSession().
  *
  * @example
  * const vad = processor.getVadContext();
@@ -256,6 +500,22 @@ class VadContext {
     this._context = nativeContext;
   }
 
+  /**
+   * Gets the VAD context of the processor registered under a session ID with
+   * Processor.registerSession(). Works from any worker thread of the process.
+   *
+   * @param {string} sessionId - ID the processor was registered under
+   * @returns {VadContext} The VAD context of the registered processor.
+   * @throws {Error} If no live processor is registered under the ID.
+   *
+   * @example
+   * const vad = VadContext.fromSession("call-42");
+   * console.log(vad.isSpeechDetected());
+   */
+  static fromSession(sessionId) {
+    return new VadContext(native.vadContextFromSession(sessionId));
+  }
+
   /**
    * Returns the VAD's prediction.
    *
@@ -299,6 +559,219 @@ class VadContext {
   }
 }
 
+/**
+ * Lock-free single-producer/single-consumer ring buffer of interleaved float32 audio
+ * backed by a SharedArrayBuffer.
+ *
+ * The ring can be shared between worker threads without copying or cloning audio
+ * through postMessage: create it in one thread, pass `ring.sharedBuffer` to another
+ * thread (e.g. via `workerData` or `postMessage`) and attach with
+ * AudioRing.fromSharedBuffer(). Read and write indices are updated atomically by the
+ * native layer.
+ *
+ * Waiting uses futex semantics on the index words of the header: JavaScript threads
+ * block with `Atomics.wait()` and native ring workers (see Processor.startRingWorker())
+ * with an OS futex. Every read or write wakes both kinds of waiters: JavaScript ones
+ * through `Atomics.notify()`, which for moves made by a ring worker is posted to the
+ * event loop of the thread that started the worker.
+ *
+ * The ring is single-producer/single-consumer: only one thread may write and one
+ * thread may read at a time. Give every producer its own ring.
+ *
+ * @example
+ * // Network worker
+ * const ring = new AudioRing(sampleRate, 1);
+ * processingWorker.postMessage(ring.sharedBuffer);
+ * socket.on("data", (chunk) => ring.write(chunk));
+ *
+ * // Processing worker
+ * const input = AudioRing.fromSharedBuffer(sharedBuffer);
+ */
+class AudioRing {
+  /**
+   * Creates a ring buffer in a new SharedArrayBuffer.
+   *
+   * @param {number} capacityFrames - Minimum number of frames the ring can hold.
+   *   Rounded up to the next power of two.
+   * @param {number} [numChannels=1] - Number of interleaved channels per frame
+   * @param {SharedArrayBuffer} [sharedBuffer] - Existing ring memory to attach to.
+   *   Prefer AudioRing.fromSharedBuffer() for this.
+   */
+  constructor(capacityFrames, numChannels = 1, sharedBuffer = undefined) {
+    const headerBytes = native.AUDIO_RING_HEADER_LENGTH * 4;
+
+    if (sharedBuffer === undefined) {
+      let capacity = 1;
+      while (capacity < capacityFrames) {
+        capacity *= 2;
+      }
+      sharedBuffer = new SharedArrayBuffer(
+        headerBytes + capacity * numChannels * 4,
+      );
+      this._header = new Int32Array(
+        sharedBuffer,
+        0,
+        native.AUDIO_RING_HEADER_LENGTH,
+      );
+      this._data = new Float32Array(sharedBuffer, headerBytes);
+      this._ring = native.audioRingNew(
+        this._header,
+        this._data,
+        capacity,
+        numChannels,
+      );
+    } else {
+      this._header = new Int32Array(
+        sharedBuffer,
+        0,
+        native.AUDIO_RING_HEADER_LENGTH,
+      );
+      this._data = new Float32Array(sharedBuffer, headerBytes);
+      this._ring = native.audioRingNew(this._header, this._data);
+    }
+
+    this._sharedBuffer = sharedBuffer;
+  }
+
+  /**
+   * Attaches to a ring created in another thread.
+   *
+   * @param {SharedArrayBuffer} sharedBuffer - The `sharedBuffer` of an existing AudioRing
+   * @returns {AudioRing} A view of the same ring.
+   */
+  static fromSharedBuffer(sharedBuffer) {
+    return new AudioRing(0, 0, sharedBuffer);
+  }
+
+  /**
+   * The SharedArrayBuffer holding the ring. Pass this to other threads.
+   * @type {SharedArrayBuffer}
+   */
+  get sharedBuffer() {
+    return this._sharedBuffer;
+  }
+
+  /**
+   * Number of frames the ring can hold.
+   * @type {number}
+   */
+  get capacity() {
+    return this._header[native.AUDIO_RING_CAPACITY];
+  }
+
+  /**
+   * Number of interleaved channels per frame.
+   * @type {number}
+   */
+  get numChannels() {
+    return this._header[native.AUDIO_RING_NUM_CHANNELS];
+  }
+
+  /**
+   * Writes as many whole frames of interleaved audio as fit into the ring.
+   *
+   * @param {Float32Array|Buffer|Uint8Array|ArrayBuffer} buffer - Interleaved audio
+   * @returns {number} The number of frames written.
+   */
+  write(buffer) {
+    const written = native.audioRingWrite(this._ring, buffer);
+    if (written > 0) {
+      Atomics.notify(this._header, native.AUDIO_RING_WRITE_INDEX);
+    }
+    return written;
+  }
+
+  /**
+   * Reads as many whole frames as are available and fit into the buffer.
+   *
+   * @param {Float32Array|Buffer|Uint8Array|ArrayBuffer} buffer - Destination for interleaved audio
+   * @returns {number} The number of frames read.
+   */
+  read(buffer) {
+    const read = native.audioRingRead(this._ring, buffer);
+    if (read > 0) {
+      Atomics.notify(this._header, native.AUDIO_RING_READ_INDEX);
+    }
+    return read;
+  }
+
+  /**
+   * @returns {number} The number of frames ready to be read.
+   */
+  availableFrames() {
+    return native.audioRingAvailable(this._ring);
+  }
+
+  /**
+   * @returns {number} The number of frames that can be written.
+   */
+  freeFrames() {
+    return native.audioRingFree(this._ring);
+  }
+
+  /**
+   * Blocks until at least `numFrames` frames can be read.
+   *
+   * Uses `Atomics.wait()`, so it cannot be called from the main thread. Blocks written
+   * by a ring worker wake the waiter through the event loop of the thread that called
+   * Processor.startRingWorker(), so that thread must not block on the rings itself.
+   *
+   * @param {number} numFrames - Number of frames to wait for
+   * @param {number} [timeoutMs=Infinity] - Maximum time to wait
+   * @returns {boolean} True if the frames are available, false on timeout.
+   */
+  waitForFrames(numFrames, timeoutMs = Infinity) {
+    return this._waitFor(
+      native.AUDIO_RING_WRITE_INDEX,
+      native.AUDIO_RING_WRITE_JS_WAITERS,
+      () => this.availableFrames() >= numFrames,
+      timeoutMs,
+    );
+  }
+
+  /**
+   * Blocks until at least `numFrames` frames can be written.
+   *
+   * Uses `Atomics.wait()`, so it cannot be called from the main thread. Blocks consumed
+   * by a ring worker wake the waiter like in waitForFrames().
+   *
+   * @param {number} numFrames - Number of frames to wait for
+   * @param {number} [timeoutMs=Infinity] - Maximum time to wait
+   * @returns {boolean} True if there is enough space, false on timeout.
+   */
+  waitForSpace(numFrames, timeoutMs = Infinity) {
+    return this._waitFor(
+      native.AUDIO_RING_READ_INDEX,
+      native.AUDIO_RING_READ_JS_WAITERS,
+      () => this.freeFrames() >= numFrames,
+      timeoutMs,
+    );
+  }
+
+  _waitFor(index, waiters, ready, timeoutMs) {
+    const deadline = performance.now() + timeoutMs;
+    while (!ready()) {
+      const remaining = deadline - performance.now();
+      if (remaining <= 0) {
+        return false;
+      }
+      const observed = Atomics.load(this._header, index);
+      // Registered before the last check, so a ring worker moving the index after it
+      // sees the waiter and notifies
+      Atomics.add(this._header, waiters, 1);
+      try {
+        if (ready()) {
+          break;
+        }
+        Atomics.wait(this._header, index, observed, remaining);
+      } finally {
+        Atomics.sub(this._header, waiters, 1);
+      }
+    }
+    return true;
+  }
+}
+
 /**
  * OpenTelemetry configuration for a processor.
  *
@@ -389,6 +862,57 @@ class Model {
     return new Model(nativeModel);
   }
 
+  /**
+   * Loads a model from a read-only shared mapping of its file instead of reading the
+   * file into private memory.
+   *
+   * The mapped pages come from the page cache, so all processes on the host that load
+   * the same file share one copy of the model data in physical memory, e.g. the
+   * workers of a Node.js `cluster` or PM2. The mapping lives for the rest of the
+   * process; loading the same file again reuses it. getMemoryUsage() reports the
+   * resident and shared bytes. Falls back to Model.fromFile() on platforms other than
+   * Linux.
+   *
+   * The process holds a read lease on the file, so opening it for writing or
+   * truncating it waits until the mapping has moved to a private copy, and running
+   * processes keep their weights. Sharing needs the process to own the file and nobody
+   * to have it open for writing; otherwise the file is copied into private memory.
+   * Replace model files by renaming a new file over them.
+   *
+   * @param {string} path - Path to the model file (.aicmodel)
+   * @returns {Model} A new Model instance.
+   * @throws {Error} If the file cannot be mapped or model creation fails.
+   *
+   * @example
+   * // In every cluster worker
+   * const model = Model.fromFileMapped("/opt/models/sparrow-l-48khz.aicmodel");
+   */
+  static fromFileMapped(path) {
+    if (native.modelFromFileMapped === undefined) {
+      return Model.fromFile(path);
+    }
+    return new Model(native.modelFromFileMapped(path));
+  }
+
+  /**
+   * Returns the physical memory of a model loaded with Model.fromFileMapped(), as
+   * accounted by the kernel for this process.
+   *
+   * `sharedBytes` counts resident pages that other processes map as well, and
+   * `proportionalBytes` divides every resident page by the number of processes
+   * mapping it, so summing it over all workers gives the real footprint.
+   *
+   * @returns {{mappedBytes: number, residentBytes: number, sharedBytes: number,
+   *   privateBytes: number, proportionalBytes: number}|null} Memory usage in bytes,
+   *   or null if the model was not loaded mapped.
+   */
+  getMemoryUsage() {
+    if (native.modelMemoryUsage === undefined) {
+      return null;
+    }
+    return native.modelMemoryUsage(this._model);
+  }
+
   /**
    * Downloads a model file from the ai-coustics artifact CDN.
    *
@@ -478,6 +1002,108 @@ class Model {
   }
 }
 
+/**
+ * Channel on which `Processor` publishes one message per process call, while it has
+ * subscribers.
+ */
+const PROCESS_CHANNEL = "aic-sdk:process";
+const processChannel = diagnosticsChannel.channel(PROCESS_CHANNEL);
+
+/** Name of the `measure` entries created for process calls. */
+const PROCESS_ENTRY_NAME = "aic-sdk.process";
+let performanceEntriesEnabled = false;
+
+/**
+ * Enables or disables `perf_hooks` entries for process calls.
+ *
+ * While enabled, every process call of a `Processor` creates a `measure` entry named
+ * "aic-sdk.process" for `PerformanceObserver`s. It starts when the call starts and
+ * lasts until it returns, and its `detail` holds the layout, the frame counts and
+ * `sdkDuration`, the SDK processing time within the call from the native monotonic
+ * clock. Entries are not kept in the global performance timeline.
+ *
+ * @param {boolean} [enabled=true]
+ *
+ * @example
+ * const obs = new PerformanceObserver((list) => record(list.getEntries()));
+ * obs.observe({ entryTypes: ["measure"] });
+ * enablePerformanceEntries();
+ */
+function enablePerformanceEntries(enabled = true) {
+  performanceEntriesEnabled = enabled;
+}
+
+/**
+ * Number of samples in a process method's buffer argument.
+ */
+function sampleCount(buffer) {
+  return buffer.byteLength / Float32Array.BYTES_PER_ELEMENT;
+}
+
+/**
+ * Runs a process call of `processor`, timing it natively, and reports it to
+ * `diagnostics_channel` subscribers and `perf_hooks` observers. Only used while
+ * either is listening, so uninstrumented calls pay a single branch.
+ *
+ * @param {Processor} processor
+ * @param {string} layout - "interleaved", "sequential", "planar" or "ring"
+ * @param {number} numFrames - Frames passed in, or -1 if only known afterwards
+ * @param {function(): number} process - The native call, returning valid frames
+ */
+function instrumentedProcess(processor, layout, numFrames, process) {
+  // Discards SDK time of uninstrumented calls, e.g. from FrameAdapter
+  native.takeProcessTime();
+  const startTime = performance.now();
+  let validFrames = 0;
+  let error;
+  try {
+    validFrames = process();
+    return validFrames;
+  } catch (e) {
+    error = e;
+    throw e;
+  } finally {
+    const duration = performance.now() - startTime;
+    const sdkDuration = native.takeProcessTime();
+    const message = {
+      processor,
+      layout,
+      numChannels: processor._numChannels,
+      numFrames: numFrames < 0 ? validFrames : numFrames,
+      validFrames,
+      duration,
+      sdkDuration,
+      startTime,
+      error,
+    };
+    if (processChannel.hasSubscribers) {
+      processChannel.publish(message);
+    }
+    if (performanceEntriesEnabled) {
+      performance.measure(PROCESS_ENTRY_NAME, {
+        start: startTime,
+        duration,
+        detail: {
+          layout,
+          numChannels: message.numChannels,
+          numFrames: message.numFrames,
+          validFrames,
+          sdkDuration,
+          error: error !== undefined,
+        },
+      });
+      performance.clearMeasures(PROCESS_ENTRY_NAME);
+    }
+  }
+}
+
+/**
+ * Whether process calls are currently observed.
+ */
+function isProcessObserved() {
+  return processChannel.hasSubscribers || performanceEntriesEnabled;
+}
+
 /**
  * High-level wrapper for the ai-coustics audio enhancement processor.
  *
@@ -514,6 +1140,9 @@ class Processor {
    */
   constructor(model, licenseKey, otelConfig = null) {
     this._processor = native.processorNew(model._model, licenseKey, otelConfig);
+    // Kept for the processors created by swapModel()
+    this._licenseKey = licenseKey;
+    this._otelConfig = otelConfig;
   }
 
   /**
@@ -526,27 +1155,46 @@ class Processor {
    * Warning: Do not call from audio processing threads as this allocates memory.
    *
    * Note: All channels are mixed to mono for processing. To process channels
-   * independently, create separate Processor instances.
+   * independently, use MultiChannelProcessor.
    *
    * @param {number} sampleRate - Sample rate in Hz (8000 - 192000)
    * @param {number} numChannels - Number of audio channels
    * @param {number} numFrames - Samples per channel provided to each processing call
    * @param {boolean} [allowVariableFrames=false] - Allow variable frame sizes (adds latency)
-   * @throws {Error} If the audio configuration is unsupported.
+   * @param {Object} [options]
+   * @param {boolean} [options.compensateDelay=false] - Align output with input by trimming
+   *   the output delay from the start of the stream. The process methods then return fewer
+   *   valid frames until the delay has passed, and flush() returns the remaining tail.
+   *   Also applies to EnhanceStream, EnhanceTransformStream and FrameAdapter.
+   * @throws {Error} If the audio configuration is unsupported or a ring worker is
+   *   running (see stopRingWorker()).
    *
    * @example
    * const sampleRate = model.getOptimalSampleRate();
    * const numFrames = model.getOptimalNumFrames(sampleRate);
    * processor.initialize(sampleRate, 2, numFrames, false);
    */
-  initialize(sampleRate, numChannels, numFrames, allowVariableFrames = false) {
+  initialize(
+    sampleRate,
+    numChannels,
+    numFrames,
+    allowVariableFrames = false,
+    options = {},
+  ) {
+    const { compensateDelay = false } = options;
     native.processorInitialize(
       this._processor,
       sampleRate,
       numChannels,
       numFrames,
       allowVariableFrames,
+      compensateDelay,
     );
+    this._numChannels = numChannels;
+    this._numFrames = numFrames;
+    if (this._postProcess) {
+      this._applyPostProcess();
+    }
   }
 
   /**
@@ -554,7 +1202,17 @@ class Processor {
    *
    * Enhances speech in the provided audio buffer. The buffer is modified in-place.
    *
-   * @param {Float32Array} buffer - Interleaved audio buffer (channel samples alternating)
+   * Besides a Float32Array, the buffer can be a Buffer, Uint8Array or ArrayBuffer holding
+   * raw 32-bit float little-endian PCM, e.g. data received from a socket. Views at a 4-byte
+   * aligned offset are processed without copying. Views at any other offset are staged
+   * through an aligned scratch buffer owned by the processor.
+   *
+   * With `compensateDelay`, the leading output delay is trimmed and the valid frames are
+   * moved to the front of the buffer.
+   *
+   * @param {Float32Array|Buffer|Uint8Array|ArrayBuffer} buffer - Interleaved audio buffer (channel samples alternating)
+   * @returns {number} The number of valid frames at the front of the buffer. Equals the
+   *   number of frames passed in unless `compensateDelay` is trimming the output delay.
    * @throws {Error} If processing fails (processor not initialized, invalid buffer size, etc.)
    *
    * @example
@@ -563,7 +1221,13 @@ class Processor {
    * processor.processInterleaved(buffer);
    */
   processInterleaved(buffer) {
-    native.processorProcessInterleaved(this._processor, buffer);
+    if (isProcessObserved()) {
+      const numFrames = sampleCount(buffer) / this._numChannels;
+      return instrumentedProcess(this, "interleaved", numFrames, () =>
+        native.processorProcessInterleaved(this._processor, buffer),
+      );
+    }
+    return native.processorProcessInterleaved(this._processor, buffer);
   }
 
   /**
@@ -572,7 +1236,10 @@ class Processor {
    * Enhances speech in the provided audio buffer. The buffer is modified in-place.
    * All samples for each channel are stored contiguously.
    *
-   * @param {Float32Array} buffer - Sequential audio buffer (all channel 0 samples, then all channel 1 samples, etc.)
+   * Accepts the same buffer types as processInterleaved().
+   *
+   * @param {Float32Array|Buffer|Uint8Array|ArrayBuffer} buffer - Sequential audio buffer (all channel 0 samples, then all channel 1 samples, etc.)
+   * @returns {number} The number of valid frames at the start of each channel.
    * @throws {Error} If processing fails (processor not initialized, invalid buffer size, etc.)
    *
    * @example
@@ -581,7 +1248,13 @@ class Processor {
    * processor.processSequential(buffer);
    */
   processSequential(buffer) {
-    native.processorProcessSequential(this._processor, buffer);
+    if (isProcessObserved()) {
+      const numFrames = sampleCount(buffer) / this._numChannels;
+      return instrumentedProcess(this, "sequential", numFrames, () =>
+        native.processorProcessSequential(this._processor, buffer),
+      );
+    }
+    return native.processorProcessSequential(this._processor, buffer);
   }
 
   /**
@@ -589,7 +1262,10 @@ class Processor {
    *
    * Enhances speech in the provided audio buffers. The buffers are modified in-place.
    *
-   * @param {Float32Array[]} buffers - Array of audio buffers, one per channel (max 16 channels)
+   * Each channel accepts the same buffer types as processInterleaved().
+   *
+   * @param {Array<Float32Array|Buffer|Uint8Array|ArrayBuffer>} buffers - Array of audio buffers, one per channel (max 16 channels)
+   * @returns {number} The number of valid frames at the start of each buffer.
    * @throws {Error} If processing fails (processor not initialized, too many channels, invalid buffer size, etc.)
    *
    * @example
@@ -598,55 +1274,1372 @@ class Processor {
    * processor.processPlanar([left, right]);
    */
   processPlanar(buffers) {
-    native.processorProcessPlanar(this._processor, buffers);
+    if (isProcessObserved()) {
+      const numFrames = buffers.length > 0 ? sampleCount(buffers[0]) : 0;
+      return instrumentedProcess(this, "planar", numFrames, () =>
+        native.processorProcessPlanar(this._processor, buffers),
+      );
+    }
+    return native.processorProcessPlanar(this._processor, buffers);
   }
 
   /**
-   * Creates a ProcessorContext instance.
+   * Feeds silence through the processor until the audio held back by the output delay
+   * has come out, and returns it.
    *
-   * This can be used to control all parameters and other settings of the processor.
+   * Without `compensateDelay` this is the last `getOutputDelay()` frames of enhanced
+   * audio. With `compensateDelay` it is exactly the frames still missing for the output
+   * to be as long as the input. Audio processed afterwards is treated as a new stream;
+   * call ProcessorContext.reset() first if it is unrelated to the previous audio.
    *
-   * @returns {ProcessorContext} A new ProcessorContext instance.
+   * Warning: Allocates memory. Intended for the end of offline jobs.
+   *
+   * @returns {Float32Array} The remaining enhanced audio, interleaved
+   * @throws {Error} If the processor is not initialized or processing fails.
    *
    * @example
-   * const processorContext = processor.getProcessorContext();
-   * processorContext.setParameter(ProcessorParameter.EnhancementLevel, 0.8);
+   * processor.initialize(sampleRate, numChannels, numFrames, false, {
+   *   compensateDelay: true,
+   * });
+   * // ...process all blocks...
+   * const tail = processor.flush();
    */
-  getProcessorContext() {
-    const nativeContext = native.processorGetProcessorContext(this._processor);
-    return new ProcessorContext(nativeContext);
+  flush() {
+    if (this._postProcess && this._postProcess.pcm16 !== null) {
+      // The tail can be longer than a block
+      this._applyPostProcess(native.processorFlushFrames(this._processor));
+    }
+    return toFloat32Array(native.processorFlush(this._processor));
   }
 
   /**
-   * Creates a Voice Activity Detector Context instance.
+   * Processes all complete blocks waiting in an input AudioRing and writes the enhanced
+   * audio to an output AudioRing.
    *
-   * @returns {VadContext} A new VadContext instance.
+   * Blocks are `numFrames` frames as passed to initialize(), in interleaved layout.
+   * Blocks that are contiguous in the input ring are enhanced in place in shared memory.
+   * Processing stops when the input has less than one block or the output is full.
+   *
+   * @param {AudioRing} input - Ring to consume audio from
+   * @param {AudioRing} output - Ring to write enhanced audio to
+   * @returns {number} The number of frames processed.
+   * @throws {Error} If the processor is not initialized, the channel counts do not match,
+   *   processing fails, or a ring worker is running or stopped because processing
+   *   failed.
    *
    * @example
-   * const vad = processor.getVadContext();
-   * if (vad.isSpeechDetected()) {
-   *   console.log("Speech detected!");
-   * }
+   * const processed = processor.processRing(input, output);
    */
-  getVadContext() {
-    const nativeContext = native.processorGetVadContext(this._processor);
-    return new VadContext(nativeContext);
+  processRing(input, output) {
+    const processed = isProcessObserved()
+      ? instrumentedProcess(this, "ring", -1, () =>
+          native.processorProcessRing(
+            this._processor,
+            input._ring,
+            output._ring,
+          ),
+        )
+      : native.processorProcessRing(this._processor, input._ring, output._ring);
+    if (processed > 0) {
+      Atomics.notify(input._header, native.AUDIO_RING_READ_INDEX);
+      Atomics.notify(output._header, native.AUDIO_RING_WRITE_INDEX);
+    }
+    return processed;
   }
-}
 
-/**
- * Returns the version of the ai-coustics core SDK library used by this package.
- *
- * Note: This is not necessarily the same as this package's version.
- *
- * @returns {string} The library version as a string.
- *
- * @example
- * const version = getVersion();
- * console.log(`ai-coustics SDK version: ${version}`);
- */
-function getVersion() {
-  return native.getVersion();
+  /**
+   * Starts a native thread that continuously moves audio from `input` through the
+   * processor into `output`, without involving the JavaScript event loop.
+   *
+   * The thread sleeps on the input ring until a full block is available and on the
+   * output ring while it is full. Only one ring worker can run per processor, and
+   * processRing() cannot be used while it runs.
+   *
+   * If a block fails to process, the thread stops and leaves the block in the input
+   * ring. getStats() and processRing() then throw the error until stopRingWorker().
+   *
+   * `threadOptions` control how the thread is scheduled (Linux only) and how it treats
+   * denormal numbers. They are applied by the thread before it processes anything. A
+   * setting the system does not permit is skipped instead of failing: the returned
+   * report lists the settings in effect and an error for each one that is not.
+   * SCHED_FIFO needs CAP_SYS_NICE or an RLIMIT_RTPRIO of at least the priority, and so
+   * does a negative nice level.
+   *
+   * @param {AudioRing} input - Ring to consume audio from
+   * @param {AudioRing} output - Ring to write enhanced audio to
+   * @param {Object|null} [threadOptions=null] - Settings of the worker thread
+   * @param {number[]} [threadOptions.cpus] - CPUs the thread may run on
+   * @param {number} [threadOptions.realtimePriority] - SCHED_FIFO priority (1 - 99)
+   * @param {number} [threadOptions.nice] - Nice level (-20 - 19). Also used when the
+   *   real-time priority is not permitted.
+   * @param {boolean} [threadOptions.flushDenormals=false] - Treat denormal inputs and
+   *   results of floating-point arithmetic as zero (FTZ and DAZ on x86-64, FZ on
+   *   AArch64), so decaying filter state does not hit slow denormal arithmetic
+   * @returns {{
+   *   cpus: number[]|null,
+   *   realtimePriority: number|null,
+   *   nice: number|null,
+   *   flushDenormals: boolean,
+   *   errors: string[],
+   * }} The settings in effect on the thread, null or false for those that are not,
+   *   and why requested ones are not.
+   * @throws {Error} If the processor is not initialized, the channel counts do not match,
+   *   or a ring worker is already running.
+   * @throws {RangeError} If a thread option is out of range.
+   *
+   * @example
+   * const report = processor.startRingWorker(input, output, {
+   *   cpus: [3],
+   *   realtimePriority: 80,
+   *   nice: -10,
+   *   flushDenormals: true,
+   * });
+   * for (const error of report.errors) console.warn(error);
+   * // ... later
+   * processor.stopRingWorker();
+   */
+  startRingWorker(input, output, threadOptions = null) {
+    const report = native.processorStartRingWorker(
+      this._processor,
+      input._ring,
+      output._ring,
+      threadOptions,
+    );
+    this._ringWorkerRings = [input, output];
+    return report;
+  }
+
+  /**
+   * Stops the ring worker started with startRingWorker() and waits for it to exit.
+   *
+   * @throws {Error} If the ring worker stopped because processing failed.
+   */
+  stopRingWorker() {
+    try {
+      native.processorStopRingWorker(this._processor);
+    } finally {
+      this._ringWorkerRings = null;
+    }
+  }
+
+  /**
+   * Returns runtime statistics collected since initialization or the last resetStats().
+   *
+   * Every process call is counted, including those made by streams, ring workers and
+   * the frame accumulator. Latencies are measured natively around the model call and
+   * reported in microseconds with about 6 % resolution. Lock waits are only recorded
+   * when another thread held the processor, for example a ring worker or an async
+   * stream sharing it.
+   *
+   * @returns {{
+   *   calls: number,
+   *   framesProcessed: number,
+   *   processTime: LatencySummary,
+   *   lock: { acquisitions: number, contendedWait: LatencySummary },
+   *   errors: number,
+   *   errorsByType: Object<string, number>,
+   *   levels?: SignalLevels,
+   * }} Statistics, where LatencySummary is `{ count, totalUs, meanUs, p50Us, p90Us,
+   *   p99Us, p999Us, maxUs }`. `levels` is present while setSignalMetrics() is on,
+   *   see there.
+   * @throws {Error} If the ring worker stopped because processing failed, see
+   *   startRingWorker().
+   *
+   * @example
+   * const { processTime } = processor.getStats();
+   * console.log(`p99: ${processTime.p99Us} us`);
+   */
+  getStats() {
+    return native.processorGetStats(this._processor);
+  }
+
+  /**
+   * Clears all statistics returned by getStats().
+   */
+  resetStats() {
+    native.processorResetStats(this._processor);
+  }
+
+  /**
+   * Turns on measuring the signal level before and after enhancement on every process
+   * call, for noise reduction telemetry.
+   *
+   * The levels are computed natively in one vectorized pass over the block on each side
+   * of the model, over all channels, and added to getStats() as `levels`: the RMS and
+   * peak of input and output since the last resetStats(), the energy change in dB
+   * (negative when the model removed energy), and the same values for the `last`
+   * block. Like the other statistics, every process path is covered.
+   *
+   * @param {boolean} [enabled=true] - Whether to measure levels
+   *
+   * @example
+   * processor.setSignalMetrics(true);
+   * // ...process a call...
+   * const { levels } = processor.getStats();
+   * console.log(`removed ${(-levels.energyDeltaDb).toFixed(1)} dB`);
+   */
+  setSignalMetrics(enabled = true) {
+    native.processorSetSignalMetrics(this._processor, enabled);
+  }
+
+  /**
+   * Sets a real-time budget for each process call and sheds enhancement under sustained
+   * overload.
+   *
+   * A call on `n` frames misses its deadline when it takes longer than
+   * `n / sampleRate * factor` seconds. When `missThreshold` of the last `windowCalls`
+   * calls missed, the next of `steps` is applied: a number caps
+   * `ProcessorParameter.EnhancementLevel`, `"bypass"` sets `ProcessorParameter.Bypass`.
+   * After `recoverCalls` calls in a row without a miss, one step is undone. The output
+   * delay does not change in bypass, so delay compensation and stream alignment are not
+   * affected. The parameters in effect before the first step are restored on full
+   * recovery, on initialize() and when the budget is removed.
+   *
+   * Deadlines are checked natively on every process path, including streams and ring
+   * workers. Events are delivered asynchronously on the main thread. getStats() gains a
+   * `realtime` entry with the miss counters and the current step.
+   *
+   * @param {Object|null} options - Budget options, or null to remove the budget
+   * @param {number} [options.factor=1] - Share of the block duration a call may take
+   * @param {number} [options.windowCalls=50] - Calls considered for shedding, at most 64
+   * @param {number} [options.missThreshold=5] - Misses within the window that trigger the
+   *   next step
+   * @param {number} [options.recoverCalls=500] - Calls without a miss before one step is
+   *   undone
+   * @param {Array<number|"bypass">} [options.steps=[0.5, "bypass"]] - Shedding steps,
+   *   applied in order: enhancement levels between 0 and 1, or `"bypass"`
+   * @param {function(Object): void} [options.onEvent] - Called with `{ type, step,
+   *   enhancementLevel, bypass, missesInWindow, totalMisses, callUs, budgetUs }` where
+   *   `type` is `"shed"` or `"recover"`
+   * @throws {Error} If the processor is not initialized or an option is out of range.
+   * @throws {RangeError} If a step is an enhancement level outside 0 to 1.
+   *
+   * @example
+   * processor.setRealtimeBudget({
+   *   factor: 0.5,
+   *   onEvent: (event) => console.warn(`${event.type} to step ${event.step}`),
+   * });
+   */
+  setRealtimeBudget(options) {
+    if (options === null || options === undefined) {
+      native.processorSetRealtimeBudget(this._processor, null);
+      return;
+    }
+    const {
+      factor = 1,
+      windowCalls = 50,
+      missThreshold = 5,
+      recoverCalls = 500,
+      steps = [0.5, "bypass"],
+      onEvent = () => {},
+    } = options;
+    native.processorSetRealtimeBudget(
+      this._processor,
+      { factor, windowCalls, missThreshold, recoverCalls, steps },
+      onEvent,
+    );
+  }
+
+  /**
+   * Sets a post-processing stage that runs natively in one pass over the enhanced
+   * output of processInterleaved(), processSequential(), processPlanar() and flush(),
+   * right after enhancement: output gain, a soft limiter, peak and clip detection, and
+   * optionally packing to interleaved 16-bit PCM.
+   *
+   * The float output is modified in place. Its peak after the gain, the number of
+   * samples beyond full scale and the number of limited samples of the last call are
+   * written to `status`, indexed by `PostStatus`. With `pcm16`, the valid frames of
+   * each call are also packed to the `pcm16` Int16Array, interleaved, whatever the
+   * layout of the call. EnhanceStream, EnhanceTransformStream, FrameAdapter,
+   * Pipeline, processRing() and ring workers cannot run the stage and throw while it
+   * is set.
+   *
+   * The stage is kept across initialize(). Read `pcm16` from the returned object,
+   * which initialize() and flush() update when they need a larger one.
+   *
+   * The buffers stay attached to the processor. Transferring one, e.g. with
+   * `postMessage(pcm16, [pcm16.buffer])`, detaches it and later calls no longer write
+   * to it; send a copy such as `pcm16.slice(0, n)` instead.
+   *
+   * @param {Object|null} options - Stage options, or null to remove the stage
+   * @param {number} [options.gain=1] - Linear output gain
+   * @param {number|null} [options.limiterThreshold=null] - Level between 0 and 1 above
+   *   which a soft limiter compresses samples smoothly towards full scale, or null
+   *   for no limiter
+   * @param {boolean} [options.pcm16=false] - Also pack the output to 16-bit PCM
+   * @returns {{status: Float64Array, pcm16: Int16Array|null}|null} The status
+   *   buffer and the PCM output, or null if the stage was removed.
+   * @throws {Error} If the processor is not initialized, a ring worker is running, or
+   *   an option is out of range.
+   *
+   * @example
+   * const post = processor.setPostProcess({
+   *   gain: 2,
+   *   limiterThreshold: 0.9,
+   *   pcm16: true,
+   * });
+   * const validFrames = processor.processInterleaved(buffer);
+   * socket.write(post.pcm16.subarray(0, validFrames * numChannels));
+   * console.log(post.status[PostStatus.Peak]);
+   */
+  setPostProcess(options) {
+    if (options === null || options === undefined) {
+      native.processorSetPostProcess(this._processor, null);
+      this._postProcess = null;
+      return null;
+    }
+    const { gain = 1, limiterThreshold = null, pcm16 = false } = options;
+    this._postOptions = { gain, limiterThreshold, pcm16 };
+    // Backed by explicit ArrayBuffers, whose memory V8 never moves
+    const statusBytes = native.POST_STATUS_LENGTH * 8;
+    this._postProcess = {
+      status: new Float64Array(new ArrayBuffer(statusBytes)),
+      pcm16: null,
+    };
+    this._applyPostProcess();
+    return this._postProcess;
+  }
+
+  /**
+   * Passes the post-processing stage to the native processor, growing the PCM output
+   * to the current block size or `minFrames`, whichever is larger.
+   */
+  _applyPostProcess(minFrames = 0) {
+    const post = this._postProcess;
+    const { gain, limiterThreshold, pcm16 } = this._postOptions;
+    const numFrames = Math.max(this._numFrames, minFrames);
+    const numSamples = numFrames * this._numChannels;
+    if (pcm16 && (post.pcm16 === null || post.pcm16.length < numSamples)) {
+      post.pcm16 = new Int16Array(new ArrayBuffer(numSamples * 2));
+    }
+    native.processorSetPostProcess(
+      this._processor,
+      { gain, limiterThreshold },
+      post.status,
+      post.pcm16,
+    );
+  }
+
+  /**
+   * Replaces the model on the live stream without a gap or a jump in the output, e.g.
+   * to step down from a large to a small model when CPU is tight and back up later.
+   *
+   * The new model's processor is initialized on a background thread with the current
+   * configuration and parameters. It then runs alongside the current model on the
+   * live input: first for `warmupMs` to settle its internal state, then while its
+   * output is crossfaded in over `crossfadeMs`. During the transition every process
+   * call costs about twice as much.
+   *
+   * The output of a model with a shorter output delay is delayed to the current one,
+   * so the stream keeps its timing and `compensateDelay` stays valid. Swapping back to
+   * the original model removes that delay again. A model with a longer delay makes
+   * the output delay grow by the difference, spliced in by the crossfade.
+   *
+   * Contexts from getProcessorContext() and getVadContext() control whichever model
+   * is current, so those obtained before the swap keep working. Calling initialize()
+   * cancels a pending swap.
+   *
+   * @param {Model} model - The model to switch to
+   * @param {Object} [options]
+   * @param {number} [options.warmupMs=100] - Audio the new model processes before it
+   *   is heard, at least its own output delay
+   * @param {number} [options.crossfadeMs=20] - Duration of the crossfade
+   * @returns {Promise<{outputDelay: number}>} Resolves once the new model has taken
+   *   over, with the output delay of the stream in frames. Rejects if the processor
+   *   is not initialized, a swap is already in progress, the new model cannot be
+   *   initialized, or the swap is cancelled by initialize().
+   *
+   * @example
+   * const small = Model.fromFile("/path/to/small.aicmodel");
+   * await processor.swapModel(small);
+   * const context = processor.getProcessorContext();
+   */
+  swapModel(model, options = {}) {
+    const { warmupMs = 100, crossfadeMs = 20 } = options;
+    return new Promise((resolve, reject) => {
+      native.processorSwapModel(
+        this._processor,
+        model._model,
+        this._licenseKey,
+        this._otelConfig,
+        warmupMs,
+        crossfadeMs,
+        (error, result) => (error ? reject(error) : resolve(result)),
+      );
+    });
+  }
+
+  /**
+   * Creates a ProcessorContext instance.
+   *
+   * This can be used to control all parameters and other settings of the processor.
+   *
+   * @returns {ProcessorContext} A new ProcessorContext instance.
+   *
+   * @example
+   * const processorContext = processor.getProcessorContext();
+   * processorContext.setParameter(ProcessorParameter.EnhancementLevel, 0.8);
+   */
+  getProcessorContext() {
+    const nativeContext = native.processorGetProcessorContext(this._processor);
+    return new ProcessorContext(nativeContext);
+  }
+
+  /**
+   * Creates a Voice Activity Detector Context instance.
+   *
+   * @returns {VadContext} A new VadContext instance.
+   *
+   * @example
+   * const vad = processor.getVadContext();
+   * if (vad.isSpeechDetected()) {
+   *   console.log("Speech detected!");
+   * }
+   */
+  getVadContext() {
+    const nativeContext = native.processorGetVadContext(this._processor);
+    return new VadContext(nativeContext);
+  }
+
+  /**
+   * Registers the processor under a session ID, so that any worker thread of this
+   * process can control it with ProcessorContext.fromSession() and
+   * VadContext.fromSession() instead of posting messages to the thread that owns
+   * the processor.
+   *
+   * The registration does not keep the processor alive. A processor can be
+   * registered under several IDs; an ID already taken by another live processor
+   * is rejected.
+   *
+   * @param {string} sessionId - ID to register the processor under
+   * @throws {Error} If another processor is registered under the ID.
+   *
+   * @example
+   * // Audio worker
+   * processor.registerSession(callId);
+   * // Control worker
+   * const context = ProcessorContext.fromSession(callId);
+   * context.setParameter(ProcessorParameter.Bypass, 1.0);
+   */
+  registerSession(sessionId) {
+    native.processorRegisterSession(this._processor, sessionId);
+  }
+
+  /**
+   * Removes the registration under a session ID, if it refers to this processor.
+   * Contexts already obtained for the session keep working.
+   *
+   * @param {string} sessionId - ID the processor was registered under
+   */
+  unregisterSession(sessionId) {
+    native.processorUnregisterSession(this._processor, sessionId);
+  }
+}
+
+/**
+ * Enhances every channel of a multichannel stream independently, in parallel.
+ *
+ * A `Processor` mixes all channels to mono. This class instead owns one processor per
+ * channel and takes one interleaved or planar buffer per call. Interleaved audio is
+ * deinterleaved natively. Channel 0 is processed on the calling thread and every other
+ * channel on a persistent native worker thread of its own, and the call returns once
+ * all channels are done. Use it for stereo interviews or multi-participant recordings
+ * where each channel carries a different talker.
+ *
+ * @example
+ * const processor = new MultiChannelProcessor(model, licenseKey, 2);
+ * processor.initialize(sampleRate, model.getOptimalNumFrames(sampleRate));
+ * processor.processInterleaved(stereo);
+ */
+class MultiChannelProcessor {
+  /**
+   * Creates one processor per channel.
+   *
+   * @param {Model} model - The loaded model instance, shared by all channels
+   * @param {string} licenseKey - License key for the ai-coustics SDK
+   * @param {number} numChannels - Number of channels (1 - 16)
+   * @param {OtelConfig|null} [otelConfig=null] - Optional OpenTelemetry config for all
+   *   channels
+   * @param {Object|null} [threadOptions=null] - Settings of the worker threads of
+   *   channels 1 and up, see Processor.startRingWorker(). Channel 0 runs on the calling
+   *   thread, which is left as is.
+   * @throws {Error} If the channel count is out of range or processor creation fails.
+   * @throws {RangeError} If a thread option is out of range.
+   */
+  constructor(
+    model,
+    licenseKey,
+    numChannels,
+    otelConfig = null,
+    threadOptions = null,
+  ) {
+    this._processor = native.multiChannelProcessorNew(
+      model._model,
+      licenseKey,
+      numChannels,
+      otelConfig,
+      threadOptions,
+    );
+    this.numChannels = numChannels;
+  }
+
+  /**
+   * Returns the settings in effect on the worker threads of channels 1 and up, in
+   * channel order. See Processor.startRingWorker() for the report format.
+   *
+   * @returns {Object[]}
+   */
+  getThreadReports() {
+    return native.multiChannelProcessorGetThreadReports(this._processor);
+  }
+
+  /**
+   * Configures every channel's processor for the given sample rate and block size.
+   *
+   * Warning: Do not call from audio processing threads as this allocates memory.
+   *
+   * @param {number} sampleRate - Sample rate in Hz (8000 - 192000)
+   * @param {number} numFrames - Frames per channel provided to each processing call
+   * @param {boolean} [allowVariableFrames=false] - Allow variable frame sizes (adds
+   *   latency)
+   * @throws {Error} If the audio configuration is unsupported.
+   */
+  initialize(sampleRate, numFrames, allowVariableFrames = false) {
+    native.multiChannelProcessorInitialize(
+      this._processor,
+      sampleRate,
+      numFrames,
+      allowVariableFrames,
+    );
+  }
+
+  /**
+   * Enhances interleaved audio in place, each channel on its own.
+   *
+   * Accepts the same buffer types as Processor.processInterleaved().
+   *
+   * @param {Float32Array|Buffer|Uint8Array|ArrayBuffer} buffer - Interleaved audio with
+   *   `numChannels` channels
+   * @returns {number} The number of frames processed.
+   * @throws {Error} If the processor is not initialized or the buffer size is invalid.
+   */
+  processInterleaved(buffer) {
+    return native.multiChannelProcessorProcessInterleaved(
+      this._processor,
+      buffer,
+    );
+  }
+
+  /**
+   * Enhances planar audio in place, each channel on its own. Aligned channel buffers
+   * are processed without copying.
+   *
+   * @param {Array<Float32Array|Buffer|Uint8Array|ArrayBuffer>} buffers - One buffer per
+   *   channel, all of the same length
+   * @returns {number} The number of frames processed.
+   * @throws {Error} If the processor is not initialized, the number of buffers does not
+   *   match `numChannels`, or a buffer size is invalid.
+   */
+  processPlanar(buffers) {
+    return native.multiChannelProcessorProcessPlanar(this._processor, buffers);
+  }
+
+  /**
+   * Returns the ProcessorContext of one channel, e.g. to set its parameters.
+   *
+   * @param {number} channel - Channel index
+   * @returns {ProcessorContext}
+   */
+  getProcessorContext(channel) {
+    return new ProcessorContext(
+      native.multiChannelProcessorGetProcessorContext(this._processor, channel),
+    );
+  }
+
+  /**
+   * Returns the VadContext of one channel, e.g. to see which talker is speaking.
+   *
+   * @param {number} channel - Channel index
+   * @returns {VadContext}
+   */
+  getVadContext(channel) {
+    return new VadContext(
+      native.multiChannelProcessorGetVadContext(this._processor, channel),
+    );
+  }
+
+  /**
+   * Returns the runtime statistics of one channel, in the format of
+   * Processor.getStats().
+   *
+   * @param {number} channel - Channel index
+   * @returns {Object}
+   */
+  getStats(channel) {
+    return native.multiChannelProcessorGetStats(this._processor, channel);
+  }
+}
+
+/**
+ * Node.js Transform stream that enhances raw interleaved float32 little-endian PCM.
+ *
+ * Chunks of any length are re-chunked natively into blocks of the `numFrames` passed
+ * to Processor.initialize(), so the stream adds no latency beyond what the block size
+ * implies. The re-chunking buffer is owned by the native layer and reused across
+ * chunks. By default each chunk is processed on the Node.js worker pool so the event
+ * loop stays free.
+ *
+ * Ending the stream feeds silence through the processor until the audio held back by
+ * the output delay has come out, so the output is exactly `getOutputDelay()` frames
+ * longer than the input.
+ *
+ * Only one stream should feed a processor at a time.
+ *
+ * @example
+ * processor.initialize(sampleRate, 1, model.getOptimalNumFrames(sampleRate));
+ * socket.pipe(new EnhanceStream(processor)).pipe(output);
+ */
+class EnhanceStream extends Transform {
+  /**
+   * Creates a stream feeding the given processor.
+   *
+   * @param {Processor} processor - An initialized processor
+   * @param {Object} [options] - Options passed on to stream.Transform, plus:
+   * @param {number} [options.highWaterMarkFrames] - Buffer limit per side in frames.
+   *   Overrides `highWaterMark`, which would otherwise be counted in bytes.
+   * @param {boolean} [options.offload=true] - Process on the Node.js worker pool instead
+   *   of the event loop thread
+   * @throws {Error} If the processor is not initialized.
+   */
+  constructor(processor, options = {}) {
+    const { highWaterMarkFrames, offload = true, ...streamOptions } = options;
+    if (highWaterMarkFrames !== undefined) {
+      streamOptions.highWaterMark =
+        highWaterMarkFrames * processor._numChannels * 4;
+    }
+    super(streamOptions);
+
+    this._accumulator = native.frameAccumulatorNew(processor._processor);
+    this._offload = offload;
+  }
+
+  _transform(chunk, encoding, callback) {
+    if (this._offload) {
+      native
+        .frameAccumulatorPushAsync(this._accumulator, chunk)
+        .then((output) => callback(null, nonEmpty(output)), callback);
+    } else {
+      let output;
+      try {
+        output = native.frameAccumulatorPush(this._accumulator, chunk);
+      } catch (error) {
+        callback(error);
+        return;
+      }
+      callback(null, nonEmpty(output));
+    }
+  }
+
+  _flush(callback) {
+    if (this._offload) {
+      native
+        .frameAccumulatorFlushAsync(this._accumulator)
+        .then((output) => callback(null, nonEmpty(output)), callback);
+    } else {
+      let output;
+      try {
+        output = native.frameAccumulatorFlush(this._accumulator);
+      } catch (error) {
+        callback(error);
+        return;
+      }
+      callback(null, nonEmpty(output));
+    }
+  }
+}
+
+/**
+ * WHATWG TransformStream that enhances interleaved float32 audio.
+ *
+ * Behaves like EnhanceStream: chunks of any length are re-chunked natively into the
+ * processor's block size and processed on the Node.js worker pool, and closing the
+ * writable side flushes the output delay with silence. Accepts Float32Array, Uint8Array
+ * or ArrayBuffer chunks and emits Float32Array chunks. Queuing strategies count frames.
+ *
+ * @example
+ * const enhanced = readable.pipeThrough(new EnhanceTransformStream(processor));
+ */
+class EnhanceTransformStream extends TransformStream {
+  /**
+   * Creates a transform stream feeding the given processor.
+   *
+   * @param {Processor} processor - An initialized processor
+   * @param {Object} [options]
+   * @param {number} [options.highWaterMarkFrames] - Queue limit per side in frames.
+   *   Defaults to one second of audio at 48 kHz.
+   * @throws {Error} If the processor is not initialized.
+   */
+  constructor(processor, options = {}) {
+    const { highWaterMarkFrames = 48000 } = options;
+    const accumulator = native.frameAccumulatorNew(processor._processor);
+    const frameBytes = processor._numChannels * 4;
+    const strategy = {
+      highWaterMark: highWaterMarkFrames,
+      size: (chunk) => chunk.byteLength / frameBytes,
+    };
+
+    super(
+      {
+        async transform(chunk, controller) {
+          const output = await native.frameAccumulatorPushAsync(
+            accumulator,
+            chunk,
+          );
+          if (output.length > 0) {
+            controller.enqueue(toFloat32Array(output));
+          }
+        },
+        async flush(controller) {
+          const output = await native.frameAccumulatorFlushAsync(accumulator);
+          if (output.length > 0) {
+            controller.enqueue(toFloat32Array(output));
+          }
+        },
+      },
+      strategy,
+      strategy,
+    );
+  }
+}
+
+/**
+ * Adapts pushes of any length to the processor's block size with the lowest possible
+ * latency.
+ *
+ * Unlike `allowVariableFrames`, which adds latency inside the model, the adapter runs
+ * complete blocks of `numFrames` through the processor and holds back only the
+ * remainder that does not fill a block. When nothing is held back and a Float32Array
+ * is pushed, complete blocks are enhanced directly in the caller's buffer without a
+ * copy. Once a remainder is pending, input is copied into a native buffer until the
+ * remainder is used up.
+ *
+ * `getAddedLatency()` reports how many frames are currently held back, so pushing
+ * whole multiples of `numFrames` keeps the added latency at zero.
+ *
+ * Only one adapter should feed a processor at a time.
+ *
+ * @example
+ * processor.initialize(48000, 1, 480);
+ * const adapter = new FrameAdapter(processor);
+ * socket.on("packet", (samples) => send(adapter.push(samples)));
+ */
+class FrameAdapter {
+  /**
+   * Creates an adapter feeding the given processor.
+   *
+   * @param {Processor} processor - An initialized processor
+   * @throws {Error} If the processor is not initialized.
+   */
+  constructor(processor) {
+    this._accumulator = native.frameAccumulatorNew(processor._processor);
+    this._numChannels = processor._numChannels;
+    this._output = new Float32Array(0);
+  }
+
+  /**
+   * Pushes interleaved audio and returns all audio that completed a block.
+   *
+   * If the input was processed in place, the returned array is a view of the input.
+   * Otherwise it is a view of an internal buffer that is overwritten by the next call
+   * to push() or flush(), so copy it if it has to be kept.
+   *
+   * @param {Float32Array|Buffer|Uint8Array|ArrayBuffer} buffer - Interleaved audio
+   *   of any length
+   * @returns {Float32Array} Enhanced audio, possibly empty
+   * @throws {Error} If processing fails.
+   */
+  push(buffer) {
+    const pendingSamples = native.frameAccumulatorPendingSamples(
+      this._accumulator,
+    );
+    if (pendingSamples === 0 && buffer instanceof Float32Array) {
+      const processed = native.frameAccumulatorProcessInPlace(
+        this._accumulator,
+        buffer,
+      );
+      return buffer.subarray(0, processed);
+    }
+
+    const output = this._reserve(pendingSamples + buffer.byteLength / 4);
+    const written = native.frameAccumulatorPushInto(
+      this._accumulator,
+      buffer,
+      output,
+    );
+    return output.subarray(0, written);
+  }
+
+  /**
+   * Pads the held back remainder with silence and feeds silence through the processor
+   * until the audio held back by the output delay has come out.
+   *
+   * The returned array is a view of an internal buffer that is overwritten by the next
+   * call to push() or flush().
+   *
+   * @returns {Float32Array} The remaining enhanced audio
+   * @throws {Error} If processing fails.
+   */
+  flush() {
+    const frames = native.frameAccumulatorFlushFrames(this._accumulator);
+    const output = this._reserve(frames * this._numChannels);
+    const written = native.frameAccumulatorFlushInto(this._accumulator, output);
+    return output.subarray(0, written);
+  }
+
+  /**
+   * Returns the latency the adapter currently adds on top of the processor's output
+   * delay, i.e. the number of frames held back until the next block is complete.
+   *
+   * @returns {number} Added latency in frames
+   */
+  getAddedLatency() {
+    return (
+      native.frameAccumulatorPendingSamples(this._accumulator) /
+      this._numChannels
+    );
+  }
+
+  _reserve(numSamples) {
+    if (this._output.length < numSamples) {
+      this._output = new Float32Array(numSamples);
+    }
+    return this._output;
+  }
+}
+
+/**
+ * A native media path for encoded audio packets: decode, resample to the processor's
+ * sample rate, enhance, detect speech, resample to the output rate and encode, all in
+ * one native call per packet.
+ *
+ * Formats are `"float32"`, `"pcm16"` (signed 16-bit), `"mulaw"` and `"alaw"` (G.711),
+ * little-endian and interleaved with the processor's channel count. Packets may have
+ * any length, even splitting a sample. Blocks are adapted like in `FrameAdapter`, so
+ * the pipeline only adds the resamplers' latency of a few milliseconds. All buffers
+ * are reused, so a pipeline stops allocating after the first packets.
+ *
+ * With `vad` enabled, the voice activity is read after every block and changes are
+ * reported as `speechStart` and `speechEnd` events at a frame of the output stream.
+ * flush() ends speech that is still active with a `speechEnd` at the end of the
+ * stream.
+ *
+ * Only one pipeline or adapter should feed a processor at a time.
+ *
+ * @example
+ * processor.initialize(16000, 1, 160);
+ * const pipeline = new Pipeline(processor, {
+ *   inputFormat: "mulaw",
+ *   inputSampleRate: 8000,
+ *   vad: true,
+ * });
+ * socket.on("packet", (packet) => {
+ *   pipeline.push(packet);
+ *   const { data, events } = pipeline.pull();
+ *   send(data);
+ * });
+ */
+class Pipeline {
+  /**
+   * Creates a pipeline feeding the given processor.
+   *
+   * @param {Processor} processor - An initialized processor
+   * @param {Object} [options] - Pipeline options
+   * @param {string} [options.inputFormat="float32"] - Format of pushed packets
+   * @param {number|null} [options.inputSampleRate=null] - Sample rate of pushed
+   *   packets, or null for the processor's sample rate
+   * @param {string} [options.outputFormat] - Format of the output, defaults to
+   *   the input format
+   * @param {number|null} [options.outputSampleRate] - Sample rate of the output,
+   *   defaults to the input sample rate
+   * @param {boolean} [options.vad=false] - Whether to report speech events
+   * @throws {Error} If the processor is not initialized or a format is unknown.
+   * @throws {RangeError} If a sample rate is not an integer from 8000 to 192000.
+   */
+  constructor(processor, options = {}) {
+    const {
+      inputFormat = "float32",
+      inputSampleRate = null,
+      outputFormat = inputFormat,
+      outputSampleRate = inputSampleRate,
+      vad = false,
+    } = options;
+    this._pipeline = native.pipelineNew(processor._processor, {
+      inputFormat,
+      inputSampleRate,
+      outputFormat,
+      outputSampleRate,
+      vad,
+    });
+  }
+
+  /**
+   * Runs an encoded packet through the pipeline.
+   *
+   * @param {Buffer|Uint8Array|ArrayBuffer} packet - Encoded audio of any length
+   * @returns {number} Number of encoded bytes ready to be pulled
+   * @throws {Error} If processing fails.
+   */
+  push(packet) {
+    return native.pipelinePush(this._pipeline, packet);
+  }
+
+  /**
+   * Takes the encoded output and speech events produced so far.
+   *
+   * @returns {{data: Buffer, events: Array<{type: string, frame: number}>}}
+   *   Encoded output and the speech events since the last pull
+   */
+  pull() {
+    return native.pipelinePull(this._pipeline);
+  }
+
+  /**
+   * Pads the stream with silence until all audio held back by the resamplers and the
+   * processor's output delay has come out, and returns the rest like pull(). The next
+   * push starts a new stream.
+   *
+   * @returns {{data: Buffer, events: Array<{type: string, frame: number}>}}
+   *   The remaining encoded output and speech events
+   * @throws {Error} If processing fails.
+   */
+  flush() {
+    return native.pipelineFlush(this._pipeline);
+  }
+}
+
+/**
+ * Serves audio enhancement to other processes on the same host over a Unix domain
+ * socket (Linux only).
+ *
+ * The daemon process loads the model once and owns all processors and their threads.
+ * Each DaemonClient gets its own processor, fed by a native ring worker from a pair of
+ * rings in memory shared with the client, so audio never passes through the socket.
+ * The socket carries the handshake and ends the session when the client disconnects.
+ *
+ * The socket file is created with the process umask; every local user who can open
+ * it shares the daemon's license. `examples/daemon.js` runs a standalone daemon.
+ *
+ * @example
+ * const model = Model.fromFile(modelPath);
+ * const daemon = new EnhancementDaemon(model, licenseKey, "/run/aic.sock");
+ * process.on("SIGTERM", () => daemon.close());
+ */
+class EnhancementDaemon {
+  /**
+   * Starts listening for clients.
+   *
+   * The daemon keeps the process alive until close() is called.
+   *
+   * @param {Model} model - The model all sessions are enhanced with
+   * @param {string} licenseKey - License key for the ai-coustics SDK
+   * @param {string} socketPath - Path of the Unix domain socket. A stale socket file
+   *   nobody listens on is replaced.
+   * @param {Object|null} [threadOptions=null] - Settings of the ring worker thread of
+   *   every session, see Processor.startRingWorker()
+   * @throws {Error} If the socket cannot be bound or daemons are not supported on this
+   *   platform.
+   * @throws {RangeError} If a thread option is out of range.
+   */
+  constructor(model, licenseKey, socketPath, threadOptions = null) {
+    if (native.daemonNew === undefined) {
+      throw new Error("EnhancementDaemon is only supported on Linux");
+    }
+    this._daemon = native.daemonNew(
+      model._model,
+      licenseKey,
+      socketPath,
+      threadOptions,
+    );
+  }
+
+  /**
+   * @returns {number} The number of connected clients.
+   */
+  getSessionCount() {
+    return native.daemonSessionCount(this._daemon);
+  }
+
+  /**
+   * Returns the settings in effect on the worker thread of the most recently started
+   * session. See Processor.startRingWorker() for the report format.
+   *
+   * @returns {Object|null} The report, or null before the first session.
+   */
+  getThreadReport() {
+    return native.daemonThreadReport(this._daemon);
+  }
+
+  /**
+   * Stops accepting clients, disconnects all sessions and removes the socket file.
+   */
+  close() {
+    native.daemonClose(this._daemon);
+  }
+}
+
+/**
+ * A session with an EnhancementDaemon: enhanced audio from a processor in another
+ * process, without loading a model here.
+ *
+ * Audio is written to and read from rings in memory shared with the daemon. Writes
+ * wake the daemon's worker directly, which processes every complete block into the
+ * output ring, delayed by `getOutputDelay()` like a local processor.
+ *
+ * Only one thread may write and one thread may read at a time.
+ *
+ * @example
+ * const client = await DaemonClient.connect("/run/aic.sock", {
+ *   sampleRate: 48000,
+ *   numChannels: 1,
+ *   numFrames: 480,
+ * });
+ * socket.on("packet", (samples) => {
+ *   client.write(samples);
+ *   const output = new Float32Array(client.availableFrames());
+ *   send(output.subarray(0, client.read(output)));
+ * });
+ */
+class DaemonClient {
+  constructor(client, numChannels) {
+    this._client = client;
+    this._numChannels = numChannels;
+  }
+
+  /**
+   * Connects to a daemon and starts a session with its own processor.
+   *
+   * @param {string} socketPath - Path of the daemon's socket
+   * @param {Object} options - Stream configuration
+   * @param {number} options.sampleRate - Sample rate in Hz
+   * @param {number} [options.numChannels=1] - Number of interleaved channels
+   * @param {number} options.numFrames - Block size the daemon processes in
+   * @param {number} [options.capacityFrames=8 * numFrames] - Minimum number of
+   *   frames each ring holds. Rounded up to the next power of two.
+   * @returns {Promise<DaemonClient>} The connected client
+   * @throws {Error} If the daemon cannot be reached or refuses the configuration.
+   */
+  static async connect(socketPath, options) {
+    if (native.daemonClientConnect === undefined) {
+      throw new Error("DaemonClient is only supported on Linux");
+    }
+    const {
+      sampleRate,
+      numChannels = 1,
+      numFrames,
+      capacityFrames = 8 * numFrames,
+    } = options;
+    let capacity = 1;
+    while (capacity < capacityFrames) {
+      capacity *= 2;
+    }
+    const client = await native.daemonClientConnect(socketPath, {
+      sampleRate,
+      numChannels,
+      numFrames,
+      capacity,
+    });
+    return new DaemonClient(client, numChannels);
+  }
+
+  /**
+   * Writes as many whole frames of interleaved audio as fit into the input ring.
+   *
+   * @param {Float32Array|Buffer|Uint8Array|ArrayBuffer} buffer - Interleaved audio
+   * @returns {number} The number of frames written.
+   * @throws {Error} If the client is closed.
+   */
+  write(buffer) {
+    return native.daemonClientWrite(this._client, buffer);
+  }
+
+  /**
+   * Reads as many enhanced frames as are available and fit into the buffer.
+   *
+   * @param {Float32Array|Buffer|Uint8Array|ArrayBuffer} buffer - Destination for
+   *   interleaved audio
+   * @returns {number} The number of frames read.
+   * @throws {Error} If the client is closed.
+   */
+  read(buffer) {
+    return native.daemonClientRead(this._client, buffer);
+  }
+
+  /**
+   * @returns {number} The number of enhanced frames ready to be read.
+   */
+  availableFrames() {
+    return native.daemonClientAvailable(this._client);
+  }
+
+  /**
+   * @returns {number} The number of frames that can be written.
+   */
+  freeFrames() {
+    return native.daemonClientFree(this._client);
+  }
+
+  /**
+   * Blocks the calling thread until at least `numFrames` enhanced frames can be read.
+   *
+   * @param {number} numFrames - Number of frames to wait for
+   * @param {number} [timeoutMs=1000] - Maximum time to wait
+   * @returns {boolean} True if the frames are available, false on timeout.
+   * @throws {Error} If the daemon ended the session, e.g. because processing failed.
+   */
+  waitForOutput(numFrames, timeoutMs = 1000) {
+    return native.daemonClientWaitForOutput(this._client, numFrames, timeoutMs);
+  }
+
+  /**
+   * Enhances interleaved audio in place through the daemon: writes it, waits for the
+   * same number of enhanced frames and reads them back into the buffer.
+   *
+   * Pass whole blocks of `numFrames` frames, since the daemon holds back an incomplete
+   * block until the rest arrives.
+   *
+   * @param {Float32Array} buffer - Interleaved audio, at most the ring capacity
+   * @param {number} [timeoutMs=1000] - Maximum time to wait for the output
+   * @returns {number} The number of frames read back.
+   * @throws {Error} If the audio does not fit into the input ring, the output
+   *   times out, or the daemon ended the session.
+   */
+  process(buffer, timeoutMs = 1000) {
+    if (buffer.length > this.freeFrames() * this._numChannels) {
+      throw new Error("Audio does not fit into the input ring");
+    }
+    const written = this.write(buffer);
+    if (!this.waitForOutput(written, timeoutMs)) {
+      throw new Error("Timed out waiting for the daemon");
+    }
+    return this.read(buffer);
+  }
+
+  /**
+   * @returns {number} The output delay of the daemon's processor in frames.
+   */
+  getOutputDelay() {
+    return native.daemonClientOutputDelay(this._client);
+  }
+
+  /**
+   * Disconnects from the daemon, which releases the session's processor.
+   */
+  close() {
+    native.daemonClientClose(this._client);
+  }
+}
+
+function nonEmpty(buffer) {
+  return buffer.length > 0 ? buffer : undefined;
+}
+
+function toFloat32Array(buffer) {
+  if (buffer.byteOffset % 4 !== 0) {
+    buffer = Buffer.from(buffer);
+  }
+  return new Float32Array(buffer.buffer, buffer.byteOffset, buffer.length / 4);
+}
+
+/**
+ * Returns the version of the ai-coustics core SDK library used by this package.
+ *
+ * Note: This is not necessarily the same as this package's version.
+ *
+ * @returns {string} The library version as a string.
+ *
+ * @example
+ * const version = getVersion();
+ * console.log(`ai-coustics SDK version: ${version}`);
+ */
+function getVersion() {
+  return native.getVersion();
+}
+
+/**
+ * Returns the inference backend the native module was built with.
+ *
+ * "aic-sdk" is the ai-coustics SDK. "mock" is a license-free stand-in built with the
+ * `mock` cargo feature for testing and benchmarking the binding offline: it delays audio
+ * by the model's output delay instead of enhancing it, accepts any license key, and
+ * `Model.download()` writes a mock model file instead of downloading.
+ *
+ * @returns {string} "aic-sdk" or "mock"
+ */
+function getBackend() {
+  return native.getBackend();
+}
+
+/**
+ * Returns which native binary was loaded.
+ *
+ * On Linux x64 the loader picks the binary built for the most capable x86-64 level
+ * the CPU supports: "x86-64-v4" (AVX-512), "x86-64-v3" (AVX2, FMA) or "baseline".
+ * Other platforms load "baseline". "local" is ./index.node from a local build, and
+ * "custom" the binary given by AIC_SDK_NODE_BINARY. Set AIC_SDK_NODE_CPU to
+ * "baseline" or a level name to cap the selection.
+ *
+ * @returns {string} The variant of the loaded binary.
+ */
+function getBinaryVariant() {
+  loadNative();
+  return nativeVariant;
+}
+
+/**
+ * Loads a model and creates and initializes a processor for it, with the slow steps
+ * off the JavaScript thread.
+ *
+ * Downloading, loading the model, creating the processor (which checks the license)
+ * and initializing it run one after another on a worker thread of the Node pool, so
+ * the event loop stays free for the rest of the application's startup, e.g. opening
+ * connections. The resolved report breaks the cold start down into its stages:
+ * `nativeLoadMs` (loading the native module, on first use of the package),
+ * `downloadMs`, `modelMs`, `licenseMs`, `initializeMs` and `totalMs` for the whole
+ * call, all in milliseconds, and `binaryVariant` (see getBinaryVariant()).
+ *
+ * @param {Object} options
+ * @param {string} [options.modelPath] - Model file to load
+ * @param {string} [options.modelId] - Model to download instead, see Model.download()
+ * @param {string} [options.downloadDir] - Directory for the downloaded model
+ * @param {string} options.licenseKey - SDK license key
+ * @param {OtelConfig|null} [options.otelConfig=null] - OpenTelemetry configuration
+ * @param {number|null} [options.sampleRate=null] - Sample rate, null for the model's
+ *   optimal one
+ * @param {number} [options.numChannels=1] - Number of channels
+ * @param {number|null} [options.numFrames=null] - Frames per block, null for the
+ *   model's optimal number at the sample rate
+ * @param {boolean} [options.allowVariableFrames=false] - See Processor.initialize()
+ * @param {boolean} [options.compensateDelay=false] - See Processor.initialize()
+ * @returns {Promise<{model: Model, processor: Processor, sampleRate: number,
+ *   numFrames: number, report: Object}>} The model and the initialized processor
+ *   with its configuration and the startup report.
+ * @throws {Error} If the model cannot be loaded or the license is invalid.
+ *
+ * @example
+ * const { processor, numFrames, report } = await init({
+ *   modelPath: "/opt/models/sparrow-l-16khz.aicmodel",
+ *   licenseKey: process.env.AIC_SDK_LICENSE,
+ * });
+ * console.log(report);
+ */
+async function init(options) {
+  const start = performance.now();
+  const {
+    modelPath = null,
+    modelId = null,
+    downloadDir = null,
+    licenseKey,
+    otelConfig = null,
+    sampleRate = null,
+    numChannels = 1,
+    numFrames = null,
+    allowVariableFrames = false,
+    compensateDelay = false,
+  } = options;
+  loadNative();
+
+  const started = await native.startupInit(
+    {
+      modelPath,
+      modelId,
+      downloadDir,
+      sampleRate,
+      numChannels,
+      numFrames,
+      allowVariableFrames,
+      compensateDelay,
+    },
+    licenseKey,
+    otelConfig,
+  );
+
+  const processor = Object.create(Processor.prototype);
+  processor._processor = started.processor;
+  processor._licenseKey = licenseKey;
+  processor._otelConfig = otelConfig;
+  processor._numChannels = numChannels;
+  processor._numFrames = started.numFrames;
+
+  return {
+    model: new Model(started.model),
+    processor,
+    sampleRate: started.sampleRate,
+    numFrames: started.numFrames,
+    report: {
+      nativeLoadMs,
+      ...started.timings,
+      totalMs: performance.now() - start,
+      binaryVariant: nativeVariant,
+    },
+  };
+}
+
+/**
+ * Returns the number of heap allocations the native module has made on the calling
+ * thread, for allocation tests.
+ *
+ * Only available in builds with the `alloc-counter` cargo feature. Allocations made by
+ * V8 and by the SDK's own native code are not counted.
+ *
+ * @returns {number|null} The allocation count, or null if the feature is not enabled
+ */
+function debugAllocationCount() {
+  return native.debugAllocationCount ? native.debugAllocationCount() : null;
+}
+
+/**
+ * Returns whether the native module was built with span tracing (the `trace`
+ * cargo feature), so that `startTrace()` can be used.
+ *
+ * @returns {boolean}
+ */
+function isTracingAvailable() {
+  return typeof native.traceStart === "function";
+}
+
+/**
+ * Starts recording native spans: argument conversion, lock waits, SDK processing,
+ * delay compensation, parameter and VAD queries, and model loading.
+ *
+ * Timestamps use the clock of `process.hrtime()`, which V8 also uses for
+ * `--cpu-prof`, so the trace lines up with CPU profiles of the same run.
+ *
+ * @throws {Error} If the native module was built without the `trace` feature, or a
+ *   trace is already running
+ */
+function startTrace() {
+  if (!isTracingAvailable()) {
+    throw new Error(
+      "Tracing is not available: build with the trace feature " +
+        "(npm run build:trace)",
+    );
+  }
+  native.traceStart(Number(process.hrtime.bigint() / 1000n));
+}
+
+/**
+ * Stops recording and writes the spans as a Chrome trace JSON file, which can be
+ * opened in Perfetto (https://ui.perfetto.dev) or `chrome://tracing`.
+ *
+ * @param {string} path - Output file path
+ * @returns {number} The number of recorded spans
+ * @throws {Error} If no trace is running or the file cannot be written
+ */
+function stopTrace(path) {
+  if (!isTracingAvailable()) {
+    throw new Error("No trace is running");
+  }
+  return native.traceStop(path);
 }
 
 /**
@@ -659,13 +2652,31 @@ function getCompatibleModelVersion() {
 }
 
 module.exports = {
+  AudioRing,
+  DaemonClient,
+  EnhanceStream,
+  EnhanceTransformStream,
+  EnhancementDaemon,
+  FrameAdapter,
   Model,
+  MultiChannelProcessor,
   OtelConfig,
+  Pipeline,
   Processor,
   ProcessorContext,
   VadContext,
   ProcessorParameter,
   VadParameter,
+  PostStatus,
   getVersion,
+  getBackend,
+  getBinaryVariant,
+  init,
   getCompatibleModelVersion,
+  debugAllocationCount,
+  enablePerformanceEntries,
+  PROCESS_CHANNEL,
+  isTracingAvailable,
+  startTrace,
+  stopTrace,
 };
@@ -26,4 +26,14 @@ for platform in "${platforms[@]}"; do
   fi
 done
 
-echo "Done. Binaries in npm/<platform>/index.node"
+# Linux x64 also ships binaries for newer x86-64 levels, picked by index.js at load time
+for level in x86-64-v3 x86-64-v4; do
+  echo "Building linux-x64-gnu for $level..."
+
+  RUSTFLAGS="-C target-cpu=$level" cargo build --release --target x86_64-unknown-linux-gnu \
+    --target-dir "target/$level"
+  cp "target/$level/x86_64-unknown-linux-gnu/release/libaic_sdk_node.so" \
+    "npm/linux-x64-gnu/index-$level.node"
+done
+
+echo "Done. Binaries in npm/<platform>/index.node and npm/linux-x64-gnu/index-<level>.node"
@@ -0,0 +1,60 @@
+//! Counting global allocator for allocation tests, enabled with the `alloc-counter` feature.
+//!
+//! Counts the heap allocations the native module makes through the Rust allocator, per
+//! thread. Allocations made by V8 or by the SDK's own native code are not included.
+
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::cell::Cell;
+
+use neon::{
+    prelude::{Context, FunctionContext},
+    result::JsResult,
+    types::JsNumber,
+};
+
+struct CountingAllocator;
+
+thread_local! {
+    static ALLOCATIONS: Cell<u64> = const { Cell::new(0) };
+}
+
+fn count() {
+    // Ignored while the thread is being torn down
+    let _ = ALLOCATIONS.try_with(|count| count.set(count.get() + 1));
+}
+
+// SAFETY: All calls are forwarded to the system allocator unchanged.
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        count();
+        unsafe { System.alloc(layout) }
+    }
+
+    unsafe fn alloc_zeroed(&self, layout: Layout) -> *mut u8 {
+        count();
+        unsafe { System.alloc_zeroed(layout) }
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        count();
+        unsafe { System.realloc(ptr, layout, new_size) }
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        unsafe { System.dealloc(ptr, layout) }
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAllocator = CountingAllocator;
+
+/// Returns the number of allocations made so far on the calling thread.
+fn debug_allocation_count(mut cx: FunctionContext) -> JsResult<JsNumber> {
+    let count = ALLOCATIONS.with(Cell::get);
+    Ok(cx.number(count as f64))
+}
+
+pub fn register_exports(cx: &mut neon::prelude::ModuleContext) -> neon::result::NeonResult<()> {
+    cx.export_function("debugAllocationCount", debug_allocation_count)?;
+    Ok(())
+}
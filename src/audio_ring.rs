@@ -0,0 +1,579 @@
+use std::sync::{
+    Arc,
+    atomic::{AtomicBool, AtomicI32, Ordering},
+};
+use std::time::Duration;
+
+use neon::{
+    event::Channel,
+    handle::{Handle, Root},
+    object::Object,
+    prelude::{Context, FunctionContext},
+    result::{JsResult, NeonResult},
+    types::{
+        Finalize, JsBox, JsFunction, JsNumber, JsObject, JsTypedArray, JsValue, buffer::TypedArray,
+    },
+};
+
+use crate::raw_samples::RawSamples;
+#[cfg(target_os = "linux")]
+use crate::shared_memory::SharedMapping;
+
+// Layout of the Int32 header at the start of the shared buffer. The producer and consumer
+// indices live on separate cache lines. Indices count frames and wrap around at 2^32, which
+// is why the capacity has to be a power of two. Native and JavaScript waiters on an index are
+// counted separately, since they are woken in different ways, see `futex` and `JsWaker`.
+pub const RING_WRITE_INDEX: usize = 0;
+pub const RING_WRITE_WAITERS: usize = 1;
+pub const RING_WRITE_JS_WAITERS: usize = 2;
+pub const RING_READ_INDEX: usize = 16;
+pub const RING_READ_WAITERS: usize = 17;
+pub const RING_READ_JS_WAITERS: usize = 18;
+pub const RING_CAPACITY: usize = 32;
+pub const RING_NUM_CHANNELS: usize = 33;
+pub const RING_HEADER_LENGTH: usize = 48;
+
+/// Largest supported ring capacity in frames.
+const MAX_CAPACITY: usize = 1 << 30;
+
+/// Size in bytes of a ring with its header, rounded up to a cache line so that rings can be
+/// laid out back to back.
+#[cfg(target_os = "linux")]
+pub(crate) fn ring_size(capacity: usize, num_channels: usize) -> usize {
+    ((RING_HEADER_LENGTH + capacity * num_channels) * size_of::<f32>()).next_multiple_of(64)
+}
+
+/// Memory of a ring buffer living in a `SharedArrayBuffer`, or in memory shared with another
+/// process.
+///
+/// The same memory can be attached from several workers at once. Each attachment keeps its
+/// memory alive for as long as any native thread holds the `Arc`.
+pub struct RingMemory {
+    header: *const AtomicI32,
+    data: *mut f32,
+    capacity: usize,
+    num_channels: usize,
+    _owner: RingOwner,
+}
+
+/// Keeps the memory of a ring alive.
+enum RingOwner {
+    /// Rooted header and data views of a `SharedArrayBuffer`.
+    Js(Root<JsTypedArray<i32>>, Root<JsTypedArray<f32>>),
+    #[cfg(target_os = "linux")]
+    Mapped { _mapping: Arc<SharedMapping> },
+}
+
+// SAFETY: The ring memory is only accessed through atomics (header) or within the region that
+// the indices hand to the current producer or consumer (data).
+unsafe impl Send for RingMemory {}
+unsafe impl Sync for RingMemory {}
+
+impl RingMemory {
+    /// Attaches to a ring at `offset` bytes into a shared mapping. With `init`, the header is
+    /// initialized to an empty ring of `capacity` frames of `num_channels` channels first;
+    /// otherwise the values in the header are validated against the mapping.
+    #[cfg(target_os = "linux")]
+    pub(crate) fn mapped(
+        mapping: Arc<SharedMapping>,
+        offset: usize,
+        init: Option<(usize, usize)>,
+    ) -> Result<RingMemory, &'static str> {
+        if !offset.is_multiple_of(64) || offset + ring_size(0, 0) > mapping.len() {
+            return Err("Ring header lies outside the shared memory");
+        }
+        // SAFETY: The header lies within the mapping, which is page-aligned.
+        let header = unsafe { mapping.as_ptr().add(offset) }.cast::<AtomicI32>();
+        // SAFETY: `index` is below RING_HEADER_LENGTH.
+        let slot = |index: usize| unsafe { &*header.add(index) };
+
+        if let Some((capacity, num_channels)) = init {
+            for index in 0..RING_HEADER_LENGTH {
+                slot(index).store(0, Ordering::Relaxed);
+            }
+            slot(RING_CAPACITY).store(capacity as i32, Ordering::Relaxed);
+            slot(RING_NUM_CHANNELS).store(num_channels as i32, Ordering::Release);
+        }
+        let capacity = slot(RING_CAPACITY).load(Ordering::Acquire) as usize;
+        let num_channels = slot(RING_NUM_CHANNELS).load(Ordering::Acquire) as usize;
+
+        if !capacity.is_power_of_two() || capacity > MAX_CAPACITY {
+            return Err("AudioRing capacity must be a power of two");
+        }
+        if num_channels == 0 || num_channels > u16::MAX as usize {
+            return Err("AudioRing channel count must be from 1 to 65535");
+        }
+        if offset + ring_size(capacity, num_channels) > mapping.len() {
+            return Err("Ring data lies outside the shared memory");
+        }
+
+        Ok(RingMemory {
+            header,
+            // SAFETY: Checked to lie within the mapping above.
+            data: unsafe {
+                mapping
+                    .as_ptr()
+                    .add(offset + RING_HEADER_LENGTH * size_of::<i32>())
+            }
+            .cast(),
+            capacity,
+            num_channels,
+            _owner: RingOwner::Mapped { _mapping: mapping },
+        })
+    }
+
+    fn slot(&self, index: usize) -> &AtomicI32 {
+        // SAFETY: `index` is below RING_HEADER_LENGTH, which was validated on attach.
+        unsafe { &*self.header.add(index) }
+    }
+
+    pub fn num_channels(&self) -> usize {
+        self.num_channels
+    }
+
+    /// Number of frames the ring holds.
+    pub fn capacity(&self) -> usize {
+        self.capacity
+    }
+
+    /// Frames ready to be read.
+    pub fn available(&self) -> usize {
+        let write = self.slot(RING_WRITE_INDEX).load(Ordering::Acquire) as u32;
+        let read = self.slot(RING_READ_INDEX).load(Ordering::Relaxed) as u32;
+        write.wrapping_sub(read) as usize
+    }
+
+    /// Frames that can be written without overwriting unread data.
+    pub fn free(&self) -> usize {
+        let write = self.slot(RING_WRITE_INDEX).load(Ordering::Relaxed) as u32;
+        let read = self.slot(RING_READ_INDEX).load(Ordering::Acquire) as u32;
+        self.capacity - write.wrapping_sub(read) as usize
+    }
+
+    /// Returns the data regions (in samples) covering `num_frames` frames starting at the
+    /// given frame index. The second region is non-empty when the range wraps around.
+    fn regions(&self, index: u32, num_frames: usize) -> ((usize, usize), (usize, usize)) {
+        let start = index as usize & (self.capacity - 1);
+        let first = num_frames.min(self.capacity - start);
+        (
+            (start * self.num_channels, first * self.num_channels),
+            (0, (num_frames - first) * self.num_channels),
+        )
+    }
+
+    /// Copies up to `samples.len / num_channels` frames into the ring and returns the number of
+    /// frames written.
+    ///
+    /// # Safety
+    ///
+    /// `samples` must be alive, and only one producer may write at a time.
+    pub unsafe fn write(&self, samples: &RawSamples) -> usize {
+        let num_frames = (samples.len / self.num_channels).min(self.free());
+        let write = self.slot(RING_WRITE_INDEX).load(Ordering::Relaxed) as u32;
+
+        let mut copied = 0;
+        let (first, second) = self.regions(write, num_frames);
+        for (offset, len) in [first, second] {
+            unsafe {
+                std::ptr::copy_nonoverlapping(
+                    samples.ptr.add(copied * size_of::<f32>()),
+                    self.data.add(offset).cast::<u8>(),
+                    len * size_of::<f32>(),
+                );
+            }
+            copied += len;
+        }
+
+        self.commit(RING_WRITE_INDEX, RING_WRITE_WAITERS, num_frames);
+        num_frames
+    }
+
+    /// Copies up to `samples.len / num_channels` frames out of the ring and returns the number
+    /// of frames read.
+    ///
+    /// # Safety
+    ///
+    /// `samples` must be alive, and only one consumer may read at a time.
+    pub unsafe fn read(&self, samples: &RawSamples) -> usize {
+        let num_frames = unsafe { self.peek(samples) };
+        self.consume(num_frames);
+        num_frames
+    }
+
+    /// Copies up to `samples.len / num_channels` frames out of the ring without consuming them,
+    /// and returns the number of frames copied.
+    ///
+    /// # Safety
+    ///
+    /// `samples` must be alive, and only one consumer may read at a time.
+    pub unsafe fn peek(&self, samples: &RawSamples) -> usize {
+        let num_frames = (samples.len / self.num_channels).min(self.available());
+        let read = self.slot(RING_READ_INDEX).load(Ordering::Relaxed) as u32;
+
+        let mut copied = 0;
+        let (first, second) = self.regions(read, num_frames);
+        for (offset, len) in [first, second] {
+            unsafe {
+                std::ptr::copy_nonoverlapping(
+                    self.data.add(offset).cast::<u8>(),
+                    samples.ptr.add(copied * size_of::<f32>()),
+                    len * size_of::<f32>(),
+                );
+            }
+            copied += len;
+        }
+
+        num_frames
+    }
+
+    /// Returns the next `num_frames` readable frames in place if they do not wrap around the
+    /// end of the ring.
+    ///
+    /// # Safety
+    ///
+    /// At least `num_frames` frames must be available and the caller must be the only consumer.
+    /// The slice is valid until `consume` is called.
+    #[allow(clippy::mut_from_ref)]
+    pub unsafe fn contiguous_read_slice(&self, num_frames: usize) -> Option<&mut [f32]> {
+        let read = self.slot(RING_READ_INDEX).load(Ordering::Relaxed) as u32;
+        let ((offset, len), (_, wrapped)) = self.regions(read, num_frames);
+        if wrapped > 0 {
+            return None;
+        }
+        Some(unsafe { std::slice::from_raw_parts_mut(self.data.add(offset), len) })
+    }
+
+    /// Marks `num_frames` frames as read without copying them.
+    pub fn consume(&self, num_frames: usize) {
+        self.commit(RING_READ_INDEX, RING_READ_WAITERS, num_frames);
+    }
+
+    fn commit(&self, index: usize, waiters: usize, num_frames: usize) {
+        if num_frames == 0 {
+            return;
+        }
+        // Sequentially consistent, so a waiter registering concurrently either sees the new
+        // index or is seen in the waiter count
+        self.slot(index)
+            .fetch_add(num_frames as i32, Ordering::SeqCst);
+        if self.slot(waiters).load(Ordering::SeqCst) > 0 {
+            futex::wake(self.slot(index));
+        }
+    }
+
+    /// Blocks the calling native thread until at least `num_frames` frames are available or the
+    /// timeout expires.
+    pub fn wait_available(&self, num_frames: usize, timeout: Duration) -> bool {
+        self.wait_until(RING_WRITE_INDEX, RING_WRITE_WAITERS, timeout, || {
+            self.available() >= num_frames
+        })
+    }
+
+    /// Blocks the calling native thread until at least `num_frames` frames are free or the
+    /// timeout expires.
+    pub fn wait_free(&self, num_frames: usize, timeout: Duration) -> bool {
+        self.wait_until(RING_READ_INDEX, RING_READ_WAITERS, timeout, || {
+            self.free() >= num_frames
+        })
+    }
+
+    fn wait_until(
+        &self,
+        index: usize,
+        waiters: usize,
+        timeout: Duration,
+        ready: impl Fn() -> bool,
+    ) -> bool {
+        if ready() {
+            return true;
+        }
+        let word = self.slot(index);
+        let observed = word.load(Ordering::Acquire);
+        self.slot(waiters).fetch_add(1, Ordering::SeqCst);
+        let ready_now = ready();
+        if !ready_now {
+            futex::wait(word, observed, timeout);
+        }
+        self.slot(waiters).fetch_sub(1, Ordering::SeqCst);
+        ready_now || ready()
+    }
+
+    /// Wakes native threads blocked on this ring, e.g. when a worker is asked to stop.
+    pub fn wake_all(&self) {
+        futex::wake(self.slot(RING_WRITE_INDEX));
+        futex::wake(self.slot(RING_READ_INDEX));
+    }
+
+    /// Whether a JavaScript thread is registered as waiting on either index.
+    fn has_js_waiters(&self) -> bool {
+        self.slot(RING_WRITE_JS_WAITERS).load(Ordering::SeqCst) > 0
+            || self.slot(RING_READ_JS_WAITERS).load(Ordering::SeqCst) > 0
+    }
+
+    /// The header view of a ring living in a `SharedArrayBuffer`.
+    fn js_header<'a>(&self, cx: &mut impl Context<'a>) -> Option<Handle<'a, JsTypedArray<i32>>> {
+        match &self._owner {
+            RingOwner::Js(header, _) => Some(header.to_inner(cx)),
+            #[cfg(target_os = "linux")]
+            RingOwner::Mapped { .. } => None,
+        }
+    }
+}
+
+/// Wakes JavaScript threads blocked in `Atomics.wait()` on rings that a native thread moves.
+///
+/// V8 parks such threads on its own futex emulation, which a kernel futex wake does not reach,
+/// so the wake-up is an `Atomics.notify()` run on the event loop of the thread that created the
+/// waker. A notification is only posted while a JavaScript waiter is registered in the header
+/// and none is pending already.
+pub(crate) struct JsWaker {
+    channel: Channel,
+    rings: Vec<Arc<RingMemory>>,
+    pending: Arc<AtomicBool>,
+}
+
+impl JsWaker {
+    /// Creates a waker for the rings living in a `SharedArrayBuffer`, or `None` if there are
+    /// none. Must be called on the thread that attached the rings.
+    pub(crate) fn new<'a>(
+        cx: &mut impl Context<'a>,
+        rings: &[&Arc<RingMemory>],
+    ) -> Option<JsWaker> {
+        let rings: Vec<_> = rings
+            .iter()
+            .filter(|ring| matches!(ring._owner, RingOwner::Js(..)))
+            .map(|ring| Arc::clone(ring))
+            .collect();
+        if rings.is_empty() {
+            return None;
+        }
+        let mut channel = cx.channel();
+        channel.unref(cx);
+        Some(JsWaker {
+            channel,
+            rings,
+            pending: Arc::new(AtomicBool::new(false)),
+        })
+    }
+
+    /// Notifies the JavaScript waiters of all rings after their indices moved.
+    pub(crate) fn wake(&self) {
+        if !self.rings.iter().any(|ring| ring.has_js_waiters()) {
+            return;
+        }
+        if self.pending.swap(true, Ordering::AcqRel) {
+            return;
+        }
+        let rings = self.rings.clone();
+        let pending = self.pending.clone();
+        self.channel.send(move |mut cx| {
+            // Cleared first, so index moves after this point post another notification
+            pending.store(false, Ordering::Release);
+            let atomics = cx.global::<JsObject>("Atomics")?;
+            let notify = atomics.get::<JsFunction, _, _>(&mut cx, "notify")?;
+            for ring in &rings {
+                let Some(header) = ring.js_header(&mut cx) else {
+                    continue;
+                };
+                for index in [RING_WRITE_INDEX, RING_READ_INDEX] {
+                    let index = cx.number(index as u32);
+                    notify
+                        .call_with(&cx)
+                        .this(atomics)
+                        .arg(header)
+                        .arg(index)
+                        .exec(&mut cx)?;
+                }
+            }
+            Ok(())
+        });
+    }
+}
+
+/// Futex wait/wake on the index words, for native waiters.
+///
+/// Native threads register in the native waiter count of an index and block while the index
+/// still holds the observed value. JavaScript threads register in the JavaScript waiter count
+/// and block with `Atomics.wait()`, which only `Atomics.notify()` wakes: the JavaScript wrapper
+/// notifies after its own reads and writes, and `JsWaker` after those of native threads.
+mod futex {
+    use std::sync::atomic::AtomicI32;
+    use std::time::Duration;
+
+    #[cfg(target_os = "linux")]
+    pub fn wait(word: &AtomicI32, expected: i32, timeout: Duration) {
+        let timeout = libc::timespec {
+            tv_sec: timeout.as_secs() as libc::time_t,
+            tv_nsec: timeout.subsec_nanos() as libc::c_long,
+        };
+        // SAFETY: `word` is a valid, aligned 32-bit integer for the duration of the call.
+        unsafe {
+            libc::syscall(
+                libc::SYS_futex,
+                word.as_ptr(),
+                libc::FUTEX_WAIT,
+                expected,
+                &timeout as *const libc::timespec,
+                std::ptr::null::<u32>(),
+                0,
+            );
+        }
+    }
+
+    #[cfg(target_os = "linux")]
+    pub fn wake(word: &AtomicI32) {
+        // SAFETY: `word` is a valid, aligned 32-bit integer for the duration of the call.
+        unsafe {
+            libc::syscall(libc::SYS_futex, word.as_ptr(), libc::FUTEX_WAKE, i32::MAX);
+        }
+    }
+
+    // Without a futex the waiter polls the index in short sleeps.
+    #[cfg(not(target_os = "linux"))]
+    pub fn wait(word: &AtomicI32, expected: i32, timeout: Duration) {
+        use std::sync::atomic::Ordering;
+        use std::time::Instant;
+
+        let deadline = Instant::now() + timeout;
+        while word.load(Ordering::Acquire) == expected && Instant::now() < deadline {
+            std::thread::sleep(Duration::from_micros(250));
+        }
+    }
+
+    #[cfg(not(target_os = "linux"))]
+    pub fn wake(_: &AtomicI32) {}
+}
+
+pub struct AudioRing {
+    pub(crate) memory: Arc<RingMemory>,
+}
+
+impl Finalize for AudioRing {
+    fn finalize<'a, C: neon::prelude::Context<'a>>(self, _: &mut C) {}
+}
+
+impl AudioRing {
+    /// Attaches to a ring from its header and data views. When a capacity and channel count
+    /// are passed, the header is initialized first.
+    pub fn new(mut cx: FunctionContext) -> JsResult<JsBox<AudioRing>> {
+        let mut header = cx.argument::<JsTypedArray<i32>>(0)?;
+        let mut data = cx.argument::<JsTypedArray<f32>>(1)?;
+
+        let header_slice = header.as_mut_slice(&mut cx);
+        if header_slice.len() < RING_HEADER_LENGTH {
+            return cx.throw_range_error("AudioRing header is too short");
+        }
+
+        if let Some(capacity) = cx.argument_opt(2) {
+            let capacity = capacity
+                .downcast_or_throw::<JsNumber, _>(&mut cx)?
+                .value(&mut cx);
+            let num_channels = cx.argument::<JsNumber>(3)?.value(&mut cx);
+            let header_slice = header.as_mut_slice(&mut cx);
+            header_slice.fill(0);
+            header_slice[RING_CAPACITY] = capacity as i32;
+            header_slice[RING_NUM_CHANNELS] = num_channels as i32;
+        }
+
+        let header_slice = header.as_mut_slice(&mut cx);
+        let capacity = header_slice[RING_CAPACITY] as usize;
+        let num_channels = header_slice[RING_NUM_CHANNELS] as usize;
+        let header_ptr = header_slice.as_ptr().cast::<AtomicI32>();
+
+        if !capacity.is_power_of_two() || capacity > MAX_CAPACITY {
+            return cx.throw_range_error("AudioRing capacity must be a power of two");
+        }
+        if num_channels == 0 || num_channels > u16::MAX as usize {
+            return cx.throw_range_error("AudioRing channel count must be from 1 to 65535");
+        }
+        let Some(num_samples) = capacity.checked_mul(num_channels) else {
+            return cx.throw_range_error("AudioRing is too large");
+        };
+
+        let data_slice = data.as_mut_slice(&mut cx);
+        if data_slice.len() < num_samples {
+            return cx.throw_range_error("AudioRing data view is too short for its capacity");
+        }
+        let data_ptr = data_slice.as_mut_ptr();
+
+        let memory = RingMemory {
+            header: header_ptr,
+            data: data_ptr,
+            capacity,
+            num_channels,
+            _owner: RingOwner::Js(header.root(&mut cx), data.root(&mut cx)),
+        };
+
+        Ok(cx.boxed(AudioRing {
+            memory: Arc::new(memory),
+        }))
+    }
+
+    pub fn write(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let this = cx.argument::<JsBox<AudioRing>>(0)?;
+        let buffer = cx.argument::<JsValue>(1)?;
+        let samples = RawSamples::from_value(&mut cx, buffer)?;
+
+        // SAFETY: The buffer handle keeps the samples alive for the duration of the call.
+        let written = unsafe { this.memory.write(&samples) };
+
+        Ok(cx.number(written as f64))
+    }
+
+    pub fn read(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let this = cx.argument::<JsBox<AudioRing>>(0)?;
+        let buffer = cx.argument::<JsValue>(1)?;
+        let samples = RawSamples::from_value(&mut cx, buffer)?;
+
+        // SAFETY: The buffer handle keeps the samples alive for the duration of the call.
+        let read = unsafe { this.memory.read(&samples) };
+
+        Ok(cx.number(read as f64))
+    }
+
+    pub fn available(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let this = cx.argument::<JsBox<AudioRing>>(0)?;
+        let available = this.memory.available();
+        Ok(cx.number(available as f64))
+    }
+
+    pub fn free(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let this = cx.argument::<JsBox<AudioRing>>(0)?;
+        let free = this.memory.free();
+        Ok(cx.number(free as f64))
+    }
+}
+
+pub fn audio_ring_argument(
+    cx: &mut FunctionContext,
+    value: Handle<JsValue>,
+) -> NeonResult<Arc<RingMemory>> {
+    let ring = value.downcast_or_throw::<JsBox<AudioRing>, _>(cx)?;
+    Ok(ring.memory.clone())
+}
+
+pub fn register_exports(cx: &mut neon::prelude::ModuleContext) -> NeonResult<()> {
+    cx.export_function("audioRingNew", AudioRing::new)?;
+    cx.export_function("audioRingWrite", AudioRing::write)?;
+    cx.export_function("audioRingRead", AudioRing::read)?;
+    cx.export_function("audioRingAvailable", AudioRing::available)?;
+    cx.export_function("audioRingFree", AudioRing::free)?;
+
+    // Export header layout constants
+    let header_length = cx.number(RING_HEADER_LENGTH as u32);
+    cx.export_value("AUDIO_RING_HEADER_LENGTH", header_length)?;
+    let write_index = cx.number(RING_WRITE_INDEX as u32);
+    cx.export_value("AUDIO_RING_WRITE_INDEX", write_index)?;
+    let read_index = cx.number(RING_READ_INDEX as u32);
+    cx.export_value("AUDIO_RING_READ_INDEX", read_index)?;
+    let capacity = cx.number(RING_CAPACITY as u32);
+    cx.export_value("AUDIO_RING_CAPACITY", capacity)?;
+    let num_channels = cx.number(RING_NUM_CHANNELS as u32);
+    cx.export_value("AUDIO_RING_NUM_CHANNELS", num_channels)?;
+    let write_js_waiters = cx.number(RING_WRITE_JS_WAITERS as u32);
+    cx.export_value("AUDIO_RING_WRITE_JS_WAITERS", write_js_waiters)?;
+    let read_js_waiters = cx.number(RING_READ_JS_WAITERS as u32);
+    cx.export_value("AUDIO_RING_READ_JS_WAITERS", read_js_waiters)?;
+
+    Ok(())
+}
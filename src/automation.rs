@@ -0,0 +1,220 @@
+//! Processor parameter changes scheduled at positions of the stream, applied by the audio
+//! path at block boundaries.
+
+use std::sync::atomic::{AtomicU8, AtomicU32, AtomicU64, AtomicUsize, Ordering};
+
+use crate::processor_context::{PROCESSOR_PARAM_BYPASS, PROCESSOR_PARAM_ENHANCEMENT_LEVEL};
+use crate::sdk;
+
+/// Number of changes that can be scheduled at once.
+const CAPACITY: usize = 64;
+
+/// Parameters that can be automated, with their `PROCESSOR_PARAM_` constant.
+const PARAMETERS: [(i32, fn() -> sdk::ProcessorParameter); 2] = [
+    (PROCESSOR_PARAM_BYPASS, || sdk::ProcessorParameter::Bypass),
+    (PROCESSOR_PARAM_ENHANCEMENT_LEVEL, || {
+        sdk::ProcessorParameter::EnhancementLevel
+    }),
+];
+
+// States of a slot. A scheduling thread claims an empty slot, fills it and marks it ready.
+// From then on only the audio path, which holds the processor lock, touches it until it
+// marks it empty again.
+const EMPTY: u8 = 0;
+const WRITING: u8 = 1;
+const READY: u8 = 2;
+/// Ramping; `start_value` holds the value the ramp started from.
+const ACTIVE: u8 = 3;
+
+#[derive(Default)]
+struct ScheduledChange {
+    state: AtomicU8,
+    /// Index into `PARAMETERS`.
+    parameter: AtomicU8,
+    /// Target value, as `f32` bits.
+    value: AtomicU32,
+    start_value: AtomicU32,
+    /// Stream frame the ramp starts at.
+    at: AtomicU64,
+    /// Length of the ramp in frames. 0 for a step.
+    ramp: AtomicU64,
+    /// Scheduling order, so that the later of two changes at the same frame wins.
+    sequence: AtomicU64,
+    /// Epoch of the timeline the change was scheduled against.
+    epoch: AtomicU64,
+}
+
+/// Fixed-capacity timeline of scheduled parameter changes of one processor.
+///
+/// Scheduling is lock-free and may happen on any thread. At the start of every block, the
+/// audio path applies the most recently scheduled change due by the end of the block for
+/// each parameter and drops the ones it supersedes. A change due inside a block therefore
+/// applies to that whole block, at most one block early, never late. A ramp is interpolated
+/// linearly and each block gets the value at its end, so the target is reached in the block
+/// containing the end of the ramp. Changes scheduled in the past are applied at the next
+/// block as if on time.
+pub(crate) struct Automation {
+    changes: [ScheduledChange; CAPACITY],
+    /// Number of ready or active changes. Lets the audio path skip the scan when idle.
+    pending: AtomicUsize,
+    next_sequence: AtomicU64,
+    /// Frames processed since the processor was initialized. Written by the audio path only.
+    position: AtomicU64,
+    /// Incremented by `clear`. Changes of an earlier epoch were scheduled against the stream
+    /// position before an initialization, e.g. by a `schedule` racing `clear`, and are
+    /// dropped instead of applied.
+    epoch: AtomicU64,
+}
+
+impl Automation {
+    pub(crate) fn new() -> Automation {
+        Automation {
+            changes: std::array::from_fn(|_| ScheduledChange::default()),
+            pending: AtomicUsize::new(0),
+            next_sequence: AtomicU64::new(0),
+            position: AtomicU64::new(0),
+            epoch: AtomicU64::new(0),
+        }
+    }
+
+    /// Schedules the parameter with the `PROCESSOR_PARAM_` constant `parameter` to ramp to
+    /// `value` over `ramp` frames, starting at stream frame `at`. Fails if the parameter is
+    /// unknown, the value is out of range or the timeline is full.
+    pub(crate) fn schedule(
+        &self,
+        parameter: i32,
+        value: f32,
+        at: u64,
+        ramp: u64,
+    ) -> Result<(), &'static str> {
+        let Some(parameter) = PARAMETERS.iter().position(|(id, _)| *id == parameter) else {
+            return Err("Invalid processor parameter");
+        };
+        if !(0.0..=1.0).contains(&value) {
+            return Err("Scheduled parameter value must be between 0 and 1");
+        }
+        // Read before claiming a slot, so a `clear` running concurrently either releases the
+        // slot or makes the change stale
+        let epoch = self.epoch.load(Ordering::Acquire);
+        let Some(change) = self.changes.iter().find(|change| {
+            change
+                .state
+                .compare_exchange(EMPTY, WRITING, Ordering::Acquire, Ordering::Relaxed)
+                .is_ok()
+        }) else {
+            return Err("Too many scheduled parameter changes");
+        };
+
+        change.parameter.store(parameter as u8, Ordering::Relaxed);
+        change.value.store(value.to_bits(), Ordering::Relaxed);
+        change.at.store(at, Ordering::Relaxed);
+        change.ramp.store(ramp, Ordering::Relaxed);
+        let sequence = self.next_sequence.fetch_add(1, Ordering::Relaxed);
+        change.sequence.store(sequence, Ordering::Relaxed);
+        change.epoch.store(epoch, Ordering::Relaxed);
+        self.pending.fetch_add(1, Ordering::Relaxed);
+        change.state.store(READY, Ordering::Release);
+        Ok(())
+    }
+
+    /// Frames processed since the processor was initialized.
+    pub(crate) fn position(&self) -> u64 {
+        self.position.load(Ordering::Relaxed)
+    }
+
+    /// Applies the changes due at the start of a block of `num_frames` frames. Called with
+    /// the processor locked.
+    pub(crate) fn apply(&self, processor: &sdk::Processor<'static>, num_frames: usize) {
+        if self.pending.load(Ordering::Acquire) == 0 {
+            return;
+        }
+        let position = self.position();
+        let context = processor.processor_context();
+
+        for (index, (_, parameter)) in PARAMETERS.iter().enumerate() {
+            let Some(change) = self.latest_due(index as u8, position + num_frames as u64) else {
+                continue;
+            };
+            let target = f32::from_bits(change.value.load(Ordering::Relaxed));
+            if change.state.load(Ordering::Relaxed) == READY {
+                let start = context.parameter(parameter()).unwrap_or(target);
+                change.start_value.store(start.to_bits(), Ordering::Relaxed);
+                change.state.store(ACTIVE, Ordering::Relaxed);
+            }
+            let start = f32::from_bits(change.start_value.load(Ordering::Relaxed));
+
+            let elapsed = position + num_frames as u64 - change.at.load(Ordering::Relaxed);
+            let ramp = change.ramp.load(Ordering::Relaxed);
+            let value = if elapsed >= ramp {
+                self.release(change);
+                target
+            } else {
+                start + (target - start) * (elapsed as f64 / ramp as f64) as f32
+            };
+            // The value was range checked when it was scheduled
+            let _ = context.set_parameter(parameter(), value);
+        }
+    }
+
+    /// Advances the stream position past a processed block.
+    pub(crate) fn advance(&self, num_frames: usize) {
+        self.position
+            .store(self.position() + num_frames as u64, Ordering::Relaxed);
+    }
+
+    /// Drops all scheduled changes and restarts the stream position at 0. Called with the
+    /// processor locked. Changes still being scheduled become stale and are dropped by the
+    /// audio path once they are ready.
+    pub(crate) fn clear(&self) {
+        self.epoch.fetch_add(1, Ordering::AcqRel);
+        for change in &self.changes {
+            let state = change.state.load(Ordering::Acquire);
+            if state == READY || state == ACTIVE {
+                self.release(change);
+            }
+        }
+        self.position.store(0, Ordering::Relaxed);
+    }
+
+    /// Returns the latest scheduled change of `parameter` starting before `end`, and releases
+    /// all earlier ones.
+    fn latest_due(&self, parameter: u8, end: u64) -> Option<&ScheduledChange> {
+        let order = |change: &ScheduledChange| {
+            (
+                change.at.load(Ordering::Relaxed),
+                change.sequence.load(Ordering::Relaxed),
+            )
+        };
+        let epoch = self.epoch.load(Ordering::Relaxed);
+        let mut latest: Option<&ScheduledChange> = None;
+        for change in &self.changes {
+            let state = change.state.load(Ordering::Acquire);
+            if state != READY && state != ACTIVE {
+                continue;
+            }
+            if change.epoch.load(Ordering::Relaxed) != epoch {
+                self.release(change);
+                continue;
+            }
+            if change.parameter.load(Ordering::Relaxed) != parameter
+                || change.at.load(Ordering::Relaxed) >= end
+            {
+                continue;
+            }
+            match latest {
+                Some(current) if order(current) > order(change) => self.release(change),
+                Some(current) => {
+                    self.release(current);
+                    latest = Some(change);
+                }
+                None => latest = Some(change),
+            }
+        }
+        latest
+    }
+
+    fn release(&self, change: &ScheduledChange) {
+        change.state.store(EMPTY, Ordering::Release);
+        self.pending.fetch_sub(1, Ordering::Relaxed);
+    }
+}
@@ -0,0 +1,169 @@
+//! Sample formats of encoded audio: 32-bit float, 16-bit PCM and G.711 µ-law and A-law, all
+//! little-endian and interleaved.
+//!
+//! The G.711 conversions follow the ITU-T reference implementation (Sun's `g711.c`).
+
+use std::sync::LazyLock;
+
+/// Converts a float sample to 16-bit PCM, scaling by 32768 and saturating at full scale, so
+/// that decoding and encoding again is lossless.
+#[inline]
+pub(crate) fn to_pcm16(sample: f32) -> i16 {
+    // Float to int casts saturate, and NaN becomes 0
+    (sample * 32768.0).round() as i16
+}
+
+#[inline]
+pub(crate) fn from_pcm16(sample: i16) -> f32 {
+    f32::from(sample) * (1.0 / 32768.0)
+}
+
+const MULAW_BIAS: i32 = 0x84;
+const MULAW_CLIP: i32 = 8159;
+
+fn mulaw_decode(byte: u8) -> i16 {
+    let byte = !byte;
+    let mut value = ((i32::from(byte) & 0x0f) << 3) + MULAW_BIAS;
+    value <<= (byte & 0x70) >> 4;
+    (if byte & 0x80 != 0 {
+        MULAW_BIAS - value
+    } else {
+        value - MULAW_BIAS
+    }) as i16
+}
+
+fn mulaw_encode(sample: i16) -> u8 {
+    // 14-bit magnitude
+    let mut value = i32::from(sample) >> 2;
+    let mask = if value < 0 {
+        value = -value;
+        0x7f
+    } else {
+        0xff
+    };
+    value = value.min(MULAW_CLIP) + (MULAW_BIAS >> 2);
+    // Segment 0 ends at 0x3f, each further segment doubles
+    let segment = (u32::BITS - (value as u32 >> 6).leading_zeros()).min(8) as i32;
+    if segment >= 8 {
+        return 0x7f ^ mask;
+    }
+    (((segment << 4) | ((value >> (segment + 1)) & 0x0f)) as u8) ^ mask
+}
+
+fn alaw_decode(byte: u8) -> i16 {
+    let byte = byte ^ 0x55;
+    let mut value = (i32::from(byte) & 0x0f) << 4;
+    match (byte & 0x70) >> 4 {
+        0 => value += 8,
+        1 => value += 0x108,
+        segment => value = (value + 0x108) << (segment - 1),
+    }
+    (if byte & 0x80 != 0 { value } else { -value }) as i16
+}
+
+fn alaw_encode(sample: i16) -> u8 {
+    // 13-bit magnitude
+    let mut value = i32::from(sample) >> 3;
+    let mask = if value >= 0 {
+        0xd5
+    } else {
+        value = -value - 1;
+        0x55
+    };
+    // Segment 0 ends at 0x1f, each further segment doubles
+    let segment = (u32::BITS - (value as u32 >> 5).leading_zeros()) as i32;
+    if segment >= 8 {
+        return 0x7f ^ mask;
+    }
+    let quantized = if segment < 2 {
+        (value >> 1) & 0x0f
+    } else {
+        (value >> segment) & 0x0f
+    };
+    (((segment << 4) | quantized) as u8) ^ mask
+}
+
+/// Decoded value of every G.711 byte.
+fn decode_table(decode: fn(u8) -> i16) -> [i16; 256] {
+    std::array::from_fn(|byte| decode(byte as u8))
+}
+
+static MULAW_TABLE: LazyLock<[i16; 256]> = LazyLock::new(|| decode_table(mulaw_decode));
+static ALAW_TABLE: LazyLock<[i16; 256]> = LazyLock::new(|| decode_table(alaw_decode));
+
+/// Format of encoded audio.
+#[derive(Clone, Copy, PartialEq, Eq)]
+pub(crate) enum Codec {
+    Float32,
+    Pcm16,
+    Mulaw,
+    Alaw,
+}
+
+impl Codec {
+    pub(crate) fn from_name(name: &str) -> Option<Codec> {
+        match name {
+            "float32" => Some(Codec::Float32),
+            "pcm16" => Some(Codec::Pcm16),
+            "mulaw" => Some(Codec::Mulaw),
+            "alaw" => Some(Codec::Alaw),
+            _ => None,
+        }
+    }
+
+    pub(crate) fn bytes_per_sample(self) -> usize {
+        match self {
+            Codec::Float32 => 4,
+            Codec::Pcm16 => 2,
+            Codec::Mulaw | Codec::Alaw => 1,
+        }
+    }
+
+    /// Decodes whole samples from `bytes` and appends them to `samples`. `bytes` must hold a
+    /// multiple of `bytes_per_sample`.
+    pub(crate) fn decode(self, bytes: &[u8], samples: &mut Vec<f32>) {
+        debug_assert_eq!(bytes.len() % self.bytes_per_sample(), 0);
+        match self {
+            Codec::Float32 => samples.extend(
+                bytes
+                    .chunks_exact(4)
+                    .map(|sample| f32::from_le_bytes([sample[0], sample[1], sample[2], sample[3]])),
+            ),
+            Codec::Pcm16 => samples.extend(
+                bytes
+                    .chunks_exact(2)
+                    .map(|sample| from_pcm16(i16::from_le_bytes([sample[0], sample[1]]))),
+            ),
+            Codec::Mulaw => {
+                let table = &*MULAW_TABLE;
+                samples.extend(bytes.iter().map(|&byte| from_pcm16(table[byte as usize])));
+            }
+            Codec::Alaw => {
+                let table = &*ALAW_TABLE;
+                samples.extend(bytes.iter().map(|&byte| from_pcm16(table[byte as usize])));
+            }
+        }
+    }
+
+    /// Encodes `samples` and appends them to `bytes`.
+    pub(crate) fn encode(self, samples: &[f32], bytes: &mut Vec<u8>) {
+        match self {
+            Codec::Float32 => {
+                for sample in samples {
+                    bytes.extend_from_slice(&sample.to_le_bytes());
+                }
+            }
+            Codec::Pcm16 => {
+                for &sample in samples {
+                    bytes.extend_from_slice(&to_pcm16(sample).to_le_bytes());
+                }
+            }
+            Codec::Mulaw => {
+                bytes.extend(samples.iter().map(|&sample| mulaw_encode(to_pcm16(sample))))
+            }
+            Codec::Alaw => {
+                bytes.extend(samples.iter().map(|&sample| alaw_encode(to_pcm16(sample))))
+            }
+        }
+    }
+}
@@ -0,0 +1,781 @@
+//! Enhancement daemon: one process owns the model and the processors and serves the other
+//! processes on the host over a Unix domain socket.
+//!
+//! A client creates a memfd holding an input ring and an output ring, seals its size, and
+//! connects with a hello message carrying its stream configuration and, as SCM_RIGHTS, the
+//! memfd. The daemon checks the seals and the size, maps the memfd, creates and initializes a
+//! processor on its model, answers with the output delay, and runs a ring worker from the
+//! input into the output ring until the client disconnects. The daemon never opens a path
+//! named by a client, and a client cannot truncate the memory under the daemon's mapping. Audio
+//! never passes through the socket: both sides block on the ring indices with futexes, which
+//! work across processes on shared mappings.
+//!
+//! If processing fails, the daemon answers with a second reply carrying the error and ends
+//! the session. The client finds it on the socket while it waits for output.
+
+use std::collections::HashMap;
+use std::io::{self, Read, Write};
+use std::net::Shutdown;
+use std::os::fd::{AsFd, AsRawFd, BorrowedFd, FromRawFd, OwnedFd};
+use std::os::unix::net::{UnixListener, UnixStream};
+use std::path::{Path, PathBuf};
+use std::ptr;
+use std::sync::{
+    Arc, Mutex,
+    atomic::{AtomicBool, AtomicU64, Ordering},
+    mpsc,
+};
+use std::thread::JoinHandle;
+use std::time::{Duration, Instant};
+
+use neon::{
+    event::Channel,
+    handle::Root,
+    object::Object,
+    prelude::{Context, FunctionContext},
+    result::{JsResult, NeonResult},
+    types::{
+        Finalize, JsBoolean, JsBox, JsNumber, JsObject, JsPromise, JsString, JsUndefined, JsValue,
+    },
+};
+
+use crate::audio_ring::{RingMemory, ring_size};
+use crate::model::Model;
+use crate::processor::{RingWorker, SharedProcessor, StreamConfig};
+use crate::raw_samples::RawSamples;
+use crate::sdk;
+use crate::shared_memory::SharedMapping;
+use crate::thread_settings::{ThreadReport, ThreadSettings};
+
+const MAGIC: u32 = u32::from_le_bytes(*b"AICD");
+const PROTOCOL_VERSION: u32 = 2;
+/// Longest error message accepted in a reply.
+const MAX_MESSAGE_LEN: u32 = 4096;
+/// How long either side waits for the other during the handshake.
+const HANDSHAKE_TIMEOUT: Duration = Duration::from_secs(10);
+/// How often a session checks its ring worker, and a waiting client the socket.
+const SESSION_POLL_INTERVAL: Duration = Duration::from_millis(50);
+
+fn invalid_data(message: &str) -> io::Error {
+    io::Error::new(io::ErrorKind::InvalidData, message)
+}
+
+fn encode_words(words: &[u32], tail: &[u8]) -> Vec<u8> {
+    let mut message = Vec::with_capacity(words.len() * 4 + tail.len());
+    for word in words {
+        message.extend_from_slice(&word.to_le_bytes());
+    }
+    message.extend_from_slice(tail);
+    message
+}
+
+fn write_words(stream: &mut UnixStream, words: &[u32], tail: &[u8]) -> io::Result<()> {
+    stream.write_all(&encode_words(words, tail))
+}
+
+/// Control buffer for one SCM_RIGHTS descriptor, aligned for `cmsghdr`.
+#[repr(C, align(8))]
+struct FdControl([u8; 64]);
+
+/// Sends `message` with `fd` attached as SCM_RIGHTS.
+fn send_with_fd(stream: &UnixStream, message: &[u8], fd: BorrowedFd) -> io::Result<()> {
+    let mut control = FdControl([0; 64]);
+    let mut iov = libc::iovec {
+        iov_base: message.as_ptr().cast_mut().cast(),
+        iov_len: message.len(),
+    };
+    // SAFETY: The header points at live buffers, and the control buffer is large enough and
+    // aligned for one descriptor.
+    let sent = unsafe {
+        let mut header: libc::msghdr = std::mem::zeroed();
+        header.msg_iov = &mut iov;
+        header.msg_iovlen = 1;
+        header.msg_control = control.0.as_mut_ptr().cast();
+        header.msg_controllen = libc::CMSG_SPACE(size_of::<libc::c_int>() as u32) as _;
+        let cmsg = libc::CMSG_FIRSTHDR(&header);
+        (*cmsg).cmsg_level = libc::SOL_SOCKET;
+        (*cmsg).cmsg_type = libc::SCM_RIGHTS;
+        (*cmsg).cmsg_len = libc::CMSG_LEN(size_of::<libc::c_int>() as u32) as _;
+        ptr::write_unaligned(libc::CMSG_DATA(cmsg).cast(), fd.as_raw_fd());
+        libc::sendmsg(stream.as_raw_fd(), &header, libc::MSG_NOSIGNAL)
+    };
+    if sent < 0 {
+        return Err(io::Error::last_os_error());
+    }
+    if sent as usize != message.len() {
+        return Err(io::Error::new(
+            io::ErrorKind::WriteZero,
+            "Hello was cut short",
+        ));
+    }
+    Ok(())
+}
+
+/// Fills `message` from the stream and returns the descriptor sent along with it. Extra
+/// descriptors are closed.
+fn receive_with_fd(stream: &mut UnixStream, message: &mut [u8]) -> io::Result<OwnedFd> {
+    let mut control = FdControl([0; 64]);
+    let mut iov = libc::iovec {
+        iov_base: message.as_mut_ptr().cast(),
+        iov_len: message.len(),
+    };
+    // SAFETY: The header points at live buffers. Received descriptors are taken into
+    // ownership right away, so none leaks.
+    let (received, mut fds, truncated) = unsafe {
+        let mut header: libc::msghdr = std::mem::zeroed();
+        header.msg_iov = &mut iov;
+        header.msg_iovlen = 1;
+        header.msg_control = control.0.as_mut_ptr().cast();
+        header.msg_controllen = control.0.len() as _;
+        let received = libc::recvmsg(stream.as_raw_fd(), &mut header, libc::MSG_CMSG_CLOEXEC);
+        if received < 0 {
+            return Err(io::Error::last_os_error());
+        }
+
+        let mut fds = Vec::new();
+        let mut cmsg = libc::CMSG_FIRSTHDR(&header);
+        while !cmsg.is_null() {
+            if (*cmsg).cmsg_level == libc::SOL_SOCKET && (*cmsg).cmsg_type == libc::SCM_RIGHTS {
+                let data = libc::CMSG_DATA(cmsg).cast::<libc::c_int>();
+                let len = (*cmsg).cmsg_len as usize - libc::CMSG_LEN(0) as usize;
+                for i in 0..len / size_of::<libc::c_int>() {
+                    fds.push(OwnedFd::from_raw_fd(ptr::read_unaligned(data.add(i))));
+                }
+            }
+            cmsg = libc::CMSG_NXTHDR(&header, cmsg);
+        }
+        (
+            received as usize,
+            fds,
+            header.msg_flags & libc::MSG_CTRUNC != 0,
+        )
+    };
+
+    if received == 0 {
+        return Err(io::Error::new(
+            io::ErrorKind::UnexpectedEof,
+            "Client disconnected",
+        ));
+    }
+    if truncated || fds.len() != 1 {
+        return Err(invalid_data(
+            "Hello must carry exactly one shared memory descriptor",
+        ));
+    }
+    stream.read_exact(&mut message[received..])?;
+    Ok(fds.pop().unwrap())
+}
+
+fn read_words<const N: usize>(stream: &mut impl Read) -> io::Result<[u32; N]> {
+    let mut words = [0; N];
+    for word in &mut words {
+        let mut bytes = [0; 4];
+        stream.read_exact(&mut bytes)?;
+        *word = u32::from_le_bytes(bytes);
+    }
+    Ok(words)
+}
+
+/// Opening message of a client: its stream configuration. The memfd holding its rings is
+/// attached to it.
+struct Hello {
+    sample_rate: u32,
+    num_channels: usize,
+    num_frames: usize,
+    /// Capacity of each ring in frames.
+    capacity: usize,
+}
+
+impl Hello {
+    const LEN: usize = 6 * 4;
+
+    fn write_to(&self, stream: &UnixStream, memory: BorrowedFd) -> io::Result<()> {
+        let words = [
+            MAGIC,
+            PROTOCOL_VERSION,
+            self.sample_rate,
+            self.num_channels as u32,
+            self.num_frames as u32,
+            self.capacity as u32,
+        ];
+        send_with_fd(stream, &encode_words(&words, &[]), memory)
+    }
+
+    fn read_from(stream: &mut UnixStream) -> io::Result<(Hello, OwnedFd)> {
+        let mut message = [0; Hello::LEN];
+        let memory = receive_with_fd(stream, &mut message)?;
+        let [
+            magic,
+            version,
+            sample_rate,
+            num_channels,
+            num_frames,
+            capacity,
+        ] = read_words::<6>(&mut &message[..])?;
+        if magic != MAGIC {
+            return Err(invalid_data("Not an enhancement daemon client"));
+        }
+        if version != PROTOCOL_VERSION {
+            return Err(invalid_data("Unsupported daemon protocol version"));
+        }
+
+        let hello = Hello {
+            sample_rate,
+            num_channels: num_channels as usize,
+            num_frames: num_frames as usize,
+            capacity: capacity as usize,
+        };
+        Ok((hello, memory))
+    }
+}
+
+/// Answers a hello with the output delay in frames, or with the reason for refusing it.
+fn write_reply(stream: &mut UnixStream, reply: Result<usize, &str>) -> io::Result<()> {
+    match reply {
+        Ok(output_delay) => write_words(stream, &[0, output_delay as u32, 0], &[]),
+        Err(message) => write_words(stream, &[1, 0, message.len() as u32], message.as_bytes()),
+    }
+}
+
+fn read_reply(stream: &mut impl Read) -> io::Result<Result<usize, String>> {
+    let [status, output_delay, message_len] = read_words::<3>(stream)?;
+    if status == 0 {
+        return Ok(Ok(output_delay as usize));
+    }
+    let mut message = vec![0; message_len.min(MAX_MESSAGE_LEN) as usize];
+    stream.read_exact(&mut message)?;
+    Ok(Err(String::from_utf8_lossy(&message).into_owned()))
+}
+
+/// State shared by the accept thread and the session threads of a daemon.
+struct Shared {
+    model: Root<JsBox<Model>>,
+    license_key: String,
+    /// Runs processor creation and teardown on the JavaScript thread, which owns the model.
+    /// Keeps the event loop alive while the daemon is running.
+    channel: Channel,
+    /// Sockets of the running sessions, shut down to end them.
+    sessions: Mutex<HashMap<u64, UnixStream>>,
+    stop: AtomicBool,
+    /// Applied to the ring worker of every session.
+    thread_settings: ThreadSettings,
+    /// Thread settings in effect on the most recently started session.
+    thread_report: Mutex<Option<ThreadReport>>,
+}
+
+/// A client's processor and the ring worker feeding it.
+struct Session {
+    processor: Option<Arc<SharedProcessor>>,
+    worker: Option<RingWorker>,
+    channel: Channel,
+}
+
+impl Session {
+    /// Reads the hello, attaches to the client's rings, and starts a processor on them.
+    /// Returns the session and its output delay.
+    fn start(shared: &Arc<Shared>, stream: &mut UnixStream) -> Result<(Session, usize), String> {
+        stream
+            .set_read_timeout(Some(HANDSHAKE_TIMEOUT))
+            .map_err(|e| e.to_string())?;
+        let (hello, memory) = Hello::read_from(stream).map_err(|e| e.to_string())?;
+        if hello.num_channels == 0 || hello.num_channels > usize::from(u16::MAX) {
+            return Err("Channel count must be from 1 to 65535".into());
+        }
+        if hello.num_frames == 0 || hello.capacity < hello.num_frames {
+            return Err("Rings must hold at least one block".into());
+        }
+
+        let output_offset = ring_size(hello.capacity, hello.num_channels);
+        let mapping = SharedMapping::open_sealed(memory, 2 * output_offset)
+            .map_err(|e| format!("Cannot map the shared memory: {e}"))?;
+        let mapping = Arc::new(mapping);
+        let input = RingMemory::mapped(mapping.clone(), 0, None)?;
+        let output = RingMemory::mapped(mapping, output_offset, None)?;
+        if input.num_channels() != hello.num_channels || output.num_channels() != hello.num_channels
+        {
+            return Err("Ring channel counts do not match the hello".into());
+        }
+        // The output ring starts right after an input ring of the announced capacity
+        if input.capacity() != hello.capacity || output.capacity() != hello.capacity {
+            return Err("Ring capacities do not match the hello".into());
+        }
+
+        // The model cannot leave the JavaScript thread, so the SDK processor is created there
+        let (sender, receiver) = mpsc::channel();
+        let creator = shared.clone();
+        shared.channel.send(move |mut cx| {
+            let model = creator.model.to_inner(&mut cx);
+            let processor = SharedProcessor::new(&model.inner, &creator.license_key, None);
+            let _ = sender.send(processor.map_err(|e| e.to_string()));
+            Ok(())
+        });
+        let processor = receiver
+            .recv()
+            .map_err(|_| "Daemon is shutting down".to_string())??;
+        let mut session = Session {
+            processor: Some(Arc::new(processor)),
+            worker: None,
+            channel: shared.channel.clone(),
+        };
+        let processor = session.processor.clone().unwrap();
+
+        let config = StreamConfig {
+            sample_rate: hello.sample_rate,
+            num_channels: hello.num_channels,
+            num_frames: hello.num_frames,
+            allow_variable_frames: false,
+        };
+        let output_delay = {
+            let mut locked = processor.lock();
+            locked
+                .initialize(&sdk::ProcessorConfig {
+                    sample_rate: config.sample_rate,
+                    num_channels: config.num_channels as u16,
+                    num_frames: config.num_frames,
+                    allow_variable_frames: false,
+                })
+                .map_err(|e| e.to_string())?;
+            processor.output_delay(&locked)
+        };
+
+        let (worker, report) = RingWorker::spawn(
+            processor,
+            config,
+            Arc::new(input),
+            Arc::new(output),
+            shared.thread_settings.clone(),
+            None,
+        );
+        session.worker = Some(worker);
+        *shared.thread_report.lock().unwrap() = Some(report);
+        Ok((session, output_delay))
+    }
+}
+
+impl Session {
+    fn worker_error(&mut self) -> Option<String> {
+        let error = self.worker.as_mut()?.error()?;
+        Some(format!("Processing failed: {error}"))
+    }
+}
+
+impl Drop for Session {
+    fn drop(&mut self) {
+        // Stop the worker first, so the processor is released on the JavaScript thread
+        drop(self.worker.take());
+        let processor = self.processor.take();
+        self.channel.send(move |_| {
+            drop(processor);
+            Ok(())
+        });
+    }
+}
+
+/// Serves one client until it disconnects or the daemon closes.
+fn run_session(shared: Arc<Shared>, id: u64, mut stream: UnixStream) {
+    let mut session = match Session::start(&shared, &mut stream) {
+        Ok((session, output_delay)) => {
+            if write_reply(&mut stream, Ok(output_delay)).is_err() {
+                return;
+            }
+            session
+        }
+        Err(message) => {
+            let _ = write_reply(&mut stream, Err(&message));
+            return;
+        }
+    };
+
+    let Ok(handle) = stream.try_clone() else {
+        return;
+    };
+    shared.sessions.lock().unwrap().insert(id, handle);
+    // The client sends nothing after its hello, so a read only returns data or end of file
+    // once it disconnects or the daemon shuts the socket down. Between reads that time out
+    // the session checks its ring worker.
+    let polling = stream.set_read_timeout(Some(SESSION_POLL_INTERVAL)).is_ok();
+    if !shared.stop.load(Ordering::Acquire) && polling {
+        let mut byte = [0; 1];
+        loop {
+            match stream.read(&mut byte) {
+                Ok(read) if read > 0 => continue,
+                Err(e)
+                    if matches!(
+                        e.kind(),
+                        io::ErrorKind::WouldBlock | io::ErrorKind::TimedOut
+                    ) => {}
+                _ => break,
+            }
+            if let Some(message) = session.worker_error() {
+                let _ = write_reply(&mut stream, Err(&message));
+                break;
+            }
+        }
+    }
+    shared.sessions.lock().unwrap().remove(&id);
+    drop(session);
+}
+
+/// A running daemon.
+struct Running {
+    shared: Arc<Shared>,
+    socket_path: PathBuf,
+    accept_thread: JoinHandle<()>,
+}
+
+pub struct Daemon {
+    running: Mutex<Option<Running>>,
+}
+
+impl Finalize for Daemon {
+    fn finalize<'a, C: neon::prelude::Context<'a>>(self, _: &mut C) {}
+}
+
+/// Binds the socket, replacing a stale socket file that no daemon is listening on.
+fn bind(socket_path: &Path) -> io::Result<UnixListener> {
+    match UnixListener::bind(socket_path) {
+        Err(e) if e.kind() == io::ErrorKind::AddrInUse => {
+            if UnixStream::connect(socket_path).is_ok() {
+                return Err(e);
+            }
+            std::fs::remove_file(socket_path)?;
+            UnixListener::bind(socket_path)
+        }
+        result => result,
+    }
+}
+
+impl Daemon {
+    /// Starts serving clients on a Unix domain socket. Arguments: model, license key, socket
+    /// path and the thread options of the session workers.
+    pub fn new(mut cx: FunctionContext) -> JsResult<JsBox<Daemon>> {
+        let model = cx.argument::<JsBox<Model>>(0)?;
+        let license_key = cx.argument::<JsString>(1)?.value(&mut cx);
+        let socket_path = PathBuf::from(cx.argument::<JsString>(2)?.value(&mut cx));
+        let thread_settings = match cx.argument_opt(3) {
+            Some(value) => ThreadSettings::from_js(&mut cx, value)?,
+            None => ThreadSettings::default(),
+        };
+
+        let listener = match bind(&socket_path) {
+            Ok(listener) => listener,
+            Err(e) => {
+                return cx.throw_error(format!("Cannot listen on {}: {e}", socket_path.display()));
+            }
+        };
+
+        let shared = Arc::new(Shared {
+            model: model.root(&mut cx),
+            license_key,
+            channel: cx.channel(),
+            sessions: Mutex::new(HashMap::new()),
+            stop: AtomicBool::new(false),
+            thread_settings,
+            thread_report: Mutex::new(None),
+        });
+
+        let accept_thread = {
+            let shared = shared.clone();
+            std::thread::Builder::new()
+                .name("aic-daemon".into())
+                .spawn(move || {
+                    let next_id = AtomicU64::new(0);
+                    for stream in listener.incoming() {
+                        if shared.stop.load(Ordering::Acquire) {
+                            break;
+                        }
+                        let Ok(stream) = stream else {
+                            continue;
+                        };
+                        let id = next_id.fetch_add(1, Ordering::Relaxed);
+                        let shared = shared.clone();
+                        // Without a thread the stream is dropped, which refuses the client
+                        let _ = std::thread::Builder::new()
+                            .name("aic-daemon-session".into())
+                            .spawn(move || run_session(shared, id, stream));
+                    }
+                })
+                .expect("Daemon thread can be spawned")
+        };
+
+        Ok(cx.boxed(Daemon {
+            running: Mutex::new(Some(Running {
+                shared,
+                socket_path,
+                accept_thread,
+            })),
+        }))
+    }
+
+    /// Returns the number of connected clients.
+    pub fn session_count(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let this = cx.argument::<JsBox<Daemon>>(0)?;
+        let count = match this.running.lock().unwrap().as_ref() {
+            Some(running) => running.shared.sessions.lock().unwrap().len(),
+            None => 0,
+        };
+        Ok(cx.number(count as f64))
+    }
+
+    /// Returns the thread settings in effect on the most recently started session, or null
+    /// before the first one.
+    pub fn thread_report(mut cx: FunctionContext) -> JsResult<JsValue> {
+        let this = cx.argument::<JsBox<Daemon>>(0)?;
+        let report = match this.running.lock().unwrap().as_ref() {
+            Some(running) => running.shared.thread_report.lock().unwrap().clone(),
+            None => None,
+        };
+        match report {
+            Some(report) => Ok(report.to_js(&mut cx)?.upcast()),
+            None => Ok(cx.null().upcast()),
+        }
+    }
+
+    /// Stops accepting clients, disconnects all sessions and removes the socket file. The
+    /// sessions release their processors on the JavaScript thread shortly after.
+    pub fn close(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let this = cx.argument::<JsBox<Daemon>>(0)?;
+        let Some(running) = this.running.lock().unwrap().take() else {
+            return Ok(cx.undefined());
+        };
+
+        running.shared.stop.store(true, Ordering::Release);
+        // Wake the accept thread, which sees the stop flag before serving this connection
+        let _ = UnixStream::connect(&running.socket_path);
+        let _ = running.accept_thread.join();
+        for (_, session) in running.shared.sessions.lock().unwrap().drain() {
+            let _ = session.shutdown(Shutdown::Both);
+        }
+        let _ = std::fs::remove_file(&running.socket_path);
+
+        Ok(cx.undefined())
+    }
+}
+
+/// A client's connection to a daemon and its rings.
+struct Connection {
+    stream: UnixStream,
+    input: RingMemory,
+    output: RingMemory,
+    output_delay: usize,
+}
+
+impl Connection {
+    /// Creates the rings, sends the hello and waits for the daemon to start the session.
+    fn open(socket_path: &Path, hello: Hello) -> Result<Connection, String> {
+        let size = 2 * ring_size(hello.capacity, hello.num_channels);
+        let (mapping, memory) = SharedMapping::create_sealed(c"aic-daemon-rings", size)
+            .map_err(|e| format!("Cannot create the shared memory: {e}"))?;
+        let mapping = Arc::new(mapping);
+
+        let ring = Some((hello.capacity, hello.num_channels));
+        let input = RingMemory::mapped(mapping.clone(), 0, ring)?;
+        let output_offset = ring_size(hello.capacity, hello.num_channels);
+        let output = RingMemory::mapped(mapping, output_offset, ring)?;
+
+        let mut stream = UnixStream::connect(socket_path)
+            .map_err(|e| format!("Cannot connect to {}: {e}", socket_path.display()))?;
+        stream
+            .set_read_timeout(Some(HANDSHAKE_TIMEOUT))
+            .map_err(|e| e.to_string())?;
+        hello
+            .write_to(&stream, memory.as_fd())
+            .map_err(|e| e.to_string())?;
+        let output_delay = read_reply(&mut stream).map_err(|e| e.to_string())??;
+
+        Ok(Connection {
+            stream,
+            input,
+            output,
+            output_delay,
+        })
+    }
+}
+
+impl Connection {
+    /// Returns why the daemon ended the session, or `None` while it is running.
+    fn session_error(&self) -> Option<String> {
+        const ENDED: &str = "Daemon ended the session";
+
+        let mut byte = 0u8;
+        // SAFETY: Peeks at most one byte into `byte` without blocking or consuming it.
+        let peeked = unsafe {
+            libc::recv(
+                self.stream.as_raw_fd(),
+                (&raw mut byte).cast(),
+                1,
+                libc::MSG_PEEK | libc::MSG_DONTWAIT,
+            )
+        };
+        match peeked {
+            -1 if io::Error::last_os_error().kind() == io::ErrorKind::WouldBlock => None,
+            1 => match read_reply(&mut &self.stream) {
+                Ok(Err(message)) => Some(message),
+                _ => Some(ENDED.into()),
+            },
+            // End of file or a failed socket
+            _ => Some(ENDED.into()),
+        }
+    }
+}
+
+impl Drop for Connection {
+    fn drop(&mut self) {
+        let _ = self.stream.shutdown(Shutdown::Both);
+    }
+}
+
+pub struct DaemonClient {
+    connection: Mutex<Option<Connection>>,
+}
+
+impl Finalize for DaemonClient {
+    fn finalize<'a, C: neon::prelude::Context<'a>>(self, _: &mut C) {}
+}
+
+impl DaemonClient {
+    /// Connects to a daemon on the Node worker pool. Arguments: socket path and `{
+    /// sampleRate, numChannels, numFrames, capacity }`, where the capacity of each ring is a
+    /// power of two. Resolves with the client.
+    pub fn connect(mut cx: FunctionContext) -> JsResult<JsPromise> {
+        let socket_path = PathBuf::from(cx.argument::<JsString>(0)?.value(&mut cx));
+        let options = cx.argument::<JsObject>(1)?;
+        let mut number = |key: &str| -> NeonResult<f64> {
+            Ok(options.get::<JsNumber, _, _>(&mut cx, key)?.value(&mut cx))
+        };
+        let sample_rate = number("sampleRate")?;
+        let num_channels = number("numChannels")?;
+        let num_frames = number("numFrames")?;
+        let capacity = number("capacity")?;
+
+        if !(num_channels >= 1.0 && num_channels <= f64::from(u16::MAX)) {
+            return cx.throw_range_error("numChannels must be from 1 to 65535");
+        }
+        if !(num_frames >= 1.0 && capacity >= num_frames) {
+            return cx.throw_range_error("capacity must hold at least one block");
+        }
+        let hello = Hello {
+            sample_rate: sample_rate as u32,
+            num_channels: num_channels as usize,
+            num_frames: num_frames as usize,
+            capacity: capacity as usize,
+        };
+
+        Ok(cx
+            .task(move || Connection::open(&socket_path, hello))
+            .promise(move |mut cx, connection| match connection {
+                Ok(connection) => Ok(cx.boxed(DaemonClient {
+                    connection: Mutex::new(Some(connection)),
+                })),
+                Err(message) => cx.throw_error(message),
+            }))
+    }
+
+    /// Runs `f` on the open connection, or throws if the client was closed.
+    fn with_connection<'a, T>(
+        cx: &mut FunctionContext<'a>,
+        f: impl FnOnce(&mut FunctionContext<'a>, &Connection) -> NeonResult<T>,
+    ) -> NeonResult<T> {
+        let this = cx.argument::<JsBox<DaemonClient>>(0)?;
+        let connection = this.connection.lock().unwrap();
+        match connection.as_ref() {
+            Some(connection) => f(cx, connection),
+            None => cx.throw_error("DaemonClient is closed"),
+        }
+    }
+
+    /// Writes as many whole frames of the interleaved buffer in argument 1 into the input
+    /// ring as fit, and returns their number.
+    pub fn write(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let buffer = cx.argument::<JsValue>(1)?;
+        let samples = RawSamples::from_value(&mut cx, buffer)?;
+        // SAFETY: The buffer handle keeps the samples alive for the duration of the call, and
+        // the JavaScript thread is the only producer of the input ring.
+        let written = Self::with_connection(&mut cx, |_, connection| {
+            Ok(unsafe { connection.input.write(&samples) })
+        })?;
+        Ok(cx.number(written as f64))
+    }
+
+    /// Reads as many whole frames from the output ring as fit into the buffer in argument 1,
+    /// and returns their number.
+    pub fn read(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let buffer = cx.argument::<JsValue>(1)?;
+        let samples = RawSamples::from_value(&mut cx, buffer)?;
+        // SAFETY: The buffer handle keeps the samples alive for the duration of the call, and
+        // the JavaScript thread is the only consumer of the output ring.
+        let read = Self::with_connection(&mut cx, |_, connection| {
+            Ok(unsafe { connection.output.read(&samples) })
+        })?;
+        Ok(cx.number(read as f64))
+    }
+
+    /// Returns the number of enhanced frames ready to be read.
+    pub fn available(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let available =
+            Self::with_connection(&mut cx, |_, connection| Ok(connection.output.available()))?;
+        Ok(cx.number(available as f64))
+    }
+
+    /// Returns the number of frames that can be written.
+    pub fn free(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let free = Self::with_connection(&mut cx, |_, connection| Ok(connection.input.free()))?;
+        Ok(cx.number(free as f64))
+    }
+
+    /// Blocks until the number of frames in argument 1 can be read or the timeout in
+    /// milliseconds in argument 2 expires. Returns whether the frames are available, and
+    /// throws if the daemon ended the session in the meantime.
+    pub fn wait_for_output(mut cx: FunctionContext) -> JsResult<JsBoolean> {
+        let num_frames = cx.argument::<JsNumber>(1)?.value(&mut cx) as usize;
+        let timeout_ms = cx.argument::<JsNumber>(2)?.value(&mut cx).max(0.0);
+        let timeout = Duration::from_secs_f64(timeout_ms.min(1e9) * 1e-3);
+        let ready = Self::with_connection(&mut cx, |cx, connection| {
+            let deadline = Instant::now() + timeout;
+            loop {
+                let left = deadline.saturating_duration_since(Instant::now());
+                let slice = left.min(SESSION_POLL_INTERVAL);
+                if connection.output.wait_available(num_frames, slice) {
+                    return Ok(true);
+                }
+                if let Some(message) = connection.session_error() {
+                    return cx.throw_error(message);
+                }
+                if left.is_zero() {
+                    return Ok(false);
+                }
+            }
+        })?;
+        Ok(cx.boolean(ready))
+    }
+
+    pub fn output_delay(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let output_delay =
+            Self::with_connection(&mut cx, |_, connection| Ok(connection.output_delay))?;
+        Ok(cx.number(output_delay as f64))
+    }
+
+    /// Disconnects from the daemon, which ends the session.
+    pub fn close(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let this = cx.argument::<JsBox<DaemonClient>>(0)?;
+        drop(this.connection.lock().unwrap().take());
+        Ok(cx.undefined())
+    }
+}
+
+pub fn register_exports(cx: &mut neon::prelude::ModuleContext) -> NeonResult<()> {
+    cx.export_function("daemonNew", Daemon::new)?;
+    cx.export_function("daemonSessionCount", Daemon::session_count)?;
+    cx.export_function("daemonThreadReport", Daemon::thread_report)?;
+    cx.export_function("daemonClose", Daemon::close)?;
+    cx.export_function("daemonClientConnect", DaemonClient::connect)?;
+    cx.export_function("daemonClientWrite", DaemonClient::write)?;
+    cx.export_function("daemonClientRead", DaemonClient::read)?;
+    cx.export_function("daemonClientAvailable", DaemonClient::available)?;
+    cx.export_function("daemonClientFree", DaemonClient::free)?;
+    cx.export_function("daemonClientWaitForOutput", DaemonClient::wait_for_output)?;
+    cx.export_function("daemonClientOutputDelay", DaemonClient::output_delay)?;
+    cx.export_function("daemonClientClose", DaemonClient::close)?;
+
+    Ok(())
+}
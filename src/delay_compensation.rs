@@ -0,0 +1,67 @@
+/// Trims the model's output delay from the front of the processed stream so that output frame
+/// `i` corresponds to input frame `i`.
+///
+/// The first `output_delay` processed frames carry no input audio. With compensation enabled
+/// they are dropped, so the first calls after initialization return fewer valid frames than
+/// they were given. The matching frames at the end of the stream are produced by feeding
+/// silence through the processor on flush.
+#[derive(Clone, Copy)]
+pub(crate) struct DelayCompensation {
+    enabled: bool,
+    output_delay: usize,
+    /// Leading frames still to be dropped.
+    trim_frames: usize,
+}
+
+impl DelayCompensation {
+    pub const DISABLED: DelayCompensation = DelayCompensation {
+        enabled: false,
+        output_delay: 0,
+        trim_frames: 0,
+    };
+
+    pub fn new(enabled: bool, output_delay: usize) -> DelayCompensation {
+        let mut compensation = DelayCompensation {
+            enabled,
+            output_delay,
+            trim_frames: 0,
+        };
+        compensation.restart();
+        compensation
+    }
+
+    /// Starts a new stream, so that its leading delay is trimmed again.
+    pub fn restart(&mut self) {
+        self.trim_frames = if self.enabled { self.output_delay } else { 0 };
+    }
+
+    /// Consumes up to `num_frames` frames of the leading delay and returns how many of them
+    /// have to be dropped from the front of a block of `num_frames` processed frames.
+    pub fn take_trim(&mut self, num_frames: usize) -> usize {
+        let trim = self.trim_frames.min(num_frames);
+        self.trim_frames -= trim;
+        trim
+    }
+}
+
+/// Drops `trim` leading frames of an interleaved block by moving the rest to the front.
+/// Returns the number of frames left at the front.
+pub(crate) fn trim_interleaved(samples: &mut [f32], num_channels: usize, trim: usize) -> usize {
+    let num_frames = samples.len() / num_channels;
+    if trim > 0 {
+        samples.copy_within(trim * num_channels.., 0);
+    }
+    num_frames - trim
+}
+
+/// Drops `trim` leading frames of each channel of a sequential block by moving the rest of
+/// each channel to the start of that channel. Returns the number of frames left per channel.
+pub(crate) fn trim_sequential(samples: &mut [f32], num_channels: usize, trim: usize) -> usize {
+    let num_frames = samples.len() / num_channels;
+    if trim > 0 {
+        for channel in samples.chunks_exact_mut(num_frames) {
+            channel.copy_within(trim.., 0);
+        }
+    }
+    num_frames - trim
+}
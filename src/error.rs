@@ -0,0 +1,63 @@
+use std::mem::Discriminant;
+use std::sync::Mutex;
+
+use neon::{object::Object, prelude::Context, result::NeonResult};
+
+use crate::sdk;
+
+/// Code and message of an SDK error variant, built on its first occurrence and kept for the
+/// lifetime of the process, so throwing the same error again does not allocate.
+#[derive(Clone, Copy)]
+struct ErrorInfo {
+    variant: Discriminant<sdk::AicError>,
+    code: &'static str,
+    /// `None` for variants with a payload, whose message depends on the payload.
+    message: Option<&'static str>,
+}
+
+/// One entry per error variant seen so far.
+static ERRORS: Mutex<Vec<ErrorInfo>> = Mutex::new(Vec::new());
+
+#[cold]
+fn error_info(error: &sdk::AicError) -> ErrorInfo {
+    let variant = std::mem::discriminant(error);
+    let mut errors = ERRORS.lock().unwrap();
+    if let Some(info) = errors.iter().find(|info| info.variant == variant) {
+        return *info;
+    }
+
+    // The variant name is the Debug output up to its payload
+    let debug = format!("{error:?}");
+    let code_len = debug.find(['(', ' ', '{']).unwrap_or(debug.len());
+    let message =
+        (code_len == debug.len()).then(|| &*Box::leak(error.to_string().into_boxed_str()));
+    let info = ErrorInfo {
+        variant,
+        code: Box::leak(debug[..code_len].into()),
+        message,
+    };
+    errors.push(info);
+    info
+}
+
+/// Static code of an SDK error: the name of its variant, e.g. `"AudioConfigMismatch"`.
+pub(crate) fn error_code(error: &sdk::AicError) -> &'static str {
+    error_info(error).code
+}
+
+/// Throws an SDK error as a JavaScript `Error` carrying its message and a `code` property.
+///
+/// Only the first occurrence of each error variant, and variants with a payload, allocate.
+pub(crate) fn throw_aic_error<'a, C: Context<'a>, T>(
+    cx: &mut C,
+    error: &sdk::AicError,
+) -> NeonResult<T> {
+    let info = error_info(error);
+    let js_error = match info.message {
+        Some(message) => cx.error(message)?,
+        None => cx.error(error.to_string())?,
+    };
+    let code = cx.string(info.code);
+    js_error.set(cx, "code", code)?;
+    cx.throw(js_error)
+}
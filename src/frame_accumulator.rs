@@ -0,0 +1,439 @@
+use std::sync::{Arc, Mutex};
+
+use neon::{
+    prelude::{Context, FunctionContext},
+    result::{JsResult, NeonResult},
+    types::{
+        Finalize, JsBox, JsBuffer, JsNumber, JsPromise, JsTypedArray, JsValue, buffer::TypedArray,
+    },
+};
+
+use crate::delay_compensation::{DelayCompensation, trim_interleaved};
+use crate::error::throw_aic_error;
+use crate::model_swap::AudioBlock;
+use crate::processor::{Processor, SharedProcessor, StreamConfig};
+use crate::raw_samples::{RawSamples, raw_bytes, sample_bytes};
+use crate::sdk;
+
+/// Re-chunks a stream of arbitrarily sized interleaved float32 chunks into blocks of the
+/// processor's configured frame count.
+///
+/// Incoming audio is appended to a buffer owned by the accumulator, processed block-wise in
+/// place, and handed back to JavaScript. The buffer is reused across chunks, so re-chunking
+/// does not allocate once it has grown to the largest chunk size.
+pub struct Accumulator {
+    processor: Arc<SharedProcessor>,
+    config: StreamConfig,
+    /// Processed samples not yet handed back, followed by less than one block of unprocessed
+    /// samples.
+    samples: Vec<f32>,
+    /// Number of processed samples at the front of `samples`.
+    num_processed: usize,
+    /// Bytes of a sample that was split across chunks.
+    partial: [u8; 4],
+    num_partial: usize,
+    compensation: DelayCompensation,
+}
+
+impl Accumulator {
+    pub fn new(processor: &Processor, config: StreamConfig) -> Accumulator {
+        Accumulator {
+            processor: processor.inner.clone(),
+            config,
+            samples: Vec::with_capacity(2 * config.num_channels * config.num_frames),
+            num_processed: 0,
+            partial: [0; 4],
+            num_partial: 0,
+            compensation: processor.delay_compensation(),
+        }
+    }
+
+    fn block_len(&self) -> usize {
+        self.config.num_channels * self.config.num_frames
+    }
+
+    /// Number of whole frames waiting for a complete block.
+    pub fn pending_frames(&self) -> usize {
+        (self.samples.len() - self.num_processed) / self.config.num_channels
+    }
+
+    /// Appends raw float32 bytes. A trailing incomplete sample is kept for the next chunk.
+    pub fn append_bytes(&mut self, mut bytes: &[u8]) {
+        const SAMPLE: usize = size_of::<f32>();
+
+        if self.num_partial > 0 {
+            let take = bytes.len().min(SAMPLE - self.num_partial);
+            self.partial[self.num_partial..self.num_partial + take].copy_from_slice(&bytes[..take]);
+            self.num_partial += take;
+            bytes = &bytes[take..];
+            if self.num_partial < SAMPLE {
+                return;
+            }
+            self.samples.push(f32::from_ne_bytes(self.partial));
+            self.num_partial = 0;
+        }
+
+        let num_samples = bytes.len() / SAMPLE;
+        let start = self.samples.len();
+        self.samples.resize(start + num_samples, 0.0);
+        // SAFETY: The destination was just resized to hold `num_samples` samples. Copying
+        // bytes avoids any alignment requirement on the source.
+        unsafe {
+            std::ptr::copy_nonoverlapping(
+                bytes.as_ptr(),
+                self.samples[start..].as_mut_ptr().cast::<u8>(),
+                num_samples * SAMPLE,
+            );
+        }
+
+        let rest = &bytes[num_samples * SAMPLE..];
+        self.partial[..rest.len()].copy_from_slice(rest);
+        self.num_partial = rest.len();
+    }
+
+    /// Appends decoded samples, e.g. from a pipeline.
+    pub fn append_samples(&mut self, samples: &[f32]) {
+        self.samples.extend_from_slice(samples);
+    }
+
+    /// Processes all complete blocks of pending input.
+    pub fn process_blocks(&mut self) -> Result<(), sdk::AicError> {
+        self.process_blocks_with(|_, _| {})
+    }
+
+    /// Processes all complete blocks of pending input and calls `after_block` with the locked
+    /// processor and the number of valid frames after each of them.
+    pub fn process_blocks_with(
+        &mut self,
+        mut after_block: impl FnMut(&sdk::Processor<'static>, usize),
+    ) -> Result<(), sdk::AicError> {
+        let block_len = self.block_len();
+        let mut processor = self.processor.lock();
+
+        while self.samples.len() - self.num_processed >= block_len {
+            let block = &mut self.samples[self.num_processed..self.num_processed + block_len];
+            self.processor.run(
+                &mut processor,
+                AudioBlock::Interleaved {
+                    samples: block,
+                    num_channels: self.config.num_channels,
+                },
+            )?;
+
+            let trim = self.compensation.take_trim(self.config.num_frames);
+            if trim > 0 {
+                let start = self.num_processed;
+                self.samples
+                    .drain(start..start + trim * self.config.num_channels);
+            }
+            self.num_processed += block_len - trim * self.config.num_channels;
+            after_block(&processor, self.config.num_frames - trim);
+        }
+
+        Ok(())
+    }
+
+    /// Throws while the processor has a post-processing stage, which accumulators do not run.
+    pub fn check_no_post_process<'a>(&self, cx: &mut impl Context<'a>) -> NeonResult<()> {
+        self.processor.check_no_post_process(cx)
+    }
+
+    /// Current output delay of the processor in frames.
+    pub fn output_delay(&self) -> usize {
+        let processor = self.processor.lock();
+        self.processor.output_delay(&processor)
+    }
+
+    /// Processes all complete blocks directly in the caller's buffer and keeps only the
+    /// remainder. Returns the number of processed samples, which start at the front of
+    /// `samples` and are fewer than the processed blocks while the leading delay is trimmed.
+    ///
+    /// Only valid while nothing is pending, since the caller's audio must come after any
+    /// buffered audio.
+    pub fn process_in_place(&mut self, samples: &mut [f32]) -> Result<usize, sdk::AicError> {
+        debug_assert!(self.samples.is_empty() && self.num_partial == 0);
+        let block_len = self.block_len();
+        let (blocks, rest) = samples.split_at_mut(samples.len() / block_len * block_len);
+
+        let num_channels = self.config.num_channels;
+        let mut num_processed = 0;
+        let mut processor = self.processor.lock();
+        for start in (0..blocks.len()).step_by(block_len) {
+            let block = &mut blocks[start..start + block_len];
+            self.processor.run(
+                &mut processor,
+                AudioBlock::Interleaved {
+                    samples: block,
+                    num_channels,
+                },
+            )?;
+
+            // Trimmed frames are overwritten by moving the valid frames forward
+            let trim = self.compensation.take_trim(self.config.num_frames);
+            let valid = trim_interleaved(&mut blocks[start..start + block_len], num_channels, trim);
+            blocks.copy_within(start..start + valid * num_channels, num_processed);
+            num_processed += valid * num_channels;
+        }
+        drop(processor);
+
+        self.samples.extend_from_slice(rest);
+        Ok(num_processed)
+    }
+
+    /// Pads the pending input with silence so that the audio still held back by the model's
+    /// output delay comes out, and processes it. Afterwards the processed samples end exactly
+    /// `output_delay` frames after the last input frame.
+    pub fn flush(&mut self) -> Result<(), sdk::AicError> {
+        self.flush_with(|_, _| {})
+    }
+
+    /// Like `flush`, calling `after_block` as `process_blocks_with` does.
+    pub fn flush_with(
+        &mut self,
+        after_block: impl FnMut(&sdk::Processor<'static>, usize),
+    ) -> Result<(), sdk::AicError> {
+        let output_delay = self.output_delay();
+        let num_channels = self.config.num_channels;
+        let num_frames = self.config.num_frames;
+
+        // A sample split across chunks at the end of the stream cannot be completed
+        self.num_partial = 0;
+
+        let tail_frames = self.pending_frames() + output_delay;
+        let padded_frames = tail_frames.div_ceil(num_frames) * num_frames;
+        self.samples
+            .resize(self.num_processed + padded_frames * num_channels, 0.0);
+
+        self.process_blocks_with(after_block)?;
+        self.samples
+            .truncate(self.num_processed - (padded_frames - tail_frames) * num_channels);
+        self.num_processed = self.samples.len();
+        self.compensation.restart();
+
+        Ok(())
+    }
+
+    /// Processed samples ready to be handed back.
+    pub fn processed(&self) -> &[f32] {
+        &self.samples[..self.num_processed]
+    }
+
+    /// Drops the processed samples and moves the pending remainder to the front.
+    pub fn drain_processed(&mut self) {
+        self.samples.drain(..self.num_processed);
+        self.num_processed = 0;
+    }
+
+    /// Copies the processed samples into `output` and drains them. Returns the number of
+    /// samples copied, or `None` if `output` is too small.
+    fn take_processed_into(&mut self, output: &mut [f32]) -> Option<usize> {
+        let processed = self.processed();
+        let num_samples = processed.len();
+        output.get_mut(..num_samples)?.copy_from_slice(processed);
+        self.drain_processed();
+        Some(num_samples)
+    }
+
+    /// Copies the processed samples into a new Node Buffer and drains them.
+    fn take_processed<'a, C: Context<'a>>(&mut self, cx: &mut C) -> JsResult<'a, JsBuffer> {
+        let buffer = JsBuffer::from_slice(cx, sample_bytes(self.processed()))?;
+        self.drain_processed();
+        Ok(buffer)
+    }
+}
+
+pub struct FrameAccumulator {
+    inner: Arc<Mutex<Accumulator>>,
+}
+
+impl Finalize for FrameAccumulator {
+    fn finalize<'a, C: neon::prelude::Context<'a>>(self, _: &mut C) {}
+}
+
+impl FrameAccumulator {
+    pub fn new(mut cx: FunctionContext) -> JsResult<JsBox<FrameAccumulator>> {
+        let processor = cx.argument::<JsBox<Processor>>(0)?;
+
+        let Some(config) = processor.stream_config() else {
+            return cx.throw_error("Processor must be initialized before creating a stream");
+        };
+
+        Ok(cx.boxed(FrameAccumulator {
+            inner: Arc::new(Mutex::new(Accumulator::new(&processor, config))),
+        }))
+    }
+
+    /// Throws while the processor has a post-processing stage, see `SharedProcessor`.
+    fn check_no_post_process(&self, cx: &mut FunctionContext) -> NeonResult<()> {
+        self.inner.lock().unwrap().check_no_post_process(cx)
+    }
+
+    /// Copies the chunk passed as argument 1 into the accumulator.
+    fn append_argument(&self, cx: &mut FunctionContext) -> NeonResult<()> {
+        self.check_no_post_process(cx)?;
+        let chunk = cx.argument::<JsValue>(1)?;
+        let (ptr, num_bytes) = raw_bytes(cx, chunk)?;
+        // SAFETY: The chunk handle keeps the bytes alive for the duration of the call.
+        let bytes = unsafe { std::slice::from_raw_parts(ptr, num_bytes) };
+        self.inner.lock().unwrap().append_bytes(bytes);
+        Ok(())
+    }
+
+    pub fn push(mut cx: FunctionContext) -> JsResult<JsBuffer> {
+        let this = cx.argument::<JsBox<FrameAccumulator>>(0)?;
+        this.append_argument(&mut cx)?;
+
+        let mut accumulator = this.inner.lock().unwrap();
+        accumulator
+            .process_blocks()
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
+        accumulator.take_processed(&mut cx)
+    }
+
+    pub fn push_async(mut cx: FunctionContext) -> JsResult<JsPromise> {
+        let this = cx.argument::<JsBox<FrameAccumulator>>(0)?;
+        this.append_argument(&mut cx)?;
+
+        let inner = this.inner.clone();
+        Ok(Self::run_on_pool(
+            &mut cx,
+            inner,
+            Accumulator::process_blocks,
+        ))
+    }
+
+    pub fn flush(mut cx: FunctionContext) -> JsResult<JsBuffer> {
+        let this = cx.argument::<JsBox<FrameAccumulator>>(0)?;
+        this.check_no_post_process(&mut cx)?;
+
+        let mut accumulator = this.inner.lock().unwrap();
+        accumulator
+            .flush()
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
+        accumulator.take_processed(&mut cx)
+    }
+
+    pub fn flush_async(mut cx: FunctionContext) -> JsResult<JsPromise> {
+        let this = cx.argument::<JsBox<FrameAccumulator>>(0)?;
+        this.check_no_post_process(&mut cx)?;
+
+        let inner = this.inner.clone();
+        Ok(Self::run_on_pool(&mut cx, inner, Accumulator::flush))
+    }
+
+    /// Processes complete blocks of the aligned buffer passed as argument 1 in place and keeps
+    /// the remainder. Returns the number of samples processed.
+    pub fn process_in_place(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let this = cx.argument::<JsBox<FrameAccumulator>>(0)?;
+        this.check_no_post_process(&mut cx)?;
+        let buffer = cx.argument::<JsValue>(1)?;
+        let samples = RawSamples::from_value(&mut cx, buffer)?;
+
+        let mut accumulator = this.inner.lock().unwrap();
+        if !samples.is_aligned() || !accumulator.samples.is_empty() || accumulator.num_partial > 0 {
+            return cx
+                .throw_error("In-place processing needs an aligned buffer and no pending audio");
+        }
+
+        // SAFETY: The buffer handle keeps the samples alive for the duration of the call and
+        // the view is aligned.
+        let audio_data = unsafe { samples.as_mut_slice() };
+        let processed = accumulator
+            .process_in_place(audio_data)
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
+
+        Ok(cx.number(processed as f64))
+    }
+
+    /// Appends the buffer passed as argument 1, processes complete blocks, and copies them into
+    /// the output buffer passed as argument 2. Returns the number of samples written.
+    pub fn push_into(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let this = cx.argument::<JsBox<FrameAccumulator>>(0)?;
+        this.append_argument(&mut cx)?;
+        let mut output = cx.argument::<JsTypedArray<f32>>(2)?;
+
+        let mut accumulator = this.inner.lock().unwrap();
+        accumulator
+            .process_blocks()
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
+
+        match accumulator.take_processed_into(output.as_mut_slice(&mut cx)) {
+            Some(written) => Ok(cx.number(written as f64)),
+            None => cx.throw_range_error("Output buffer is too small"),
+        }
+    }
+
+    /// Flushes the output delay into the output buffer passed as argument 1. Returns the
+    /// number of samples written.
+    pub fn flush_into(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let this = cx.argument::<JsBox<FrameAccumulator>>(0)?;
+        this.check_no_post_process(&mut cx)?;
+        let mut output = cx.argument::<JsTypedArray<f32>>(1)?;
+
+        let mut accumulator = this.inner.lock().unwrap();
+        accumulator
+            .flush()
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
+
+        match accumulator.take_processed_into(output.as_mut_slice(&mut cx)) {
+            Some(written) => Ok(cx.number(written as f64)),
+            None => cx.throw_range_error("Output buffer is too small"),
+        }
+    }
+
+    /// Returns the number of samples buffered while waiting for a complete block, counting a
+    /// sample split across chunks as one.
+    pub fn pending_samples(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let this = cx.argument::<JsBox<FrameAccumulator>>(0)?;
+        let accumulator = this.inner.lock().unwrap();
+        let pending = accumulator.samples.len() - accumulator.num_processed
+            + usize::from(accumulator.num_partial > 0);
+        Ok(cx.number(pending as f64))
+    }
+
+    /// Returns the number of frames the pending output delay flush will produce.
+    pub fn flush_frames(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let this = cx.argument::<JsBox<FrameAccumulator>>(0)?;
+        let accumulator = this.inner.lock().unwrap();
+        let frames = accumulator.pending_frames() + accumulator.output_delay();
+        Ok(cx.number(frames as f64))
+    }
+
+    /// Runs `work` on the Node worker pool and resolves with the processed samples.
+    fn run_on_pool<'a>(
+        cx: &mut FunctionContext<'a>,
+        inner: Arc<Mutex<Accumulator>>,
+        work: fn(&mut Accumulator) -> Result<(), sdk::AicError>,
+    ) -> neon::handle::Handle<'a, JsPromise> {
+        let task_inner = inner.clone();
+        cx.task(move || work(&mut task_inner.lock().unwrap()))
+            .promise(move |mut cx, result| {
+                result.or_else(|e| throw_aic_error(&mut cx, &e))?;
+                inner.lock().unwrap().take_processed(&mut cx)
+            })
+    }
+}
+
+pub fn register_exports(cx: &mut neon::prelude::ModuleContext) -> NeonResult<()> {
+    cx.export_function("frameAccumulatorNew", FrameAccumulator::new)?;
+    cx.export_function("frameAccumulatorPush", FrameAccumulator::push)?;
+    cx.export_function("frameAccumulatorPushAsync", FrameAccumulator::push_async)?;
+    cx.export_function("frameAccumulatorFlush", FrameAccumulator::flush)?;
+    cx.export_function("frameAccumulatorFlushAsync", FrameAccumulator::flush_async)?;
+    cx.export_function(
+        "frameAccumulatorProcessInPlace",
+        FrameAccumulator::process_in_place,
+    )?;
+    cx.export_function("frameAccumulatorPushInto", FrameAccumulator::push_into)?;
+    cx.export_function("frameAccumulatorFlushInto", FrameAccumulator::flush_into)?;
+    cx.export_function(
+        "frameAccumulatorPendingSamples",
+        FrameAccumulator::pending_samples,
+    )?;
+    cx.export_function(
+        "frameAccumulatorFlushFrames",
+        FrameAccumulator::flush_frames,
+    )?;
+
+    Ok(())
+}
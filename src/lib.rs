@@ -1,17 +1,64 @@
 use neon::prelude::*;
 
+#[cfg(feature = "alloc-counter")]
+mod alloc_counter;
+mod audio_ring;
+mod automation;
+mod codec;
+#[cfg(target_os = "linux")]
+mod daemon;
+mod delay_compensation;
+mod error;
+mod frame_accumulator;
+#[cfg(feature = "mock")]
+mod mock;
 mod model;
+mod model_swap;
+mod multi_channel_processor;
+mod pipeline;
+mod post_process;
 mod processor;
 mod processor_context;
+mod raw_samples;
+mod realtime_budget;
+mod resampler;
+mod session;
+#[cfg(target_os = "linux")]
+mod shared_memory;
+mod startup;
+mod stats;
+mod thread_settings;
+mod trace;
 mod vad_context;
 
+#[cfg(not(any(feature = "aic-sdk", feature = "mock")))]
+compile_error!("Enable either the `aic-sdk` or the `mock` feature");
+
+/// Inference backend: the ai-coustics SDK, or the license-free stand-in of the `mock` feature.
+mod sdk {
+    #[cfg(all(feature = "aic-sdk", not(feature = "mock")))]
+    pub use aic_sdk::*;
+
+    #[cfg(feature = "mock")]
+    pub use crate::mock::*;
+}
+
 fn get_sdk_version(mut cx: FunctionContext) -> JsResult<JsString> {
-    let version = aic_sdk::get_sdk_version();
+    let version = sdk::get_sdk_version();
     Ok(cx.string(version))
 }
 
+fn get_backend(mut cx: FunctionContext) -> JsResult<JsString> {
+    let backend = if cfg!(feature = "mock") {
+        "mock"
+    } else {
+        "aic-sdk"
+    };
+    Ok(cx.string(backend))
+}
+
 fn get_compatible_model_version(mut cx: FunctionContext) -> JsResult<JsNumber> {
-    let model_version = aic_sdk::get_compatible_model_version();
+    let model_version = sdk::get_compatible_model_version();
     Ok(cx.number(model_version))
 }
 
@@ -20,6 +67,7 @@ fn main(mut cx: ModuleContext) -> NeonResult<()> {
     // Free functions
     cx.export_function("getVersion", get_sdk_version)?;
     cx.export_function("getCompatibleModelVersion", get_compatible_model_version)?;
+    cx.export_function("getBackend", get_backend)?;
 
     // Model
     model::register_exports(&mut cx)?;
@@ -27,11 +75,44 @@ fn main(mut cx: ModuleContext) -> NeonResult<()> {
     // Processor
     processor::register_exports(&mut cx)?;
 
+    // MultiChannelProcessor
+    multi_channel_processor::register_exports(&mut cx)?;
+
+    // Post-processing status layout
+    post_process::register_exports(&mut cx)?;
+
     // ProcessorContext
     processor_context::register_exports(&mut cx)?;
 
     // VadContext
     vad_context::register_exports(&mut cx)?;
 
+    // AudioRing
+    audio_ring::register_exports(&mut cx)?;
+
+    // FrameAccumulator
+    frame_accumulator::register_exports(&mut cx)?;
+
+    // Pipeline
+    pipeline::register_exports(&mut cx)?;
+
+    // Asynchronous cold start
+    startup::register_exports(&mut cx)?;
+
+    // Enhancement daemon and its clients
+    #[cfg(target_os = "linux")]
+    daemon::register_exports(&mut cx)?;
+
+    // Process timing
+    stats::register_exports(&mut cx)?;
+
+    // Tracing
+    #[cfg(feature = "trace")]
+    trace::register_exports(&mut cx)?;
+
+    // Allocation tests
+    #[cfg(feature = "alloc-counter")]
+    alloc_counter::register_exports(&mut cx)?;
+
     Ok(())
 }
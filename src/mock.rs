@@ -0,0 +1,545 @@
+//! License-free stand-in for the ai-coustics SDK, enabled with the `mock` feature.
+//!
+//! Mirrors the subset of the `aic_sdk` API used by the binding, so the whole JavaScript and
+//! native binding path can be tested and benchmarked offline. Instead of running a model, the
+//! processor delays the audio by the configured output delay, burns the configured compute
+//! time, and reports voice activity from a fixed pattern.
+//!
+//! Mock models are text files with one `key = value` pair per line:
+//!
+//! ```text
+//! # Identifier returned by Model.getId()
+//! id = mock-16khz
+//! # Optimal sample rate in Hz
+//! sample_rate = 16000
+//! # Optimal block duration in milliseconds
+//! window_ms = 10
+//! # Output delay in milliseconds
+//! delay_ms = 5
+//! # Processing time as a fraction of the audio duration, spent busy-waiting. Scaled by
+//! # the enhancement level; bypass costs nothing.
+//! real_time_factor = 0
+//! # Voice activity per processed block, repeated
+//! vad_pattern = 0
+//! # Blocks processed before every further block fails with `ProcessingFailed`; unset
+//! # never fails
+//! fail_after_blocks = 100
+//! ```
+//!
+//! All keys are optional. `Model.download` writes such a file instead of downloading.
+
+use std::fmt;
+use std::marker::PhantomData;
+use std::path::{Path, PathBuf};
+use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, AtomicU32, AtomicUsize, Ordering};
+use std::time::{Duration, Instant};
+
+#[derive(Debug, Clone, PartialEq)]
+pub enum AicError {
+    ModelFile(String),
+    ProcessorNotInitialized,
+    AudioConfigUnsupported,
+    AudioConfigMismatch,
+    ParameterOutOfRange,
+    LicenseFormatInvalid,
+    ProcessingFailed,
+}
+
+impl fmt::Display for AicError {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        match self {
+            AicError::ModelFile(reason) => write!(f, "Invalid mock model: {reason}"),
+            AicError::ProcessorNotInitialized => write!(f, "Processor is not initialized"),
+            AicError::AudioConfigUnsupported => write!(f, "Audio configuration is not supported"),
+            AicError::AudioConfigMismatch => {
+                write!(
+                    f,
+                    "Audio buffer does not match the initialized configuration"
+                )
+            }
+            AicError::ParameterOutOfRange => write!(f, "Parameter value is out of range"),
+            AicError::LicenseFormatInvalid => write!(f, "License key is not a JWT"),
+            AicError::ProcessingFailed => write!(f, "Processing failed"),
+        }
+    }
+}
+
+impl std::error::Error for AicError {}
+
+pub fn get_sdk_version() -> &'static str {
+    concat!(env!("CARGO_PKG_VERSION"), "-mock")
+}
+
+pub fn get_compatible_model_version() -> u32 {
+    0
+}
+
+/// # Safety
+///
+/// No requirements, kept `unsafe` to match the SDK.
+pub unsafe fn set_sdk_id(_id: u32) {}
+
+#[derive(Clone)]
+struct ModelConfig {
+    id: String,
+    sample_rate: u32,
+    window_ms: f64,
+    delay_ms: f64,
+    real_time_factor: f64,
+    vad_pattern: Vec<bool>,
+    fail_after_blocks: Option<usize>,
+}
+
+impl ModelConfig {
+    fn parse(text: &str) -> Result<ModelConfig, AicError> {
+        let mut config = ModelConfig {
+            id: "mock".to_owned(),
+            sample_rate: 16000,
+            window_ms: 10.0,
+            delay_ms: 5.0,
+            real_time_factor: 0.0,
+            vad_pattern: vec![false],
+            fail_after_blocks: None,
+        };
+
+        for line in text.lines().map(str::trim) {
+            if line.is_empty() || line.starts_with('#') {
+                continue;
+            }
+            let Some((key, value)) = line.split_once('=') else {
+                return Err(AicError::ModelFile(format!(
+                    "expected `key = value`: {line}"
+                )));
+            };
+            let (key, value) = (key.trim(), value.trim());
+            let invalid = || AicError::ModelFile(format!("invalid value for `{key}`: {value}"));
+
+            match key {
+                "id" => config.id = value.to_owned(),
+                "sample_rate" => config.sample_rate = value.parse().map_err(|_| invalid())?,
+                "window_ms" => config.window_ms = value.parse().map_err(|_| invalid())?,
+                "delay_ms" => config.delay_ms = value.parse().map_err(|_| invalid())?,
+                "real_time_factor" => {
+                    config.real_time_factor = value.parse().map_err(|_| invalid())?
+                }
+                "vad_pattern" => {
+                    config.vad_pattern = value
+                        .chars()
+                        .map(|c| match c {
+                            '0' => Ok(false),
+                            '1' => Ok(true),
+                            _ => Err(invalid()),
+                        })
+                        .collect::<Result<_, _>>()?;
+                    if config.vad_pattern.is_empty() {
+                        return Err(invalid());
+                    }
+                }
+                "fail_after_blocks" => {
+                    config.fail_after_blocks = Some(value.parse().map_err(|_| invalid())?)
+                }
+                _ => return Err(AicError::ModelFile(format!("unknown key `{key}`"))),
+            }
+        }
+
+        if config.sample_rate == 0 || config.window_ms <= 0.0 || config.delay_ms < 0.0 {
+            return Err(AicError::ModelFile("values out of range".to_owned()));
+        }
+        Ok(config)
+    }
+
+    fn frames(&self, ms: f64, sample_rate: u32) -> usize {
+        (ms * f64::from(sample_rate) / 1000.0).round() as usize
+    }
+}
+
+pub struct Model<'a> {
+    config: ModelConfig,
+    _buffer: PhantomData<&'a [u8]>,
+}
+
+impl<'a> Model<'a> {
+    pub fn from_file<P: AsRef<Path>>(path: P) -> Result<Model<'static>, AicError> {
+        let text = std::fs::read_to_string(path).map_err(|e| AicError::ModelFile(e.to_string()))?;
+        Ok(Model {
+            config: ModelConfig::parse(&text)?,
+            _buffer: PhantomData,
+        })
+    }
+
+    pub fn from_buffer(buffer: &'a [u8]) -> Result<Model<'a>, AicError> {
+        let text = std::str::from_utf8(buffer).map_err(|e| AicError::ModelFile(e.to_string()))?;
+        Ok(Model {
+            config: ModelConfig::parse(text)?,
+            _buffer: PhantomData,
+        })
+    }
+
+    /// Writes a mock model for `model_id` instead of downloading. The sample rate is taken
+    /// from a `<rate>khz` suffix of the identifier, if any.
+    pub fn download<P: AsRef<Path>>(model_id: &str, download_dir: P) -> Result<PathBuf, AicError> {
+        let sample_rate = model_id
+            .rsplit('-')
+            .next()
+            .and_then(|suffix| suffix.strip_suffix("khz"))
+            .and_then(|khz| khz.parse::<u32>().ok())
+            .map_or(16000, |khz| khz * 1000);
+
+        let path = download_dir
+            .as_ref()
+            .join(format!("{model_id}.mock.aicmodel"));
+        std::fs::write(
+            &path,
+            format!("id = {model_id}\nsample_rate = {sample_rate}\n"),
+        )
+        .map_err(|e| AicError::ModelFile(e.to_string()))?;
+        Ok(path)
+    }
+
+    pub fn id(&self) -> &str {
+        &self.config.id
+    }
+
+    pub fn optimal_sample_rate(&self) -> u32 {
+        self.config.sample_rate
+    }
+
+    pub fn optimal_num_frames(&self, sample_rate: u32) -> usize {
+        self.config
+            .frames(self.config.window_ms, sample_rate)
+            .max(1)
+    }
+}
+
+/// Accepted for API parity. The mock exports no telemetry.
+#[allow(dead_code)]
+pub struct OtelConfig {
+    pub enable: bool,
+    pub session_id: Option<String>,
+    pub export_interval_ms: u32,
+}
+
+pub struct ProcessorConfig {
+    pub sample_rate: u32,
+    pub num_channels: u16,
+    pub num_frames: usize,
+    pub allow_variable_frames: bool,
+}
+
+#[derive(Clone, Copy)]
+pub enum ProcessorParameter {
+    Bypass,
+    EnhancementLevel,
+}
+
+#[derive(Clone, Copy)]
+pub enum VadParameter {
+    SpeechHoldDuration,
+    Sensitivity,
+    MinimumSpeechDuration,
+}
+
+/// State shared between a processor and its contexts. Parameters are stored as `f32` bits.
+struct Shared {
+    bypass: AtomicU32,
+    enhancement_level: AtomicU32,
+    output_delay: AtomicUsize,
+    reset_requested: AtomicBool,
+    license_is_jwt: bool,
+    speech_detected: AtomicBool,
+    speech_hold_duration: AtomicU32,
+    sensitivity: AtomicU32,
+    minimum_speech_duration: AtomicU32,
+}
+
+fn load(value: &AtomicU32) -> f32 {
+    f32::from_bits(value.load(Ordering::Relaxed))
+}
+
+fn store(value: &AtomicU32, new: f32) {
+    value.store(new.to_bits(), Ordering::Relaxed);
+}
+
+fn is_jwt(key: &str) -> bool {
+    key.split('.').count() == 3
+}
+
+struct Stream {
+    num_channels: usize,
+    num_frames: usize,
+    allow_variable_frames: bool,
+    block_duration_per_frame: Duration,
+    /// Channel-major delay line of `delay` frames per channel.
+    delay_line: Vec<f32>,
+    delay: usize,
+    position: usize,
+    num_blocks: usize,
+}
+
+pub struct Processor<'a> {
+    model: ModelConfig,
+    shared: Arc<Shared>,
+    stream: Option<Stream>,
+    _model: PhantomData<&'a ()>,
+}
+
+impl<'a> Processor<'a> {
+    pub fn new(model: &Model<'a>, license_key: &str) -> Result<Self, AicError> {
+        Ok(Processor {
+            model: model.config.clone(),
+            shared: Arc::new(Shared {
+                bypass: AtomicU32::new(0.0f32.to_bits()),
+                enhancement_level: AtomicU32::new(1.0f32.to_bits()),
+                output_delay: AtomicUsize::new(0),
+                reset_requested: AtomicBool::new(false),
+                license_is_jwt: is_jwt(license_key),
+                speech_detected: AtomicBool::new(false),
+                speech_hold_duration: AtomicU32::new(0.05f32.to_bits()),
+                sensitivity: AtomicU32::new(0.5f32.to_bits()),
+                minimum_speech_duration: AtomicU32::new(0.0f32.to_bits()),
+            }),
+            stream: None,
+            _model: PhantomData,
+        })
+    }
+
+    pub fn with_otel_config(
+        model: &Model<'a>,
+        license_key: &str,
+        _otel_config: &OtelConfig,
+    ) -> Result<Self, AicError> {
+        Self::new(model, license_key)
+    }
+
+    pub fn initialize(&mut self, config: &ProcessorConfig) -> Result<(), AicError> {
+        if !(8000..=192000).contains(&config.sample_rate)
+            || config.num_channels == 0
+            || config.num_frames == 0
+        {
+            return Err(AicError::AudioConfigUnsupported);
+        }
+
+        let num_channels = usize::from(config.num_channels);
+        let mut delay = self.model.frames(self.model.delay_ms, config.sample_rate);
+        if config.allow_variable_frames {
+            delay += config.num_frames;
+        }
+
+        self.stream = Some(Stream {
+            num_channels,
+            num_frames: config.num_frames,
+            allow_variable_frames: config.allow_variable_frames,
+            block_duration_per_frame: Duration::from_secs_f64(
+                self.model.real_time_factor / f64::from(config.sample_rate),
+            ),
+            delay_line: vec![0.0; delay * num_channels],
+            delay,
+            position: 0,
+            num_blocks: 0,
+        });
+        self.shared.output_delay.store(delay, Ordering::Relaxed);
+        self.shared.reset_requested.store(false, Ordering::Relaxed);
+        Ok(())
+    }
+
+    pub fn process_interleaved(&mut self, audio: &mut [f32]) -> Result<(), AicError> {
+        let num_channels = self.stream()?.num_channels;
+        let num_frames = self.check_frames(audio.len(), num_channels)?;
+        self.process(num_frames, |frame, channel, slot| {
+            std::mem::swap(slot, &mut audio[frame * num_channels + channel]);
+        })
+    }
+
+    pub fn process_sequential(&mut self, audio: &mut [f32]) -> Result<(), AicError> {
+        let num_channels = self.stream()?.num_channels;
+        let num_frames = self.check_frames(audio.len(), num_channels)?;
+        self.process(num_frames, |frame, channel, slot| {
+            std::mem::swap(slot, &mut audio[channel * num_frames + frame]);
+        })
+    }
+
+    pub fn process_planar<V: AsMut<[f32]>>(&mut self, audio: &mut [V]) -> Result<(), AicError> {
+        let stream = self.stream()?;
+        if audio.len() != stream.num_channels {
+            return Err(AicError::AudioConfigMismatch);
+        }
+        let num_frames = audio
+            .first_mut()
+            .map_or(0, |channel| channel.as_mut().len());
+        if audio
+            .iter_mut()
+            .any(|channel| channel.as_mut().len() != num_frames)
+        {
+            return Err(AicError::AudioConfigMismatch);
+        }
+        let num_frames = self.check_frames(num_frames, 1)?;
+        self.process(num_frames, |frame, channel, slot| {
+            std::mem::swap(slot, &mut audio[channel].as_mut()[frame]);
+        })
+    }
+
+    pub fn processor_context(&self) -> ProcessorContext {
+        ProcessorContext {
+            shared: self.shared.clone(),
+        }
+    }
+
+    pub fn vad_context(&self) -> VadContext {
+        VadContext {
+            shared: self.shared.clone(),
+        }
+    }
+
+    fn stream(&self) -> Result<&Stream, AicError> {
+        self.stream
+            .as_ref()
+            .ok_or(AicError::ProcessorNotInitialized)
+    }
+
+    /// Returns the number of frames in a buffer of `len` samples if it fits the configuration.
+    fn check_frames(&self, len: usize, samples_per_frame: usize) -> Result<usize, AicError> {
+        let stream = self.stream()?;
+        let num_frames = len / samples_per_frame;
+        let fits = if stream.allow_variable_frames {
+            num_frames <= stream.num_frames
+        } else {
+            num_frames == stream.num_frames
+        };
+        if !len.is_multiple_of(samples_per_frame) || !fits {
+            return Err(AicError::AudioConfigMismatch);
+        }
+        Ok(num_frames)
+    }
+
+    /// Swaps each sample with the delay line and spends the configured compute time.
+    fn process(
+        &mut self,
+        num_frames: usize,
+        mut swap_sample: impl FnMut(usize, usize, &mut f32),
+    ) -> Result<(), AicError> {
+        let start = Instant::now();
+        let Some(stream) = self.stream.as_mut() else {
+            return Err(AicError::ProcessorNotInitialized);
+        };
+
+        if self.shared.reset_requested.swap(false, Ordering::Relaxed) {
+            stream.delay_line.fill(0.0);
+            stream.position = 0;
+            stream.num_blocks = 0;
+        }
+        if self
+            .model
+            .fail_after_blocks
+            .is_some_and(|limit| stream.num_blocks >= limit)
+        {
+            return Err(AicError::ProcessingFailed);
+        }
+
+        if stream.delay > 0 {
+            for channel in 0..stream.num_channels {
+                let line = &mut stream.delay_line[channel * stream.delay..][..stream.delay];
+                for frame in 0..num_frames {
+                    swap_sample(
+                        frame,
+                        channel,
+                        &mut line[(stream.position + frame) % stream.delay],
+                    );
+                }
+            }
+            stream.position = (stream.position + num_frames) % stream.delay;
+        }
+
+        let pattern = &self.model.vad_pattern;
+        let speech = pattern[stream.num_blocks % pattern.len()];
+        self.shared.speech_detected.store(speech, Ordering::Relaxed);
+        stream.num_blocks += 1;
+
+        // Compute cost scales with the enhancement level, and bypass is free
+        let level = if load(&self.shared.bypass) > 0.5 {
+            0.0
+        } else {
+            load(&self.shared.enhancement_level)
+        };
+        let cost = stream
+            .block_duration_per_frame
+            .mul_f64(num_frames as f64 * f64::from(level));
+        while start.elapsed() < cost {
+            std::hint::spin_loop();
+        }
+        Ok(())
+    }
+}
+
+pub struct ProcessorContext {
+    shared: Arc<Shared>,
+}
+
+impl ProcessorContext {
+    pub fn reset(&self) -> Result<(), AicError> {
+        self.shared.reset_requested.store(true, Ordering::Relaxed);
+        Ok(())
+    }
+
+    pub fn set_parameter(&self, parameter: ProcessorParameter, value: f32) -> Result<(), AicError> {
+        if !(0.0..=1.0).contains(&value) {
+            return Err(AicError::ParameterOutOfRange);
+        }
+        match parameter {
+            ProcessorParameter::Bypass => store(&self.shared.bypass, value),
+            ProcessorParameter::EnhancementLevel => store(&self.shared.enhancement_level, value),
+        }
+        Ok(())
+    }
+
+    pub fn parameter(&self, parameter: ProcessorParameter) -> Result<f32, AicError> {
+        Ok(match parameter {
+            ProcessorParameter::Bypass => load(&self.shared.bypass),
+            ProcessorParameter::EnhancementLevel => load(&self.shared.enhancement_level),
+        })
+    }
+
+    pub fn output_delay(&self) -> usize {
+        self.shared.output_delay.load(Ordering::Relaxed)
+    }
+
+    pub fn update_bearer_token(&self, token: &str) -> Result<(), AicError> {
+        if !self.shared.license_is_jwt || !is_jwt(token) {
+            return Err(AicError::LicenseFormatInvalid);
+        }
+        Ok(())
+    }
+}
+
+pub struct VadContext {
+    shared: Arc<Shared>,
+}
+
+impl VadContext {
+    pub fn is_speech_detected(&self) -> bool {
+        self.shared.speech_detected.load(Ordering::Relaxed)
+    }
+
+    pub fn set_parameter(&self, parameter: VadParameter, value: f32) -> Result<(), AicError> {
+        let (target, range) = match parameter {
+            VadParameter::SpeechHoldDuration => (&self.shared.speech_hold_duration, 0.0..=100.0),
+            VadParameter::Sensitivity => (&self.shared.sensitivity, 0.0..=15.0),
+            VadParameter::MinimumSpeechDuration => {
+                (&self.shared.minimum_speech_duration, 0.0..=1.0)
+            }
+        };
+        if !range.contains(&value) {
+            return Err(AicError::ParameterOutOfRange);
+        }
+        store(target, value);
+        Ok(())
+    }
+
+    pub fn parameter(&self, parameter: VadParameter) -> Result<f32, AicError> {
+        Ok(match parameter {
+            VadParameter::SpeechHoldDuration => load(&self.shared.speech_hold_duration),
+            VadParameter::Sensitivity => load(&self.shared.sensitivity),
+            VadParameter::MinimumSpeechDuration => load(&self.shared.minimum_speech_duration),
+        })
+    }
+}
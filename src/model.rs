@@ -1,11 +1,213 @@
+#[cfg(target_os = "linux")]
+use std::fs::File;
+#[cfg(target_os = "linux")]
+use std::sync::{
+    Mutex, OnceLock,
+    atomic::{AtomicI32, Ordering},
+};
+
 use neon::{
     prelude::{Context, FunctionContext},
     result::{JsResult, NeonResult},
     types::{Finalize, JsBox, JsNumber, JsString},
 };
 
+use crate::error::throw_aic_error;
+use crate::sdk;
+#[cfg(target_os = "linux")]
+use crate::shared_memory::SharedMapping;
+use crate::trace;
+
 pub struct Model {
-    pub(crate) inner: aic_sdk::Model<'static>,
+    pub(crate) inner: sdk::Model<'static>,
+    /// Mapping of the model file the model was loaded from with `fromFileMapped`.
+    #[cfg(target_os = "linux")]
+    mapping: Option<&'static SharedMapping>,
+}
+
+/// Identity of a model file's contents: device, inode, size and modification time.
+#[cfg(target_os = "linux")]
+type FileIdentity = (u64, u64, u64, i64, i64);
+
+/// A model file mapped by `fromFileMapped`.
+#[cfg(target_os = "linux")]
+struct MappedFile {
+    identity: FileIdentity,
+    mapping: &'static SharedMapping,
+    /// The file, kept open while it holds the read lease that keeps writers away from the
+    /// mapped pages. See `watch_leases`.
+    leased: Option<File>,
+}
+
+/// Mappings of model files. SDK models, and the processors created from them, borrow the
+/// model buffer for `'static`, so a mapping lives for the rest of the process. Loading the
+/// same file again reuses its mapping; a file replaced on disk is mapped anew.
+#[cfg(target_os = "linux")]
+static MAPPED_FILES: Mutex<Vec<MappedFile>> = Mutex::new(Vec::new());
+
+/// Name of the memfds holding private copies of model files.
+#[cfg(target_os = "linux")]
+const MODEL_COPY_NAME: &std::ffi::CStr = c"aic-model";
+
+/// `fcntl` command selecting the signal sent when a lease is broken. Missing from `libc` for
+/// glibc targets.
+#[cfg(target_os = "linux")]
+const F_SETSIG: libc::c_int = 10;
+
+/// Write end of the pipe that wakes `watch_leases`.
+#[cfg(target_os = "linux")]
+static LEASE_WAKEUPS: AtomicI32 = AtomicI32::new(-1);
+
+/// Signal the kernel sends to break the lease of a mapped model file.
+#[cfg(target_os = "linux")]
+fn lease_signal() -> libc::c_int {
+    libc::SIGRTMIN() + 4
+}
+
+#[cfg(target_os = "linux")]
+extern "C" fn on_lease_break(_: libc::c_int) {
+    // SAFETY: write() is async-signal-safe. The pipe is non-blocking, and when it is full a
+    // wake-up is pending anyway.
+    unsafe {
+        libc::write(
+            LEASE_WAKEUPS.load(Ordering::Relaxed),
+            [0u8].as_ptr().cast(),
+            1,
+        );
+    }
+}
+
+/// Starts `watch_leases` and installs the lease break handler, on the first call. Returns
+/// false if that failed, e.g. because the signal is taken.
+#[cfg(target_os = "linux")]
+fn lease_watcher_started() -> bool {
+    static STARTED: OnceLock<bool> = OnceLock::new();
+    *STARTED.get_or_init(|| start_lease_watcher().is_ok())
+}
+
+#[cfg(target_os = "linux")]
+fn start_lease_watcher() -> std::io::Result<()> {
+    use std::io::Error;
+    use std::os::fd::FromRawFd;
+
+    let signal = lease_signal();
+    let mut fds = [0; 2];
+    // SAFETY: Reads the signal's action, and the pipe's descriptors are owned from here on.
+    let wakeups = unsafe {
+        let mut action: libc::sigaction = std::mem::zeroed();
+        if libc::sigaction(signal, std::ptr::null(), &mut action) != 0 {
+            return Err(Error::last_os_error());
+        }
+        if action.sa_sigaction != libc::SIG_DFL {
+            return Err(Error::new(
+                std::io::ErrorKind::AlreadyExists,
+                "lease signal is in use",
+            ));
+        }
+        if libc::pipe2(fds.as_mut_ptr(), libc::O_CLOEXEC) != 0 {
+            return Err(Error::last_os_error());
+        }
+        libc::fcntl(fds[1], libc::F_SETFL, libc::O_NONBLOCK);
+        File::from_raw_fd(fds[0])
+    };
+    LEASE_WAKEUPS.store(fds[1], Ordering::Relaxed);
+    std::thread::Builder::new()
+        .name("aic-model-leases".to_owned())
+        .spawn(move || watch_leases(wakeups))?;
+
+    // SAFETY: The handler only writes to the pipe.
+    unsafe {
+        let mut action: libc::sigaction = std::mem::zeroed();
+        action.sa_sigaction = on_lease_break as usize;
+        action.sa_flags = libc::SA_RESTART;
+        libc::sigemptyset(&mut action.sa_mask);
+        if libc::sigaction(signal, &action, std::ptr::null_mut()) != 0 {
+            return Err(Error::last_os_error());
+        }
+    }
+    Ok(())
+}
+
+/// Takes a read lease on a model file, which the kernel grants only to the file's owner and
+/// only while no process has the file open for writing. Until the lease is released, opening
+/// the file for writing or truncating it waits for `watch_leases`.
+#[cfg(target_os = "linux")]
+fn take_lease(file: &File) -> bool {
+    use std::os::fd::AsRawFd;
+
+    // SAFETY: Sets the lease signal and takes a lease on a descriptor owned by `file`.
+    lease_watcher_started()
+        && unsafe {
+            libc::fcntl(file.as_raw_fd(), F_SETSIG, lease_signal()) == 0
+                && libc::fcntl(file.as_raw_fd(), libc::F_SETLEASE, libc::F_RDLCK) == 0
+        }
+}
+
+/// Moves the mapping of every model file whose lease is being broken onto a private copy,
+/// then releases the lease, so the writer that broke it proceeds only once the mapping no
+/// longer follows the file. A rewritten file would otherwise change the weights under the
+/// SDK, or crash the process with SIGBUS once truncated.
+#[cfg(target_os = "linux")]
+fn watch_leases(mut wakeups: File) {
+    use std::io::Read;
+    use std::os::fd::AsRawFd;
+
+    let mut wakeup = [0u8];
+    while wakeups.read_exact(&mut wakeup).is_ok() {
+        let mut files = MAPPED_FILES.lock().unwrap();
+        for file in files.iter_mut() {
+            let Some(leased) = &file.leased else {
+                continue;
+            };
+            // A lease being broken reads as the type it is downgraded to
+            // SAFETY: Reads the lease of a descriptor owned by `leased`.
+            if unsafe { libc::fcntl(leased.as_raw_fd(), libc::F_GETLEASE) } == libc::F_RDLCK {
+                continue;
+            }
+            // Should the copy fail, the lease is released all the same, as the kernel would
+            // break it after `lease-break-time` anyway
+            let _ = file.mapping.detach(MODEL_COPY_NAME);
+            // Closing the file releases the lease
+            file.leased = None;
+        }
+    }
+}
+
+/// Maps a model file, sharing its page cache with other processes while this process can
+/// hold a lease on it, see `take_lease`. Other files are copied into private memory sealed
+/// against changes.
+#[cfg(target_os = "linux")]
+fn mapped_file(path: &str) -> std::io::Result<&'static SharedMapping> {
+    use std::os::unix::fs::MetadataExt;
+
+    let mut files = MAPPED_FILES.lock().unwrap();
+    let file = File::open(path)?;
+    let leased = take_lease(&file);
+    // Taken under the lease, so no writer can change the file in between
+    let metadata = file.metadata()?;
+    let identity = (
+        metadata.dev(),
+        metadata.ino(),
+        metadata.len(),
+        metadata.mtime(),
+        metadata.mtime_nsec(),
+    );
+    if let Some(mapped) = files.iter().find(|mapped| mapped.identity == identity) {
+        return Ok(mapped.mapping);
+    }
+    let len = metadata.len() as usize;
+    let mapping = if leased {
+        SharedMapping::map_read_only(&file, len)?
+    } else {
+        SharedMapping::copy_read_only(MODEL_COPY_NAME, &file, len)?
+    };
+    let mapping = Box::leak(Box::new(mapping));
+    files.push(MappedFile {
+        identity,
+        mapping,
+        leased: leased.then_some(file),
+    });
+    Ok(mapping)
 }
 
 impl Finalize for Model {
@@ -13,17 +215,75 @@ impl Finalize for Model {
 }
 
 impl Model {
+    /// Wraps a model loaded into private memory.
+    pub(crate) fn from_sdk(inner: sdk::Model<'static>) -> Model {
+        Model {
+            inner,
+            #[cfg(target_os = "linux")]
+            mapping: None,
+        }
+    }
+
     pub fn from_file(mut cx: FunctionContext) -> JsResult<JsBox<Model>> {
+        let _span = trace::span("Model.fromFile");
+        let path = cx.argument::<JsString>(0)?.value(&mut cx);
+        let inner = sdk::Model::from_file(path).or_else(|e| throw_aic_error(&mut cx, &e))?;
+        Ok(cx.boxed(Model::from_sdk(inner)))
+    }
+
+    /// Loads a model from a read-only shared mapping of its file instead of reading it into
+    /// private memory, so that all processes loading the file share its pages.
+    #[cfg(target_os = "linux")]
+    pub fn from_file_mapped(mut cx: FunctionContext) -> JsResult<JsBox<Model>> {
+        let _span = trace::span("Model.fromFileMapped");
         let path = cx.argument::<JsString>(0)?.value(&mut cx);
-        let inner = aic_sdk::Model::from_file(path).or_else(|e| cx.throw_error(e.to_string()))?;
-        Ok(cx.boxed(Model { inner }))
+        let mapping = match mapped_file(&path) {
+            Ok(mapping) => mapping,
+            Err(e) => return cx.throw_error(format!("Cannot map model file {path}: {e}")),
+        };
+        let inner = sdk::Model::from_buffer(mapping.as_slice())
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
+        Ok(cx.boxed(Model {
+            inner,
+            mapping: Some(mapping),
+        }))
+    }
+
+    /// Returns `{ mappedBytes, residentBytes, sharedBytes, privateBytes, proportionalBytes }`
+    /// of the model file's mapping, or null if the model was not loaded mapped.
+    #[cfg(target_os = "linux")]
+    pub fn memory_usage(mut cx: FunctionContext) -> JsResult<neon::types::JsValue> {
+        use neon::object::Object;
+
+        let this = cx.argument::<JsBox<Model>>(0)?;
+        let Some(mapping) = this.mapping else {
+            return Ok(cx.null().upcast());
+        };
+        let residency = match mapping.residency() {
+            Ok(residency) => residency,
+            Err(e) => return cx.throw_error(format!("Cannot read memory usage: {e}")),
+        };
+
+        let usage = cx.empty_object();
+        for (key, bytes) in [
+            ("mappedBytes", mapping.len() as u64),
+            ("residentBytes", residency.resident),
+            ("sharedBytes", residency.shared),
+            ("privateBytes", residency.private),
+            ("proportionalBytes", residency.proportional),
+        ] {
+            let bytes = cx.number(bytes as f64);
+            usage.set(&mut cx, key, bytes)?;
+        }
+        Ok(usage.upcast())
     }
 
     pub fn download(mut cx: FunctionContext) -> JsResult<JsString> {
+        let _span = trace::span("Model.download");
         let model_id = cx.argument::<JsString>(0)?.value(&mut cx);
         let download_dir = cx.argument::<JsString>(1)?.value(&mut cx);
-        let path = aic_sdk::Model::download(&model_id, download_dir)
-            .or_else(|e| cx.throw_error(e.to_string()))?;
+        let path = sdk::Model::download(&model_id, download_dir)
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
         Ok(cx.string(path.to_str().expect("Path can be converted to string")))
     }
 
@@ -49,6 +309,10 @@ impl Model {
 
 pub fn register_exports(cx: &mut neon::prelude::ModuleContext) -> NeonResult<()> {
     cx.export_function("modelFromFile", Model::from_file)?;
+    #[cfg(target_os = "linux")]
+    cx.export_function("modelFromFileMapped", Model::from_file_mapped)?;
+    #[cfg(target_os = "linux")]
+    cx.export_function("modelMemoryUsage", Model::memory_usage)?;
     cx.export_function("modelDownload", Model::download)?;
     cx.export_function("modelId", Model::get_id)?;
     cx.export_function("modelGetOptimalSampleRate", Model::get_optimal_sample_rate)?;
@@ -0,0 +1,380 @@
+//! Replacing the model of a live processor without a gap or a jump in its output.
+//!
+//! The new SDK processor is created and initialized off the audio path. It then runs next to
+//! the current one on the live input, first only to warm up its internal state, then while
+//! its output is crossfaded in. Its output is delayed to the current output delay, so the
+//! stream keeps its timing when stepping down to a model with a shorter delay and back up.
+
+use neon::{event::Channel, handle::Root, object::Object, prelude::Context, types::JsFunction};
+
+use crate::raw_samples::staging_area;
+use crate::sdk;
+use crate::stats::BlockLevels;
+
+/// One block of audio in any of the layouts accepted by the process methods.
+pub(crate) enum AudioBlock<'a, 'b> {
+    Interleaved {
+        samples: &'a mut [f32],
+        num_channels: usize,
+    },
+    Sequential {
+        samples: &'a mut [f32],
+        num_channels: usize,
+    },
+    Planar(&'a mut [&'b mut [f32]]),
+}
+
+impl AudioBlock<'_, '_> {
+    pub(crate) fn num_channels(&self) -> usize {
+        match self {
+            AudioBlock::Interleaved { num_channels, .. }
+            | AudioBlock::Sequential { num_channels, .. } => (*num_channels).max(1),
+            AudioBlock::Planar(channels) => channels.len(),
+        }
+    }
+
+    pub(crate) fn num_frames(&self) -> usize {
+        match self {
+            AudioBlock::Interleaved { samples, .. } | AudioBlock::Sequential { samples, .. } => {
+                samples.len() / self.num_channels()
+            }
+            AudioBlock::Planar(channels) => channels.first().map_or(0, |channel| channel.len()),
+        }
+    }
+
+    /// Energy and peak over all channels of the block.
+    pub(crate) fn levels(&self) -> BlockLevels {
+        match self {
+            AudioBlock::Interleaved { samples, .. } | AudioBlock::Sequential { samples, .. } => {
+                BlockLevels::of(samples)
+            }
+            AudioBlock::Planar(channels) => channels
+                .iter()
+                .map(|channel| BlockLevels::of(channel))
+                .fold(BlockLevels::default(), BlockLevels::merge),
+        }
+    }
+
+    /// Processes the block in place with the SDK method of its layout.
+    pub(crate) fn process(
+        &mut self,
+        processor: &mut sdk::Processor<'static>,
+    ) -> Result<(), sdk::AicError> {
+        match self {
+            AudioBlock::Interleaved { samples, .. } => processor.process_interleaved(samples),
+            AudioBlock::Sequential { samples, .. } => processor.process_sequential(samples),
+            AudioBlock::Planar(channels) => processor.process_planar(channels),
+        }
+    }
+
+    fn sample(&mut self, channel: usize, frame: usize) -> &mut f32 {
+        let num_channels = self.num_channels();
+        let num_frames = self.num_frames();
+        match self {
+            AudioBlock::Interleaved { samples, .. } => &mut samples[frame * num_channels + channel],
+            AudioBlock::Sequential { samples, .. } => &mut samples[channel * num_frames + frame],
+            AudioBlock::Planar(channels) => &mut channels[channel][frame],
+        }
+    }
+
+    fn copy_to_interleaved(&mut self, interleaved: &mut [f32]) {
+        let num_channels = self.num_channels();
+        for frame in 0..self.num_frames() {
+            for channel in 0..num_channels {
+                interleaved[frame * num_channels + channel] = *self.sample(channel, frame);
+            }
+        }
+    }
+}
+
+/// Fixed delay of multichannel audio, for aligning the output of models with different
+/// output delays.
+struct DelayLine {
+    /// Interleaved ring of `delay` frames.
+    samples: Vec<f32>,
+    position: usize,
+    delay: usize,
+}
+
+impl DelayLine {
+    const NONE: DelayLine = DelayLine {
+        samples: Vec::new(),
+        position: 0,
+        delay: 0,
+    };
+
+    fn new(delay: usize, num_channels: usize) -> DelayLine {
+        DelayLine {
+            samples: vec![0.0; delay * num_channels],
+            position: 0,
+            delay,
+        }
+    }
+
+    fn apply(&mut self, block: &mut AudioBlock) {
+        if self.delay == 0 {
+            return;
+        }
+        let num_channels = block.num_channels();
+        for frame in 0..block.num_frames() {
+            let delayed = &mut self.samples[self.position * num_channels..][..num_channels];
+            for (channel, delayed) in delayed.iter_mut().enumerate() {
+                std::mem::swap(block.sample(channel, frame), delayed);
+            }
+            self.position = (self.position + 1) % self.delay;
+        }
+    }
+}
+
+/// Completion callback of a swap, called with `(error)` or `(null, result)`.
+pub(crate) struct SwapCallback {
+    channel: Channel,
+    callback: Root<JsFunction>,
+}
+
+impl SwapCallback {
+    pub(crate) fn new(channel: Channel, callback: Root<JsFunction>) -> SwapCallback {
+        SwapCallback { channel, callback }
+    }
+
+    /// Settles the swap on the JavaScript thread. `retired` is the replaced SDK processor,
+    /// which is dropped there rather than on the audio path.
+    fn settle(self, outcome: Result<usize, String>, retired: Option<sdk::Processor<'static>>) {
+        let SwapCallback { channel, callback } = self;
+        // `retired` moves into the closure and is dropped on the JavaScript thread with it
+        channel.send(move |mut cx| {
+            let _retired = retired;
+            let callback = callback.into_inner(&mut cx);
+            match outcome {
+                Ok(output_delay) => {
+                    let result = cx.empty_object();
+                    let output_delay = cx.number(output_delay as f64);
+                    result.set(&mut cx, "outputDelay", output_delay)?;
+                    let null = cx.null();
+                    callback.call_with(&cx).arg(null).arg(result).exec(&mut cx)
+                }
+                Err(message) => {
+                    let error = cx.error(message)?;
+                    callback.call_with(&cx).arg(error).exec(&mut cx)
+                }
+            }
+        });
+    }
+}
+
+/// A prepared model waiting to replace the current one.
+pub(crate) struct PendingSwap {
+    next: sdk::Processor<'static>,
+    /// Copy of the input block, enhanced by `next`.
+    shadow: Vec<f32>,
+    /// Delays the output of `next` to the output delay of the stream.
+    alignment: DelayLine,
+    warmup_frames: usize,
+    crossfade_frames: usize,
+    crossfade_position: usize,
+    /// Output delay of the stream once the swap is done.
+    output_delay: usize,
+    callback: SwapCallback,
+}
+
+impl PendingSwap {
+    /// Wraps an initialized SDK processor that takes over from one whose stream currently has
+    /// `current_delay` frames of output delay, including earlier alignment.
+    pub(crate) fn new(
+        next: sdk::Processor<'static>,
+        num_channels: usize,
+        num_frames: usize,
+        current_delay: usize,
+        warmup_frames: usize,
+        crossfade_frames: usize,
+        callback: SwapCallback,
+    ) -> PendingSwap {
+        let model_delay = next.processor_context().output_delay();
+        let padding = current_delay.saturating_sub(model_delay);
+        PendingSwap {
+            next,
+            shadow: vec![0.0; num_channels * num_frames],
+            alignment: DelayLine::new(padding, num_channels),
+            // Until the new model's own delay and the padding have passed, its output is
+            // still the silence it started with
+            warmup_frames: warmup_frames.max(model_delay + padding),
+            crossfade_frames,
+            crossfade_position: 0,
+            output_delay: model_delay + padding,
+            callback,
+        }
+    }
+}
+
+/// Model swap state of a processor. Locked after the processor on the audio path.
+pub(crate) struct ModelSwap {
+    /// Delays the output of the current model to the output delay of the one it replaced.
+    alignment: DelayLine,
+    pending: Option<PendingSwap>,
+    /// A swap is being prepared or pending.
+    busy: bool,
+    /// Incremented by `initialize`, so that swaps prepared for an earlier stream are dropped.
+    generation: u64,
+}
+
+impl ModelSwap {
+    pub(crate) const fn new() -> ModelSwap {
+        ModelSwap {
+            alignment: DelayLine::NONE,
+            pending: None,
+            busy: false,
+            generation: 0,
+        }
+    }
+
+    /// Whether process calls need to go through `begin` and `finish`.
+    pub(crate) fn is_active(&self) -> bool {
+        self.pending.is_some() || self.alignment.delay > 0
+    }
+
+    /// Frames the output of the current model is delayed by for alignment.
+    pub(crate) fn alignment_delay(&self) -> usize {
+        self.alignment.delay
+    }
+
+    /// Reserves the swap for a new model. Returns the current generation, or `None` if a swap
+    /// is already in progress.
+    pub(crate) fn reserve(&mut self) -> Option<u64> {
+        if self.busy {
+            return None;
+        }
+        self.busy = true;
+        Some(self.generation)
+    }
+
+    /// Installs a prepared swap reserved in `generation`. Fails it instead if the stream was
+    /// initialized again in the meantime.
+    pub(crate) fn install(&mut self, generation: u64, swap: PendingSwap) {
+        if generation != self.generation {
+            swap.callback.settle(
+                Err("Model swap was cancelled by initialize()".into()),
+                Some(swap.next),
+            );
+            return;
+        }
+        self.pending = Some(swap);
+    }
+
+    /// Fails a swap reserved in `generation` whose preparation failed.
+    pub(crate) fn fail(&mut self, generation: u64, callback: SwapCallback, message: String) {
+        if generation == self.generation {
+            self.busy = false;
+        }
+        callback.settle(Err(message), None);
+    }
+
+    /// Starts a new stream with the current model: cancels any swap and drops the alignment.
+    pub(crate) fn restart(&mut self) {
+        self.generation += 1;
+        self.busy = false;
+        self.alignment = DelayLine::NONE;
+        if let Some(swap) = self.pending.take() {
+            swap.callback.settle(
+                Err("Model swap was cancelled by initialize()".into()),
+                Some(swap.next),
+            );
+        }
+    }
+
+    /// Keeps a copy of the input block for the pending model. Call before processing.
+    pub(crate) fn begin(&mut self, block: &mut AudioBlock) {
+        if let Some(swap) = &mut self.pending {
+            let len = block.num_channels() * block.num_frames();
+            block.copy_to_interleaved(staging_area(&mut swap.shadow, len));
+        }
+    }
+
+    /// Aligns the processed block and mixes in the pending model. When the crossfade is
+    /// complete, the pending model replaces `processor`.
+    pub(crate) fn finish(
+        &mut self,
+        processor: &mut sdk::Processor<'static>,
+        block: &mut AudioBlock,
+    ) {
+        self.alignment.apply(block);
+
+        let Some(swap) = &mut self.pending else {
+            return;
+        };
+        let num_channels = block.num_channels();
+        let num_frames = block.num_frames();
+        let shadow = &mut swap.shadow[..num_channels * num_frames];
+        if let Err(error) = swap.next.process_interleaved(shadow) {
+            let swap = self.pending.take().expect("Swap is pending");
+            self.busy = false;
+            swap.callback
+                .settle(Err(error.to_string()), Some(swap.next));
+            return;
+        }
+        swap.alignment.apply(&mut AudioBlock::Interleaved {
+            samples: shadow,
+            num_channels,
+        });
+
+        for frame in 0..num_frames {
+            let gain = if swap.warmup_frames > 0 {
+                swap.warmup_frames -= 1;
+                continue;
+            } else if swap.crossfade_position < swap.crossfade_frames {
+                swap.crossfade_position += 1;
+                swap.crossfade_position as f32 / (swap.crossfade_frames + 1) as f32
+            } else {
+                1.0
+            };
+            for channel in 0..num_channels {
+                let sample = block.sample(channel, frame);
+                *sample += gain * (shadow[frame * num_channels + channel] - *sample);
+            }
+        }
+
+        if swap.warmup_frames == 0 && swap.crossfade_position == swap.crossfade_frames {
+            let mut swap = self.pending.take().expect("Swap is pending");
+            std::mem::swap(processor, &mut swap.next);
+            copy_parameters(&swap.next, processor);
+            self.alignment = swap.alignment;
+            self.busy = false;
+            swap.callback.settle(Ok(swap.output_delay), Some(swap.next));
+        }
+    }
+}
+
+/// Copies the processor and VAD parameters of `from` to `to`. Parameters the new model does
+/// not support keep their defaults.
+fn copy_parameters(from: &sdk::Processor<'static>, to: &sdk::Processor<'static>) {
+    copy_context_parameters(&from.processor_context(), &from.vad_context(), to);
+}
+
+/// Like `copy_parameters`, from the contexts of a processor that is not at hand.
+pub(crate) fn copy_context_parameters(
+    processor_context: &sdk::ProcessorContext,
+    vad_context: &sdk::VadContext,
+    to: &sdk::Processor<'static>,
+) {
+    let processor_parameters: [fn() -> sdk::ProcessorParameter; 2] = [
+        || sdk::ProcessorParameter::Bypass,
+        || sdk::ProcessorParameter::EnhancementLevel,
+    ];
+    let to_processor = to.processor_context();
+    for parameter in processor_parameters {
+        if let Ok(value) = processor_context.parameter(parameter()) {
+            let _ = to_processor.set_parameter(parameter(), value);
+        }
+    }
+
+    let vad_parameters: [fn() -> sdk::VadParameter; 3] = [
+        || sdk::VadParameter::SpeechHoldDuration,
+        || sdk::VadParameter::Sensitivity,
+        || sdk::VadParameter::MinimumSpeechDuration,
+    ];
+    let to_vad = to.vad_context();
+    for parameter in vad_parameters {
+        if let Ok(value) = vad_context.parameter(parameter()) {
+            let _ = to_vad.set_parameter(parameter(), value);
+        }
+    }
+}
@@ -0,0 +1,474 @@
+//! Independent enhancement of every channel of a multichannel stream.
+//!
+//! A `MultiChannelProcessor` owns one mono SDK processor per channel. Channel 0 is processed
+//! on the calling thread and every other channel on a persistent worker thread of its own, so
+//! one call enhances all channels in parallel and returns when the last one is done.
+
+use std::sync::{Arc, Condvar, Mutex};
+use std::thread::JoinHandle;
+
+use neon::{
+    handle::Handle,
+    object::Object,
+    prelude::{Context, FunctionContext},
+    result::{JsResult, NeonResult},
+    types::{
+        Finalize, JsArray, JsBoolean, JsBox, JsNumber, JsObject, JsString, JsUndefined, JsValue,
+    },
+};
+
+use crate::error::throw_aic_error;
+use crate::model::Model;
+use crate::processor::{SharedProcessor, parse_otel_config};
+use crate::processor_context::ProcessorContext;
+use crate::raw_samples::{RawSamples, staging_area};
+use crate::sdk;
+use crate::thread_settings::{ThreadReport, ThreadSettings};
+use crate::trace;
+use crate::vad_context::VadContext;
+
+/// Same limit as `Processor.processPlanar`, so per-call state fits in fixed-size arrays.
+const MAX_CHANNELS: usize = 16;
+
+/// Mono samples of one channel, handed to a worker for the duration of one call.
+#[derive(Clone, Copy)]
+struct ChannelSlice {
+    ptr: *mut f32,
+    len: usize,
+}
+
+// SAFETY: The caller blocks until the worker reports back, and no other code touches the
+// samples in the meantime.
+unsafe impl Send for ChannelSlice {}
+
+impl ChannelSlice {
+    const EMPTY: ChannelSlice = ChannelSlice {
+        ptr: std::ptr::null_mut(),
+        len: 0,
+    };
+
+    fn new(samples: &mut [f32]) -> ChannelSlice {
+        ChannelSlice {
+            ptr: samples.as_mut_ptr(),
+            len: samples.len(),
+        }
+    }
+
+    /// # Safety
+    ///
+    /// The samples must be alive and not accessed elsewhere for the returned lifetime.
+    unsafe fn as_mut_slice<'a>(&self) -> &'a mut [f32] {
+        if self.len == 0 {
+            return &mut [];
+        }
+        unsafe { std::slice::from_raw_parts_mut(self.ptr, self.len) }
+    }
+}
+
+enum Job {
+    Idle,
+    Process(ChannelSlice),
+    Done(Result<(), sdk::AicError>),
+    Stop,
+}
+
+/// Persistent thread processing one channel per call.
+struct ChannelWorker {
+    job: Arc<(Mutex<Job>, Condvar)>,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl ChannelWorker {
+    /// Starts the worker thread and waits until it has applied `settings` to itself.
+    fn spawn(
+        channel: usize,
+        processor: Arc<SharedProcessor>,
+        settings: ThreadSettings,
+    ) -> (ChannelWorker, ThreadReport) {
+        let job = Arc::new((Mutex::new(Job::Idle), Condvar::new()));
+        let (report_sender, report_receiver) = std::sync::mpsc::sync_channel(1);
+
+        let thread = {
+            let job = job.clone();
+            std::thread::Builder::new()
+                .name(format!("aic-channel-{channel}"))
+                .spawn(move || {
+                    let _ = report_sender.send(settings.apply());
+                    let (slot, ready) = &*job;
+                    loop {
+                        let mut current = slot.lock().unwrap();
+                        let samples = loop {
+                            match *current {
+                                Job::Process(samples) => break samples,
+                                Job::Stop => return,
+                                Job::Idle | Job::Done(_) => current = ready.wait(current).unwrap(),
+                            }
+                        };
+                        drop(current);
+
+                        // SAFETY: The caller waits for `Done` before the samples go away.
+                        let samples = unsafe { samples.as_mut_slice() };
+                        let result = processor.process_interleaved(samples, samples.len());
+
+                        *slot.lock().unwrap() = Job::Done(result);
+                        ready.notify_all();
+                    }
+                })
+                .expect("Channel worker thread can be spawned")
+        };
+
+        let report = report_receiver
+            .recv()
+            .expect("Channel worker reports its thread settings");
+        let worker = ChannelWorker {
+            job,
+            thread: Some(thread),
+        };
+        (worker, report)
+    }
+
+    fn start(&self, samples: ChannelSlice) {
+        let (slot, ready) = &*self.job;
+        *slot.lock().unwrap() = Job::Process(samples);
+        ready.notify_all();
+    }
+
+    fn wait(&self) -> Result<(), sdk::AicError> {
+        let (slot, ready) = &*self.job;
+        let mut current = slot.lock().unwrap();
+        loop {
+            match std::mem::replace(&mut *current, Job::Idle) {
+                Job::Done(result) => return result,
+                job => {
+                    *current = job;
+                    current = ready.wait(current).unwrap();
+                }
+            }
+        }
+    }
+}
+
+impl Drop for ChannelWorker {
+    fn drop(&mut self) {
+        let (slot, ready) = &*self.job;
+        *slot.lock().unwrap() = Job::Stop;
+        ready.notify_all();
+        if let Some(thread) = self.thread.take() {
+            thread.join().expect("Channel worker thread does not panic");
+        }
+    }
+}
+
+/// Per-call state, locked for the duration of a process call.
+struct Streams {
+    /// Frames per call passed to `initialize`, or `None` before.
+    num_frames: Option<usize>,
+    /// Channel-major staging area for deinterleaved and unaligned audio.
+    scratch: Vec<f32>,
+}
+
+pub struct MultiChannelProcessor {
+    channels: Vec<Arc<SharedProcessor>>,
+    /// Workers of channels 1 and up. Channel 0 runs on the calling thread.
+    workers: Vec<ChannelWorker>,
+    /// Thread settings in effect on each worker.
+    thread_reports: Vec<ThreadReport>,
+    streams: Mutex<Streams>,
+}
+
+impl Finalize for MultiChannelProcessor {
+    fn finalize<'a, C: neon::prelude::Context<'a>>(self, _: &mut C) {}
+}
+
+impl MultiChannelProcessor {
+    /// Processes every channel in `channels` in place, in parallel, and waits for all of them
+    /// before returning the first error.
+    fn process_channels(&self, channels: &[ChannelSlice]) -> Result<(), sdk::AicError> {
+        let Some((first, rest)) = channels.split_first() else {
+            return Ok(());
+        };
+        for (worker, samples) in self.workers.iter().zip(rest) {
+            worker.start(*samples);
+        }
+
+        // SAFETY: The samples stay valid until this function returns.
+        let first = unsafe { first.as_mut_slice() };
+        let mut result = self.channels[0].process_interleaved(first, first.len());
+
+        // Every worker must be done with its samples before they can be released
+        for worker in &self.workers[..rest.len()] {
+            let worker_result = worker.wait();
+            if result.is_ok() {
+                result = worker_result;
+            }
+        }
+        result
+    }
+
+    pub fn new(mut cx: FunctionContext) -> JsResult<JsBox<MultiChannelProcessor>> {
+        let model = cx.argument::<JsBox<Model>>(0)?;
+        let license_key = cx.argument::<JsString>(1)?.value(&mut cx);
+        let num_channels = cx.argument::<JsNumber>(2)?.value(&mut cx) as usize;
+        let otel_config = match cx.argument_opt(3) {
+            Some(value) => parse_otel_config(&mut cx, value)?,
+            None => None,
+        };
+        let settings = match cx.argument_opt(4) {
+            Some(value) => ThreadSettings::from_js(&mut cx, value)?,
+            None => ThreadSettings::default(),
+        };
+
+        if !(1..=MAX_CHANNELS).contains(&num_channels) {
+            return cx.throw_range_error(format!(
+                "Number of channels must be between 1 and {MAX_CHANNELS}"
+            ));
+        }
+
+        let mut channels = Vec::with_capacity(num_channels);
+        for _ in 0..num_channels {
+            let processor = SharedProcessor::new(&model.inner, &license_key, otel_config.as_ref())
+                .or_else(|e| throw_aic_error(&mut cx, &e))?;
+            channels.push(Arc::new(processor));
+        }
+
+        let (workers, thread_reports) = channels
+            .iter()
+            .enumerate()
+            .skip(1)
+            .map(|(channel, processor)| {
+                ChannelWorker::spawn(channel, processor.clone(), settings.clone())
+            })
+            .unzip();
+
+        Ok(cx.boxed(MultiChannelProcessor {
+            channels,
+            workers,
+            thread_reports,
+            streams: Mutex::new(Streams {
+                num_frames: None,
+                scratch: Vec::new(),
+            }),
+        }))
+    }
+
+    pub fn initialize(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let _span = trace::span("MultiChannelProcessor.initialize");
+        let this = cx.argument::<JsBox<MultiChannelProcessor>>(0)?;
+        let sample_rate = cx.argument::<JsNumber>(1)?.value(&mut cx) as u32;
+        let num_frames = cx.argument::<JsNumber>(2)?.value(&mut cx) as usize;
+        let allow_variable_frames = cx.argument::<JsBoolean>(3)?.value(&mut cx);
+
+        let config = sdk::ProcessorConfig {
+            sample_rate,
+            num_channels: 1,
+            num_frames,
+            allow_variable_frames,
+        };
+
+        let mut streams = this.streams.lock().unwrap();
+        for channel in &this.channels {
+            let mut processor = channel.lock();
+            processor
+                .initialize(&config)
+                .or_else(|e| throw_aic_error(&mut cx, &e))?;
+            channel.automation.clear();
+        }
+
+        streams.num_frames = Some(num_frames);
+        streams.scratch.clear();
+        streams
+            .scratch
+            .resize(this.channels.len() * num_frames, 0.0);
+
+        Ok(cx.undefined())
+    }
+
+    pub fn process_interleaved(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let _span = trace::span("MultiChannelProcessor.processInterleaved");
+        let this = cx.argument::<JsBox<MultiChannelProcessor>>(0)?;
+        let buffer = cx.argument::<JsValue>(1)?;
+        let samples = RawSamples::from_value(&mut cx, buffer)?;
+        let num_channels = this.channels.len();
+
+        if samples.len % num_channels != 0 {
+            return cx.throw_range_error(format!(
+                "Interleaved buffer length must be a multiple of {num_channels} channels"
+            ));
+        }
+        let num_frames = samples.len / num_channels;
+
+        let mut streams = this.streams.lock().unwrap();
+        if streams.num_frames.is_none() {
+            return cx.throw_error("Processor is not initialized");
+        }
+        let staged = staging_area(&mut streams.scratch, samples.len);
+
+        // The interleaved buffer may be an unaligned byte view, so it is read and written
+        // sample by sample without assuming alignment
+        let interleaved = samples.ptr.cast::<f32>();
+        let mut channels = [ChannelSlice::EMPTY; MAX_CHANNELS];
+        for (channel, (mono, slice)) in staged
+            .chunks_exact_mut(num_frames.max(1))
+            .zip(&mut channels)
+            .enumerate()
+        {
+            for (frame, sample) in mono.iter_mut().enumerate() {
+                // SAFETY: The index is within the `samples.len` samples of the buffer.
+                *sample = unsafe {
+                    interleaved
+                        .add(frame * num_channels + channel)
+                        .read_unaligned()
+                };
+            }
+            *slice = ChannelSlice::new(mono);
+        }
+
+        let result = this.process_channels(&channels[..num_channels]);
+
+        for (channel, mono) in staged.chunks_exact(num_frames.max(1)).enumerate() {
+            for (frame, sample) in mono.iter().enumerate() {
+                // SAFETY: See above.
+                unsafe {
+                    interleaved
+                        .add(frame * num_channels + channel)
+                        .write_unaligned(*sample)
+                };
+            }
+        }
+        drop(streams);
+
+        result.or_else(|e| throw_aic_error(&mut cx, &e))?;
+        Ok(cx.number(num_frames as f64))
+    }
+
+    pub fn process_planar(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let _span = trace::span("MultiChannelProcessor.processPlanar");
+        let this = cx.argument::<JsBox<MultiChannelProcessor>>(0)?;
+        let buffers = cx.argument::<JsArray>(1)?;
+        let num_channels = this.channels.len();
+
+        if buffers.len(&mut cx) as usize != num_channels {
+            return cx.throw_range_error(format!("Expected {num_channels} channel buffers"));
+        }
+
+        let mut samples = [RawSamples::EMPTY; MAX_CHANNELS];
+        for (i, samples) in samples[..num_channels].iter_mut().enumerate() {
+            let buffer: Handle<JsValue> = buffers.get(&mut cx, i as u32)?;
+            *samples = RawSamples::from_value(&mut cx, buffer)?;
+        }
+        let samples = &samples[..num_channels];
+        let num_frames = samples[0].len;
+        if samples.iter().any(|channel| channel.len != num_frames) {
+            return cx.throw_range_error("All channel buffers must have the same length");
+        }
+
+        let mut streams = this.streams.lock().unwrap();
+        if streams.num_frames.is_none() {
+            return cx.throw_error("Processor is not initialized");
+        }
+
+        // Aligned channels are processed in place, unaligned ones staged in the scratch buffer
+        let mut staging = staging_area(&mut streams.scratch, num_channels * num_frames);
+        let mut channels = [ChannelSlice::EMPTY; MAX_CHANNELS];
+        for (slice, samples) in channels.iter_mut().zip(samples) {
+            if samples.is_aligned() {
+                // SAFETY: The buffer handles are rooted for the duration of the call, each
+                // refers to a different buffer, and no JavaScript runs meanwhile.
+                *slice = ChannelSlice::new(unsafe { samples.as_mut_slice() });
+            } else {
+                let (staged, rest) = std::mem::take(&mut staging).split_at_mut(num_frames);
+                // SAFETY: As above. `staged` has exactly `samples.len` samples.
+                unsafe { samples.load(staged) };
+                *slice = ChannelSlice::new(staged);
+                staging = rest;
+            }
+        }
+
+        let result = this.process_channels(&channels[..num_channels]);
+
+        for (slice, samples) in channels.iter().zip(samples) {
+            if !samples.is_aligned() {
+                // SAFETY: See above.
+                unsafe { samples.store(slice.as_mut_slice()) };
+            }
+        }
+        drop(streams);
+
+        result.or_else(|e| throw_aic_error(&mut cx, &e))?;
+        Ok(cx.number(num_frames as f64))
+    }
+
+    /// Returns the channel index in argument 1, checked against the number of channels.
+    fn channel_argument(&self, cx: &mut FunctionContext) -> NeonResult<&Arc<SharedProcessor>> {
+        let channel = cx.argument::<JsNumber>(1)?.value(cx);
+        if channel < 0.0 || channel.fract() != 0.0 || channel as usize >= self.channels.len() {
+            return cx.throw_range_error(format!(
+                "Channel must be an integer between 0 and {}",
+                self.channels.len() - 1
+            ));
+        }
+        Ok(&self.channels[channel as usize])
+    }
+
+    pub fn get_processor_context(mut cx: FunctionContext) -> JsResult<JsBox<ProcessorContext>> {
+        let this = cx.argument::<JsBox<MultiChannelProcessor>>(0)?;
+        let processor = this.channel_argument(&mut cx)?.clone();
+        Ok(cx.boxed(ProcessorContext { processor }))
+    }
+
+    pub fn get_vad_context(mut cx: FunctionContext) -> JsResult<JsBox<VadContext>> {
+        let this = cx.argument::<JsBox<MultiChannelProcessor>>(0)?;
+        let processor = this.channel_argument(&mut cx)?.clone();
+        Ok(cx.boxed(VadContext { processor }))
+    }
+
+    pub fn get_stats(mut cx: FunctionContext) -> JsResult<JsObject> {
+        let this = cx.argument::<JsBox<MultiChannelProcessor>>(0)?;
+        let processor = this.channel_argument(&mut cx)?;
+        processor.stats.to_object(&mut cx)
+    }
+
+    /// Returns the thread settings in effect on the workers of channels 1 and up.
+    pub fn get_thread_reports(mut cx: FunctionContext) -> JsResult<JsArray> {
+        let this = cx.argument::<JsBox<MultiChannelProcessor>>(0)?;
+        let reports = cx.empty_array();
+        for (index, report) in this.thread_reports.iter().enumerate() {
+            let report = report.to_js(&mut cx)?;
+            reports.set(&mut cx, index as u32, report)?;
+        }
+        Ok(reports)
+    }
+}
+
+pub fn register_exports(cx: &mut neon::prelude::ModuleContext) -> NeonResult<()> {
+    cx.export_function("multiChannelProcessorNew", MultiChannelProcessor::new)?;
+    cx.export_function(
+        "multiChannelProcessorInitialize",
+        MultiChannelProcessor::initialize,
+    )?;
+    cx.export_function(
+        "multiChannelProcessorProcessInterleaved",
+        MultiChannelProcessor::process_interleaved,
+    )?;
+    cx.export_function(
+        "multiChannelProcessorProcessPlanar",
+        MultiChannelProcessor::process_planar,
+    )?;
+    cx.export_function(
+        "multiChannelProcessorGetProcessorContext",
+        MultiChannelProcessor::get_processor_context,
+    )?;
+    cx.export_function(
+        "multiChannelProcessorGetVadContext",
+        MultiChannelProcessor::get_vad_context,
+    )?;
+    cx.export_function(
+        "multiChannelProcessorGetStats",
+        MultiChannelProcessor::get_stats,
+    )?;
+    cx.export_function(
+        "multiChannelProcessorGetThreadReports",
+        MultiChannelProcessor::get_thread_reports,
+    )?;
+    Ok(())
+}
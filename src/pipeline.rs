@@ -0,0 +1,328 @@
+//! A media path in one native call per packet: decode, resample to the processor's rate,
+//! enhance, detect speech, resample to the output rate and encode.
+
+use std::sync::Mutex;
+
+use neon::{
+    handle::Handle,
+    object::Object,
+    prelude::{Context, FunctionContext},
+    result::{JsResult, NeonResult},
+    types::{
+        Finalize, JsBoolean, JsBox, JsBuffer, JsNull, JsNumber, JsObject, JsString, JsUndefined,
+        JsValue, buffer::TypedArray,
+    },
+};
+
+use crate::codec::Codec;
+use crate::error::throw_aic_error;
+use crate::frame_accumulator::Accumulator;
+use crate::processor::Processor;
+use crate::raw_samples::raw_bytes;
+use crate::resampler::Resampler;
+use crate::sdk;
+use crate::trace;
+
+/// A change of the voice activity, at a frame of the output stream.
+struct SpeechEvent {
+    speech: bool,
+    frame: u64,
+}
+
+/// Stages and buffers of a pipeline. All buffers are reused across packets, so a pipeline
+/// stops allocating once they have grown to the largest packet.
+struct Stages {
+    input_codec: Codec,
+    output_codec: Codec,
+    processor_rate: u32,
+    output_rate: u32,
+    /// Bytes of a sample that was split across packets.
+    partial: [u8; 4],
+    num_partial: usize,
+    decoded: Vec<f32>,
+    /// Input rate to processor rate, if they differ.
+    input_resampler: Option<Resampler>,
+    resampled: Vec<f32>,
+    accumulator: Accumulator,
+    /// Processor rate to output rate, if they differ.
+    output_resampler: Option<Resampler>,
+    encoded: Vec<u8>,
+    /// Whether speech events are collected.
+    vad: bool,
+    speech: bool,
+    /// Enhanced frames at the processor rate so far.
+    enhanced_frames: u64,
+    events: Vec<SpeechEvent>,
+}
+
+impl Stages {
+    /// Decodes a packet into `decoded`. A trailing incomplete sample is kept for the next one.
+    fn decode(&mut self, mut bytes: &[u8]) {
+        let sample_size = self.input_codec.bytes_per_sample();
+        self.decoded.clear();
+
+        if self.num_partial > 0 {
+            let take = bytes.len().min(sample_size - self.num_partial);
+            self.partial[self.num_partial..self.num_partial + take].copy_from_slice(&bytes[..take]);
+            self.num_partial += take;
+            bytes = &bytes[take..];
+            if self.num_partial < sample_size {
+                return;
+            }
+            self.input_codec
+                .decode(&self.partial[..sample_size], &mut self.decoded);
+            self.num_partial = 0;
+        }
+
+        let whole = bytes.len() / sample_size * sample_size;
+        self.input_codec.decode(&bytes[..whole], &mut self.decoded);
+        let rest = &bytes[whole..];
+        self.partial[..rest.len()].copy_from_slice(rest);
+        self.num_partial = rest.len();
+    }
+
+    /// Runs a packet through all stages. The encoded output is appended to `encoded`.
+    fn push(&mut self, bytes: &[u8]) -> Result<(), sdk::AicError> {
+        {
+            let _span = trace::span("pipeline.decode");
+            self.decode(bytes);
+        }
+        match self.input_resampler.as_mut() {
+            Some(resampler) => {
+                let _span = trace::span("pipeline.resample");
+                self.resampled.clear();
+                resampler.process(&self.decoded, &mut self.resampled);
+                self.accumulator.append_samples(&self.resampled);
+            }
+            None => self.accumulator.append_samples(&self.decoded),
+        }
+        self.enhance(false)
+    }
+
+    /// Pads the stream with silence until all audio held back by the resamplers and the
+    /// processor's output delay has come out, and encodes it. Afterwards a new stream starts.
+    fn flush(&mut self) -> Result<(), sdk::AicError> {
+        self.num_partial = 0;
+        if let Some(resampler) = self.input_resampler.as_mut() {
+            self.resampled.clear();
+            resampler.flush(&mut self.resampled);
+            self.accumulator.append_samples(&self.resampled);
+        }
+        self.enhance(true)
+    }
+
+    /// Enhances all complete blocks, or with `flush` the rest of the stream, and resamples
+    /// and encodes the result.
+    fn enhance(&mut self, flush: bool) -> Result<(), sdk::AicError> {
+        let vad = self.vad;
+        let speech = &mut self.speech;
+        let enhanced_frames = &mut self.enhanced_frames;
+        let events = &mut self.events;
+        let after_block = |processor: &sdk::Processor<'static>, valid_frames: usize| {
+            if vad {
+                let detected = processor.vad_context().is_speech_detected();
+                if detected != *speech {
+                    *speech = detected;
+                    events.push(SpeechEvent {
+                        speech: detected,
+                        frame: *enhanced_frames,
+                    });
+                }
+            }
+            *enhanced_frames += valid_frames as u64;
+        };
+        if flush {
+            self.accumulator.flush_with(after_block)?;
+        } else {
+            self.accumulator.process_blocks_with(after_block)?;
+        }
+
+        let _span = trace::span("pipeline.encode");
+        let processed = self.accumulator.processed();
+        match self.output_resampler.as_mut() {
+            Some(resampler) => {
+                self.resampled.clear();
+                resampler.process(processed, &mut self.resampled);
+                if flush {
+                    resampler.flush(&mut self.resampled);
+                }
+                self.output_codec.encode(&self.resampled, &mut self.encoded);
+            }
+            None => self.output_codec.encode(processed, &mut self.encoded),
+        }
+        self.accumulator.drain_processed();
+        // Speech still active ends with the stream, so every speechStart has its speechEnd
+        if flush && self.speech {
+            self.speech = false;
+            self.events.push(SpeechEvent {
+                speech: false,
+                frame: self.enhanced_frames,
+            });
+        }
+        Ok(())
+    }
+
+    /// Converts a frame at the processor rate to the output rate.
+    fn output_frame(&self, frame: u64) -> u64 {
+        frame * u64::from(self.output_rate) / u64::from(self.processor_rate)
+    }
+
+    /// Moves the encoded output and speech events into `{ data, events }`.
+    fn take_output<'a, C: Context<'a>>(&mut self, cx: &mut C) -> JsResult<'a, JsObject> {
+        let result = cx.empty_object();
+        let data = JsBuffer::from_slice(cx, &self.encoded)?;
+        self.encoded.clear();
+        result.set(cx, "data", data)?;
+
+        let events = cx.empty_array();
+        for (index, event) in self.events.iter().enumerate() {
+            let object = cx.empty_object();
+            let kind = cx.string(if event.speech {
+                "speechStart"
+            } else {
+                "speechEnd"
+            });
+            object.set(cx, "type", kind)?;
+            let frame = cx.number(self.output_frame(event.frame) as f64);
+            object.set(cx, "frame", frame)?;
+            events.set(cx, index as u32, object)?;
+        }
+        self.events.clear();
+        result.set(cx, "events", events)?;
+
+        Ok(result)
+    }
+}
+
+pub struct Pipeline {
+    stages: Mutex<Stages>,
+}
+
+impl Finalize for Pipeline {
+    fn finalize<'a, C: neon::prelude::Context<'a>>(self, _: &mut C) {}
+}
+
+/// Reads a codec name from `options[key]`.
+fn codec_option(
+    cx: &mut FunctionContext,
+    options: Handle<JsObject>,
+    key: &str,
+) -> NeonResult<Codec> {
+    let name = options.get::<JsString, _, _>(cx, key)?.value(cx);
+    match Codec::from_name(&name) {
+        Some(codec) => Ok(codec),
+        None => cx.throw_error(format!(
+            "{key} must be \"float32\", \"pcm16\", \"mulaw\" or \"alaw\", got \"{name}\""
+        )),
+    }
+}
+
+/// Reads a sample rate from `options[key]`, defaulting to `default` if it is null.
+fn rate_option(
+    cx: &mut FunctionContext,
+    options: Handle<JsObject>,
+    key: &str,
+    default: u32,
+) -> NeonResult<u32> {
+    let value = options.get::<JsValue, _, _>(cx, key)?;
+    if value.is_a::<JsNull, _>(cx) || value.is_a::<JsUndefined, _>(cx) {
+        return Ok(default);
+    }
+    let rate = value.downcast_or_throw::<JsNumber, _>(cx)?.value(cx);
+    if rate.fract() != 0.0 || !(8000.0..=192000.0).contains(&rate) {
+        return cx.throw_range_error(format!("{key} must be an integer from 8000 to 192000"));
+    }
+    Ok(rate as u32)
+}
+
+impl Pipeline {
+    /// Creates a pipeline around an initialized processor. Argument 1 is `{ inputFormat,
+    /// inputSampleRate, outputFormat, outputSampleRate, vad }`; null sample rates default to
+    /// the processor's.
+    pub fn new(mut cx: FunctionContext) -> JsResult<JsBox<Pipeline>> {
+        let processor = cx.argument::<JsBox<Processor>>(0)?;
+        let options = cx.argument::<JsObject>(1)?;
+
+        let Some(config) = processor.stream_config() else {
+            return cx.throw_error("Processor must be initialized before creating a pipeline");
+        };
+        let input_codec = codec_option(&mut cx, options, "inputFormat")?;
+        let output_codec = codec_option(&mut cx, options, "outputFormat")?;
+        let input_rate = rate_option(&mut cx, options, "inputSampleRate", config.sample_rate)?;
+        let output_rate = rate_option(&mut cx, options, "outputSampleRate", config.sample_rate)?;
+        let vad = options
+            .get::<JsBoolean, _, _>(&mut cx, "vad")?
+            .value(&mut cx);
+
+        let num_channels = config.num_channels;
+        let resampler = |from_rate: u32, to_rate: u32| {
+            (from_rate != to_rate).then(|| Resampler::new(from_rate, to_rate, num_channels))
+        };
+        let block_len = num_channels * config.num_frames;
+
+        Ok(cx.boxed(Pipeline {
+            stages: Mutex::new(Stages {
+                input_codec,
+                output_codec,
+                processor_rate: config.sample_rate,
+                output_rate,
+                partial: [0; 4],
+                num_partial: 0,
+                decoded: Vec::with_capacity(block_len),
+                input_resampler: resampler(input_rate, config.sample_rate),
+                resampled: Vec::with_capacity(block_len),
+                accumulator: Accumulator::new(&processor, config),
+                output_resampler: resampler(config.sample_rate, output_rate),
+                encoded: Vec::with_capacity(2 * block_len * output_codec.bytes_per_sample()),
+                vad,
+                speech: false,
+                enhanced_frames: 0,
+                events: Vec::new(),
+            }),
+        }))
+    }
+
+    /// Runs the encoded packet passed as argument 1 through the pipeline. Returns the number
+    /// of encoded output bytes ready to be pulled.
+    pub fn push(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let _span = trace::span("Pipeline.push");
+        let this = cx.argument::<JsBox<Pipeline>>(0)?;
+        let packet = cx.argument::<JsValue>(1)?;
+        let (ptr, num_bytes) = raw_bytes(&mut cx, packet)?;
+        // SAFETY: The packet handle keeps the bytes alive for the duration of the call.
+        let bytes = unsafe { std::slice::from_raw_parts(ptr, num_bytes) };
+
+        let mut stages = this.stages.lock().unwrap();
+        stages.accumulator.check_no_post_process(&mut cx)?;
+        stages
+            .push(bytes)
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
+
+        Ok(cx.number(stages.encoded.len() as f64))
+    }
+
+    /// Returns and drains the encoded output and the speech events as `{ data, events }`.
+    pub fn pull(mut cx: FunctionContext) -> JsResult<JsObject> {
+        let this = cx.argument::<JsBox<Pipeline>>(0)?;
+        let mut stages = this.stages.lock().unwrap();
+        stages.take_output(&mut cx)
+    }
+
+    /// Flushes the rest of the stream and returns it like `pull`.
+    pub fn flush(mut cx: FunctionContext) -> JsResult<JsObject> {
+        let this = cx.argument::<JsBox<Pipeline>>(0)?;
+        let mut stages = this.stages.lock().unwrap();
+        stages.accumulator.check_no_post_process(&mut cx)?;
+        stages.flush().or_else(|e| throw_aic_error(&mut cx, &e))?;
+        stages.take_output(&mut cx)
+    }
+}
+
+pub fn register_exports(cx: &mut neon::prelude::ModuleContext) -> NeonResult<()> {
+    cx.export_function("pipelineNew", Pipeline::new)?;
+    cx.export_function("pipelinePush", Pipeline::push)?;
+    cx.export_function("pipelinePull", Pipeline::pull)?;
+    cx.export_function("pipelineFlush", Pipeline::flush)?;
+
+    Ok(())
+}
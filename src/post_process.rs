@@ -0,0 +1,232 @@
+//! Optional post-processing of the enhanced output, fused into a single pass that runs right
+//! after the SDK call: output gain, a soft limiter, peak and clip detection, and packing to
+//! interleaved 16-bit PCM.
+
+use neon::{
+    handle::{Handle, Root},
+    object::Object,
+    prelude::{Context, FunctionContext},
+    result::NeonResult,
+    types::{JsNull, JsNumber, JsObject, JsTypedArray, JsUndefined, JsValue, buffer::TypedArray},
+};
+
+use crate::codec::to_pcm16;
+use crate::model_swap::AudioBlock;
+
+// Layout of the Float64 status buffer. All entries except the total describe the last call.
+/// Largest absolute sample after the gain, before limiting.
+pub const POST_STATUS_PEAK: usize = 0;
+/// Samples beyond full scale after limiting, clamped when packed to PCM.
+pub const POST_STATUS_CLIPPED: usize = 1;
+/// Samples reduced by the limiter.
+pub const POST_STATUS_LIMITED: usize = 2;
+/// Frames post-processed, and packed to PCM if enabled.
+pub const POST_STATUS_FRAMES: usize = 3;
+/// Clipped samples since the stage was set.
+pub const POST_STATUS_TOTAL_CLIPPED: usize = 4;
+pub const POST_STATUS_LENGTH: usize = 5;
+
+/// Samples per chunk of the inner loop. The gain and the peak of a chunk are computed
+/// branch-free, so the compiler vectorizes them; only chunks above the limiter threshold or
+/// full scale take the per-sample path.
+const CHUNK: usize = 16;
+
+/// Post-processing stage of a processor, configured with `setPostProcess`.
+///
+/// The status and PCM views are rooted and borrowed again on every process call on the
+/// JavaScript thread. Rooting does not keep their buffers from being transferred to another
+/// thread, so their current length is checked before each write: a detached buffer has
+/// length 0 and is no longer written.
+pub(crate) struct PostProcess {
+    gain: f32,
+    /// Level above which the limiter compresses, below 1.0. `None` without limiter.
+    limiter_threshold: Option<f32>,
+    status: Root<JsTypedArray<f64>>,
+    pcm16: Option<Root<JsTypedArray<i16>>>,
+}
+
+/// Counters of one post-processed block.
+#[derive(Default)]
+struct Counters {
+    peak: f32,
+    clipped: u32,
+    limited: u32,
+}
+
+impl PostProcess {
+    /// Parses `{ gain, limiterThreshold }`, the Float64Array status buffer and the optional
+    /// Int16Array PCM output, which has to hold at least `min_pcm16_len` samples.
+    pub(crate) fn from_options(
+        cx: &mut FunctionContext,
+        options: Handle<JsObject>,
+        status: Handle<JsTypedArray<f64>>,
+        pcm16: Handle<JsValue>,
+        min_pcm16_len: usize,
+    ) -> NeonResult<PostProcess> {
+        let gain = options.get::<JsNumber, _, _>(cx, "gain")?.value(cx);
+        if !gain.is_finite() || gain < 0.0 {
+            return cx.throw_range_error("gain must be a finite number of at least 0");
+        }
+
+        let threshold = options.get::<JsValue, _, _>(cx, "limiterThreshold")?;
+        let limiter_threshold =
+            if threshold.is_a::<JsNull, _>(cx) || threshold.is_a::<JsUndefined, _>(cx) {
+                None
+            } else {
+                let threshold = threshold.downcast_or_throw::<JsNumber, _>(cx)?.value(cx);
+                if !(threshold > 0.0 && threshold < 1.0) {
+                    return cx.throw_range_error("limiterThreshold must be between 0 and 1");
+                }
+                Some(threshold as f32)
+            };
+
+        // The status is zeroed by `setPostProcess()`, not here, so that `TotalClipped` keeps
+        // counting when `initialize()` passes the stage again
+        if status.as_slice(cx).len() < POST_STATUS_LENGTH {
+            return cx.throw_range_error("Post-process status buffer is too short");
+        }
+
+        let pcm16 = if pcm16.is_a::<JsNull, _>(cx) || pcm16.is_a::<JsUndefined, _>(cx) {
+            None
+        } else {
+            let pcm16 = pcm16.downcast_or_throw::<JsTypedArray<i16>, _>(cx)?;
+            if pcm16.as_slice(cx).len() < min_pcm16_len {
+                return cx.throw_range_error("PCM16 output is too short for one block");
+            }
+            Some(pcm16.root(cx))
+        };
+
+        Ok(PostProcess {
+            gain: gain as f32,
+            limiter_threshold,
+            status: status.root(cx),
+            pcm16,
+        })
+    }
+
+    /// Post-processes the first `valid_frames` frames of a processed block in place and writes
+    /// the status. With PCM output enabled, the frames are also packed there, interleaved.
+    pub(crate) fn apply<'a>(
+        &mut self,
+        cx: &mut impl Context<'a>,
+        block: AudioBlock,
+        valid_frames: usize,
+    ) {
+        let num_channels = block.num_channels();
+        let num_frames = block.num_frames();
+        let mut pcm16_view = self.pcm16.as_ref().map(|pcm16| pcm16.to_inner(cx));
+        let pcm16: &mut [i16] = match pcm16_view.as_mut() {
+            Some(view) => {
+                let pcm16 = view.as_mut_slice(cx);
+                // Frames beyond the PCM capacity are processed but not packed
+                let packed_frames = valid_frames.min(pcm16.len() / num_channels);
+                &mut pcm16[..packed_frames * num_channels]
+            }
+            None => &mut [],
+        };
+
+        let mut counters = Counters::default();
+        match block {
+            AudioBlock::Interleaved { samples, .. } => {
+                self.run(
+                    &mut samples[..valid_frames * num_channels],
+                    pcm16,
+                    0,
+                    1,
+                    &mut counters,
+                );
+            }
+            AudioBlock::Sequential { samples, .. } => {
+                for (channel, samples) in samples.chunks_exact_mut(num_frames).enumerate() {
+                    let samples = &mut samples[..valid_frames];
+                    self.run(samples, pcm16, channel, num_channels, &mut counters);
+                }
+            }
+            AudioBlock::Planar(channels) => {
+                for (channel, samples) in channels.iter_mut().enumerate() {
+                    let samples = &mut samples[..valid_frames];
+                    self.run(samples, pcm16, channel, num_channels, &mut counters);
+                }
+            }
+        }
+
+        let mut status_view = self.status.to_inner(cx);
+        let Some(status) = status_view.as_mut_slice(cx).get_mut(..POST_STATUS_LENGTH) else {
+            return;
+        };
+        status[POST_STATUS_PEAK] = f64::from(counters.peak);
+        status[POST_STATUS_CLIPPED] = f64::from(counters.clipped);
+        status[POST_STATUS_LIMITED] = f64::from(counters.limited);
+        status[POST_STATUS_FRAMES] = valid_frames as f64;
+        status[POST_STATUS_TOTAL_CLIPPED] += f64::from(counters.clipped);
+    }
+
+    /// Runs the stage over one run of samples. Sample `i` is packed to `pcm16[offset + i *
+    /// stride]`, as far as `pcm16` reaches.
+    fn run(
+        &self,
+        samples: &mut [f32],
+        pcm16: &mut [i16],
+        offset: usize,
+        stride: usize,
+        counters: &mut Counters,
+    ) {
+        let knee = self.limiter_threshold.unwrap_or(1.0);
+
+        for (index, chunk) in samples.chunks_mut(CHUNK).enumerate() {
+            let mut chunk_peak = 0.0f32;
+            for sample in chunk.iter_mut() {
+                *sample *= self.gain;
+                chunk_peak = chunk_peak.max(sample.abs());
+            }
+            counters.peak = counters.peak.max(chunk_peak);
+
+            if chunk_peak > knee {
+                for sample in chunk.iter_mut() {
+                    if sample.abs() > knee && self.limiter_threshold.is_some() {
+                        *sample = soft_limit(*sample, knee);
+                        counters.limited += 1;
+                    }
+                    if sample.abs() > 1.0 {
+                        counters.clipped += 1;
+                    }
+                }
+            }
+
+            let first = offset + index * CHUNK * stride;
+            if first < pcm16.len() {
+                for (sample, packed) in chunk.iter().zip(pcm16[first..].iter_mut().step_by(stride))
+                {
+                    *packed = to_pcm16(*sample);
+                }
+            }
+        }
+    }
+}
+
+/// Compresses the part of `sample` above `threshold` smoothly towards full scale, with unit
+/// slope at the threshold, so the output never exceeds 1.0.
+#[inline]
+fn soft_limit(sample: f32, threshold: f32) -> f32 {
+    let headroom = 1.0 - threshold;
+    let excess = (sample.abs() - threshold) / headroom;
+    (threshold + headroom * excess.tanh()).copysign(sample)
+}
+
+pub fn register_exports(cx: &mut neon::prelude::ModuleContext) -> NeonResult<()> {
+    // Export status layout constants
+    let peak = cx.number(POST_STATUS_PEAK as u32);
+    cx.export_value("POST_STATUS_PEAK", peak)?;
+    let clipped = cx.number(POST_STATUS_CLIPPED as u32);
+    cx.export_value("POST_STATUS_CLIPPED", clipped)?;
+    let limited = cx.number(POST_STATUS_LIMITED as u32);
+    cx.export_value("POST_STATUS_LIMITED", limited)?;
+    let frames = cx.number(POST_STATUS_FRAMES as u32);
+    cx.export_value("POST_STATUS_FRAMES", frames)?;
+    let total_clipped = cx.number(POST_STATUS_TOTAL_CLIPPED as u32);
+    cx.export_value("POST_STATUS_TOTAL_CLIPPED", total_clipped)?;
+    let length = cx.number(POST_STATUS_LENGTH as u32);
+    cx.export_value("POST_STATUS_LENGTH", length)?;
+
+    Ok(())
+}
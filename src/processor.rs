@@ -1,4 +1,9 @@
-use std::sync::{Arc, Mutex};
+use std::sync::{
+    Arc, Mutex, MutexGuard,
+    atomic::{AtomicBool, Ordering},
+};
+use std::thread::JoinHandle;
+use std::time::{Duration, Instant};
 
 use neon::{
     handle::Handle,
@@ -6,27 +11,366 @@ use neon::{
     prelude::{Context, FunctionContext},
     result::{JsResult, NeonResult},
     types::{
-        Finalize, JsArray, JsBoolean, JsBox, JsNull, JsNumber, JsObject, JsString, JsTypedArray,
-        JsUndefined, JsValue, buffer::TypedArray,
+        Finalize, JsArray, JsBoolean, JsBox, JsBuffer, JsFunction, JsNull, JsNumber, JsObject,
+        JsString, JsTypedArray, JsUndefined, JsValue, buffer::TypedArray,
     },
 };
 
+use crate::audio_ring::{JsWaker, RingMemory, audio_ring_argument};
+use crate::automation::Automation;
+use crate::delay_compensation::{DelayCompensation, trim_interleaved, trim_sequential};
+use crate::error::throw_aic_error;
 use crate::model::Model;
+use crate::model_swap::{
+    AudioBlock, ModelSwap, PendingSwap, SwapCallback, copy_context_parameters,
+};
+use crate::post_process::PostProcess;
 use crate::processor_context::ProcessorContext;
+use crate::raw_samples::{RawSamples, sample_bytes, staging_area};
+use crate::realtime_budget::RealtimeBudget;
+use crate::sdk;
+use crate::session;
+use crate::stats::ProcessorStats;
+use crate::thread_settings::{ThreadReport, ThreadSettings};
+use crate::trace;
 use crate::vad_context::VadContext;
 
+/// The SDK processor, shared with accumulators and the ring worker, and its statistics.
+pub(crate) struct SharedProcessor {
+    processor: Mutex<sdk::Processor<'static>>,
+    pub(crate) stats: ProcessorStats,
+    /// Deadline monitor, if a real-time budget is set. Lock after `processor`.
+    budget: Mutex<Option<RealtimeBudget>>,
+    /// Model swap in progress and output alignment after earlier swaps. Lock after
+    /// `processor`, and on the audio path only while `swap_active` is set.
+    swap: Mutex<ModelSwap>,
+    swap_active: AtomicBool,
+    /// Scheduled parameter changes, applied at the start of every block.
+    pub(crate) automation: Arc<Automation>,
+    /// Set while the owning `Processor` has a post-processing stage, which runs on the
+    /// JavaScript thread after the process methods and `flush` only.
+    post_process_set: AtomicBool,
+}
+
+fn new_sdk_processor(
+    model: &sdk::Model<'static>,
+    license_key: &str,
+    otel_config: Option<&sdk::OtelConfig>,
+) -> Result<sdk::Processor<'static>, sdk::AicError> {
+    // SAFETY: This function has no safety requirements.
+    unsafe {
+        sdk::set_sdk_id(4);
+    }
+
+    match otel_config {
+        Some(otel_config) => sdk::Processor::with_otel_config(model, license_key, otel_config),
+        None => sdk::Processor::new(model, license_key),
+    }
+}
+
+impl SharedProcessor {
+    /// Creates an SDK processor for `model`, with statistics and without a real-time budget.
+    pub(crate) fn new(
+        model: &sdk::Model<'static>,
+        license_key: &str,
+        otel_config: Option<&sdk::OtelConfig>,
+    ) -> Result<SharedProcessor, sdk::AicError> {
+        Ok(SharedProcessor {
+            processor: Mutex::new(new_sdk_processor(model, license_key, otel_config)?),
+            stats: ProcessorStats::new(),
+            budget: Mutex::new(None),
+            swap: Mutex::new(ModelSwap::new()),
+            swap_active: AtomicBool::new(false),
+            automation: Arc::new(Automation::new()),
+            post_process_set: AtomicBool::new(false),
+        })
+    }
+
+    /// Throws while a post-processing stage is set, from paths that cannot run it: streams,
+    /// frame adapters, pipelines and rings.
+    pub(crate) fn check_no_post_process<'a>(&self, cx: &mut impl Context<'a>) -> NeonResult<()> {
+        if self.post_process_set.load(Ordering::Relaxed) {
+            return cx.throw_error("The post-process stage only runs in process calls and flush()");
+        }
+        Ok(())
+    }
+
+    /// Output delay of the stream in frames: the model's delay plus the alignment to the
+    /// delay of a model swapped out earlier.
+    pub(crate) fn output_delay(&self, processor: &sdk::Processor<'static>) -> usize {
+        processor.processor_context().output_delay() + self.swap.lock().unwrap().alignment_delay()
+    }
+
+    /// Runs `f` on the context of the current SDK processor, which a model swap replaces.
+    /// The processor stays locked, so a swap cannot complete in between.
+    pub(crate) fn with_processor_context<R>(
+        &self,
+        f: impl FnOnce(&sdk::ProcessorContext) -> R,
+    ) -> R {
+        f(&self.lock().processor_context())
+    }
+
+    /// Like `with_processor_context`, for the VAD context.
+    pub(crate) fn with_vad_context<R>(&self, f: impl FnOnce(&sdk::VadContext) -> R) -> R {
+        f(&self.lock().vad_context())
+    }
+
+    /// Locks the processor, recording the wait if the lock is contended.
+    pub(crate) fn lock(&self) -> MutexGuard<'_, sdk::Processor<'static>> {
+        let _span = trace::span("lock");
+        self.stats.lock(&self.processor)
+    }
+
+    /// Locks the processor and processes one interleaved block of `num_frames` frames.
+    pub(crate) fn process_interleaved(
+        &self,
+        samples: &mut [f32],
+        num_frames: usize,
+    ) -> Result<(), sdk::AicError> {
+        let mut processor = self.lock();
+        let num_channels = samples.len() / num_frames.max(1);
+        self.run(
+            &mut processor,
+            AudioBlock::Interleaved {
+                samples,
+                num_channels,
+            },
+        )
+    }
+
+    /// Runs one process call on the locked `processor`, recording its statistics and
+    /// checking it against the real-time budget. While a model swap is in progress, the
+    /// incoming model runs on the same block and is crossfaded in. With signal metrics
+    /// enabled, the levels of the block are measured before and after, outside the timing.
+    pub(crate) fn run(
+        &self,
+        processor: &mut sdk::Processor<'static>,
+        mut block: AudioBlock,
+    ) -> Result<(), sdk::AicError> {
+        let num_frames = block.num_frames();
+        let input_levels = self.stats.levels.is_enabled().then(|| {
+            let _span = trace::span_with_frames("signalLevels", num_frames);
+            block.levels()
+        });
+        let shedding = self
+            .budget
+            .lock()
+            .unwrap()
+            .as_ref()
+            .is_some_and(RealtimeBudget::is_shedding);
+        if !shedding {
+            self.automation.apply(processor, num_frames);
+        }
+        let mut swap = self
+            .swap_active
+            .load(Ordering::Acquire)
+            .then(|| self.swap.lock().unwrap());
+
+        let start = Instant::now();
+        if let Some(swap) = swap.as_mut() {
+            swap.begin(&mut block);
+        }
+        let result = {
+            let _span = trace::span_with_frames("sdk.process", num_frames);
+            block.process(processor)
+        };
+        if let Some(swap) = swap.as_mut() {
+            if result.is_ok() {
+                let _span = trace::span_with_frames("modelSwap", num_frames);
+                swap.finish(processor, &mut block);
+            }
+            self.swap_active.store(swap.is_active(), Ordering::Release);
+        }
+        drop(swap);
+        let elapsed = start.elapsed();
+
+        self.stats.record(num_frames, elapsed, &result);
+        if result.is_ok() {
+            self.automation.advance(num_frames);
+        }
+        if let (Some(input_levels), Ok(())) = (input_levels, &result) {
+            let _span = trace::span_with_frames("signalLevels", num_frames);
+            self.stats.levels.record(input_levels, block.levels());
+        }
+        if let Some(budget) = self.budget.lock().unwrap().as_mut() {
+            budget.observe(processor, num_frames, elapsed);
+        }
+        result
+    }
+}
+
 pub struct Processor {
-    inner: Arc<Mutex<aic_sdk::Processor<'static>>>,
+    pub(crate) inner: Arc<SharedProcessor>,
+    /// Aligned staging area for byte buffers whose offset is not a multiple of 4.
+    /// Sized in `initialize` so the unaligned path does not allocate per call.
+    scratch: Mutex<Vec<f32>>,
+    config: Mutex<Option<StreamConfig>>,
+    /// Trimming state of the output delay for the process methods. Lock after `inner`.
+    compensation: Mutex<DelayCompensation>,
+    ring_worker: Mutex<Option<RingWorker>>,
+    /// Gain, limiter and PCM packing after the process methods. Lock after `compensation`.
+    post_process: Mutex<Option<PostProcess>>,
 }
 
 impl Finalize for Processor {
     fn finalize<'a, C: neon::prelude::Context<'a>>(self, _: &mut C) {}
 }
 
-fn parse_otel_config(
+/// Audio configuration the processor was last initialized with.
+#[derive(Clone, Copy)]
+pub(crate) struct StreamConfig {
+    pub(crate) sample_rate: u32,
+    pub(crate) num_channels: usize,
+    pub(crate) num_frames: usize,
+    pub(crate) allow_variable_frames: bool,
+}
+
+/// Native thread moving audio from an input ring through the processor into an output ring.
+pub(crate) struct RingWorker {
+    stop: Arc<AtomicBool>,
+    input: Arc<RingMemory>,
+    output: Arc<RingMemory>,
+    thread: Option<JoinHandle<Result<(), sdk::AicError>>>,
+    /// Error the thread stopped with, kept from when it is joined until `join` returns it.
+    error: Option<sdk::AicError>,
+}
+
+impl RingWorker {
+    /// How long the worker sleeps on a ring before re-checking the stop flag.
+    const POLL_INTERVAL: Duration = Duration::from_millis(20);
+
+    /// Starts the worker thread and waits until it has applied `settings` to itself. With a
+    /// `waker`, JavaScript threads waiting on the rings are notified when blocks move.
+    pub(crate) fn spawn(
+        processor: Arc<SharedProcessor>,
+        config: StreamConfig,
+        input: Arc<RingMemory>,
+        output: Arc<RingMemory>,
+        settings: ThreadSettings,
+        waker: Option<JsWaker>,
+    ) -> (RingWorker, ThreadReport) {
+        let stop = Arc::new(AtomicBool::new(false));
+        let (report_sender, report_receiver) = std::sync::mpsc::sync_channel(1);
+
+        let thread = {
+            let stop = stop.clone();
+            let input = input.clone();
+            let output = output.clone();
+            std::thread::Builder::new()
+                .name("aic-ring-worker".into())
+                .spawn(move || {
+                    let _ = report_sender.send(settings.apply());
+                    let mut scratch = vec![0.0; config.num_channels * config.num_frames];
+                    while !stop.load(Ordering::Acquire) {
+                        if !input.wait_available(config.num_frames, Self::POLL_INTERVAL)
+                            || !output.wait_free(config.num_frames, Self::POLL_INTERVAL)
+                        {
+                            continue;
+                        }
+                        let pumped =
+                            pump_ring_blocks(&processor, config, &input, &output, &mut scratch);
+                        // Blocks before a failed one may have moved as well
+                        if let Some(waker) = &waker {
+                            waker.wake();
+                        }
+                        pumped?;
+                    }
+                    Ok(())
+                })
+                .expect("Ring worker thread can be spawned")
+        };
+
+        let report = report_receiver
+            .recv()
+            .expect("Ring worker reports its thread settings");
+        let worker = RingWorker {
+            stop,
+            input,
+            output,
+            thread: Some(thread),
+            error: None,
+        };
+        (worker, report)
+    }
+
+    /// Returns the error the thread stopped with once processing has failed. The block that
+    /// failed stays in the input ring.
+    pub(crate) fn error(&mut self) -> Option<&sdk::AicError> {
+        if self.thread.as_ref().is_some_and(JoinHandle::is_finished) {
+            self.reap();
+        }
+        self.error.as_ref()
+    }
+
+    fn reap(&mut self) {
+        let Some(thread) = self.thread.take() else {
+            return;
+        };
+        if let Err(e) = thread.join().expect("Ring worker thread does not panic") {
+            self.error = Some(e);
+        }
+    }
+
+    fn join(&mut self) -> Result<(), sdk::AicError> {
+        self.stop.store(true, Ordering::Release);
+        self.input.wake_all();
+        self.output.wake_all();
+        self.reap();
+        match self.error.take() {
+            Some(e) => Err(e),
+            None => Ok(()),
+        }
+    }
+}
+
+impl Drop for RingWorker {
+    fn drop(&mut self) {
+        let _ = self.join();
+    }
+}
+
+/// Moves all complete blocks from `input` through the processor into `output`, as long as
+/// `output` has room for them. Returns the number of frames processed.
+///
+/// Blocks that are contiguous in the input ring are enhanced in place in shared memory and
+/// copied once into the output ring. Blocks that wrap around are staged in `scratch`. A block
+/// that fails to process is neither written to `output` nor consumed from `input`.
+fn pump_ring_blocks(
+    processor: &SharedProcessor,
+    config: StreamConfig,
+    input: &RingMemory,
+    output: &RingMemory,
+    scratch: &mut Vec<f32>,
+) -> Result<usize, sdk::AicError> {
+    let block = config.num_frames;
+    let mut processed = 0;
+
+    while input.available() >= block && output.free() >= block {
+        // SAFETY: The ring worker or the calling JS thread is the only consumer of `input` and
+        // the only producer of `output`, and `block` frames are available.
+        match unsafe { input.contiguous_read_slice(block) } {
+            Some(samples) => {
+                processor.process_interleaved(samples, block)?;
+                unsafe { output.write(&RawSamples::from_slice(samples)) };
+            }
+            None => {
+                let staged = staging_area(scratch, block * config.num_channels);
+                unsafe { input.peek(&RawSamples::from_slice(staged)) };
+                processor.process_interleaved(staged, block)?;
+                unsafe { output.write(&RawSamples::from_slice(staged)) };
+            }
+        }
+        input.consume(block);
+        processed += block;
+    }
+
+    Ok(processed)
+}
+
+pub(crate) fn parse_otel_config(
     cx: &mut FunctionContext,
     value: Handle<JsValue>,
-) -> NeonResult<Option<aic_sdk::OtelConfig>> {
+) -> NeonResult<Option<sdk::OtelConfig>> {
     if value.is_a::<JsUndefined, _>(cx) || value.is_a::<JsNull, _>(cx) {
         return Ok(None);
     }
@@ -56,7 +400,7 @@ fn parse_otel_config(
             .value(cx) as u32
     };
 
-    Ok(Some(aic_sdk::OtelConfig {
+    Ok(Some(sdk::OtelConfig {
         enable,
         session_id,
         export_interval_ms,
@@ -72,34 +416,59 @@ impl Processor {
             None => None,
         };
 
-        // SAFETY: This function has no safety requirements.
-        unsafe {
-            aic_sdk::set_sdk_id(4);
-        }
-
-        let processor = match &otel_config {
-            Some(otel_config) => {
-                aic_sdk::Processor::with_otel_config(&model.inner, &license_key, otel_config)
-            }
-            None => aic_sdk::Processor::new(&model.inner, &license_key),
-        }
-        .or_else(|e| cx.throw_error(e.to_string()))?;
+        let inner = SharedProcessor::new(&model.inner, &license_key, otel_config.as_ref())
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
 
         Ok(cx.boxed(Processor {
-            inner: Arc::new(Mutex::new(processor)),
+            inner: Arc::new(inner),
+            scratch: Mutex::new(Vec::new()),
+            config: Mutex::new(None),
+            compensation: Mutex::new(DelayCompensation::DISABLED),
+            ring_worker: Mutex::new(None),
+            post_process: Mutex::new(None),
         }))
     }
 
+    /// Wraps a processor that was already initialized with `config`, e.g. on a worker
+    /// thread, in the state `initialize` leaves it in.
+    pub(crate) fn initialized(
+        inner: SharedProcessor,
+        config: StreamConfig,
+        compensate_delay: bool,
+    ) -> Processor {
+        let output_delay = inner.lock().processor_context().output_delay();
+        Processor {
+            inner: Arc::new(inner),
+            scratch: Mutex::new(vec![0.0; config.num_channels * config.num_frames]),
+            config: Mutex::new(Some(config)),
+            compensation: Mutex::new(DelayCompensation::new(compensate_delay, output_delay)),
+            ring_worker: Mutex::new(None),
+            post_process: Mutex::new(None),
+        }
+    }
+
     pub fn initialize(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let _span = trace::span("Processor.initialize");
         let this = cx.argument::<JsBox<Processor>>(0)?;
         let sample_rate = cx.argument::<JsNumber>(1)?.value(&mut cx) as u32;
         let num_channels = cx.argument::<JsNumber>(2)?.value(&mut cx) as u16;
         let num_frames = cx.argument::<JsNumber>(3)?.value(&mut cx) as usize;
         let allow_variable_frames = cx.argument::<JsBoolean>(4)?.value(&mut cx);
+        let compensate_delay = match cx.argument_opt(5) {
+            Some(value) => value
+                .downcast_or_throw::<JsBoolean, _>(&mut cx)?
+                .value(&mut cx),
+            None => false,
+        };
 
-        let mut processor = this.inner.lock().unwrap();
+        // The worker pumps blocks with the config it was started with
+        if this.ring_worker.lock().unwrap().is_some() {
+            return cx.throw_error("Stop the ring worker before initializing the processor again");
+        }
+
+        let mut processor = this.inner.lock();
 
-        let config = aic_sdk::ProcessorConfig {
+        let config = sdk::ProcessorConfig {
             sample_rate,
             num_channels,
             num_frames,
@@ -108,46 +477,178 @@ impl Processor {
 
         processor
             .initialize(&config)
-            .or_else(|e| cx.throw_error(e.to_string()))?;
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
+
+        let mut scratch = this.scratch.lock().unwrap();
+        scratch.clear();
+        scratch.resize(num_channels as usize * num_frames, 0.0);
+
+        *this.config.lock().unwrap() = Some(StreamConfig {
+            sample_rate,
+            num_channels: num_channels as usize,
+            num_frames,
+            allow_variable_frames,
+        });
+
+        this.inner.automation.clear();
+
+        let mut swap = this.inner.swap.lock().unwrap();
+        swap.restart();
+        this.inner.swap_active.store(false, Ordering::Release);
+        drop(swap);
+
+        let output_delay = processor.processor_context().output_delay();
+        *this.compensation.lock().unwrap() = DelayCompensation::new(compensate_delay, output_delay);
+
+        if let Some(budget) = this.inner.budget.lock().unwrap().as_mut() {
+            budget.restart(&processor, sample_rate);
+        }
 
         Ok(cx.undefined())
     }
 
-    pub fn process_interleaved(mut cx: FunctionContext) -> JsResult<JsUndefined> {
-        let this = cx.argument::<JsBox<Processor>>(0)?;
-        let mut buffer = cx.argument::<JsTypedArray<f32>>(1)?;
+    /// Returns the configuration from the last successful `initialize` call.
+    pub(crate) fn stream_config(&self) -> Option<StreamConfig> {
+        *self.config.lock().unwrap()
+    }
 
-        let mut processor = this.inner.lock().unwrap();
+    /// Returns the delay compensation state for a new stream, e.g. for an accumulator.
+    pub(crate) fn delay_compensation(&self) -> DelayCompensation {
+        let mut compensation = *self.compensation.lock().unwrap();
+        compensation.restart();
+        compensation
+    }
 
-        let audio_data = buffer.as_mut_slice(&mut cx);
+    fn num_channels(&self) -> usize {
+        self.stream_config().map_or(1, |config| config.num_channels)
+    }
 
-        processor
-            .process_interleaved(audio_data)
-            .or_else(|e| cx.throw_error(e.to_string()))?;
+    /// Drops the part of the leading output delay that falls into a processed block of
+    /// `num_frames` frames. Returns the number of valid frames at the front of the block.
+    fn compensate(&self, num_frames: usize, trim_block: impl FnOnce(usize) -> usize) -> usize {
+        let _span = trace::span("compensateDelay");
+        let trim = self.compensation.lock().unwrap().take_trim(num_frames);
+        trim_block(trim)
+    }
 
-        Ok(cx.undefined())
+    /// Runs the post-processing stage, if set, on the `valid_frames` frames at the front of a
+    /// processed block.
+    fn post_process<'a>(&self, cx: &mut impl Context<'a>, block: AudioBlock, valid_frames: usize) {
+        if let Some(post_process) = self.post_process.lock().unwrap().as_mut() {
+            let _span = trace::span_with_frames("postProcess", valid_frames);
+            post_process.apply(cx, block, valid_frames);
+        }
+    }
+
+    /// Runs `process` on the samples of a contiguous (interleaved or sequential) buffer.
+    ///
+    /// Aligned buffers are processed in place. Unaligned byte views are staged through the
+    /// scratch buffer and copied back afterwards.
+    fn with_samples<R>(&self, samples: RawSamples, process: impl FnOnce(&mut [f32]) -> R) -> R {
+        if samples.is_aligned() {
+            // SAFETY: The buffer handle is rooted for the duration of the native call and no
+            // JavaScript runs while the slice is in use.
+            return process(unsafe { samples.as_mut_slice() });
+        }
+
+        let _span = trace::span("stageUnaligned");
+        let mut scratch = self.scratch.lock().unwrap();
+        let staged = staging_area(&mut scratch, samples.len);
+
+        // SAFETY: See above. `staged` has exactly `samples.len` elements.
+        unsafe { samples.load(staged) };
+        let result = process(staged);
+        unsafe { samples.store(staged) };
+
+        result
     }
 
-    pub fn process_sequential(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+    pub fn process_interleaved(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let _span = trace::span("Processor.processInterleaved");
         let this = cx.argument::<JsBox<Processor>>(0)?;
-        let mut buffer = cx.argument::<JsTypedArray<f32>>(1)?;
+        let samples = {
+            let _span = trace::span("convertArguments");
+            let buffer = cx.argument::<JsValue>(1)?;
+            RawSamples::from_value(&mut cx, buffer)?
+        };
+        let num_channels = this.num_channels();
 
-        let mut processor = this.inner.lock().unwrap();
+        let mut processor = this.inner.lock();
 
-        let audio_data = buffer.as_mut_slice(&mut cx);
+        let valid_frames = this
+            .with_samples(samples, |audio_data| {
+                let num_frames = audio_data.len() / num_channels;
+                this.inner.run(
+                    &mut processor,
+                    AudioBlock::Interleaved {
+                        samples: audio_data,
+                        num_channels,
+                    },
+                )?;
+                let valid_frames = this.compensate(num_frames, |trim| {
+                    trim_interleaved(audio_data, num_channels, trim)
+                });
+                this.post_process(
+                    &mut cx,
+                    AudioBlock::Interleaved {
+                        samples: audio_data,
+                        num_channels,
+                    },
+                    valid_frames,
+                );
+                Ok(valid_frames)
+            })
+            .or_else(|e: sdk::AicError| throw_aic_error(&mut cx, &e))?;
 
-        processor
-            .process_sequential(audio_data)
-            .or_else(|e| cx.throw_error(e.to_string()))?;
+        Ok(cx.number(valid_frames as f64))
+    }
 
-        Ok(cx.undefined())
+    pub fn process_sequential(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let _span = trace::span("Processor.processSequential");
+        let this = cx.argument::<JsBox<Processor>>(0)?;
+        let samples = {
+            let _span = trace::span("convertArguments");
+            let buffer = cx.argument::<JsValue>(1)?;
+            RawSamples::from_value(&mut cx, buffer)?
+        };
+        let num_channels = this.num_channels();
+
+        let mut processor = this.inner.lock();
+
+        let valid_frames = this
+            .with_samples(samples, |audio_data| {
+                let num_frames = audio_data.len() / num_channels;
+                this.inner.run(
+                    &mut processor,
+                    AudioBlock::Sequential {
+                        samples: audio_data,
+                        num_channels,
+                    },
+                )?;
+                let valid_frames = this.compensate(num_frames, |trim| {
+                    trim_sequential(audio_data, num_channels, trim)
+                });
+                this.post_process(
+                    &mut cx,
+                    AudioBlock::Sequential {
+                        samples: audio_data,
+                        num_channels,
+                    },
+                    valid_frames,
+                );
+                Ok(valid_frames)
+            })
+            .or_else(|e: sdk::AicError| throw_aic_error(&mut cx, &e))?;
+
+        Ok(cx.number(valid_frames as f64))
     }
 
-    pub fn process_planar(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+    pub fn process_planar(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let _span = trace::span("Processor.processPlanar");
         let this = cx.argument::<JsBox<Processor>>(0)?;
         let buffers = cx.argument::<JsArray>(1)?;
 
-        let mut processor = this.inner.lock().unwrap();
+        let mut processor = this.inner.lock();
 
         let length = buffers.len(&mut cx);
 
@@ -156,59 +657,437 @@ impl Processor {
         }
 
         // Use fixed-size arrays to avoid heap allocation
-        let mut handles: [Option<Handle<JsTypedArray<f32>>>; 16] = Default::default();
+        let mut channels = [RawSamples::EMPTY; 16];
+        let mut num_unaligned_samples = 0;
 
-        for i in 0..length {
-            let buffer: Handle<JsTypedArray<f32>> = buffers.get(&mut cx, i)?;
-            handles[i as usize] = Some(buffer);
+        {
+            let _span = trace::span("convertArguments");
+            for i in 0..length {
+                let buffer: Handle<JsValue> = buffers.get(&mut cx, i)?;
+                let samples = RawSamples::from_value(&mut cx, buffer)?;
+                if !samples.is_aligned() {
+                    num_unaligned_samples += samples.len;
+                }
+                channels[i as usize] = samples;
+            }
         }
+        let channels = &channels[..length as usize];
+
+        // Unaligned channels are staged back to back in the scratch buffer
+        let mut scratch = if num_unaligned_samples > 0 {
+            Some(this.scratch.lock().unwrap())
+        } else {
+            None
+        };
+        let mut staging: &mut [f32] = match scratch.as_mut() {
+            Some(scratch) => staging_area(scratch, num_unaligned_samples),
+            None => &mut [],
+        };
 
-        // Create a fixed-size array of mutable slice pointers
+        // Create a fixed-size array of mutable slices
         // SAFETY: We use unsafe here because Neon's borrow checker doesn't allow
         // getting multiple mutable slices at once, but we know:
         // 1. Each handle refers to a different JavaScript typed array
         // 2. The slices don't overlap
         // 3. The handles keep the buffers alive for the duration of this function
-        let mut slice_array: [&mut [f32]; 16] = unsafe {
-            let cx_ptr = &mut cx as *mut FunctionContext;
-            let mut arr: [std::mem::MaybeUninit<&mut [f32]>; 16] =
-                std::mem::MaybeUninit::uninit().assume_init();
-
-            for i in 0..length as usize {
-                if let Some(ref mut handle) = handles[i] {
-                    let slice = handle.as_mut_slice(&mut *cx_ptr);
-                    arr[i] = std::mem::MaybeUninit::new(slice);
-                }
+        let mut slice_array: [&mut [f32]; 16] = Default::default();
+
+        for (slice, samples) in slice_array.iter_mut().zip(channels) {
+            if samples.is_aligned() {
+                *slice = unsafe { samples.as_mut_slice() };
+            } else {
+                let (staged, rest) = std::mem::take(&mut staging).split_at_mut(samples.len);
+                unsafe { samples.load(staged) };
+                *slice = staged;
+                staging = rest;
             }
+        }
+
+        let slice_refs = &mut slice_array[..length as usize];
 
-            std::mem::transmute(arr)
+        let num_frames = slice_refs.first().map_or(0, |slice| slice.len());
+        let result = this
+            .inner
+            .run(&mut processor, AudioBlock::Planar(slice_refs))
+            .map(|()| {
+                let valid_frames = this.compensate(num_frames, |trim| {
+                    for slice in slice_refs.iter_mut() {
+                        trim_sequential(slice, 1, trim);
+                    }
+                    num_frames - trim
+                });
+                this.post_process(&mut cx, AudioBlock::Planar(slice_refs), valid_frames);
+                valid_frames
+            });
+
+        for (slice, samples) in slice_refs.iter().zip(channels) {
+            if !samples.is_aligned() {
+                unsafe { samples.store(slice) };
+            }
+        }
+
+        let valid_frames = result.or_else(|e| throw_aic_error(&mut cx, &e))?;
+
+        Ok(cx.number(valid_frames as f64))
+    }
+
+    /// Feeds silence through the processor until the audio held back by the output delay has
+    /// come out, and returns it as interleaved float32 bytes. Afterwards the next processed
+    /// audio is treated as the start of a new stream.
+    pub fn flush(mut cx: FunctionContext) -> JsResult<JsBuffer> {
+        let _span = trace::span("Processor.flush");
+        let this = cx.argument::<JsBox<Processor>>(0)?;
+        let Some(config) = this.stream_config() else {
+            return cx.throw_error("Processor is not initialized");
         };
+        let num_channels = config.num_channels;
 
-        let slice_refs = &mut slice_array[..length as usize];
+        let mut processor = this.inner.lock();
+        let mut compensation = this.compensation.lock().unwrap();
 
-        processor
-            .process_planar(slice_refs)
-            .or_else(|e| cx.throw_error(e.to_string()))?;
+        let output_delay = this.inner.output_delay(&processor);
+        let mut tail = Vec::with_capacity(output_delay * num_channels);
+        let mut block = vec![0.0; config.num_frames * num_channels];
+        let mut remaining = output_delay;
 
+        while remaining > 0 {
+            block.fill(0.0);
+            this.inner
+                .run(
+                    &mut processor,
+                    AudioBlock::Interleaved {
+                        samples: &mut block,
+                        num_channels,
+                    },
+                )
+                .or_else(|e| throw_aic_error(&mut cx, &e))?;
+
+            let num_frames = remaining.min(config.num_frames);
+            remaining -= num_frames;
+            let trim = compensation.take_trim(num_frames);
+            tail.extend_from_slice(&block[trim * num_channels..num_frames * num_channels]);
+        }
+        compensation.restart();
+
+        let tail_frames = tail.len() / num_channels;
+        this.post_process(
+            &mut cx,
+            AudioBlock::Interleaved {
+                samples: &mut tail,
+                num_channels,
+            },
+            tail_frames,
+        );
+
+        JsBuffer::from_slice(&mut cx, sample_bytes(&tail))
+    }
+
+    /// Returns the number of frames the next `flush` returns at most: the output delay.
+    pub fn flush_frames(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let this = cx.argument::<JsBox<Processor>>(0)?;
+        let processor = this.inner.lock();
+        let output_delay = this.inner.output_delay(&processor);
+        Ok(cx.number(output_delay as f64))
+    }
+
+    pub fn get_stats(mut cx: FunctionContext) -> JsResult<JsObject> {
+        let this = cx.argument::<JsBox<Processor>>(0)?;
+        this.check_ring_worker(&mut cx)?;
+        let stats = this.inner.stats.to_object(&mut cx)?;
+        if let Some(budget) = this.inner.budget.lock().unwrap().as_ref() {
+            let realtime = budget.to_object(&mut cx)?;
+            stats.set(&mut cx, "realtime", realtime)?;
+        }
+        Ok(stats)
+    }
+
+    pub fn reset_stats(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let this = cx.argument::<JsBox<Processor>>(0)?;
+        this.inner.stats.reset();
+        if let Some(budget) = this.inner.budget.lock().unwrap().as_mut() {
+            budget.reset_counters();
+        }
         Ok(cx.undefined())
     }
 
-    pub fn get_processor_context(mut cx: FunctionContext) -> JsResult<JsBox<ProcessorContext>> {
+    /// Turns the measurement of input and output signal levels on every process call on or
+    /// off. Argument 1 is the new state.
+    pub fn set_signal_metrics(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let this = cx.argument::<JsBox<Processor>>(0)?;
+        let enabled = cx.argument::<JsBoolean>(1)?.value(&mut cx);
+        this.inner.stats.levels.set_enabled(enabled);
+        Ok(cx.undefined())
+    }
+
+    /// Sets or, with `null` options, removes the real-time budget. Removing it restores the
+    /// parameters that were in effect before shedding started.
+    pub fn set_realtime_budget(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let this = cx.argument::<JsBox<Processor>>(0)?;
+        let options = cx.argument::<JsValue>(1)?;
+
+        let budget =
+            if options.is_a::<JsNull, _>(&mut cx) || options.is_a::<JsUndefined, _>(&mut cx) {
+                None
+            } else {
+                let Some(config) = this.stream_config() else {
+                    return cx.throw_error("Processor must be initialized before setting a budget");
+                };
+                let options = options.downcast_or_throw::<JsObject, _>(&mut cx)?;
+                let callback = cx.argument::<JsFunction>(2)?;
+                Some(RealtimeBudget::from_options(
+                    &mut cx,
+                    options,
+                    callback,
+                    config.sample_rate,
+                )?)
+            };
+
+        let processor = this.inner.lock();
+        let mut current = this.inner.budget.lock().unwrap();
+        if let Some(previous) = current.as_mut() {
+            previous.restore(&processor);
+        }
+        *current = budget;
+
+        Ok(cx.undefined())
+    }
+
+    /// Sets or, with `null` options, removes the post-processing stage of the process methods
+    /// and `flush`. Arguments: `{ gain, limiterThreshold }`, the Float64Array status buffer,
+    /// and an Int16Array for the packed PCM output or `null`.
+    pub fn set_post_process(mut cx: FunctionContext) -> JsResult<JsUndefined> {
         let this = cx.argument::<JsBox<Processor>>(0)?;
-        let processor = this.inner.lock().unwrap();
+        let options = cx.argument::<JsValue>(1)?;
+        if this.ring_worker.lock().unwrap().is_some() {
+            return cx.throw_error("Stop the ring worker before setting a post-process stage");
+        }
+
+        let post_process =
+            if options.is_a::<JsNull, _>(&mut cx) || options.is_a::<JsUndefined, _>(&mut cx) {
+                None
+            } else {
+                let Some(config) = this.stream_config() else {
+                    return cx.throw_error(
+                        "Processor must be initialized before setting a post-process stage",
+                    );
+                };
+                let options = options.downcast_or_throw::<JsObject, _>(&mut cx)?;
+                let status = cx.argument::<JsTypedArray<f64>>(2)?;
+                let pcm16 = cx.argument::<JsValue>(3)?;
+                Some(PostProcess::from_options(
+                    &mut cx,
+                    options,
+                    status,
+                    pcm16,
+                    config.num_frames * config.num_channels,
+                )?)
+            };
 
-        let context = processor.processor_context();
+        this.inner
+            .post_process_set
+            .store(post_process.is_some(), Ordering::Relaxed);
+        *this.post_process.lock().unwrap() = post_process;
 
-        Ok(cx.boxed(ProcessorContext { inner: context }))
+        Ok(cx.undefined())
+    }
+
+    /// Resolves the input and output ring arguments and checks them against the configuration.
+    fn ring_arguments(
+        &self,
+        cx: &mut FunctionContext,
+    ) -> NeonResult<(StreamConfig, Arc<RingMemory>, Arc<RingMemory>)> {
+        let input = cx.argument::<JsValue>(1)?;
+        let input = audio_ring_argument(cx, input)?;
+        let output = cx.argument::<JsValue>(2)?;
+        let output = audio_ring_argument(cx, output)?;
+
+        let Some(config) = self.stream_config() else {
+            return cx.throw_error("Processor must be initialized before processing rings");
+        };
+        if input.num_channels() != config.num_channels
+            || output.num_channels() != config.num_channels
+        {
+            return cx.throw_error("AudioRing channel count does not match the processor");
+        }
+
+        Ok((config, input, output))
+    }
+
+    /// Throws the error the ring worker stopped with, until `stop_ring_worker` clears it.
+    fn check_ring_worker(&self, cx: &mut FunctionContext) -> NeonResult<()> {
+        let mut ring_worker = self.ring_worker.lock().unwrap();
+        match ring_worker.as_mut().and_then(RingWorker::error) {
+            Some(e) => throw_aic_error(cx, e),
+            None => Ok(()),
+        }
+    }
+
+    pub fn process_ring(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let _span = trace::span("Processor.processRing");
+        let this = cx.argument::<JsBox<Processor>>(0)?;
+        let (config, input, output) = this.ring_arguments(&mut cx)?;
+        this.inner.check_no_post_process(&mut cx)?;
+
+        this.check_ring_worker(&mut cx)?;
+        if this.ring_worker.lock().unwrap().is_some() {
+            return cx.throw_error("A ring worker is already consuming from this processor");
+        }
+
+        let mut scratch = this.scratch.lock().unwrap();
+        let processed = pump_ring_blocks(&this.inner, config, &input, &output, &mut scratch)
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
+
+        Ok(cx.number(processed as f64))
+    }
+
+    /// Starts a ring worker. Arguments: input and output rings, and the thread options.
+    /// Returns the thread settings in effect, see `ThreadReport`.
+    pub fn start_ring_worker(mut cx: FunctionContext) -> JsResult<JsObject> {
+        let this = cx.argument::<JsBox<Processor>>(0)?;
+        let (config, input, output) = this.ring_arguments(&mut cx)?;
+        this.inner.check_no_post_process(&mut cx)?;
+        let settings = match cx.argument_opt(3) {
+            Some(value) => ThreadSettings::from_js(&mut cx, value)?,
+            None => ThreadSettings::default(),
+        };
+
+        let mut ring_worker = this.ring_worker.lock().unwrap();
+        if ring_worker.is_some() {
+            return cx.throw_error("A ring worker is already running for this processor");
+        }
+        let waker = JsWaker::new(&mut cx, &[&input, &output]);
+
+        let (worker, report) =
+            RingWorker::spawn(this.inner.clone(), config, input, output, settings, waker);
+        *ring_worker = Some(worker);
+
+        report.to_js(&mut cx)
+    }
+
+    pub fn stop_ring_worker(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let this = cx.argument::<JsBox<Processor>>(0)?;
+        let worker = this.ring_worker.lock().unwrap().take();
+
+        if let Some(mut worker) = worker {
+            worker.join().or_else(|e| throw_aic_error(&mut cx, &e))?;
+        }
+
+        Ok(cx.undefined())
+    }
+
+    /// Replaces the model on the live stream. Arguments: model, license key, OpenTelemetry
+    /// config, warm-up and crossfade durations in milliseconds, and a callback called with
+    /// `(error)` or `(null, { outputDelay })` once the new model has taken over.
+    ///
+    /// The SDK processor is created here, since the model cannot leave the JavaScript thread,
+    /// and initialized on a background thread. The audio path then warms it up and
+    /// crossfades to it, see `ModelSwap`.
+    pub fn swap_model(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let this = cx.argument::<JsBox<Processor>>(0)?;
+        let model = cx.argument::<JsBox<Model>>(1)?;
+        let license_key = cx.argument::<JsString>(2)?.value(&mut cx);
+        let otel_value = cx.argument::<JsValue>(3)?;
+        let otel_config = parse_otel_config(&mut cx, otel_value)?;
+        let warmup_ms = cx.argument::<JsNumber>(4)?.value(&mut cx);
+        let crossfade_ms = cx.argument::<JsNumber>(5)?.value(&mut cx);
+        let callback = cx.argument::<JsFunction>(6)?;
+
+        let Some(config) = this.stream_config() else {
+            return cx.throw_error("Processor is not initialized");
+        };
+        if !(warmup_ms >= 0.0 && crossfade_ms >= 0.0) {
+            return cx.throw_range_error("Warm-up and crossfade durations must be at least 0");
+        }
+        let to_frames = |ms: f64| (ms * 1e-3 * f64::from(config.sample_rate)).round() as usize;
+        let warmup_frames = to_frames(warmup_ms);
+        let crossfade_frames = to_frames(crossfade_ms);
+
+        let mut next = new_sdk_processor(&model.inner, &license_key, otel_config.as_ref())
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
+
+        let Some(generation) = this.inner.swap.lock().unwrap().reserve() else {
+            return cx.throw_error("A model swap is already in progress");
+        };
+        let (processor_context, vad_context) = {
+            let processor = this.inner.lock();
+            (processor.processor_context(), processor.vad_context())
+        };
+
+        let mut channel = cx.channel();
+        channel.unref(&mut cx);
+        let callback = SwapCallback::new(channel, callback.root(&mut cx));
+        let shared = this.inner.clone();
+
+        std::thread::Builder::new()
+            .name("aic-model-swap".into())
+            .spawn(move || {
+                let prepared = next.initialize(&sdk::ProcessorConfig {
+                    sample_rate: config.sample_rate,
+                    num_channels: config.num_channels as u16,
+                    num_frames: config.num_frames,
+                    allow_variable_frames: config.allow_variable_frames,
+                });
+
+                let mut swap = shared.swap.lock().unwrap();
+                match prepared {
+                    Ok(()) => {
+                        copy_context_parameters(&processor_context, &vad_context, &next);
+                        let current_delay =
+                            processor_context.output_delay() + swap.alignment_delay();
+                        let pending = PendingSwap::new(
+                            next,
+                            config.num_channels,
+                            config.num_frames,
+                            current_delay,
+                            warmup_frames,
+                            crossfade_frames,
+                            callback,
+                        );
+                        swap.install(generation, pending);
+                        shared
+                            .swap_active
+                            .store(swap.is_active(), Ordering::Release);
+                    }
+                    Err(e) => swap.fail(generation, callback, e.to_string()),
+                }
+            })
+            .expect("Model swap thread can be spawned");
+
+        Ok(cx.undefined())
+    }
+
+    pub fn get_processor_context(mut cx: FunctionContext) -> JsResult<JsBox<ProcessorContext>> {
+        let this = cx.argument::<JsBox<Processor>>(0)?;
+        Ok(cx.boxed(ProcessorContext {
+            processor: this.inner.clone(),
+        }))
     }
 
     pub fn get_vad_context(mut cx: FunctionContext) -> JsResult<JsBox<VadContext>> {
         let this = cx.argument::<JsBox<Processor>>(0)?;
-        let processor = this.inner.lock().unwrap();
+        Ok(cx.boxed(VadContext {
+            processor: this.inner.clone(),
+        }))
+    }
 
-        let context = processor.vad_context();
+    /// Registers the processor under the session ID passed as argument 1, so that
+    /// `processorContextFromSession` and `vadContextFromSession` find it from any thread.
+    pub fn register_session(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let this = cx.argument::<JsBox<Processor>>(0)?;
+        let id = cx.argument::<JsString>(1)?.value(&mut cx);
+        if let Err(message) = session::register(&id, &this.inner) {
+            return cx.throw_error(message);
+        }
+        Ok(cx.undefined())
+    }
 
-        Ok(cx.boxed(VadContext { inner: context }))
+    /// Removes the registration of the session ID passed as argument 1, if it refers to
+    /// this processor.
+    pub fn unregister_session(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let this = cx.argument::<JsBox<Processor>>(0)?;
+        let id = cx.argument::<JsString>(1)?.value(&mut cx);
+        session::unregister(&id, &this.inner);
+        Ok(cx.undefined())
     }
 }
 
@@ -221,11 +1100,24 @@ pub fn register_exports(cx: &mut neon::prelude::ModuleContext) -> NeonResult<()>
     )?;
     cx.export_function("processorProcessSequential", Processor::process_sequential)?;
     cx.export_function("processorProcessPlanar", Processor::process_planar)?;
+    cx.export_function("processorFlush", Processor::flush)?;
+    cx.export_function("processorFlushFrames", Processor::flush_frames)?;
+    cx.export_function("processorGetStats", Processor::get_stats)?;
+    cx.export_function("processorResetStats", Processor::reset_stats)?;
+    cx.export_function("processorSetSignalMetrics", Processor::set_signal_metrics)?;
+    cx.export_function("processorSetRealtimeBudget", Processor::set_realtime_budget)?;
+    cx.export_function("processorSetPostProcess", Processor::set_post_process)?;
+    cx.export_function("processorProcessRing", Processor::process_ring)?;
+    cx.export_function("processorStartRingWorker", Processor::start_ring_worker)?;
+    cx.export_function("processorStopRingWorker", Processor::stop_ring_worker)?;
     cx.export_function(
         "processorGetProcessorContext",
         Processor::get_processor_context,
     )?;
     cx.export_function("processorGetVadContext", Processor::get_vad_context)?;
+    cx.export_function("processorSwapModel", Processor::swap_model)?;
+    cx.export_function("processorRegisterSession", Processor::register_session)?;
+    cx.export_function("processorUnregisterSession", Processor::unregister_session)?;
 
     Ok(())
 }
@@ -1,3 +1,5 @@
+use std::sync::Arc;
+
 use neon::{
     handle::Handle,
     prelude::{Context, FunctionContext},
@@ -5,6 +7,12 @@ use neon::{
     types::{Finalize, JsBox, JsNumber, JsString, JsUndefined, JsValue},
 };
 
+use crate::error::throw_aic_error;
+use crate::processor::SharedProcessor;
+use crate::sdk;
+use crate::session;
+use crate::trace;
+
 // Processor parameter constants
 pub const PROCESSOR_PARAM_BYPASS: i32 = 0;
 pub const PROCESSOR_PARAM_ENHANCEMENT_LEVEL: i32 = 1;
@@ -12,18 +20,20 @@ pub const PROCESSOR_PARAM_ENHANCEMENT_LEVEL: i32 = 1;
 pub fn parse_processor_parameter(
     cx: &mut FunctionContext,
     value: Handle<JsValue>,
-) -> NeonResult<aic_sdk::ProcessorParameter> {
+) -> NeonResult<sdk::ProcessorParameter> {
     let param_num = value.downcast_or_throw::<JsNumber, _>(cx)?.value(cx) as i32;
 
     match param_num {
-        PROCESSOR_PARAM_BYPASS => Ok(aic_sdk::ProcessorParameter::Bypass),
-        PROCESSOR_PARAM_ENHANCEMENT_LEVEL => Ok(aic_sdk::ProcessorParameter::EnhancementLevel),
+        PROCESSOR_PARAM_BYPASS => Ok(sdk::ProcessorParameter::Bypass),
+        PROCESSOR_PARAM_ENHANCEMENT_LEVEL => Ok(sdk::ProcessorParameter::EnhancementLevel),
         _ => cx.throw_error(format!("Invalid processor parameter: {}", param_num)),
     }
 }
 
+/// Context of a processor. The SDK context is resolved on every call, so that it follows
+/// the processor through model swaps.
 pub struct ProcessorContext {
-    pub(crate) inner: aic_sdk::ProcessorContext,
+    pub(crate) processor: Arc<SharedProcessor>,
 }
 
 impl Finalize for ProcessorContext {
@@ -31,43 +41,88 @@ impl Finalize for ProcessorContext {
 }
 
 impl ProcessorContext {
+    /// Gets the context of the processor registered under the session ID passed as
+    /// argument 0. Callable from any worker thread.
+    pub fn from_session(mut cx: FunctionContext) -> JsResult<JsBox<ProcessorContext>> {
+        let id = cx.argument::<JsString>(0)?.value(&mut cx);
+        let processor = match session::lookup(&id) {
+            Ok(processor) => processor,
+            Err(message) => return cx.throw_error(message),
+        };
+        Ok(cx.boxed(ProcessorContext { processor }))
+    }
+
     pub fn reset(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let _span = trace::span("ProcessorContext.reset");
         let this = cx.argument::<JsBox<ProcessorContext>>(0)?;
-        this.inner
-            .reset()
-            .or_else(|e| cx.throw_error(e.to_string()))?;
+        this.processor
+            .with_processor_context(sdk::ProcessorContext::reset)
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
         Ok(cx.undefined())
     }
 
     pub fn set_parameter(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let _span = trace::span("ProcessorContext.setParameter");
         let this = cx.argument::<JsBox<ProcessorContext>>(0)?;
         let parameter_arg = cx.argument::<JsValue>(1)?;
         let parameter = parse_processor_parameter(&mut cx, parameter_arg)?;
         let value = cx.argument::<JsNumber>(2)?.value(&mut cx) as f32;
 
-        this.inner
-            .set_parameter(parameter, value)
-            .or_else(|e| cx.throw_error(e.to_string()))?;
+        this.processor
+            .with_processor_context(|context| context.set_parameter(parameter, value))
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
 
         Ok(cx.undefined())
     }
 
     pub fn get_parameter(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let _span = trace::span("ProcessorContext.getParameter");
         let this = cx.argument::<JsBox<ProcessorContext>>(0)?;
         let parameter_arg = cx.argument::<JsValue>(1)?;
         let parameter = parse_processor_parameter(&mut cx, parameter_arg)?;
 
         let value = this
-            .inner
-            .parameter(parameter)
-            .or_else(|e| cx.throw_error(e.to_string()))?;
+            .processor
+            .with_processor_context(|context| context.parameter(parameter))
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
 
         Ok(cx.number(value as f64))
     }
 
+    /// Schedules a parameter change at a frame of the stream. Arguments 1 to 4 are the
+    /// parameter, the target value, the frame to start at and the ramp length in frames.
+    pub fn schedule_parameter(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let this = cx.argument::<JsBox<ProcessorContext>>(0)?;
+        let parameter = cx.argument::<JsNumber>(1)?.value(&mut cx) as i32;
+        let value = cx.argument::<JsNumber>(2)?.value(&mut cx) as f32;
+        let at = cx.argument::<JsNumber>(3)?.value(&mut cx);
+        let ramp = cx.argument::<JsNumber>(4)?.value(&mut cx);
+        if !(at >= 0.0 && ramp >= 0.0 && at.fract() == 0.0 && ramp.fract() == 0.0) {
+            return cx.throw_range_error("Frame and ramp length must be integers of at least 0");
+        }
+
+        if let Err(message) =
+            this.processor
+                .automation
+                .schedule(parameter, value, at as u64, ramp as u64)
+        {
+            return cx.throw_error(message);
+        }
+        Ok(cx.undefined())
+    }
+
+    /// Returns the number of frames processed since the processor was initialized, the
+    /// position `schedule_parameter` counts in.
+    pub fn get_stream_position(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let this = cx.argument::<JsBox<ProcessorContext>>(0)?;
+        Ok(cx.number(this.processor.automation.position() as f64))
+    }
+
     pub fn get_output_delay(mut cx: FunctionContext) -> JsResult<JsNumber> {
         let this = cx.argument::<JsBox<ProcessorContext>>(0)?;
-        let delay = this.inner.output_delay();
+        let delay = this
+            .processor
+            .with_processor_context(sdk::ProcessorContext::output_delay);
         Ok(cx.number(delay as f64))
     }
 
@@ -75,15 +130,19 @@ impl ProcessorContext {
         let this = cx.argument::<JsBox<ProcessorContext>>(0)?;
         let token = cx.argument::<JsString>(1)?.value(&mut cx);
 
-        this.inner
-            .update_bearer_token(&token)
-            .or_else(|e| cx.throw_error(e.to_string()))?;
+        this.processor
+            .with_processor_context(|context| context.update_bearer_token(&token))
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
 
         Ok(cx.undefined())
     }
 }
 
 pub fn register_exports(cx: &mut neon::prelude::ModuleContext) -> NeonResult<()> {
+    cx.export_function(
+        "processorContextFromSession",
+        ProcessorContext::from_session,
+    )?;
     cx.export_function("processorContextReset", ProcessorContext::reset)?;
     cx.export_function(
         "processorContextSetParameter",
@@ -93,6 +152,14 @@ pub fn register_exports(cx: &mut neon::prelude::ModuleContext) -> NeonResult<()>
         "processorContextGetParameter",
         ProcessorContext::get_parameter,
     )?;
+    cx.export_function(
+        "processorContextScheduleParameter",
+        ProcessorContext::schedule_parameter,
+    )?;
+    cx.export_function(
+        "processorContextGetStreamPosition",
+        ProcessorContext::get_stream_position,
+    )?;
     cx.export_function(
         "processorContextGetOutputDelay",
         ProcessorContext::get_output_delay,
@@ -0,0 +1,131 @@
+use neon::{
+    handle::Handle,
+    prelude::{Context, FunctionContext},
+    result::NeonResult,
+    types::{JsArrayBuffer, JsTypedArray, JsValue, buffer::TypedArray},
+};
+
+/// Raw view of a JS audio buffer holding 32-bit float samples in native (little-endian) byte
+/// order.
+///
+/// Accepts a `Float32Array`, or a `Buffer`, `Uint8Array` or `ArrayBuffer` containing the raw
+/// sample bytes. Byte views can start at any offset, so the pointer is not guaranteed to be
+/// aligned for `f32` access.
+#[derive(Clone, Copy)]
+pub(crate) struct RawSamples {
+    pub(crate) ptr: *mut u8,
+    pub(crate) len: usize,
+}
+
+impl RawSamples {
+    pub(crate) const EMPTY: RawSamples = RawSamples {
+        ptr: std::ptr::null_mut(),
+        len: 0,
+    };
+
+    pub(crate) fn from_value(
+        cx: &mut FunctionContext,
+        value: Handle<JsValue>,
+    ) -> NeonResult<RawSamples> {
+        let (ptr, num_bytes) = raw_bytes(cx, value)?;
+
+        if num_bytes % size_of::<f32>() != 0 {
+            return cx.throw_range_error("Audio buffer byte length must be a multiple of 4");
+        }
+
+        Ok(RawSamples {
+            ptr,
+            len: num_bytes / size_of::<f32>(),
+        })
+    }
+
+    /// Views a native sample slice, e.g. a region of an audio ring.
+    pub(crate) fn from_slice(samples: &mut [f32]) -> RawSamples {
+        RawSamples {
+            ptr: samples.as_mut_ptr().cast(),
+            len: samples.len(),
+        }
+    }
+
+    pub(crate) fn is_aligned(&self) -> bool {
+        self.ptr.align_offset(align_of::<f32>()) == 0
+    }
+
+    /// # Safety
+    ///
+    /// The view must be aligned, and the JS buffer must stay alive and must not be accessed
+    /// through any other reference for the returned lifetime.
+    pub(crate) unsafe fn as_mut_slice<'a>(&self) -> &'a mut [f32] {
+        if self.len == 0 {
+            return &mut [];
+        }
+        unsafe { std::slice::from_raw_parts_mut(self.ptr.cast(), self.len) }
+    }
+
+    /// # Safety
+    ///
+    /// The JS buffer must be alive and `staged` must hold exactly `self.len` samples.
+    pub(crate) unsafe fn load(&self, staged: &mut [f32]) {
+        debug_assert_eq!(staged.len(), self.len);
+        unsafe {
+            std::ptr::copy_nonoverlapping(
+                self.ptr,
+                staged.as_mut_ptr().cast::<u8>(),
+                self.len * size_of::<f32>(),
+            );
+        }
+    }
+
+    /// # Safety
+    ///
+    /// The JS buffer must be alive and `staged` must hold exactly `self.len` samples.
+    pub(crate) unsafe fn store(&self, staged: &[f32]) {
+        debug_assert_eq!(staged.len(), self.len);
+        unsafe {
+            std::ptr::copy_nonoverlapping(
+                staged.as_ptr().cast::<u8>(),
+                self.ptr,
+                self.len * size_of::<f32>(),
+            );
+        }
+    }
+}
+
+/// Returns the pointer and byte length of any of the buffer types accepted for audio data.
+///
+/// Unlike `RawSamples::from_value`, the byte length does not have to be a multiple of 4, which
+/// lets streams accept chunks that split a sample.
+pub(crate) fn raw_bytes(
+    cx: &mut FunctionContext,
+    value: Handle<JsValue>,
+) -> NeonResult<(*mut u8, usize)> {
+    if let Ok(mut array) = value.downcast::<JsTypedArray<f32>, _>(cx) {
+        let samples = array.as_mut_slice(cx);
+        Ok((samples.as_mut_ptr().cast(), std::mem::size_of_val(samples)))
+    } else if let Ok(mut array) = value.downcast::<JsTypedArray<u8>, _>(cx) {
+        let bytes = array.as_mut_slice(cx);
+        Ok((bytes.as_mut_ptr(), bytes.len()))
+    } else if let Ok(mut array) = value.downcast::<JsArrayBuffer, _>(cx) {
+        let bytes = array.as_mut_slice(cx);
+        Ok((bytes.as_mut_ptr(), bytes.len()))
+    } else {
+        cx.throw_type_error(
+            "Audio buffer must be a Float32Array, Buffer, Uint8Array or ArrayBuffer",
+        )
+    }
+}
+
+/// Views samples as raw bytes, e.g. to copy them into a Node Buffer.
+pub(crate) fn sample_bytes(samples: &[f32]) -> &[u8] {
+    // SAFETY: Any initialized f32 slice can be viewed as bytes.
+    unsafe { std::slice::from_raw_parts(samples.as_ptr().cast::<u8>(), size_of_val(samples)) }
+}
+
+/// Returns the first `len` samples of the scratch buffer, growing it if a caller passes more
+/// samples than the processor was initialized for.
+pub(crate) fn staging_area(scratch: &mut Vec<f32>, len: usize) -> &mut [f32] {
+    if scratch.len() < len {
+        scratch.resize(len, 0.0);
+    }
+    &mut scratch[..len]
+}
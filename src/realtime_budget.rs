@@ -0,0 +1,317 @@
+use std::sync::Arc;
+use std::time::Duration;
+
+use neon::{
+    event::Channel,
+    handle::{Handle, Root},
+    object::Object,
+    prelude::{Context, FunctionContext},
+    result::{JsResult, NeonResult},
+    types::{JsArray, JsFunction, JsNumber, JsObject, JsString, JsValue},
+};
+
+use crate::sdk;
+
+/// One load shedding step, applied on top of the parameters set by the user.
+#[derive(Clone, Copy)]
+pub(crate) enum ShedStep {
+    /// Caps `ProcessorParameter::EnhancementLevel`.
+    EnhancementLevel(f32),
+    /// Sets `ProcessorParameter::Bypass`. The SDK keeps the output delay in bypass, so the
+    /// stream stays aligned.
+    Bypass,
+}
+
+/// Values of the shed parameters: those the user set, restored on full recovery, or those
+/// the budget itself last wrote.
+#[derive(Clone, Copy)]
+struct Baseline {
+    enhancement_level: f32,
+    bypass: f32,
+}
+
+/// JavaScript callback receiving shedding events, called on the main thread.
+struct EventSink {
+    channel: Channel,
+    callback: Arc<Root<JsFunction>>,
+}
+
+/// Real-time deadline monitor of one processor.
+///
+/// Each process call on `n` frames has a budget of `n / sample_rate * factor` seconds. When
+/// at least `miss_threshold` of the last `window_calls` calls missed their budget, the next
+/// shedding step is applied. After `recover_calls` calls in a row without a miss, one step
+/// is undone. Only the transitions touch the SDK or allocate, so monitoring itself costs a
+/// few integer operations per call.
+pub(crate) struct RealtimeBudget {
+    factor: f64,
+    window_calls: u32,
+    miss_threshold: u32,
+    recover_calls: u64,
+    steps: Vec<ShedStep>,
+    events: EventSink,
+
+    budget_ns_per_frame: f64,
+    /// Bit `i` is set if the call `i` calls ago missed its budget.
+    window: u64,
+    calls_since_miss: u64,
+    /// Number of applied shedding steps, 0 when running at full quality.
+    step: usize,
+    baseline: Option<Baseline>,
+    /// Parameters as last set by a shedding step. A live value that differs was changed by
+    /// the user while shedding and replaces the baseline value.
+    written: Option<Baseline>,
+    calls: u64,
+    misses: u64,
+}
+
+impl RealtimeBudget {
+    /// Largest supported `windowCalls`, the width of the miss bitmask.
+    const MAX_WINDOW_CALLS: u32 = u64::BITS;
+
+    /// Parses `{ factor, windowCalls, missThreshold, recoverCalls, steps }` and the event
+    /// callback.
+    pub fn from_options(
+        cx: &mut FunctionContext,
+        options: Handle<JsObject>,
+        callback: Handle<JsFunction>,
+        sample_rate: u32,
+    ) -> NeonResult<RealtimeBudget> {
+        let factor = options.get::<JsNumber, _, _>(cx, "factor")?.value(cx);
+        let window_calls = options.get::<JsNumber, _, _>(cx, "windowCalls")?.value(cx);
+        let miss_threshold = options
+            .get::<JsNumber, _, _>(cx, "missThreshold")?
+            .value(cx);
+        let recover_calls = options.get::<JsNumber, _, _>(cx, "recoverCalls")?.value(cx);
+
+        if factor.is_nan() || factor <= 0.0 {
+            return cx.throw_error("factor must be greater than 0");
+        }
+        if !(1.0..=f64::from(Self::MAX_WINDOW_CALLS)).contains(&window_calls) {
+            return cx.throw_error(format!(
+                "windowCalls must be between 1 and {}",
+                Self::MAX_WINDOW_CALLS
+            ));
+        }
+        if !(1.0..=window_calls).contains(&miss_threshold) {
+            return cx.throw_error("missThreshold must be between 1 and windowCalls");
+        }
+        if recover_calls.is_nan() || recover_calls < 1.0 {
+            return cx.throw_error("recoverCalls must be at least 1");
+        }
+
+        let steps_array = options.get::<JsArray, _, _>(cx, "steps")?;
+        let mut steps = Vec::new();
+        for i in 0..steps_array.len(cx) {
+            let value: Handle<JsValue> = steps_array.get(cx, i)?;
+            if let Ok(level) = value.downcast::<JsNumber, _>(cx) {
+                let level = level.value(cx);
+                if !(0.0..=1.0).contains(&level) {
+                    return cx
+                        .throw_range_error("Enhancement levels in steps must be between 0 and 1");
+                }
+                steps.push(ShedStep::EnhancementLevel(level as f32));
+            } else if value
+                .downcast::<JsString, _>(cx)
+                .is_ok_and(|step| step.value(cx) == "bypass")
+            {
+                steps.push(ShedStep::Bypass);
+            } else {
+                return cx.throw_error("steps must be enhancement levels or \"bypass\"");
+            }
+        }
+
+        let mut channel = cx.channel();
+        channel.unref(cx);
+
+        Ok(RealtimeBudget {
+            factor,
+            window_calls: window_calls as u32,
+            miss_threshold: miss_threshold as u32,
+            recover_calls: recover_calls as u64,
+            steps,
+            events: EventSink {
+                channel,
+                callback: Arc::new(callback.root(cx)),
+            },
+            budget_ns_per_frame: factor * 1e9 / f64::from(sample_rate),
+            window: 0,
+            calls_since_miss: 0,
+            step: 0,
+            baseline: None,
+            written: None,
+            calls: 0,
+            misses: 0,
+        })
+    }
+
+    /// Recomputes the budget for a new sample rate and returns to full quality.
+    pub fn restart(&mut self, processor: &sdk::Processor<'static>, sample_rate: u32) {
+        self.budget_ns_per_frame = self.factor * 1e9 / f64::from(sample_rate);
+        self.restore(processor);
+    }
+
+    /// Whether shedding steps are applied. Scheduled parameter changes are held meanwhile,
+    /// so they do not undo the steps.
+    pub fn is_shedding(&self) -> bool {
+        self.step > 0
+    }
+
+    /// Undoes all shedding steps without emitting an event.
+    pub fn restore(&mut self, processor: &sdk::Processor<'static>) {
+        if self.step > 0 {
+            self.step = 0;
+            self.apply(processor);
+        }
+        self.window = 0;
+        self.calls_since_miss = 0;
+    }
+
+    /// Accounts for one process call on `num_frames` frames that took `elapsed`, and sheds
+    /// or restores quality when the miss rate calls for it.
+    pub fn observe(
+        &mut self,
+        processor: &sdk::Processor<'static>,
+        num_frames: usize,
+        elapsed: Duration,
+    ) {
+        let budget_ns = num_frames as f64 * self.budget_ns_per_frame;
+        let missed = elapsed.as_nanos() as f64 > budget_ns;
+
+        self.calls += 1;
+        self.window = (self.window << 1) | u64::from(missed);
+        if missed {
+            self.misses += 1;
+            self.calls_since_miss = 0;
+        } else {
+            self.calls_since_miss += 1;
+        }
+
+        let window_mask = u64::MAX >> (u64::BITS - self.window_calls);
+        let misses_in_window = (self.window & window_mask).count_ones();
+
+        if misses_in_window >= self.miss_threshold && self.step < self.steps.len() {
+            self.step += 1;
+            // Every step gets a fresh window to prove it is not enough
+            self.window = 0;
+            self.transition(processor, "shed", misses_in_window, elapsed, budget_ns);
+        } else if self.step > 0 && self.calls_since_miss >= self.recover_calls {
+            self.step -= 1;
+            self.calls_since_miss = 0;
+            self.transition(processor, "recover", misses_in_window, elapsed, budget_ns);
+        }
+    }
+
+    #[cold]
+    fn transition(
+        &mut self,
+        processor: &sdk::Processor<'static>,
+        kind: &'static str,
+        misses_in_window: u32,
+        elapsed: Duration,
+        budget_ns: f64,
+    ) {
+        let (enhancement_level, bypass) = self.apply(processor);
+
+        let step = self.step;
+        let total_misses = self.misses;
+        let callback = self.events.callback.clone();
+        self.events.channel.send(move |mut cx| {
+            let event = cx.empty_object();
+            let values = [
+                ("step", step as f64),
+                ("enhancementLevel", f64::from(enhancement_level)),
+                ("missesInWindow", f64::from(misses_in_window)),
+                ("totalMisses", total_misses as f64),
+                ("callUs", elapsed.as_nanos() as f64 / 1e3),
+                ("budgetUs", budget_ns / 1e3),
+            ];
+            let kind = cx.string(kind);
+            event.set(&mut cx, "type", kind)?;
+            for (key, value) in values {
+                let value = cx.number(value);
+                event.set(&mut cx, key, value)?;
+            }
+            let bypass = cx.boolean(bypass);
+            event.set(&mut cx, "bypass", bypass)?;
+
+            let callback = callback.to_inner(&mut cx);
+            callback.call_with(&cx).arg(event).exec(&mut cx)
+        });
+    }
+
+    /// Sets the processor parameters for the current step. Returns the resulting enhancement
+    /// level and bypass state.
+    fn apply(&mut self, processor: &sdk::Processor<'static>) -> (f32, bool) {
+        let context = processor.processor_context();
+        let live = || Baseline {
+            enhancement_level: context
+                .parameter(sdk::ProcessorParameter::EnhancementLevel)
+                .unwrap_or(1.0),
+            bypass: context
+                .parameter(sdk::ProcessorParameter::Bypass)
+                .unwrap_or(0.0),
+        };
+
+        // Changes the user made while shedding are neither overwritten by this step nor lost
+        // on recovery
+        let current = live();
+        let mut baseline = self.baseline.unwrap_or(current);
+        if let Some(written) = self.written {
+            if current.enhancement_level != written.enhancement_level {
+                baseline.enhancement_level = current.enhancement_level;
+            }
+            if current.bypass != written.bypass {
+                baseline.bypass = current.bypass;
+            }
+        }
+
+        let mut enhancement_level = baseline.enhancement_level;
+        let mut bypass = baseline.bypass;
+        for step in &self.steps[..self.step] {
+            match *step {
+                ShedStep::EnhancementLevel(level) => {
+                    enhancement_level = enhancement_level.min(level);
+                }
+                ShedStep::Bypass => bypass = 1.0,
+            }
+        }
+
+        // A rejected value leaves the previous setting in place
+        let _ = context.set_parameter(sdk::ProcessorParameter::EnhancementLevel, enhancement_level);
+        let _ = context.set_parameter(sdk::ProcessorParameter::Bypass, bypass);
+
+        if self.step == 0 {
+            // Parameters changed by the user while at full quality become the new baseline
+            self.baseline = None;
+            self.written = None;
+        } else {
+            self.baseline = Some(baseline);
+            // Read back, since the SDK may reject or adjust a value
+            self.written = Some(live());
+        }
+
+        (enhancement_level, bypass > 0.5)
+    }
+
+    pub fn reset_counters(&mut self) {
+        self.calls = 0;
+        self.misses = 0;
+    }
+
+    /// Converts the monitor state into `{ factor, calls, misses, step, maxStep }`.
+    pub fn to_object<'a, C: Context<'a>>(&self, cx: &mut C) -> JsResult<'a, JsObject> {
+        let object = cx.empty_object();
+        for (key, value) in [
+            ("factor", self.factor),
+            ("calls", self.calls as f64),
+            ("misses", self.misses as f64),
+            ("step", self.step as f64),
+            ("maxStep", self.steps.len() as f64),
+        ] {
+            let value = cx.number(value);
+            object.set(cx, key, value)?;
+        }
+        Ok(object)
+    }
+}
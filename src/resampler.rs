@@ -0,0 +1,146 @@
+//! Streaming sample rate conversion for interleaved audio.
+
+/// Kernel positions tabulated per input frame. Weights in between are interpolated linearly.
+const PHASES: usize = 256;
+
+/// Zero crossings of the sinc kernel on each side at full bandwidth.
+const ZERO_CROSSINGS: usize = 8;
+
+/// Band-limited resampler with a fixed ratio of two integer sample rates.
+///
+/// Output frames are interpolated from the input with a Hann-windowed sinc kernel. When
+/// downsampling, the kernel is widened to cut off below the new Nyquist frequency. Output
+/// frame `k` lies exactly at input time `k * from_rate / to_rate`, tracked as an integer
+/// frame index plus a fraction in units of `1 / to_rate`, so there is no drift.
+///
+/// The input is buffered until the kernel extends past the last needed frame, which adds
+/// `half_taps` input frames of latency but keeps the output aligned with the input: the
+/// first output frame is at the first input frame. `flush` pads the input with silence to
+/// release the rest.
+pub(crate) struct Resampler {
+    num_channels: usize,
+    from_rate: u32,
+    to_rate: u32,
+    /// Input frames the kernel reaches on each side of an output frame.
+    half_taps: usize,
+    /// `PHASES + 1` rows of `2 * half_taps` weights. Row `p` is for an output frame
+    /// `p / PHASES` of a frame after the input frame it is based on.
+    kernel: Vec<f32>,
+    /// Interleaved input not yet consumed, starting `half_taps - 1` frames before `index`.
+    history: Vec<f32>,
+    /// Input frame of the next output frame, relative to the start of `history` plus
+    /// `half_taps - 1`.
+    index: usize,
+    /// Fractional part of the position of the next output frame, in units of `1 / to_rate`.
+    fraction: u32,
+}
+
+impl Resampler {
+    pub(crate) fn new(from_rate: u32, to_rate: u32, num_channels: usize) -> Resampler {
+        let divisor = gcd(from_rate, to_rate);
+        let (from_rate, to_rate) = (from_rate / divisor, to_rate / divisor);
+        let cutoff = (f64::from(to_rate) / f64::from(from_rate)).min(1.0);
+        let half_taps = (ZERO_CROSSINGS as f64 / cutoff).ceil() as usize;
+        let taps = 2 * half_taps;
+
+        let mut kernel = Vec::with_capacity((PHASES + 1) * taps);
+        for phase in 0..=PHASES {
+            let offset = phase as f64 / PHASES as f64;
+            let row_start = kernel.len();
+            for tap in 0..taps {
+                // Distance of the input frame of this tap from the output frame
+                let distance = tap as f64 - (half_taps - 1) as f64 - offset;
+                let window = if distance.abs() < half_taps as f64 {
+                    0.5 * (1.0 + (std::f64::consts::PI * distance / half_taps as f64).cos())
+                } else {
+                    0.0
+                };
+                kernel.push((cutoff * sinc(cutoff * distance) * window) as f32);
+            }
+            // Unity gain at DC for every phase
+            let sum: f32 = kernel[row_start..].iter().sum();
+            for weight in &mut kernel[row_start..] {
+                *weight /= sum;
+            }
+        }
+
+        Resampler {
+            num_channels,
+            from_rate,
+            to_rate,
+            half_taps,
+            kernel,
+            history: vec![0.0; (half_taps - 1) * num_channels],
+            index: 0,
+            fraction: 0,
+        }
+    }
+
+    /// Resamples interleaved `input` and appends all output frames that can be computed so
+    /// far to `output`.
+    pub(crate) fn process(&mut self, input: &[f32], output: &mut Vec<f32>) {
+        let num_channels = self.num_channels;
+        let taps = 2 * self.half_taps;
+        self.history.extend_from_slice(input);
+        let num_frames = self.history.len() / num_channels;
+
+        // The kernel of the next output frame covers frames `index..index + taps`
+        while self.index + taps <= num_frames {
+            let phase = self.fraction as f32 / self.to_rate as f32 * PHASES as f32;
+            let row = (phase as usize).min(PHASES - 1);
+            let blend = phase - row as f32;
+            let (weights, next_weights) = self.kernel[row * taps..(row + 2) * taps].split_at(taps);
+            let frames =
+                &self.history[self.index * num_channels..(self.index + taps) * num_channels];
+
+            for channel in 0..num_channels {
+                let mut sum = 0.0;
+                for (tap, (weight, next_weight)) in weights.iter().zip(next_weights).enumerate() {
+                    let weight = weight + blend * (next_weight - weight);
+                    sum += frames[tap * num_channels + channel] * weight;
+                }
+                output.push(sum);
+            }
+
+            self.fraction += self.from_rate;
+            self.index += (self.fraction / self.to_rate) as usize;
+            self.fraction %= self.to_rate;
+        }
+
+        let consumed = self.index.min(num_frames);
+        self.history.drain(..consumed * num_channels);
+        self.index -= consumed;
+    }
+
+    /// Pads the input with silence so that the output reaches the end of the input, and
+    /// starts a new stream.
+    pub(crate) fn flush(&mut self, output: &mut Vec<f32>) {
+        let num_channels = self.num_channels;
+        let padding = self.half_taps * num_channels;
+        let start = self.history.len();
+        self.history.resize(start + padding, 0.0);
+        self.process(&[], output);
+
+        self.history.clear();
+        self.history
+            .resize((self.half_taps - 1) * num_channels, 0.0);
+        self.index = 0;
+        self.fraction = 0;
+    }
+}
+
+fn sinc(x: f64) -> f64 {
+    if x == 0.0 {
+        1.0
+    } else {
+        let x = std::f64::consts::PI * x;
+        x.sin() / x
+    }
+}
+
+fn gcd(mut a: u32, mut b: u32) -> u32 {
+    while b != 0 {
+        (a, b) = (b, a % b);
+    }
+    a
+}
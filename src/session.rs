@@ -0,0 +1,54 @@
+//! Processors registered under a session ID, so that any worker thread of the process can
+//! get their contexts without a handle to the processor.
+
+use std::collections::HashMap;
+use std::sync::{Arc, Mutex, Weak};
+
+use crate::processor::SharedProcessor;
+
+/// Registered processors by session ID. The addon is loaded once per process, so all worker
+/// threads see the same registry. Entries do not keep their processor alive.
+static SESSIONS: Mutex<Option<HashMap<String, Weak<SharedProcessor>>>> = Mutex::new(None);
+
+/// Registers `processor` under `id`. Fails if another live processor is registered under
+/// it; the entry of a dropped processor is replaced.
+pub(crate) fn register(id: &str, processor: &Arc<SharedProcessor>) -> Result<(), String> {
+    let mut sessions = SESSIONS.lock().unwrap();
+    let sessions = sessions.get_or_insert_with(HashMap::new);
+    let taken = sessions.get(id).is_some_and(|existing| {
+        existing.strong_count() > 0 && !existing.ptr_eq(&Arc::downgrade(processor))
+    });
+    if taken {
+        return Err(format!("Session \"{id}\" is already registered"));
+    }
+    sessions.insert(id.to_owned(), Arc::downgrade(processor));
+    Ok(())
+}
+
+/// Removes the entry of `id` if it refers to `processor`.
+pub(crate) fn unregister(id: &str, processor: &Arc<SharedProcessor>) {
+    let mut sessions = SESSIONS.lock().unwrap();
+    let Some(sessions) = sessions.as_mut() else {
+        return;
+    };
+    let registered = sessions
+        .get(id)
+        .is_some_and(|existing| existing.ptr_eq(&Arc::downgrade(processor)));
+    if registered {
+        sessions.remove(id);
+    }
+}
+
+/// Returns the processor registered under `id`, if it is still alive.
+pub(crate) fn lookup(id: &str) -> Result<Arc<SharedProcessor>, String> {
+    let mut sessions = SESSIONS.lock().unwrap();
+    let sessions = sessions.get_or_insert_with(HashMap::new);
+    match sessions.get(id).map(Weak::upgrade) {
+        Some(Some(processor)) => Ok(processor),
+        Some(None) => {
+            sessions.remove(id);
+            Err(format!("The processor of session \"{id}\" was dropped"))
+        }
+        None => Err(format!("No session \"{id}\" is registered")),
+    }
+}
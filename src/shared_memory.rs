@@ -0,0 +1,229 @@
+//! Memory shared between processes through a memfd that one creates and passes to the other,
+//! or through the page cache of a file that several processes map read-only.
+
+use std::ffi::CStr;
+use std::fs::File;
+use std::io::{self, Read};
+use std::os::fd::{AsRawFd, FromRawFd, OwnedFd};
+
+/// Seals a memfd must carry before it is mapped from another process: with them, its owner
+/// cannot truncate it under the mapping, which would raise SIGBUS on access.
+const SIZE_SEALS: libc::c_int = libc::F_SEAL_SHRINK | libc::F_SEAL_GROW;
+
+/// A shared mapping of a whole file. Unmapped on drop.
+pub(crate) struct SharedMapping {
+    ptr: *mut u8,
+    len: usize,
+}
+
+// SAFETY: The mapping is plain memory. Concurrent access is coordinated by its users, e.g.
+// through the atomic indices of the rings living in it.
+unsafe impl Send for SharedMapping {}
+unsafe impl Sync for SharedMapping {}
+
+impl SharedMapping {
+    /// Creates an anonymous memfd of `len` zeroed bytes, seals its size and maps it. Returns
+    /// the mapping and the memfd to pass to another process.
+    pub(crate) fn create_sealed(name: &CStr, len: usize) -> io::Result<(SharedMapping, OwnedFd)> {
+        let file = memfd(name)?;
+        file.set_len(len as u64)?;
+        add_seals(&file, SIZE_SEALS | libc::F_SEAL_SEAL)?;
+        let mapping = Self::map(&file, len, libc::PROT_READ | libc::PROT_WRITE)?;
+        Ok((mapping, file.into()))
+    }
+
+    /// Maps a memfd received from another process, after checking that its size is sealed and
+    /// that it is `len` bytes long.
+    pub(crate) fn open_sealed(fd: OwnedFd, len: usize) -> io::Result<SharedMapping> {
+        let file = File::from(fd);
+        // SAFETY: Reads the seals of a descriptor owned by `file`.
+        let seals = unsafe { libc::fcntl(file.as_raw_fd(), libc::F_GET_SEALS) };
+        if seals < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        if seals & SIZE_SEALS != SIZE_SEALS {
+            return Err(io::Error::new(
+                io::ErrorKind::InvalidInput,
+                "Shared memory size is not sealed",
+            ));
+        }
+        if file.metadata()?.len() != len as u64 {
+            return Err(io::Error::new(
+                io::ErrorKind::InvalidInput,
+                "Shared memory size does not match the rings",
+            ));
+        }
+        Self::map(&file, len, libc::PROT_READ | libc::PROT_WRITE)
+    }
+
+    /// Maps the first `len` bytes of an open file for reading. The pages are those of the
+    /// page cache, so all processes mapping the file share one copy in physical memory.
+    pub(crate) fn map_read_only(file: &File, len: usize) -> io::Result<SharedMapping> {
+        Self::map(file, len, libc::PROT_READ)
+    }
+
+    /// Copies the first `len` bytes of `source` into a memfd sealed against every change and
+    /// maps it for reading. The pages are private to this process.
+    pub(crate) fn copy_read_only(
+        name: &CStr,
+        source: impl Read,
+        len: usize,
+    ) -> io::Result<SharedMapping> {
+        let file = sealed_copy(name, source, len)?;
+        Self::map(&file, len, libc::PROT_READ)
+    }
+
+    /// Moves a read-only mapping onto a sealed copy of its contents, at the same address, so
+    /// that it keeps its bytes once the file behind it changes. Readers racing with the move
+    /// fault in pages of either, which hold the same bytes as long as the file does not change
+    /// before the move returns.
+    pub(crate) fn detach(&self, name: &CStr) -> io::Result<()> {
+        let file = sealed_copy(name, self.as_slice(), self.len)?;
+        // SAFETY: MAP_FIXED replaces exactly the pages of this mapping, with the same protection.
+        let ptr = unsafe {
+            libc::mmap(
+                self.ptr.cast(),
+                self.len,
+                libc::PROT_READ,
+                libc::MAP_SHARED | libc::MAP_FIXED,
+                file.as_raw_fd(),
+                0,
+            )
+        };
+        if ptr == libc::MAP_FAILED {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(())
+    }
+
+    fn map(file: &File, len: usize, protection: libc::c_int) -> io::Result<SharedMapping> {
+        if len == 0 {
+            return Err(io::Error::new(io::ErrorKind::InvalidInput, "Empty mapping"));
+        }
+        // SAFETY: The file descriptor is valid for the call, and the mapping stays valid after
+        // the file is closed.
+        let ptr = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                protection,
+                libc::MAP_SHARED,
+                file.as_raw_fd(),
+                0,
+            )
+        };
+        if ptr == libc::MAP_FAILED {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(SharedMapping {
+            ptr: ptr.cast(),
+            len,
+        })
+    }
+
+    /// Start of the mapping. Page-aligned.
+    pub(crate) fn as_ptr(&self) -> *mut u8 {
+        self.ptr
+    }
+
+    pub(crate) fn len(&self) -> usize {
+        self.len
+    }
+
+    pub(crate) fn as_slice(&self) -> &[u8] {
+        // SAFETY: The mapping is readable and `len` bytes long. Shared memory written by
+        // another process is only read through atomics, not through this slice.
+        unsafe { std::slice::from_raw_parts(self.ptr, self.len) }
+    }
+
+    /// Reads how much of the mapping is resident in physical memory, and how much of that is
+    /// shared with other processes, from `/proc/self/smaps`.
+    pub(crate) fn residency(&self) -> io::Result<Residency> {
+        let smaps = std::fs::read_to_string("/proc/self/smaps")?;
+        let start = format!("{:x}-", self.ptr as usize);
+        let mut lines = smaps.lines().skip_while(|line| !line.starts_with(&start));
+        if lines.next().is_none() {
+            return Err(io::Error::new(
+                io::ErrorKind::NotFound,
+                "Mapping not in smaps",
+            ));
+        }
+
+        let mut residency = Residency::default();
+        for line in lines {
+            let mut fields = line.split_whitespace();
+            let key = fields.next().unwrap_or_default();
+            // The next mapping starts with its address range
+            if key.contains('-') {
+                break;
+            }
+            let Some(kilobytes) = fields.next().and_then(|value| value.parse::<u64>().ok()) else {
+                continue;
+            };
+            let bytes = kilobytes * 1024;
+            match key {
+                "Rss:" => residency.resident = bytes,
+                "Pss:" => residency.proportional = bytes,
+                "Shared_Clean:" | "Shared_Dirty:" => residency.shared += bytes,
+                "Private_Clean:" | "Private_Dirty:" => residency.private += bytes,
+                _ => {}
+            }
+        }
+        Ok(residency)
+    }
+}
+
+impl Drop for SharedMapping {
+    fn drop(&mut self) {
+        // SAFETY: `ptr` and `len` describe a mapping created by `map`, and no references into
+        // it outlive `self`.
+        unsafe {
+            libc::munmap(self.ptr.cast(), self.len);
+        }
+    }
+}
+
+fn memfd(name: &CStr) -> io::Result<File> {
+    // SAFETY: `name` is NUL-terminated, and the returned descriptor is owned from here on.
+    unsafe {
+        let fd = libc::memfd_create(name.as_ptr(), libc::MFD_CLOEXEC | libc::MFD_ALLOW_SEALING);
+        if fd < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(File::from(OwnedFd::from_raw_fd(fd)))
+    }
+}
+
+fn add_seals(file: &File, seals: libc::c_int) -> io::Result<()> {
+    // SAFETY: Only adds seals to a descriptor owned by `file`.
+    if unsafe { libc::fcntl(file.as_raw_fd(), libc::F_ADD_SEALS, seals) } != 0 {
+        return Err(io::Error::last_os_error());
+    }
+    Ok(())
+}
+
+/// Copies the first `len` bytes of `source` into a new memfd and seals it against every change.
+fn sealed_copy(name: &CStr, source: impl Read, len: usize) -> io::Result<File> {
+    let mut file = memfd(name)?;
+    if io::copy(&mut source.take(len as u64), &mut file)? != len as u64 {
+        return Err(io::Error::new(
+            io::ErrorKind::UnexpectedEof,
+            "File is shorter than expected",
+        ));
+    }
+    add_seals(&file, SIZE_SEALS | libc::F_SEAL_WRITE | libc::F_SEAL_SEAL)?;
+    Ok(file)
+}
+
+/// Physical memory of a mapping in bytes, as accounted by the kernel.
+#[derive(Default)]
+pub(crate) struct Residency {
+    /// Pages of the mapping in physical memory.
+    pub(crate) resident: u64,
+    /// Resident pages also mapped by other processes.
+    pub(crate) shared: u64,
+    /// Resident pages mapped by this process only.
+    pub(crate) private: u64,
+    /// Resident pages divided by the number of processes mapping each.
+    pub(crate) proportional: u64,
+}
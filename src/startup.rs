@@ -0,0 +1,222 @@
+//! Cold start off the JavaScript thread: model download and loading, processor creation
+//! with its license check, and initialization, timed stage by stage.
+
+use std::time::Instant;
+
+use neon::{
+    handle::Handle,
+    object::Object,
+    prelude::{Context, FunctionContext},
+    result::{JsResult, NeonResult},
+    types::{JsBoolean, JsNull, JsNumber, JsObject, JsPromise, JsString, JsUndefined, JsValue},
+};
+
+use crate::error::throw_aic_error;
+use crate::model::Model;
+use crate::processor::{Processor, SharedProcessor, StreamConfig, parse_otel_config};
+use crate::sdk;
+
+/// Where the model comes from.
+enum ModelSource {
+    File(String),
+    Download { id: String, dir: String },
+}
+
+/// Stream settings; `None` picks the model's optimum.
+struct Settings {
+    sample_rate: Option<u32>,
+    num_channels: usize,
+    num_frames: Option<usize>,
+    allow_variable_frames: bool,
+    compensate_delay: bool,
+}
+
+/// Durations of the stages in milliseconds.
+#[derive(Default)]
+struct Timings {
+    download: f64,
+    model: f64,
+    license: f64,
+    initialize: f64,
+}
+
+struct Started {
+    model: sdk::Model<'static>,
+    processor: SharedProcessor,
+    config: StreamConfig,
+    timings: Timings,
+}
+
+fn elapsed_ms(start: Instant) -> f64 {
+    start.elapsed().as_secs_f64() * 1e3
+}
+
+/// Runs all stages in order. Each one needs the result of the one before.
+fn start(
+    source: ModelSource,
+    license_key: &str,
+    otel_config: Option<&sdk::OtelConfig>,
+    settings: &Settings,
+) -> Result<Started, sdk::AicError> {
+    let mut timings = Timings::default();
+
+    let start = Instant::now();
+    let path = match source {
+        ModelSource::File(path) => path,
+        ModelSource::Download { id, dir } => {
+            let path = sdk::Model::download(&id, dir)?;
+            timings.download = elapsed_ms(start);
+            path.to_string_lossy().into_owned()
+        }
+    };
+
+    let start = Instant::now();
+    let model = sdk::Model::from_file(path)?;
+    timings.model = elapsed_ms(start);
+
+    let start = Instant::now();
+    let processor = SharedProcessor::new(&model, license_key, otel_config)?;
+    timings.license = elapsed_ms(start);
+
+    let sample_rate = settings
+        .sample_rate
+        .unwrap_or_else(|| model.optimal_sample_rate());
+    let config = StreamConfig {
+        sample_rate,
+        num_channels: settings.num_channels,
+        num_frames: settings
+            .num_frames
+            .unwrap_or_else(|| model.optimal_num_frames(sample_rate)),
+        allow_variable_frames: settings.allow_variable_frames,
+    };
+    let start = Instant::now();
+    processor.lock().initialize(&sdk::ProcessorConfig {
+        sample_rate: config.sample_rate,
+        num_channels: config.num_channels as u16,
+        num_frames: config.num_frames,
+        allow_variable_frames: config.allow_variable_frames,
+    })?;
+    timings.initialize = elapsed_ms(start);
+
+    Ok(Started {
+        model,
+        processor,
+        config,
+        timings,
+    })
+}
+
+/// Reads `options[key]` as a string, or `None` if it is null or undefined.
+fn optional_string(
+    cx: &mut FunctionContext,
+    options: Handle<JsObject>,
+    key: &str,
+) -> NeonResult<Option<String>> {
+    let value = options.get::<JsValue, _, _>(cx, key)?;
+    if value.is_a::<JsNull, _>(cx) || value.is_a::<JsUndefined, _>(cx) {
+        return Ok(None);
+    }
+    Ok(Some(value.downcast_or_throw::<JsString, _>(cx)?.value(cx)))
+}
+
+/// Reads `options[key]` as a positive integer, or `None` if it is null or undefined.
+fn optional_count(
+    cx: &mut FunctionContext,
+    options: Handle<JsObject>,
+    key: &str,
+) -> NeonResult<Option<f64>> {
+    let value = options.get::<JsValue, _, _>(cx, key)?;
+    if value.is_a::<JsNull, _>(cx) || value.is_a::<JsUndefined, _>(cx) {
+        return Ok(None);
+    }
+    let count = value.downcast_or_throw::<JsNumber, _>(cx)?.value(cx);
+    if !(count >= 1.0 && count.fract() == 0.0) {
+        return cx.throw_range_error(format!("{key} must be a positive integer"));
+    }
+    Ok(Some(count))
+}
+
+/// Loads a model and creates and initializes a processor for it on the Node worker pool.
+/// Argument 0 is `{ modelPath, modelId, downloadDir, sampleRate, numChannels, numFrames,
+/// allowVariableFrames, compensateDelay }`, with either a model path or an ID to download,
+/// and null sample rate or frame count for the model's optimum. Arguments 1 and 2 are the
+/// license key and the OpenTelemetry configuration. Resolves with `{ model, processor,
+/// numFrames, sampleRate, timings }`.
+pub fn init(mut cx: FunctionContext) -> JsResult<JsPromise> {
+    let options = cx.argument::<JsObject>(0)?;
+    let license_key = cx.argument::<JsString>(1)?.value(&mut cx);
+    let otel_config = match cx.argument_opt(2) {
+        Some(value) => parse_otel_config(&mut cx, value)?,
+        None => None,
+    };
+
+    let source = match (
+        optional_string(&mut cx, options, "modelPath")?,
+        optional_string(&mut cx, options, "modelId")?,
+    ) {
+        (Some(path), _) => ModelSource::File(path),
+        (None, Some(id)) => {
+            let dir = options
+                .get::<JsString, _, _>(&mut cx, "downloadDir")?
+                .value(&mut cx);
+            ModelSource::Download { id, dir }
+        }
+        (None, None) => return cx.throw_error("Either modelPath or modelId is required"),
+    };
+    let num_channels = optional_count(&mut cx, options, "numChannels")?.unwrap_or(1.0);
+    if num_channels > f64::from(u16::MAX) {
+        return cx.throw_range_error("numChannels must be from 1 to 65535");
+    }
+    let settings = Settings {
+        sample_rate: optional_count(&mut cx, options, "sampleRate")?.map(|rate| rate as u32),
+        num_channels: num_channels as usize,
+        num_frames: optional_count(&mut cx, options, "numFrames")?.map(|frames| frames as usize),
+        allow_variable_frames: options
+            .get::<JsBoolean, _, _>(&mut cx, "allowVariableFrames")?
+            .value(&mut cx),
+        compensate_delay: options
+            .get::<JsBoolean, _, _>(&mut cx, "compensateDelay")?
+            .value(&mut cx),
+    };
+    let compensate_delay = settings.compensate_delay;
+
+    Ok(cx
+        .task(move || start(source, &license_key, otel_config.as_ref(), &settings))
+        .promise(move |mut cx, started| {
+            let started = started.or_else(|e| throw_aic_error(&mut cx, &e))?;
+            let result = cx.empty_object();
+
+            let model = cx.boxed(Model::from_sdk(started.model));
+            result.set(&mut cx, "model", model)?;
+            let processor = cx.boxed(Processor::initialized(
+                started.processor,
+                started.config,
+                compensate_delay,
+            ));
+            result.set(&mut cx, "processor", processor)?;
+            let sample_rate = cx.number(started.config.sample_rate);
+            result.set(&mut cx, "sampleRate", sample_rate)?;
+            let num_frames = cx.number(started.config.num_frames as f64);
+            result.set(&mut cx, "numFrames", num_frames)?;
+
+            let timings = cx.empty_object();
+            for (key, ms) in [
+                ("downloadMs", started.timings.download),
+                ("modelMs", started.timings.model),
+                ("licenseMs", started.timings.license),
+                ("initializeMs", started.timings.initialize),
+            ] {
+                let ms = cx.number(ms);
+                timings.set(&mut cx, key, ms)?;
+            }
+            result.set(&mut cx, "timings", timings)?;
+
+            Ok(result)
+        }))
+}
+
+pub fn register_exports(cx: &mut neon::prelude::ModuleContext) -> NeonResult<()> {
+    cx.export_function("startupInit", init)?;
+
+    Ok(())
+}
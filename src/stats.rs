@@ -0,0 +1,472 @@
+use std::cell::Cell;
+use std::sync::Mutex;
+use std::sync::atomic::{AtomicBool, AtomicU32, AtomicU64, Ordering};
+use std::time::{Duration, Instant};
+
+use neon::{
+    object::Object,
+    prelude::{Context, FunctionContext},
+    result::{JsResult, NeonResult},
+    types::{JsNumber, JsObject},
+};
+
+use crate::error::error_code;
+use crate::sdk;
+
+/// Log-linear latency histogram in the style of HdrHistogram, with lock-free recording.
+///
+/// Values below `SUB_BUCKETS` nanoseconds get a bucket each. Above that, every power of two
+/// is split into `SUB_BUCKETS` linear buckets, so the relative error of any recorded value is
+/// below 1 / `SUB_BUCKETS` (about 6 %). Values above 2^`MAX_EXPONENT` ns (about 18 minutes)
+/// land in the last bucket.
+pub(crate) struct LatencyHistogram {
+    buckets: [AtomicU64; Self::NUM_BUCKETS],
+    sum_ns: AtomicU64,
+    max_ns: AtomicU64,
+}
+
+impl LatencyHistogram {
+    const SUB_BUCKET_BITS: u32 = 4;
+    const SUB_BUCKETS: usize = 1 << Self::SUB_BUCKET_BITS;
+    const MAX_EXPONENT: u32 = 40;
+    const NUM_BUCKETS: usize =
+        (Self::MAX_EXPONENT - Self::SUB_BUCKET_BITS + 2) as usize * Self::SUB_BUCKETS;
+
+    pub fn new() -> LatencyHistogram {
+        LatencyHistogram {
+            buckets: std::array::from_fn(|_| AtomicU64::new(0)),
+            sum_ns: AtomicU64::new(0),
+            max_ns: AtomicU64::new(0),
+        }
+    }
+
+    fn bucket_index(value_ns: u64) -> usize {
+        if value_ns < Self::SUB_BUCKETS as u64 {
+            return value_ns as usize;
+        }
+        let exponent = (63 - value_ns.leading_zeros()).min(Self::MAX_EXPONENT);
+        let shift = exponent - Self::SUB_BUCKET_BITS;
+        let sub_bucket = ((value_ns >> shift) as usize).min(2 * Self::SUB_BUCKETS - 1);
+        (shift as usize + 1) * Self::SUB_BUCKETS + sub_bucket - Self::SUB_BUCKETS
+    }
+
+    /// Highest value that falls into the bucket at `index`.
+    fn bucket_upper_bound(index: usize) -> u64 {
+        let group = index / Self::SUB_BUCKETS;
+        if group == 0 {
+            return index as u64;
+        }
+        let sub_bucket = (Self::SUB_BUCKETS + index % Self::SUB_BUCKETS) as u64;
+        ((sub_bucket + 1) << (group - 1)) - 1
+    }
+
+    pub fn record(&self, value: Duration) {
+        let value_ns = u64::try_from(value.as_nanos()).unwrap_or(u64::MAX);
+        self.buckets[Self::bucket_index(value_ns)].fetch_add(1, Ordering::Relaxed);
+        self.sum_ns.fetch_add(value_ns, Ordering::Relaxed);
+        self.max_ns.fetch_max(value_ns, Ordering::Relaxed);
+    }
+
+    pub fn reset(&self) {
+        for bucket in &self.buckets {
+            bucket.store(0, Ordering::Relaxed);
+        }
+        self.sum_ns.store(0, Ordering::Relaxed);
+        self.max_ns.store(0, Ordering::Relaxed);
+    }
+
+    /// Converts the histogram into `{ count, totalUs, meanUs, p50Us, p90Us, p99Us, p999Us,
+    /// maxUs }`. Percentiles report the upper bound of their bucket.
+    pub fn to_object<'a, C: Context<'a>>(&self, cx: &mut C) -> JsResult<'a, JsObject> {
+        let counts: Vec<u64> = self
+            .buckets
+            .iter()
+            .map(|bucket| bucket.load(Ordering::Relaxed))
+            .collect();
+        let count: u64 = counts.iter().sum();
+        let sum_ns = self.sum_ns.load(Ordering::Relaxed);
+        let max_ns = self.max_ns.load(Ordering::Relaxed);
+
+        let percentile_ns = |percentile: f64| {
+            let rank = ((percentile / 100.0) * count as f64).ceil().max(1.0) as u64;
+            let mut seen = 0;
+            for (index, bucket_count) in counts.iter().enumerate() {
+                seen += bucket_count;
+                if seen >= rank {
+                    return Self::bucket_upper_bound(index).min(max_ns);
+                }
+            }
+            max_ns
+        };
+
+        let object = cx.empty_object();
+        set_number(cx, object, "count", count as f64)?;
+        set_number(cx, object, "totalUs", sum_ns as f64 / 1e3)?;
+        let mean_ns = if count > 0 { sum_ns / count } else { 0 };
+        set_number(cx, object, "meanUs", mean_ns as f64 / 1e3)?;
+        for (key, percentile) in [
+            ("p50Us", 50.0),
+            ("p90Us", 90.0),
+            ("p99Us", 99.0),
+            ("p999Us", 99.9),
+        ] {
+            let value_ns = if count > 0 {
+                percentile_ns(percentile)
+            } else {
+                0
+            };
+            set_number(cx, object, key, value_ns as f64 / 1e3)?;
+        }
+        set_number(cx, object, "maxUs", max_ns as f64 / 1e3)?;
+        Ok(object)
+    }
+}
+
+/// Energy and peak of the samples of one block.
+#[derive(Clone, Copy, Default)]
+pub(crate) struct BlockLevels {
+    sum_squares: f64,
+    peak: f32,
+    num_samples: usize,
+}
+
+impl BlockLevels {
+    /// Lanes of the inner loop. Independent accumulators let the compiler vectorize it.
+    const LANES: usize = 8;
+    /// Samples summed in `f32` before the partial sums are added up in `f64`.
+    const SPAN: usize = 4096;
+
+    pub fn of(samples: &[f32]) -> BlockLevels {
+        let mut sum_squares = 0.0;
+        let mut peak = [0.0f32; Self::LANES];
+        for span in samples.chunks(Self::SPAN) {
+            let mut sum = [0.0f32; Self::LANES];
+            let chunks = span.chunks_exact(Self::LANES);
+            for &sample in chunks.remainder() {
+                sum[0] += sample * sample;
+                peak[0] = peak[0].max(sample.abs());
+            }
+            for chunk in chunks {
+                for lane in 0..Self::LANES {
+                    sum[lane] += chunk[lane] * chunk[lane];
+                    peak[lane] = peak[lane].max(chunk[lane].abs());
+                }
+            }
+            sum_squares += sum.iter().map(|&sum| f64::from(sum)).sum::<f64>();
+        }
+        BlockLevels {
+            sum_squares,
+            peak: peak.into_iter().fold(0.0, f32::max),
+            num_samples: samples.len(),
+        }
+    }
+
+    pub fn merge(self, other: BlockLevels) -> BlockLevels {
+        BlockLevels {
+            sum_squares: self.sum_squares + other.sum_squares,
+            peak: self.peak.max(other.peak),
+            num_samples: self.num_samples + other.num_samples,
+        }
+    }
+
+    fn rms(&self) -> f64 {
+        if self.num_samples == 0 {
+            return 0.0;
+        }
+        (self.sum_squares / self.num_samples as f64).sqrt()
+    }
+}
+
+/// Change of energy from input to output in dB, negative when the processor removed energy.
+fn energy_delta_db(input_energy: f64, output_energy: f64) -> f64 {
+    if input_energy <= 0.0 || output_energy <= 0.0 {
+        return 0.0;
+    }
+    10.0 * (output_energy / input_energy).log10()
+}
+
+/// Input and output signal levels of the process calls, recorded while enabled.
+///
+/// Recording happens under the processor lock, so there is a single writer and sums can be
+/// updated with a plain load and store. Floats are stored as their bits; peaks are
+/// non-negative, so their bit patterns order like their values and `fetch_max` works.
+pub(crate) struct SignalLevels {
+    enabled: AtomicBool,
+    blocks: AtomicU64,
+    samples: AtomicU64,
+    input_energy: AtomicU64,
+    output_energy: AtomicU64,
+    input_peak: AtomicU32,
+    output_peak: AtomicU32,
+    last_input_rms: AtomicU64,
+    last_output_rms: AtomicU64,
+    last_input_peak: AtomicU32,
+    last_output_peak: AtomicU32,
+}
+
+impl SignalLevels {
+    fn new() -> SignalLevels {
+        SignalLevels {
+            enabled: AtomicBool::new(false),
+            blocks: AtomicU64::new(0),
+            samples: AtomicU64::new(0),
+            input_energy: AtomicU64::new(0),
+            output_energy: AtomicU64::new(0),
+            input_peak: AtomicU32::new(0),
+            output_peak: AtomicU32::new(0),
+            last_input_rms: AtomicU64::new(0),
+            last_output_rms: AtomicU64::new(0),
+            last_input_peak: AtomicU32::new(0),
+            last_output_peak: AtomicU32::new(0),
+        }
+    }
+
+    pub fn set_enabled(&self, enabled: bool) {
+        self.enabled.store(enabled, Ordering::Relaxed);
+    }
+
+    #[inline]
+    pub fn is_enabled(&self) -> bool {
+        self.enabled.load(Ordering::Relaxed)
+    }
+
+    /// Records the levels of one block before and after processing.
+    pub fn record(&self, input: BlockLevels, output: BlockLevels) {
+        fn add(sum: &AtomicU64, value: f64) {
+            let total = f64::from_bits(sum.load(Ordering::Relaxed)) + value;
+            sum.store(total.to_bits(), Ordering::Relaxed);
+        }
+
+        self.blocks.fetch_add(1, Ordering::Relaxed);
+        self.samples
+            .fetch_add(input.num_samples as u64, Ordering::Relaxed);
+        add(&self.input_energy, input.sum_squares);
+        add(&self.output_energy, output.sum_squares);
+        self.input_peak
+            .fetch_max(input.peak.to_bits(), Ordering::Relaxed);
+        self.output_peak
+            .fetch_max(output.peak.to_bits(), Ordering::Relaxed);
+        self.last_input_rms
+            .store(input.rms().to_bits(), Ordering::Relaxed);
+        self.last_output_rms
+            .store(output.rms().to_bits(), Ordering::Relaxed);
+        self.last_input_peak
+            .store(input.peak.to_bits(), Ordering::Relaxed);
+        self.last_output_peak
+            .store(output.peak.to_bits(), Ordering::Relaxed);
+    }
+
+    fn reset(&self) {
+        for value in [
+            &self.blocks,
+            &self.samples,
+            &self.input_energy,
+            &self.output_energy,
+            &self.last_input_rms,
+            &self.last_output_rms,
+        ] {
+            value.store(0, Ordering::Relaxed);
+        }
+        for peak in [
+            &self.input_peak,
+            &self.output_peak,
+            &self.last_input_peak,
+            &self.last_output_peak,
+        ] {
+            peak.store(0, Ordering::Relaxed);
+        }
+    }
+
+    /// Converts the levels into `{ blocks, inputRms, inputPeak, outputRms, outputPeak,
+    /// energyDeltaDb, last: { inputRms, inputPeak, outputRms, outputPeak, energyDeltaDb } }`.
+    fn to_object<'a, C: Context<'a>>(&self, cx: &mut C) -> JsResult<'a, JsObject> {
+        let float = |value: &AtomicU64| f64::from_bits(value.load(Ordering::Relaxed));
+        let peak = |value: &AtomicU32| f64::from(f32::from_bits(value.load(Ordering::Relaxed)));
+
+        let samples = self.samples.load(Ordering::Relaxed) as f64;
+        let input_energy = float(&self.input_energy);
+        let output_energy = float(&self.output_energy);
+        let rms = |energy: f64| {
+            if samples > 0.0 {
+                (energy / samples).sqrt()
+            } else {
+                0.0
+            }
+        };
+
+        let object = cx.empty_object();
+        let blocks = self.blocks.load(Ordering::Relaxed) as f64;
+        set_number(cx, object, "blocks", blocks)?;
+        set_number(cx, object, "inputRms", rms(input_energy))?;
+        set_number(cx, object, "inputPeak", peak(&self.input_peak))?;
+        set_number(cx, object, "outputRms", rms(output_energy))?;
+        set_number(cx, object, "outputPeak", peak(&self.output_peak))?;
+        let delta_db = energy_delta_db(input_energy, output_energy);
+        set_number(cx, object, "energyDeltaDb", delta_db)?;
+
+        let last = cx.empty_object();
+        let last_input_rms = float(&self.last_input_rms);
+        let last_output_rms = float(&self.last_output_rms);
+        set_number(cx, last, "inputRms", last_input_rms)?;
+        set_number(cx, last, "inputPeak", peak(&self.last_input_peak))?;
+        set_number(cx, last, "outputRms", last_output_rms)?;
+        set_number(cx, last, "outputPeak", peak(&self.last_output_peak))?;
+        let last_delta_db = energy_delta_db(
+            last_input_rms * last_input_rms,
+            last_output_rms * last_output_rms,
+        );
+        set_number(cx, last, "energyDeltaDb", last_delta_db)?;
+        object.set(cx, "last", last)?;
+
+        Ok(object)
+    }
+}
+
+thread_local! {
+    /// SDK process time of all processors on this thread since the last `takeProcessTime`.
+    static THREAD_PROCESS_TIME: Cell<Duration> = const { Cell::new(Duration::ZERO) };
+}
+
+/// Runtime statistics of one processor. Recording uses relaxed atomics only, except for
+/// errors, which take a mutex on the error path.
+pub(crate) struct ProcessorStats {
+    calls: AtomicU64,
+    frames: AtomicU64,
+    process_time: LatencyHistogram,
+    lock_acquisitions: AtomicU64,
+    lock_wait: LatencyHistogram,
+    /// Error counts by SDK error code.
+    errors: Mutex<Vec<(&'static str, u64)>>,
+    pub(crate) levels: SignalLevels,
+}
+
+impl ProcessorStats {
+    pub fn new() -> ProcessorStats {
+        ProcessorStats {
+            calls: AtomicU64::new(0),
+            frames: AtomicU64::new(0),
+            process_time: LatencyHistogram::new(),
+            lock_acquisitions: AtomicU64::new(0),
+            lock_wait: LatencyHistogram::new(),
+            errors: Mutex::new(Vec::new()),
+            levels: SignalLevels::new(),
+        }
+    }
+
+    /// Locks `mutex`. Only contended acquisitions read the clock and record their wait.
+    pub fn lock<'m, T>(&self, mutex: &'m Mutex<T>) -> std::sync::MutexGuard<'m, T> {
+        self.lock_acquisitions.fetch_add(1, Ordering::Relaxed);
+        if let Ok(guard) = mutex.try_lock() {
+            return guard;
+        }
+        let start = Instant::now();
+        let guard = mutex.lock().unwrap();
+        self.lock_wait.record(start.elapsed());
+        guard
+    }
+
+    /// Records a process call on `num_frames` frames that took `elapsed`.
+    pub fn record<T>(
+        &self,
+        num_frames: usize,
+        elapsed: Duration,
+        result: &Result<T, sdk::AicError>,
+    ) {
+        self.process_time.record(elapsed);
+        self.calls.fetch_add(1, Ordering::Relaxed);
+        THREAD_PROCESS_TIME.with(|time| time.set(time.get() + elapsed));
+
+        match result {
+            Ok(_) => {
+                self.frames.fetch_add(num_frames as u64, Ordering::Relaxed);
+            }
+            Err(error) => self.record_error(error),
+        }
+    }
+
+    #[cold]
+    fn record_error(&self, error: &sdk::AicError) {
+        let code = error_code(error);
+        let mut errors = self.errors.lock().unwrap();
+        match errors.iter_mut().find(|(name, _)| *name == code) {
+            Some((_, count)) => *count += 1,
+            None => errors.push((code, 1)),
+        }
+    }
+
+    pub fn reset(&self) {
+        self.calls.store(0, Ordering::Relaxed);
+        self.frames.store(0, Ordering::Relaxed);
+        self.process_time.reset();
+        self.lock_acquisitions.store(0, Ordering::Relaxed);
+        self.lock_wait.reset();
+        self.errors.lock().unwrap().clear();
+        self.levels.reset();
+    }
+
+    pub fn to_object<'a, C: Context<'a>>(&self, cx: &mut C) -> JsResult<'a, JsObject> {
+        let object = cx.empty_object();
+        set_number(
+            cx,
+            object,
+            "calls",
+            self.calls.load(Ordering::Relaxed) as f64,
+        )?;
+        set_number(
+            cx,
+            object,
+            "framesProcessed",
+            self.frames.load(Ordering::Relaxed) as f64,
+        )?;
+
+        let process_time = self.process_time.to_object(cx)?;
+        object.set(cx, "processTime", process_time)?;
+
+        let lock = cx.empty_object();
+        let acquisitions = self.lock_acquisitions.load(Ordering::Relaxed);
+        set_number(cx, lock, "acquisitions", acquisitions as f64)?;
+        let wait = self.lock_wait.to_object(cx)?;
+        lock.set(cx, "contendedWait", wait)?;
+        object.set(cx, "lock", lock)?;
+
+        let errors = cx.empty_object();
+        let mut total = 0;
+        for (kind, count) in self.errors.lock().unwrap().iter() {
+            set_number(cx, errors, kind, *count as f64)?;
+            total += count;
+        }
+        set_number(cx, object, "errors", total as f64)?;
+        object.set(cx, "errorsByType", errors)?;
+
+        if self.levels.is_enabled() {
+            let levels = self.levels.to_object(cx)?;
+            object.set(cx, "levels", levels)?;
+        }
+
+        Ok(object)
+    }
+}
+
+fn set_number<'a, C: Context<'a>>(
+    cx: &mut C,
+    object: neon::handle::Handle<'a, JsObject>,
+    key: &str,
+    value: f64,
+) -> neon::result::NeonResult<()> {
+    let value: neon::handle::Handle<JsNumber> = cx.number(value);
+    object.set(cx, key, value)?;
+    Ok(())
+}
+
+/// Returns the SDK process time in milliseconds spent on the calling thread since the
+/// previous call, and starts counting again. Lets `index.js` time a process call with the
+/// native monotonic clock for `diagnostics_channel` and `perf_hooks`.
+fn take_process_time(mut cx: FunctionContext) -> JsResult<JsNumber> {
+    let time = THREAD_PROCESS_TIME.with(|time| time.replace(Duration::ZERO));
+    Ok(cx.number(time.as_secs_f64() * 1e3))
+}
+
+pub fn register_exports(cx: &mut neon::prelude::ModuleContext) -> NeonResult<()> {
+    cx.export_function("takeProcessTime", take_process_time)?;
+    Ok(())
+}
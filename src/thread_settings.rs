@@ -0,0 +1,308 @@
+//! Scheduling and floating-point settings for the native worker threads: CPU affinity,
+//! real-time priority or nice level, and flushing of denormal numbers to zero.
+//!
+//! Settings are applied by the worker itself when it starts. A setting the system does not
+//! permit, e.g. SCHED_FIFO without CAP_SYS_NICE or RLIMIT_RTPRIO, is skipped and reported
+//! instead of failing the worker.
+
+use neon::{
+    handle::Handle,
+    object::Object,
+    prelude::{Context, FunctionContext},
+    result::{JsResult, NeonResult},
+    types::{JsArray, JsBoolean, JsNull, JsNumber, JsObject, JsUndefined, JsValue},
+};
+
+/// Highest CPU index that fits into the kernel's default CPU set.
+const MAX_CPU: usize = 1023;
+
+/// Settings requested for a worker thread. The default leaves the thread as spawned.
+#[derive(Clone, Default)]
+pub(crate) struct ThreadSettings {
+    /// CPUs the thread may run on.
+    cpus: Option<Vec<usize>>,
+    /// SCHED_FIFO priority from 1 to 99.
+    realtime_priority: Option<i32>,
+    /// Nice level from -20 to 19. Also the fallback if real-time scheduling is not permitted.
+    nice: Option<i32>,
+    /// Sets FTZ and DAZ on x86-64, or FZ on AArch64.
+    flush_denormals: bool,
+}
+
+/// Settings in effect on a worker thread, and why requested ones are not.
+#[derive(Clone, Default)]
+pub(crate) struct ThreadReport {
+    cpus: Option<Vec<usize>>,
+    realtime_priority: Option<i32>,
+    nice: Option<i32>,
+    flush_denormals: bool,
+    errors: Vec<String>,
+}
+
+impl ThreadSettings {
+    /// Applies the settings to the calling thread.
+    pub(crate) fn apply(&self) -> ThreadReport {
+        let mut report = ThreadReport::default();
+
+        if let Some(cpus) = &self.cpus {
+            match platform::set_affinity(cpus) {
+                Ok(()) => report.cpus = Some(cpus.clone()),
+                Err(e) => report.errors.push(format!("CPU affinity: {e}")),
+            }
+        }
+        if let Some(priority) = self.realtime_priority {
+            match platform::set_realtime_priority(priority) {
+                Ok(()) => report.realtime_priority = Some(priority),
+                Err(e) => report
+                    .errors
+                    .push(format!("SCHED_FIFO priority {priority}: {e}")),
+            }
+        }
+        // The nice level has no effect on real-time threads
+        if let (None, Some(nice)) = (report.realtime_priority, self.nice) {
+            match platform::set_nice(nice) {
+                Ok(()) => report.nice = Some(nice),
+                Err(e) => report.errors.push(format!("Nice level {nice}: {e}")),
+            }
+        }
+        if self.flush_denormals {
+            match flush_denormals() {
+                Ok(()) => report.flush_denormals = true,
+                Err(e) => report.errors.push(format!("Flushing denormals: {e}")),
+            }
+        }
+
+        report
+    }
+
+    /// Parses `{ cpus, realtimePriority, nice, flushDenormals }`, where every key is
+    /// optional. Null or undefined leaves threads as spawned.
+    pub(crate) fn from_js(
+        cx: &mut FunctionContext,
+        value: Handle<JsValue>,
+    ) -> NeonResult<ThreadSettings> {
+        if value.is_a::<JsNull, _>(cx) || value.is_a::<JsUndefined, _>(cx) {
+            return Ok(ThreadSettings::default());
+        }
+        let options = value.downcast_or_throw::<JsObject, _>(cx)?;
+
+        let cpus = match optional(cx, options, "cpus")? {
+            Some(cpus) => {
+                let cpus = cpus.downcast_or_throw::<JsArray, _>(cx)?;
+                let length = cpus.len(cx);
+                if length == 0 {
+                    return cx.throw_range_error("cpus must not be empty");
+                }
+                let mut indices = Vec::with_capacity(length as usize);
+                for i in 0..length {
+                    let cpu = cpus.get::<JsNumber, _, _>(cx, i)?.value(cx);
+                    indices.push(integer_in(cx, cpu, 0, MAX_CPU as i32, "cpus")? as usize);
+                }
+                Some(indices)
+            }
+            None => None,
+        };
+        let realtime_priority = match optional(cx, options, "realtimePriority")? {
+            Some(priority) => {
+                let priority = priority.downcast_or_throw::<JsNumber, _>(cx)?.value(cx);
+                Some(integer_in(cx, priority, 1, 99, "realtimePriority")?)
+            }
+            None => None,
+        };
+        let nice = match optional(cx, options, "nice")? {
+            Some(nice) => {
+                let nice = nice.downcast_or_throw::<JsNumber, _>(cx)?.value(cx);
+                Some(integer_in(cx, nice, -20, 19, "nice")?)
+            }
+            None => None,
+        };
+        let flush_denormals = match optional(cx, options, "flushDenormals")? {
+            Some(flush) => flush.downcast_or_throw::<JsBoolean, _>(cx)?.value(cx),
+            None => false,
+        };
+
+        Ok(ThreadSettings {
+            cpus,
+            realtime_priority,
+            nice,
+            flush_denormals,
+        })
+    }
+}
+
+impl ThreadReport {
+    /// Converts to `{ cpus, realtimePriority, nice, flushDenormals, errors }`, with null for
+    /// settings not in effect.
+    pub(crate) fn to_js<'a>(&self, cx: &mut impl Context<'a>) -> JsResult<'a, JsObject> {
+        let report = cx.empty_object();
+
+        let cpus = match &self.cpus {
+            Some(cpus) => {
+                let array = cx.empty_array();
+                for (index, cpu) in cpus.iter().enumerate() {
+                    let cpu = cx.number(*cpu as f64);
+                    array.set(cx, index as u32, cpu)?;
+                }
+                array.upcast::<JsValue>()
+            }
+            None => cx.null().upcast(),
+        };
+        report.set(cx, "cpus", cpus)?;
+        for (key, value) in [
+            ("realtimePriority", self.realtime_priority),
+            ("nice", self.nice),
+        ] {
+            let value = match value {
+                Some(value) => cx.number(value).upcast::<JsValue>(),
+                None => cx.null().upcast(),
+            };
+            report.set(cx, key, value)?;
+        }
+        let flush_denormals = cx.boolean(self.flush_denormals);
+        report.set(cx, "flushDenormals", flush_denormals)?;
+
+        let errors = cx.empty_array();
+        for (index, error) in self.errors.iter().enumerate() {
+            let error = cx.string(error);
+            errors.set(cx, index as u32, error)?;
+        }
+        report.set(cx, "errors", errors)?;
+
+        Ok(report)
+    }
+}
+
+/// Reads `options[key]`, or `None` if it is null or undefined.
+fn optional<'a>(
+    cx: &mut FunctionContext<'a>,
+    options: Handle<JsObject>,
+    key: &str,
+) -> NeonResult<Option<Handle<'a, JsValue>>> {
+    let value = options.get::<JsValue, _, _>(cx, key)?;
+    if value.is_a::<JsNull, _>(cx) || value.is_a::<JsUndefined, _>(cx) {
+        return Ok(None);
+    }
+    Ok(Some(value))
+}
+
+fn integer_in(
+    cx: &mut FunctionContext,
+    value: f64,
+    min: i32,
+    max: i32,
+    key: &str,
+) -> NeonResult<i32> {
+    if !(value >= f64::from(min) && value <= f64::from(max) && value.fract() == 0.0) {
+        return cx.throw_range_error(format!("{key} must be an integer from {min} to {max}"));
+    }
+    Ok(value as i32)
+}
+
+#[cfg(target_os = "linux")]
+mod platform {
+    use std::io;
+
+    pub(super) fn set_affinity(cpus: &[usize]) -> io::Result<()> {
+        // SAFETY: `cpu_set_t` is a plain bit set, and all indices are below `CPU_SETSIZE`.
+        let result = unsafe {
+            let mut set: libc::cpu_set_t = std::mem::zeroed();
+            for &cpu in cpus {
+                libc::CPU_SET(cpu, &mut set);
+            }
+            // PID 0 is the calling thread
+            libc::sched_setaffinity(0, size_of::<libc::cpu_set_t>(), &set)
+        };
+        if result != 0 {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(())
+    }
+
+    pub(super) fn set_realtime_priority(priority: i32) -> io::Result<()> {
+        let param = libc::sched_param {
+            sched_priority: priority,
+        };
+        // SAFETY: Changes the scheduling of the calling thread only.
+        let result =
+            unsafe { libc::pthread_setschedparam(libc::pthread_self(), libc::SCHED_FIFO, &param) };
+        if result != 0 {
+            return Err(io::Error::from_raw_os_error(result));
+        }
+        Ok(())
+    }
+
+    pub(super) fn set_nice(nice: i32) -> io::Result<()> {
+        // On Linux the nice level is per thread, addressed by the thread ID
+        // SAFETY: Changes the priority of the calling thread only.
+        let result = unsafe {
+            let tid = libc::syscall(libc::SYS_gettid) as libc::id_t;
+            libc::setpriority(libc::PRIO_PROCESS, tid, nice)
+        };
+        if result != 0 {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(())
+    }
+}
+
+#[cfg(not(target_os = "linux"))]
+mod platform {
+    use std::io;
+
+    fn unsupported() -> io::Error {
+        io::Error::new(io::ErrorKind::Unsupported, "only supported on Linux")
+    }
+
+    pub(super) fn set_affinity(_: &[usize]) -> io::Result<()> {
+        Err(unsupported())
+    }
+
+    pub(super) fn set_realtime_priority(_: i32) -> io::Result<()> {
+        Err(unsupported())
+    }
+
+    pub(super) fn set_nice(_: i32) -> io::Result<()> {
+        Err(unsupported())
+    }
+}
+
+/// Sets flush-to-zero and denormals-are-zero in MXCSR, so SSE and AVX arithmetic on the
+/// thread treats denormal inputs and results as zero.
+#[cfg(target_arch = "x86_64")]
+fn flush_denormals() -> std::io::Result<()> {
+    const FLUSH_TO_ZERO: u32 = 1 << 15;
+    const DENORMALS_ARE_ZERO: u32 = 1 << 6;
+
+    let mut csr = 0u32;
+    // SAFETY: Only the denormal handling of the calling thread changes. The exception masks
+    // and rounding mode are written back unchanged.
+    unsafe {
+        std::arch::asm!("stmxcsr [{}]", in(reg) &mut csr, options(nostack, preserves_flags));
+        csr |= FLUSH_TO_ZERO | DENORMALS_ARE_ZERO;
+        std::arch::asm!("ldmxcsr [{}]", in(reg) &csr, options(nostack, preserves_flags, readonly));
+    }
+    Ok(())
+}
+
+/// Sets flush-to-zero in FPCR, which on AArch64 also treats denormal inputs as zero.
+#[cfg(target_arch = "aarch64")]
+fn flush_denormals() -> std::io::Result<()> {
+    const FLUSH_TO_ZERO: u64 = 1 << 24;
+
+    // SAFETY: Only the denormal handling of the calling thread changes.
+    unsafe {
+        let mut fpcr: u64;
+        std::arch::asm!("mrs {}, fpcr", out(reg) fpcr, options(nomem, nostack, preserves_flags));
+        fpcr |= FLUSH_TO_ZERO;
+        std::arch::asm!("msr fpcr, {}", in(reg) fpcr, options(nomem, nostack, preserves_flags));
+    }
+    Ok(())
+}
+
+#[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+fn flush_denormals() -> std::io::Result<()> {
+    Err(std::io::Error::new(
+        std::io::ErrorKind::Unsupported,
+        "not supported on this architecture",
+    ))
+}
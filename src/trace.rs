@@ -0,0 +1,227 @@
+//! Span tracing of the native layer in Chrome trace format, for Perfetto or `chrome://tracing`.
+//!
+//! Spans are only compiled in with the `trace` feature and only recorded between `traceStart`
+//! and `traceStop`. Without the feature, `span` returns a zero-sized guard and compiles away.
+//!
+//! Timestamps are in microseconds on the clock of `process.hrtime()`, the monotonic clock
+//! V8 also uses for `--cpu-prof`, so traces and CPU profiles line up.
+
+#[cfg(feature = "trace")]
+pub(crate) use enabled::{register_exports, span, span_with_frames};
+
+#[cfg(not(feature = "trace"))]
+pub(crate) use disabled::{span, span_with_frames};
+
+#[cfg(not(feature = "trace"))]
+mod disabled {
+    /// Zero-sized stand-in for a span when tracing is compiled out.
+    pub(crate) struct Span;
+
+    #[inline(always)]
+    pub(crate) fn span(_name: &'static str) -> Span {
+        Span
+    }
+
+    #[inline(always)]
+    pub(crate) fn span_with_frames(_name: &'static str, _num_frames: usize) -> Span {
+        Span
+    }
+}
+
+#[cfg(feature = "trace")]
+mod enabled {
+    use std::cell::Cell;
+    use std::fmt::Write as _;
+    use std::sync::Mutex;
+    use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+    use std::time::Instant;
+
+    use neon::{
+        prelude::{Context, FunctionContext},
+        result::{JsResult, NeonResult},
+        types::{JsNumber, JsString, JsUndefined},
+    };
+
+    /// Upper bound of recorded spans, about 48 MB. Later spans are counted as dropped.
+    const MAX_EVENTS: usize = 1 << 20;
+
+    static ENABLED: AtomicBool = AtomicBool::new(false);
+    static NEXT_THREAD_ID: AtomicU64 = AtomicU64::new(1);
+    static TRACE: Mutex<Option<Trace>> = Mutex::new(None);
+    /// Incremented for every trace, so that each trace names its threads.
+    static GENERATION: AtomicU64 = AtomicU64::new(0);
+
+    thread_local! {
+        static THREAD_ID: u64 = NEXT_THREAD_ID.fetch_add(1, Ordering::Relaxed);
+        /// Generation of the last trace this thread was named in.
+        static NAMED_IN: Cell<u64> = const { Cell::new(0) };
+    }
+
+    struct Event {
+        name: &'static str,
+        start: Instant,
+        end: Instant,
+        thread_id: u64,
+        /// Frames processed in the span, 0 if not applicable.
+        num_frames: usize,
+    }
+
+    struct Trace {
+        generation: u64,
+        /// Same instant as `origin_us` on the `process.hrtime()` clock.
+        origin: Instant,
+        origin_us: f64,
+        events: Vec<Event>,
+        threads: Vec<(u64, String)>,
+        dropped: u64,
+    }
+
+    /// Records the time from its creation to its drop, if tracing was running at creation.
+    pub(crate) struct Span {
+        name: &'static str,
+        num_frames: usize,
+        start: Option<Instant>,
+    }
+
+    #[inline]
+    pub(crate) fn span(name: &'static str) -> Span {
+        span_with_frames(name, 0)
+    }
+
+    #[inline]
+    pub(crate) fn span_with_frames(name: &'static str, num_frames: usize) -> Span {
+        let start = ENABLED.load(Ordering::Relaxed).then(Instant::now);
+        Span {
+            name,
+            num_frames,
+            start,
+        }
+    }
+
+    impl Drop for Span {
+        #[inline]
+        fn drop(&mut self) {
+            if let Some(start) = self.start {
+                record(self.name, start, Instant::now(), self.num_frames);
+            }
+        }
+    }
+
+    #[cold]
+    fn record(name: &'static str, start: Instant, end: Instant, num_frames: usize) {
+        let thread_id = THREAD_ID.with(|id| *id);
+
+        let mut trace = TRACE.lock().unwrap();
+        let Some(trace) = trace.as_mut() else {
+            return;
+        };
+        if NAMED_IN.replace(trace.generation) != trace.generation {
+            let thread_name = match std::thread::current().name() {
+                Some(name) => name.to_owned(),
+                None => format!("thread {thread_id}"),
+            };
+            trace.threads.push((thread_id, thread_name));
+        }
+        if trace.events.len() == MAX_EVENTS {
+            trace.dropped += 1;
+            return;
+        }
+        trace.events.push(Event {
+            name,
+            start,
+            end,
+            thread_id,
+            num_frames,
+        });
+    }
+
+    /// Starts recording. Argument 0 is `process.hrtime()` in microseconds, taken right
+    /// before the call.
+    fn trace_start(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let origin_us = cx.argument::<JsNumber>(0)?.value(&mut cx);
+
+        let mut trace = TRACE.lock().unwrap();
+        if trace.is_some() {
+            return cx.throw_error("A trace is already running");
+        }
+        *trace = Some(Trace {
+            generation: GENERATION.fetch_add(1, Ordering::Relaxed) + 1,
+            origin: Instant::now(),
+            origin_us,
+            events: Vec::with_capacity(MAX_EVENTS / 16),
+            threads: Vec::new(),
+            dropped: 0,
+        });
+        ENABLED.store(true, Ordering::Relaxed);
+
+        Ok(cx.undefined())
+    }
+
+    /// Stops recording and writes the trace as Chrome trace JSON to the path in argument 0.
+    /// Returns the number of recorded spans.
+    fn trace_stop(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let path = cx.argument::<JsString>(0)?.value(&mut cx);
+
+        ENABLED.store(false, Ordering::Relaxed);
+        let Some(trace) = TRACE.lock().unwrap().take() else {
+            return cx.throw_error("No trace is running");
+        };
+
+        std::fs::write(&path, to_json(&trace))
+            .or_else(|e| cx.throw_error(format!("Failed to write trace: {e}")))?;
+
+        Ok(cx.number(trace.events.len() as f64))
+    }
+
+    fn to_json(trace: &Trace) -> String {
+        let pid = std::process::id();
+        let timestamp_us = |instant: Instant| {
+            trace.origin_us
+                + if instant >= trace.origin {
+                    (instant - trace.origin).as_secs_f64() * 1e6
+                } else {
+                    -((trace.origin - instant).as_secs_f64() * 1e6)
+                }
+        };
+
+        let mut json = String::with_capacity(128 * (trace.events.len() + 1));
+        json.push_str("{\"traceEvents\":[\n");
+        for (thread_id, name) in &trace.threads {
+            let name = name.replace(['"', '\\'], "_");
+            let _ = writeln!(
+                json,
+                "{{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":{pid},\"tid\":{thread_id},\
+                 \"args\":{{\"name\":\"{name}\"}}}},"
+            );
+        }
+        for event in &trace.events {
+            let _ = write!(
+                json,
+                "{{\"ph\":\"X\",\"cat\":\"aic\",\"name\":\"{}\",\"pid\":{pid},\"tid\":{},\
+                 \"ts\":{:.3},\"dur\":{:.3}",
+                event.name,
+                event.thread_id,
+                timestamp_us(event.start),
+                (event.end - event.start).as_secs_f64() * 1e6,
+            );
+            if event.num_frames > 0 {
+                let _ = write!(json, ",\"args\":{{\"frames\":{}}}", event.num_frames);
+            }
+            json.push_str("},\n");
+        }
+        let _ = write!(
+            json,
+            "{{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":{pid},\
+             \"args\":{{\"name\":\"aic-sdk-node\"}}}}\n],\
+             \"displayTimeUnit\":\"ms\",\"otherData\":{{\"droppedEvents\":{}}}}}\n",
+            trace.dropped
+        );
+        json
+    }
+
+    pub fn register_exports(cx: &mut neon::prelude::ModuleContext) -> NeonResult<()> {
+        cx.export_function("traceStart", trace_start)?;
+        cx.export_function("traceStop", trace_stop)?;
+        Ok(())
+    }
+}
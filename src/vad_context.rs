@@ -1,10 +1,18 @@
+use std::sync::Arc;
+
 use neon::{
     handle::Handle,
     prelude::{Context, FunctionContext},
     result::{JsResult, NeonResult},
-    types::{Finalize, JsBoolean, JsBox, JsNumber, JsUndefined, JsValue},
+    types::{Finalize, JsBoolean, JsBox, JsNumber, JsString, JsUndefined, JsValue},
 };
 
+use crate::error::throw_aic_error;
+use crate::processor::SharedProcessor;
+use crate::sdk;
+use crate::session;
+use crate::trace;
+
 // VAD parameter constants
 pub const VAD_PARAM_SPEECH_HOLD_DURATION: i32 = 0;
 pub const VAD_PARAM_SENSITIVITY: i32 = 1;
@@ -13,19 +21,21 @@ pub const VAD_PARAM_MINIMUM_SPEECH_DURATION: i32 = 2;
 pub fn parse_vad_parameter(
     cx: &mut FunctionContext,
     value: Handle<JsValue>,
-) -> NeonResult<aic_sdk::VadParameter> {
+) -> NeonResult<sdk::VadParameter> {
     let param_num = value.downcast_or_throw::<JsNumber, _>(cx)?.value(cx) as i32;
 
     match param_num {
-        VAD_PARAM_SPEECH_HOLD_DURATION => Ok(aic_sdk::VadParameter::SpeechHoldDuration),
-        VAD_PARAM_SENSITIVITY => Ok(aic_sdk::VadParameter::Sensitivity),
-        VAD_PARAM_MINIMUM_SPEECH_DURATION => Ok(aic_sdk::VadParameter::MinimumSpeechDuration),
+        VAD_PARAM_SPEECH_HOLD_DURATION => Ok(sdk::VadParameter::SpeechHoldDuration),
+        VAD_PARAM_SENSITIVITY => Ok(sdk::VadParameter::Sensitivity),
+        VAD_PARAM_MINIMUM_SPEECH_DURATION => Ok(sdk::VadParameter::MinimumSpeechDuration),
         _ => cx.throw_error(format!("Invalid VAD parameter: {}", param_num)),
     }
 }
 
+/// VAD context of a processor. The SDK context is resolved on every call, so that it
+/// follows the processor through model swaps.
 pub struct VadContext {
-    pub(crate) inner: aic_sdk::VadContext,
+    pub(crate) processor: Arc<SharedProcessor>,
 }
 
 impl Finalize for VadContext {
@@ -33,40 +43,57 @@ impl Finalize for VadContext {
 }
 
 impl VadContext {
+    /// Gets the VAD context of the processor registered under the session ID passed as
+    /// argument 0. Callable from any worker thread.
+    pub fn from_session(mut cx: FunctionContext) -> JsResult<JsBox<VadContext>> {
+        let id = cx.argument::<JsString>(0)?.value(&mut cx);
+        let processor = match session::lookup(&id) {
+            Ok(processor) => processor,
+            Err(message) => return cx.throw_error(message),
+        };
+        Ok(cx.boxed(VadContext { processor }))
+    }
+
     pub fn is_speech_detected(mut cx: FunctionContext) -> JsResult<JsBoolean> {
+        let _span = trace::span("VadContext.isSpeechDetected");
         let this = cx.argument::<JsBox<VadContext>>(0)?;
-        let detected = this.inner.is_speech_detected();
+        let detected = this
+            .processor
+            .with_vad_context(sdk::VadContext::is_speech_detected);
         Ok(cx.boolean(detected))
     }
 
     pub fn set_parameter(mut cx: FunctionContext) -> JsResult<JsUndefined> {
+        let _span = trace::span("VadContext.setParameter");
         let this = cx.argument::<JsBox<VadContext>>(0)?;
         let parameter_arg = cx.argument::<JsValue>(1)?;
         let parameter = parse_vad_parameter(&mut cx, parameter_arg)?;
         let value = cx.argument::<JsNumber>(2)?.value(&mut cx) as f32;
 
-        this.inner
-            .set_parameter(parameter, value)
-            .or_else(|e| cx.throw_error(e.to_string()))?;
+        this.processor
+            .with_vad_context(|context| context.set_parameter(parameter, value))
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
 
         Ok(cx.undefined())
     }
 
     pub fn get_parameter(mut cx: FunctionContext) -> JsResult<JsNumber> {
+        let _span = trace::span("VadContext.getParameter");
         let this = cx.argument::<JsBox<VadContext>>(0)?;
         let parameter_arg = cx.argument::<JsValue>(1)?;
         let parameter = parse_vad_parameter(&mut cx, parameter_arg)?;
 
         let value = this
-            .inner
-            .parameter(parameter)
-            .or_else(|e| cx.throw_error(e.to_string()))?;
+            .processor
+            .with_vad_context(|context| context.parameter(parameter))
+            .or_else(|e| throw_aic_error(&mut cx, &e))?;
 
         Ok(cx.number(value as f64))
     }
 }
 
 pub fn register_exports(cx: &mut neon::prelude::ModuleContext) -> NeonResult<()> {
+    cx.export_function("vadContextFromSession", VadContext::from_session)?;
     cx.export_function("vadContextIsSpeechDetected", VadContext::is_speech_detected)?;
     cx.export_function("vadContextSetParameter", VadContext::set_parameter)?;
     cx.export_function("vadContextGetParameter", VadContext::get_parameter)?;
@@ -0,0 +1,232 @@
+const assert = require("assert");
+
+const {
+  AudioRing,
+  FrameAdapter,
+  Model,
+  Processor,
+  debugAllocationCount,
+} = require("..");
+const {
+  TEST_AUDIO_PATH,
+  getTestModelPath,
+  licenseKey,
+  loadWavAudio,
+  interleavedToSequential,
+  interleavedToPlanar,
+} = require("./common");
+
+// Asserts that steady-state process calls make no heap allocations in the native module.
+// Requires a build with the `alloc-counter` cargo feature (npm run build:alloc).
+
+const WARMUP_CALLS = 10;
+const MEASURED_CALLS = 100;
+
+/**
+ * Returns the native allocations made by `MEASURED_CALLS` calls of `fn`, after
+ * `WARMUP_CALLS` calls that may still size buffers and build cached error messages.
+ * @param {function(number): void} fn - Function to measure
+ * @returns {number}
+ */
+function allocationsDuring(fn) {
+  for (let i = 0; i < WARMUP_CALLS; i++) {
+    fn(i);
+  }
+  const before = debugAllocationCount();
+  for (let i = 0; i < MEASURED_CALLS; i++) {
+    fn(WARMUP_CALLS + i);
+  }
+  return debugAllocationCount() - before;
+}
+
+/**
+ * Creates an initialized processor and one block of the test signal.
+ */
+function setup(options = {}) {
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const model = Model.fromFile(getTestModelPath());
+  const numFrames = model.getOptimalNumFrames(audio.sampleRate);
+  const numChannels = audio.numChannels;
+  const processor = new Processor(model, licenseKey());
+  processor.initialize(
+    audio.sampleRate,
+    numChannels,
+    numFrames,
+    false,
+    options,
+  );
+  const block = audio.interleavedSamples.slice(0, numFrames * numChannels);
+  return { processor, numFrames, numChannels, block };
+}
+
+/**
+ * Tests the process methods in every layout, including staged unaligned buffers and
+ * delay compensation.
+ */
+function testProcessLayouts() {
+  console.log("Running: testProcessLayouts");
+
+  for (const compensateDelay of [false, true]) {
+    const { processor, numChannels, block } = setup({ compensateDelay });
+    const sequential = interleavedToSequential(block, numChannels);
+    const planar = interleavedToPlanar(block, numChannels);
+    const bytes = Buffer.from(block.buffer.slice(0));
+    const unaligned = Buffer.alloc(block.byteLength + 1).subarray(1);
+    const unalignedPlanar = planar.map((channel) =>
+      Buffer.alloc(channel.byteLength + 1).subarray(1),
+    );
+
+    const cases = {
+      interleaved: () => processor.processInterleaved(block),
+      sequential: () => processor.processSequential(sequential),
+      planar: () => processor.processPlanar(planar),
+      buffer: () => processor.processInterleaved(bytes),
+      unalignedBuffer: () => processor.processInterleaved(unaligned),
+      unalignedPlanar: () => processor.processPlanar(unalignedPlanar),
+    };
+    for (const [name, fn] of Object.entries(cases)) {
+      assert.strictEqual(
+        allocationsDuring(fn),
+        0,
+        `${name} (compensateDelay: ${compensateDelay}) allocated`,
+      );
+    }
+  }
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that rejected process calls do not allocate once their error was seen.
+ */
+function testProcessErrors() {
+  console.log("Running: testProcessErrors");
+
+  const { processor, block } = setup();
+  const wrongSize = block.subarray(0, block.length - 1);
+  const allocations = allocationsDuring(() => {
+    assert.throws(() => processor.processInterleaved(wrongSize));
+  });
+  assert.strictEqual(allocations, 0, "Rejected process calls allocated");
+  console.log("  PASSED");
+}
+
+/**
+ * Tests FrameAdapter with whole blocks, processed in place, and with odd packet sizes,
+ * buffered natively.
+ */
+function testFrameAdapter() {
+  console.log("Running: testFrameAdapter");
+
+  const { processor, numFrames, numChannels, block } = setup();
+  const adapter = new FrameAdapter(processor);
+  const twoBlocks = new Float32Array(2 * block.length);
+  const oddPacket = new Float32Array(Math.floor(numFrames / 3) * numChannels);
+
+  assert.strictEqual(
+    allocationsDuring(() => adapter.push(twoBlocks)),
+    0,
+    "In-place adapter push allocated",
+  );
+  assert.strictEqual(
+    allocationsDuring(() => adapter.push(oddPacket)),
+    0,
+    "Buffered adapter push allocated",
+  );
+  console.log("  PASSED");
+}
+
+/**
+ * Tests processing between audio rings, contiguous and wrapping around.
+ */
+function testProcessRing() {
+  console.log("Running: testProcessRing");
+
+  const { processor, numFrames, numChannels, block } = setup();
+  // Not a multiple of the block size, so blocks regularly wrap around
+  const capacity = 3 * numFrames + 7;
+  const input = new AudioRing(capacity, numChannels);
+  const output = new AudioRing(capacity, numChannels);
+  const enhanced = new Float32Array(block.length);
+
+  const allocations = allocationsDuring(() => {
+    input.write(block);
+    processor.processRing(input, output);
+    output.read(enhanced);
+  });
+  assert.strictEqual(allocations, 0, "Ring processing allocated");
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that statistics and a real-time budget add no allocations to process calls.
+ */
+function testMonitoring() {
+  console.log("Running: testMonitoring");
+
+  const { processor, block } = setup();
+  processor.setRealtimeBudget({ factor: 1e6 });
+  const allocations = allocationsDuring(() =>
+    processor.processInterleaved(block),
+  );
+  assert.strictEqual(allocations, 0, "Monitored process calls allocated");
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that the post-processing stage, including the limiter and PCM packing, adds no
+ * allocations to process calls.
+ */
+function testPostProcess() {
+  console.log("Running: testPostProcess");
+
+  const { processor, block } = setup();
+  processor.setPostProcess({ gain: 4, limiterThreshold: 0.8, pcm16: true });
+  const allocations = allocationsDuring(() =>
+    processor.processInterleaved(block),
+  );
+  assert.strictEqual(allocations, 0, "Post-processed calls allocated");
+  console.log("  PASSED");
+}
+
+// Run all tests
+async function runAllTests() {
+  if (debugAllocationCount() === null) {
+    console.log(
+      "Skipping: the native module was not built with the alloc-counter " +
+        "feature (npm run build:alloc)",
+    );
+    return;
+  }
+
+  console.log("Running allocation tests...\n");
+
+  const tests = [
+    testProcessLayouts,
+    testProcessErrors,
+    testFrameAdapter,
+    testProcessRing,
+    testMonitoring,
+    testPostProcess,
+  ];
+
+  let passed = 0;
+  let failed = 0;
+
+  for (const test of tests) {
+    try {
+      await test();
+      passed++;
+    } catch (error) {
+      console.log(`  FAILED: ${error.message}`);
+      failed++;
+    }
+  }
+
+  console.log(`\nResults: ${passed} passed, ${failed} failed`);
+
+  if (failed > 0) {
+    process.exit(1);
+  }
+}
+
+runAllTests();
@@ -2,7 +2,7 @@ const fs = require("fs");
 const path = require("path");
 const WaveFile = require("wavefile").WaveFile;
 
-const { Model } = require("..");
+const { Model, getBackend } = require("..");
 
 const TEST_AUDIO_PATH = path.join(__dirname, "data", "test_signal.wav");
 const TEST_AUDIO_ENHANCED_PATH = path.join(
@@ -37,6 +37,12 @@ function findExistingModel(targetDir) {
 function getTestModelPath() {
   const targetDir = path.join(__dirname, "..", "target");
 
+  // The mock backend writes its model file offline
+  if (getBackend() === "mock") {
+    fs.mkdirSync(targetDir, { recursive: true });
+    return Model.download("quail-vf-2.1-s-16khz", targetDir);
+  }
+
   const existing = findExistingModel(targetDir);
   if (existing) {
     return existing;
@@ -51,11 +57,15 @@ function getTestModelPath() {
 
 /**
  * Gets the license key from environment variable.
+ * The mock backend accepts any key, so it does not require the variable.
  * @returns {string} - The license key
  * @throws {Error} If AIC_SDK_LICENSE is not set
  */
 function licenseKey() {
   const key = process.env.AIC_SDK_LICENSE;
+  if (!key && getBackend() === "mock") {
+    return "mock-license";
+  }
   if (!key) {
     throw new Error("AIC_SDK_LICENSE environment variable not set");
   }
@@ -1,7 +1,16 @@
 const fs = require("fs");
 const assert = require("assert");
 
-const { Model, Processor, ProcessorParameter } = require("..");
+const { Readable } = require("stream");
+
+const {
+  AudioRing,
+  EnhanceStream,
+  FrameAdapter,
+  Model,
+  Processor,
+  ProcessorParameter,
+} = require("..");
 const {
   TEST_AUDIO_PATH,
   TEST_AUDIO_ENHANCED_PATH,
@@ -167,6 +176,63 @@ function testProcessFullFilePlanar() {
   console.log("  PASSED");
 }
 
+/**
+ * Tests audio enhancement on raw float32 PCM bytes in a Node Buffer at an unaligned offset.
+ * The samples are placed one byte into a larger Buffer so the view cannot be reinterpreted
+ * as a Float32Array, which exercises the processor's aligned scratch path. The output must
+ * match the reference exactly, like the Float32Array variants.
+ */
+function testProcessFullFileUnalignedBuffer() {
+  console.log("Running: testProcessFullFileUnalignedBuffer");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const model = Model.fromFile(getTestModelPath());
+
+  const processor = new Processor(model, licenseKey());
+  processor.initialize(
+    audio.sampleRate,
+    audio.numChannels,
+    audio.numFrames,
+    false,
+  );
+
+  const procCtx = processor.getProcessorContext();
+  procCtx.setParameter(ProcessorParameter.EnhancementLevel, 0.9);
+
+  const inputBytes = Buffer.from(
+    audio.interleavedSamples.buffer,
+    audio.interleavedSamples.byteOffset,
+    audio.interleavedSamples.byteLength,
+  );
+  const backing = Buffer.alloc(inputBytes.length + 1);
+  const bytes = backing.subarray(1);
+  inputBytes.copy(bytes);
+
+  processor.processInterleaved(bytes);
+
+  const expectedOutput = loadWavAudio(TEST_AUDIO_ENHANCED_PATH);
+
+  let mismatchCount = 0;
+  for (let i = 0; i < audio.interleavedSamples.length; i++) {
+    const sample = bytes.readFloatLE(i * 4);
+    if (!approxEqual(sample, expectedOutput.interleavedSamples[i], 1e-6)) {
+      mismatchCount++;
+      if (mismatchCount <= 5) {
+        console.log(
+          `  Sample mismatch at index ${i}: got ${sample}, expected ${expectedOutput.interleavedSamples[i]}`,
+        );
+      }
+    }
+  }
+
+  assert.strictEqual(
+    mismatchCount,
+    0,
+    `${mismatchCount} samples did not match expected output`,
+  );
+  console.log("  PASSED");
+}
+
 /**
  * Tests block-based audio processing with voice activity detection (VAD).
  * Processes audio in optimal frame-sized blocks and collects per-block speech detection results.
@@ -266,16 +332,332 @@ function testProcessBlocksWithVadAndEnhancement() {
   console.log("  PASSED");
 }
 
+/**
+ * Tests processing through shared-memory audio rings.
+ * Streams the test audio through an input AudioRing in packets that are not a multiple of
+ * the block size, drains it with processRing(), and verifies that the output ring yields
+ * exactly what block-wise processInterleaved() produces on a second processor.
+ */
+function testProcessRing() {
+  console.log("Running: testProcessRing");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const model = Model.fromFile(getTestModelPath());
+  const numFrames = model.getOptimalNumFrames(audio.sampleRate);
+  const blockSize = numFrames * audio.numChannels;
+
+  const ringProcessor = new Processor(model, licenseKey());
+  ringProcessor.initialize(
+    audio.sampleRate,
+    audio.numChannels,
+    numFrames,
+    false,
+  );
+  const referenceProcessor = new Processor(model, licenseKey());
+  referenceProcessor.initialize(
+    audio.sampleRate,
+    audio.numChannels,
+    numFrames,
+    false,
+  );
+
+  const input = new AudioRing(4 * numFrames, audio.numChannels);
+  const output = AudioRing.fromSharedBuffer(
+    new AudioRing(audio.numFrames, audio.numChannels).sharedBuffer,
+  );
+
+  const packetSize = (numFrames + 7) * audio.numChannels;
+  const samples = audio.interleavedSamples;
+  let offset = 0;
+  while (offset < samples.length) {
+    const packet = samples.subarray(offset, offset + packetSize);
+    offset += input.write(packet) * audio.numChannels;
+    ringProcessor.processRing(input, output);
+  }
+
+  const numBlocks = Math.floor(audio.numFrames / numFrames);
+  const result = new Float32Array(numBlocks * blockSize);
+  assert.strictEqual(output.read(result), numBlocks * numFrames);
+
+  const expected = new Float32Array(samples.subarray(0, result.length));
+  for (let block = 0; block < numBlocks; block++) {
+    referenceProcessor.processInterleaved(
+      expected.subarray(block * blockSize, (block + 1) * blockSize),
+    );
+  }
+
+  assert.deepStrictEqual(result, expected, "Ring output does not match");
+  console.log("  PASSED");
+}
+
+/**
+ * Tests streaming enhancement with EnhanceStream.
+ * Feeds the test audio as raw bytes in chunks that split samples and frames, and verifies
+ * that the output equals block-wise processing of the input followed by enough silence to
+ * flush the output delay, with exactly getOutputDelay() extra frames.
+ */
+async function testEnhanceStream() {
+  console.log("Running: testEnhanceStream");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const model = Model.fromFile(getTestModelPath());
+  const numFrames = model.getOptimalNumFrames(audio.sampleRate);
+  const blockSize = numFrames * audio.numChannels;
+
+  const streamProcessor = new Processor(model, licenseKey());
+  streamProcessor.initialize(
+    audio.sampleRate,
+    audio.numChannels,
+    numFrames,
+    false,
+  );
+  const referenceProcessor = new Processor(model, licenseKey());
+  referenceProcessor.initialize(
+    audio.sampleRate,
+    audio.numChannels,
+    numFrames,
+    false,
+  );
+  const delay = referenceProcessor.getProcessorContext().getOutputDelay();
+
+  const input = Buffer.from(
+    audio.interleavedSamples.buffer,
+    audio.interleavedSamples.byteOffset,
+    audio.interleavedSamples.byteLength,
+  );
+  const chunks = [];
+  for (let offset = 0; offset < input.length; offset += 1001) {
+    chunks.push(input.subarray(offset, offset + 1001));
+  }
+
+  const outputChunks = [];
+  const stream = Readable.from(chunks).pipe(
+    new EnhanceStream(streamProcessor, { highWaterMarkFrames: 4 * numFrames }),
+  );
+  for await (const chunk of stream) {
+    outputChunks.push(chunk);
+  }
+  const output = Buffer.concat(outputChunks);
+  const result = new Float32Array(
+    output.buffer,
+    output.byteOffset,
+    output.length / 4,
+  );
+
+  const outputFrames = audio.numFrames + delay;
+  assert.strictEqual(result.length, outputFrames * audio.numChannels);
+
+  const numBlocks = Math.ceil(outputFrames / numFrames);
+  const expected = new Float32Array(numBlocks * blockSize);
+  expected.set(audio.interleavedSamples);
+  for (let block = 0; block < numBlocks; block++) {
+    referenceProcessor.processInterleaved(
+      expected.subarray(block * blockSize, (block + 1) * blockSize),
+    );
+  }
+
+  assert.deepStrictEqual(
+    result,
+    expected.subarray(0, result.length),
+    "Stream output does not match",
+  );
+  console.log("  PASSED");
+}
+
+/**
+ * Tests the frame adapter with packets of twice the optimal size followed by odd-sized
+ * packets. Verifies that aligned packets are processed in place without added latency and
+ * that the concatenated output matches block-wise processing of the whole file.
+ */
+function testFrameAdapter() {
+  console.log("Running: testFrameAdapter");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const model = Model.fromFile(getTestModelPath());
+  const numFrames = model.getOptimalNumFrames(audio.sampleRate);
+  const numChannels = audio.numChannels;
+  const blockSize = numFrames * numChannels;
+
+  const adapterProcessor = new Processor(model, licenseKey());
+  adapterProcessor.initialize(audio.sampleRate, numChannels, numFrames, false);
+  const referenceProcessor = new Processor(model, licenseKey());
+  referenceProcessor.initialize(
+    audio.sampleRate,
+    numChannels,
+    numFrames,
+    false,
+  );
+  const delay = referenceProcessor.getProcessorContext().getOutputDelay();
+
+  const adapter = new FrameAdapter(adapterProcessor);
+  const outputChunks = [];
+
+  const packet = audio.interleavedSamples.slice(0, 2 * blockSize);
+  const enhanced = adapter.push(packet);
+  assert.strictEqual(enhanced.buffer, packet.buffer, "Packet was copied");
+  assert.strictEqual(enhanced.length, packet.length);
+  assert.strictEqual(adapter.getAddedLatency(), 0);
+  outputChunks.push(enhanced.slice());
+
+  const oddSize = 333 * numChannels;
+  const numSamples = audio.interleavedSamples.length;
+  for (let offset = packet.length; offset < numSamples; offset += oddSize) {
+    const input = audio.interleavedSamples.slice(offset, offset + oddSize);
+    outputChunks.push(adapter.push(input).slice());
+    assert.ok(adapter.getAddedLatency() < numFrames);
+  }
+  outputChunks.push(adapter.flush().slice());
+
+  const outputFrames = audio.numFrames + delay;
+  const result = new Float32Array(outputFrames * numChannels);
+  let written = 0;
+  for (const chunk of outputChunks) {
+    result.set(chunk, written);
+    written += chunk.length;
+  }
+  assert.strictEqual(written, result.length);
+
+  const numBlocks = Math.ceil(outputFrames / numFrames);
+  const expected = new Float32Array(numBlocks * blockSize);
+  expected.set(audio.interleavedSamples);
+  for (let block = 0; block < numBlocks; block++) {
+    referenceProcessor.processInterleaved(
+      expected.subarray(block * blockSize, (block + 1) * blockSize),
+    );
+  }
+
+  assert.deepStrictEqual(
+    result,
+    expected.subarray(0, result.length),
+    "Adapter output does not match",
+  );
+  console.log("  PASSED");
+}
+
+/**
+ * Tests delay compensation by processing the file block by block with the leading output
+ * delay trimmed natively and the tail produced by flush(). Verifies the output is exactly
+ * as long as the input and matches uncompensated processing with the delay sliced off.
+ */
+function testDelayCompensation() {
+  console.log("Running: testDelayCompensation");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const model = Model.fromFile(getTestModelPath());
+  const numFrames = model.getOptimalNumFrames(audio.sampleRate);
+  const numChannels = audio.numChannels;
+  const blockSize = numFrames * numChannels;
+
+  const processor = new Processor(model, licenseKey());
+  processor.initialize(audio.sampleRate, numChannels, numFrames, false, {
+    compensateDelay: true,
+  });
+  const referenceProcessor = new Processor(model, licenseKey());
+  referenceProcessor.initialize(
+    audio.sampleRate,
+    numChannels,
+    numFrames,
+    false,
+  );
+  const delay = referenceProcessor.getProcessorContext().getOutputDelay();
+
+  const numBlocks = Math.ceil(audio.numFrames / numFrames);
+  const input = new Float32Array(numBlocks * blockSize);
+  input.set(audio.interleavedSamples);
+
+  const result = new Float32Array(input.length + delay * numChannels);
+  let written = 0;
+  for (let block = 0; block < numBlocks; block++) {
+    const samples = input.slice(block * blockSize, (block + 1) * blockSize);
+    const validFrames = processor.processInterleaved(samples);
+    result.set(samples.subarray(0, validFrames * numChannels), written);
+    written += validFrames * numChannels;
+  }
+  assert.strictEqual(written, input.length - delay * numChannels);
+
+  const tail = processor.flush();
+  assert.strictEqual(tail.length, delay * numChannels);
+  result.set(tail, written);
+  written += tail.length;
+  assert.strictEqual(written, input.length);
+
+  const referenceBlocks = numBlocks + Math.ceil(delay / numFrames);
+  const expected = new Float32Array(referenceBlocks * blockSize);
+  expected.set(input);
+  for (let block = 0; block < referenceBlocks; block++) {
+    referenceProcessor.processInterleaved(
+      expected.subarray(block * blockSize, (block + 1) * blockSize),
+    );
+  }
+
+  assert.deepStrictEqual(
+    result.subarray(0, written),
+    expected.subarray(delay * numChannels, delay * numChannels + written),
+    "Compensated output does not match",
+  );
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that runtime statistics count every process call and frame, including failed
+ * calls, and that resetStats() clears them.
+ */
+function testProcessorStats() {
+  console.log("Running: testProcessorStats");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const model = Model.fromFile(getTestModelPath());
+  const numFrames = model.getOptimalNumFrames(audio.sampleRate);
+  const numChannels = audio.numChannels;
+
+  const processor = new Processor(model, licenseKey());
+  processor.initialize(audio.sampleRate, numChannels, numFrames, false);
+
+  const numBlocks = 20;
+  const block = new Float32Array(numFrames * numChannels);
+  for (let i = 0; i < numBlocks; i++) {
+    const offset = i * block.length;
+    block.set(
+      audio.interleavedSamples.subarray(offset, offset + block.length),
+    );
+    processor.processInterleaved(block);
+  }
+
+  let stats = processor.getStats();
+  assert.strictEqual(stats.calls, numBlocks);
+  assert.strictEqual(stats.framesProcessed, numBlocks * numFrames);
+  assert.strictEqual(stats.errors, 0);
+  assert.strictEqual(stats.processTime.count, numBlocks);
+  assert.ok(stats.processTime.p50Us > 0, "p50 should be positive");
+  assert.ok(stats.processTime.p50Us <= stats.processTime.p99Us);
+  assert.ok(stats.processTime.p99Us <= stats.processTime.maxUs);
+  assert.ok(stats.lock.acquisitions >= numBlocks);
+
+  processor.resetStats();
+  stats = processor.getStats();
+  assert.strictEqual(stats.calls, 0);
+  assert.strictEqual(stats.framesProcessed, 0);
+  assert.strictEqual(stats.processTime.count, 0);
+  assert.strictEqual(stats.processTime.maxUs, 0);
+  console.log("  PASSED");
+}
+
 // Run all tests
-function runAllTests() {
+async function runAllTests() {
   console.log("Running end-to-end tests...\n");
 
   const tests = [
     testProcessFullFileInterleaved,
     testProcessFullFileSequential,
     testProcessFullFilePlanar,
+    testProcessFullFileUnalignedBuffer,
     testProcessBlocksWithVad,
     testProcessBlocksWithVadAndEnhancement,
+    testProcessRing,
+    testEnhanceStream,
+    testFrameAdapter,
+    testDelayCompensation,
+    testProcessorStats,
   ];
 
   let passed = 0;
@@ -283,7 +665,7 @@ function runAllTests() {
 
   for (const test of tests) {
     try {
-      test();
+      await test();
       passed++;
     } catch (error) {
       console.log(`  FAILED: ${error.message}`);
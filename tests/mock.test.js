@@ -0,0 +1,1362 @@
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+const assert = require("assert");
+const diagnosticsChannel = require("diagnostics_channel");
+const { PerformanceObserver } = require("perf_hooks");
+const { Worker } = require("worker_threads");
+
+const { Readable } = require("stream");
+
+const {
+  AudioRing,
+  DaemonClient,
+  EnhanceStream,
+  EnhancementDaemon,
+  FrameAdapter,
+  Model,
+  MultiChannelProcessor,
+  PROCESS_CHANNEL,
+  Pipeline,
+  Processor,
+  PostStatus,
+  ProcessorContext,
+  ProcessorParameter,
+  VadContext,
+  VadParameter,
+  enablePerformanceEntries,
+  getBackend,
+  getBinaryVariant,
+  init,
+  isTracingAvailable,
+  startTrace,
+  stopTrace,
+} = require("..");
+const {
+  TEST_AUDIO_PATH,
+  loadWavAudio,
+  interleavedToSequential,
+  sequentialToInterleaved,
+  interleavedToPlanar,
+  planarToInterleaved,
+} = require("./common");
+
+// Binding tests against the mock backend. The mock processor delays the audio by the
+// output delay instead of enhancing it, so every output sample is known exactly.
+
+/**
+ * Writes a mock model file and loads it.
+ * @param {Object} config - Mock model keys, see src/mock.rs
+ * @returns {Model}
+ */
+function mockModel(config) {
+  const lines = Object.entries(config).map(
+    ([key, value]) => `${key} = ${value}`,
+  );
+  const modelPath = path.join(
+    fs.mkdtempSync(path.join(os.tmpdir(), "aic-mock-")),
+    "model.aicmodel",
+  );
+  fs.writeFileSync(modelPath, lines.join("\n") + "\n");
+  return Model.fromFile(modelPath);
+}
+
+/**
+ * Returns `samples` delayed by `delay` frames with silence in front, truncated to the
+ * original length.
+ */
+function delayed(samples, numChannels, delay) {
+  const result = new Float32Array(samples.length);
+  const delaySamples = delay * numChannels;
+  result.set(samples.subarray(0, samples.length - delaySamples), delaySamples);
+  return result;
+}
+
+/**
+ * Creates a processor on the test signal's sample rate and channel count.
+ */
+function setup(audio, modelConfig = {}, options = {}) {
+  const model = mockModel({ sample_rate: audio.sampleRate, ...modelConfig });
+  const numFrames = model.getOptimalNumFrames(audio.sampleRate);
+  const processor = new Processor(model, "mock-license");
+  processor.initialize(
+    audio.sampleRate,
+    audio.numChannels,
+    numFrames,
+    false,
+    options,
+  );
+  const delay = processor.getProcessorContext().getOutputDelay();
+  return { processor, numFrames, delay };
+}
+
+/**
+ * Trims the test signal to whole blocks.
+ */
+function wholeBlocks(audio, numFrames) {
+  const blockSize = numFrames * audio.numChannels;
+  const numBlocks = Math.floor(audio.interleavedSamples.length / blockSize);
+  return audio.interleavedSamples.slice(0, numBlocks * blockSize);
+}
+
+/**
+ * Tests that interleaved, sequential, planar and unaligned Buffer inputs all reach the
+ * backend with the right layout, by checking the output is the input delayed exactly.
+ */
+function testMockLayouts() {
+  console.log("Running: testMockLayouts");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const numChannels = audio.numChannels;
+  const layouts = {
+    interleaved: (processor, block) => {
+      processor.processInterleaved(block);
+      return block;
+    },
+    sequential: (processor, block) => {
+      const sequential = interleavedToSequential(block, numChannels);
+      processor.processSequential(sequential);
+      return sequentialToInterleaved(sequential, numChannels);
+    },
+    planar: (processor, block) => {
+      const planar = interleavedToPlanar(block, numChannels);
+      processor.processPlanar(planar);
+      return planarToInterleaved(planar);
+    },
+    unalignedBuffer: (processor, block) => {
+      const bytes = Buffer.alloc(block.byteLength + 1);
+      Buffer.from(block.buffer).copy(bytes, 1);
+      const view = bytes.subarray(1);
+      processor.processInterleaved(view);
+      return new Float32Array(new Uint8Array(view).buffer);
+    },
+  };
+
+  for (const [layout, processLayout] of Object.entries(layouts)) {
+    const { processor, numFrames, delay } = setup(audio);
+    const blockSize = numFrames * numChannels;
+    const input = wholeBlocks(audio, numFrames);
+    const output = new Float32Array(input.length);
+
+    for (let offset = 0; offset < input.length; offset += blockSize) {
+      const block = input.slice(offset, offset + blockSize);
+      output.set(processLayout(processor, block), offset);
+    }
+
+    assert.deepStrictEqual(
+      output,
+      delayed(input, numChannels, delay),
+      `${layout} output is not the delayed input`,
+    );
+  }
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that delay compensation makes the output identical to the input, including
+ * a delay longer than one block.
+ */
+function testMockDelayCompensation() {
+  console.log("Running: testMockDelayCompensation");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const { processor, numFrames, delay } = setup(
+    audio,
+    { delay_ms: 25 },
+    { compensateDelay: true },
+  );
+  assert.ok(delay > numFrames, "Delay should span several blocks");
+
+  const blockSize = numFrames * audio.numChannels;
+  const input = wholeBlocks(audio, numFrames);
+  const output = [];
+  for (let offset = 0; offset < input.length; offset += blockSize) {
+    const block = input.slice(offset, offset + blockSize);
+    const validFrames = processor.processInterleaved(block);
+    output.push(...block.subarray(0, validFrames * audio.numChannels));
+  }
+  output.push(...processor.flush());
+
+  assert.deepStrictEqual(Float32Array.from(output), input);
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that the VAD context reports the configured per-block pattern.
+ */
+function testMockVadPattern() {
+  console.log("Running: testMockVadPattern");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const { processor, numFrames } = setup(audio, { vad_pattern: "0110" });
+  const vad = processor.getVadContext();
+  const block = new Float32Array(numFrames * audio.numChannels);
+
+  const detected = [];
+  for (let i = 0; i < 8; i++) {
+    processor.processInterleaved(block);
+    detected.push(vad.isSpeechDetected());
+  }
+
+  assert.deepStrictEqual(detected, [
+    false,
+    true,
+    true,
+    false,
+    false,
+    true,
+    true,
+    false,
+  ]);
+  console.log("  PASSED");
+}
+
+/**
+ * Tests the worker pool path of EnhanceStream and the in-place path of FrameAdapter
+ * with odd chunk sizes.
+ */
+async function testMockStreamAndAdapter() {
+  console.log("Running: testMockStreamAndAdapter");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const numChannels = audio.numChannels;
+  const input = audio.interleavedSamples;
+
+  const stream = setup(audio, {}, { compensateDelay: true });
+  const bytes = Buffer.from(input.buffer, input.byteOffset, input.byteLength);
+  const chunks = [];
+  for (let offset = 0; offset < bytes.length; offset += 999) {
+    chunks.push(bytes.subarray(offset, offset + 999));
+  }
+  const outputChunks = [];
+  for await (const chunk of Readable.from(chunks).pipe(
+    new EnhanceStream(stream.processor),
+  )) {
+    outputChunks.push(chunk);
+  }
+  const streamed = new Uint8Array(Buffer.concat(outputChunks));
+  assert.deepStrictEqual(
+    new Float32Array(streamed.buffer),
+    input,
+    "Stream output is not the input",
+  );
+
+  const { processor, numFrames, delay } = setup(audio);
+  const adapter = new FrameAdapter(processor);
+  const adapted = [];
+  const packetSize = 2 * numFrames * numChannels;
+  for (let offset = 0; offset < input.length; offset += packetSize) {
+    adapted.push(...adapter.push(input.slice(offset, offset + packetSize)));
+  }
+  adapted.push(...adapter.flush());
+
+  const expected = new Float32Array(input.length + delay * numChannels);
+  expected.set(input, delay * numChannels);
+  assert.deepStrictEqual(Float32Array.from(adapted), expected);
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that sustained deadline misses step through the shedding levels down to bypass,
+ * that a run of calls within budget undoes a step, that the output stays aligned, and
+ * that enhancement levels outside 0 to 1 are rejected as steps.
+ */
+async function testMockRealtimeShedding() {
+  console.log("Running: testMockRealtimeShedding");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  // Every call at full enhancement takes twice the block duration
+  const { processor, numFrames, delay } = setup(audio, {
+    real_time_factor: 2,
+  });
+  const context = processor.getProcessorContext();
+  const events = [];
+  processor.setRealtimeBudget({
+    factor: 1,
+    windowCalls: 4,
+    missThreshold: 2,
+    recoverCalls: 3,
+    steps: [0.75, "bypass"],
+    onEvent: (event) => events.push(event),
+  });
+  // Held while shedding, instead of undoing the first step
+  context.scheduleParameter(
+    ProcessorParameter.EnhancementLevel,
+    1.0,
+    2 * numFrames,
+  );
+
+  const blockSize = numFrames * audio.numChannels;
+  const input = wholeBlocks(audio, numFrames).subarray(0, 7 * blockSize);
+  const output = new Float32Array(input.length);
+  const states = [];
+  for (let offset = 0; offset < input.length; offset += blockSize) {
+    const block = input.slice(offset, offset + blockSize);
+    processor.processInterleaved(block);
+    output.set(block, offset);
+    states.push([
+      context.getParameter(ProcessorParameter.EnhancementLevel),
+      context.getParameter(ProcessorParameter.Bypass),
+    ]);
+  }
+
+  // Two misses per step at level 1 and 0.75, then three free calls in bypass
+  assert.deepStrictEqual(states, [
+    [1, 0],
+    [0.75, 0],
+    [0.75, 0],
+    [0.75, 1],
+    [0.75, 1],
+    [0.75, 1],
+    [0.75, 0],
+  ]);
+  assert.deepStrictEqual(
+    output,
+    delayed(input, audio.numChannels, delay),
+    "Shedding changed the output alignment",
+  );
+
+  const realtime = processor.getStats().realtime;
+  assert.strictEqual(realtime.calls, 7);
+  assert.strictEqual(realtime.misses, 4);
+  assert.strictEqual(realtime.step, 1);
+
+  for (let i = 0; i < 100 && events.length < 3; i++) {
+    await new Promise((resolve) => setTimeout(resolve, 10));
+  }
+  assert.deepStrictEqual(
+    events.map((event) => [event.type, event.step, event.bypass]),
+    [
+      ["shed", 1, false],
+      ["shed", 2, true],
+      ["recover", 1, false],
+    ],
+  );
+
+  // A level set while shedding replaces the one restored on recovery
+  context.setParameter(ProcessorParameter.EnhancementLevel, 0.625);
+  processor.setRealtimeBudget(null);
+  assert.strictEqual(
+    context.getParameter(ProcessorParameter.EnhancementLevel),
+    0.625,
+  );
+  assert.strictEqual(processor.getStats().realtime, undefined);
+
+  for (const level of [NaN, Infinity, -0.5, 1.5]) {
+    assert.throws(
+      () => processor.setRealtimeBudget({ steps: [level, "bypass"] }),
+      RangeError,
+    );
+  }
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that a trace records spans of the process path on the hrtime clock and is written
+ * as Chrome trace JSON.
+ */
+function testMockTrace() {
+  console.log("Running: testMockTrace");
+
+  if (!isTracingAvailable()) {
+    console.log("  SKIPPED: built without the trace feature");
+    return;
+  }
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const { processor, numFrames } = setup(audio);
+  const vad = processor.getVadContext();
+  const block = new Float32Array(numFrames * audio.numChannels);
+  const tracePath = path.join(
+    fs.mkdtempSync(path.join(os.tmpdir(), "aic-trace-")),
+    "trace.json",
+  );
+
+  const startUs = Number(process.hrtime.bigint() / 1000n);
+  startTrace();
+  assert.throws(() => startTrace(), /already running/);
+  for (let i = 0; i < 4; i++) {
+    processor.processInterleaved(block);
+    vad.isSpeechDetected();
+  }
+  const numSpans = stopTrace(tracePath);
+  const endUs = Number(process.hrtime.bigint() / 1000n);
+  assert.throws(() => stopTrace(tracePath), /No trace is running/);
+
+  const trace = JSON.parse(fs.readFileSync(tracePath, "utf8"));
+  const spans = trace.traceEvents.filter((event) => event.ph === "X");
+  assert.strictEqual(spans.length, numSpans);
+  const count = (name) => spans.filter((span) => span.name === name).length;
+  assert.strictEqual(count("Processor.processInterleaved"), 4);
+  assert.strictEqual(count("convertArguments"), 4);
+  assert.strictEqual(count("lock"), 4);
+  assert.strictEqual(count("sdk.process"), 4);
+  assert.strictEqual(count("VadContext.isSpeechDetected"), 4);
+
+  for (const span of spans) {
+    assert.ok(span.ts >= startUs - 1 && span.ts + span.dur <= endUs + 1);
+  }
+  const processSpan = spans.find((span) => span.name === "sdk.process");
+  assert.strictEqual(processSpan.args.frames, numFrames);
+  assert.ok(
+    trace.traceEvents.some(
+      (event) => event.ph === "M" && event.name === "thread_name",
+    ),
+  );
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that process calls are published to diagnostics_channel subscribers and to
+ * PerformanceObserver with the natively measured processing time.
+ */
+async function testMockDiagnostics() {
+  console.log("Running: testMockDiagnostics");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  // Every call busy-waits for half of the block duration
+  const { processor, numFrames } = setup(audio, { real_time_factor: 0.5 });
+  const blockMs = (1000 * numFrames) / audio.sampleRate;
+  const block = new Float32Array(numFrames * audio.numChannels);
+  const planar = interleavedToPlanar(block, audio.numChannels);
+
+  const messages = [];
+  const onMessage = (message) => messages.push(message);
+  diagnosticsChannel.subscribe(PROCESS_CHANNEL, onMessage);
+  processor.processInterleaved(block);
+  processor.processPlanar(planar);
+  const wrongSize = block.subarray(audio.numChannels);
+  assert.throws(() => processor.processSequential(wrongSize));
+  diagnosticsChannel.unsubscribe(PROCESS_CHANNEL, onMessage);
+  processor.processInterleaved(block);
+
+  assert.deepStrictEqual(
+    messages.map((message) => [
+      message.layout,
+      message.numFrames,
+      message.error !== undefined,
+    ]),
+    [
+      ["interleaved", numFrames, false],
+      ["planar", numFrames, false],
+      ["sequential", numFrames - 1, true],
+    ],
+  );
+  assert.strictEqual(messages[0].processor, processor);
+  assert.ok(messages[0].sdkDuration >= 0.4 * blockMs);
+  assert.ok(messages[0].sdkDuration < 10 * blockMs);
+  assert.ok(messages[0].duration >= 0.4 * blockMs);
+  // Calls are measured from start to end on the performance.now() timeline
+  const firstEnd = messages[0].startTime + messages[0].duration;
+  assert.ok(firstEnd <= messages[1].startTime + 1e-3);
+
+  const entries = [];
+  const observer = new PerformanceObserver((list) =>
+    entries.push(...list.getEntriesByName("aic-sdk.process")),
+  );
+  observer.observe({ entryTypes: ["measure"] });
+  enablePerformanceEntries();
+  processor.processInterleaved(block);
+  enablePerformanceEntries(false);
+  processor.processInterleaved(block);
+  await new Promise((resolve) => setImmediate(resolve));
+  observer.disconnect();
+
+  assert.strictEqual(entries.length, 1);
+  assert.strictEqual(entries[0].detail.layout, "interleaved");
+  assert.strictEqual(entries[0].detail.numFrames, numFrames);
+  assert.ok(entries[0].duration >= 0.4 * blockMs);
+  assert.ok(entries[0].detail.sdkDuration >= 0.4 * blockMs);
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that each channel of a MultiChannelProcessor is delayed on its own, that
+ * interleaved and planar input give the same output, and that channels have separate
+ * contexts.
+ */
+function testMockMultiChannel() {
+  console.log("Running: testMockMultiChannel");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const model = mockModel({ sample_rate: audio.sampleRate });
+  const numFrames = model.getOptimalNumFrames(audio.sampleRate);
+  const numChannels = 3;
+  const gains = [1, -1, 0.5];
+
+  const mono = audio.interleavedSamples.filter(
+    (_, i) => i % audio.numChannels === 0,
+  );
+  const numBlocks = Math.floor(mono.length / numFrames);
+  const input = new Float32Array(numBlocks * numFrames * numChannels);
+  for (let i = 0; i < input.length; i++) {
+    input[i] = mono[Math.floor(i / numChannels)] * gains[i % numChannels];
+  }
+
+  const interleaved = new MultiChannelProcessor(model, "mock-license", 3);
+  const planar = new MultiChannelProcessor(model, "mock-license", 3);
+  interleaved.initialize(audio.sampleRate, numFrames);
+  planar.initialize(audio.sampleRate, numFrames);
+  const delay = interleaved.getProcessorContext(1).getOutputDelay();
+  assert.ok(delay > 0);
+
+  const blockSize = numFrames * numChannels;
+  const output = new Float32Array(input.length);
+  const planarOutput = new Float32Array(input.length);
+  for (let offset = 0; offset < input.length; offset += blockSize) {
+    const block = input.slice(offset, offset + blockSize);
+    const channels = interleavedToPlanar(block, numChannels);
+    assert.strictEqual(interleaved.processInterleaved(block), numFrames);
+    assert.strictEqual(planar.processPlanar(channels), numFrames);
+    output.set(block, offset);
+    planarOutput.set(planarToInterleaved(channels), offset);
+  }
+
+  assert.deepStrictEqual(output, delayed(input, numChannels, delay));
+  assert.deepStrictEqual(planarOutput, output);
+  assert.strictEqual(interleaved.getStats(2).calls, numBlocks);
+
+  interleaved
+    .getProcessorContext(2)
+    .setParameter(ProcessorParameter.EnhancementLevel, 0.25);
+  assert.strictEqual(
+    interleaved
+      .getProcessorContext(0)
+      .getParameter(ProcessorParameter.EnhancementLevel),
+    1,
+  );
+  assert.throws(() => interleaved.getVadContext(3), RangeError);
+  assert.throws(
+    () => planar.processPlanar([new Float32Array(numFrames)]),
+    RangeError,
+  );
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that swapping to a model with a shorter delay and back keeps the output exactly
+ * aligned, that a longer delay is reported, and that contexts follow the swaps.
+ */
+async function testMockModelSwap() {
+  console.log("Running: testMockModelSwap");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const { processor, numFrames, delay } = setup(audio, { delay_ms: 10 });
+  const shortDelay = mockModel({ sample_rate: audio.sampleRate, delay_ms: 5 });
+  const longDelay = mockModel({ sample_rate: audio.sampleRate, delay_ms: 20 });
+  const original = mockModel({ sample_rate: audio.sampleRate, delay_ms: 10 });
+  const context = processor.getProcessorContext();
+
+  const blockSize = numFrames * audio.numChannels;
+  const input = wholeBlocks(audio, numFrames);
+  const output = new Float32Array(input.length);
+  let offset = 0;
+
+  // Processes blocks until the swap has completed
+  async function swapWhileProcessing(model) {
+    let result;
+    const swap = processor
+      .swapModel(model, { warmupMs: 20, crossfadeMs: 10 })
+      .then((value) => (result = value));
+    while (result === undefined) {
+      assert.ok(offset < input.length, "Swap did not complete");
+      const block = input.slice(offset, offset + blockSize);
+      processor.processInterleaved(block);
+      output.set(block, offset);
+      offset += blockSize;
+      await new Promise((resolve) => setImmediate(resolve));
+    }
+    await swap;
+    return result;
+  }
+
+  assert.deepStrictEqual(await swapWhileProcessing(shortDelay), {
+    outputDelay: delay,
+  });
+  await assert.rejects(
+    Promise.all([
+      processor.swapModel(original),
+      processor.swapModel(original),
+    ]),
+    /already in progress/,
+  );
+  processor.initialize(audio.sampleRate, audio.numChannels, numFrames);
+  offset = 0;
+
+  await swapWhileProcessing(shortDelay);
+  assert.deepStrictEqual(await swapWhileProcessing(original), {
+    outputDelay: delay,
+  });
+  const processed = output.subarray(0, offset);
+  assert.deepStrictEqual(
+    processed,
+    delayed(input.subarray(0, offset), audio.numChannels, delay),
+  );
+
+  const { outputDelay } = await swapWhileProcessing(longDelay);
+  assert.strictEqual(outputDelay, 2 * delay);
+
+  // A context taken before the swaps controls the current model
+  context.setParameter(ProcessorParameter.EnhancementLevel, 0.5);
+  assert.strictEqual(
+    processor
+      .getProcessorContext()
+      .getParameter(ProcessorParameter.EnhancementLevel),
+    0.5,
+  );
+  assert.strictEqual(context.getOutputDelay(), 2 * delay);
+  console.log("  PASSED");
+}
+
+/**
+ * Tests the post-processing stage on sequential input: gain, clip counting and peak
+ * without limiter, then a limiter that keeps the output below full scale, with the PCM
+ * output packed interleaved. Also tests that flush() runs the stage and that paths which
+ * cannot run it throw.
+ */
+function testMockPostProcess() {
+  console.log("Running: testMockPostProcess");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const { numChannels } = audio;
+  const { processor, numFrames, delay } = setup(audio);
+  const blockSize = numFrames * numChannels;
+  const input = wholeBlocks(audio, numFrames);
+  const gain = 8;
+  const expected = delayed(input, numChannels, delay).map((x) => x * gain);
+
+  for (const limiterThreshold of [null, 0.5]) {
+    processor.getProcessorContext().reset();
+    const post = processor.setPostProcess({
+      gain,
+      limiterThreshold,
+      pcm16: true,
+    });
+    let clipped = 0;
+    let limited = 0;
+    for (let offset = 0; offset < input.length; offset += blockSize) {
+      const block = input.slice(offset, offset + blockSize);
+      const sequential = interleavedToSequential(block, numChannels);
+      assert.strictEqual(processor.processSequential(sequential), numFrames);
+      const output = sequentialToInterleaved(sequential, numChannels);
+      const reference = expected.subarray(offset, offset + blockSize);
+
+      let peak = 0;
+      for (let i = 0; i < blockSize; i++) {
+        peak = Math.max(peak, Math.abs(reference[i]));
+        if (limiterThreshold === null) {
+          assert.strictEqual(output[i], reference[i]);
+        } else if (Math.abs(reference[i]) > limiterThreshold) {
+          limited++;
+          assert.ok(Math.abs(output[i]) <= 1, "Not limited");
+        } else {
+          assert.strictEqual(output[i], reference[i]);
+        }
+        clipped += Math.abs(output[i]) > 1 ? 1 : 0;
+        const packed = Math.max(-32768, Math.min(32767, output[i] * 32768));
+        assert.ok(Math.abs(post.pcm16[i] - packed) <= 0.5 + 1e-3);
+      }
+      assert.strictEqual(post.status[PostStatus.Peak], peak);
+      assert.strictEqual(post.status[PostStatus.Frames], numFrames);
+    }
+    assert.strictEqual(post.status[PostStatus.TotalClipped], clipped);
+    // The total is only reset by setPostProcess(), not by initialize()
+    processor.initialize(audio.sampleRate, numChannels, numFrames, false);
+    assert.strictEqual(post.status[PostStatus.TotalClipped], clipped);
+    if (limiterThreshold === null) {
+      assert.ok(clipped > 0, "Gain should clip the test signal");
+    } else {
+      assert.ok(limited > 0, "Limiter should have engaged");
+      assert.strictEqual(clipped, 0);
+    }
+  }
+
+  // Transferring the PCM output detaches it; later calls stop packing instead of
+  // writing into memory the processor no longer owns
+  const post = processor.setPostProcess({ gain, pcm16: true });
+  const transferred = structuredClone(post.pcm16, {
+    transfer: [post.pcm16.buffer],
+  });
+  assert.strictEqual(post.pcm16.length, 0);
+  const before = transferred.slice();
+  processor.processInterleaved(input.slice(0, blockSize));
+  assert.deepStrictEqual(transferred, before);
+  assert.strictEqual(post.status[PostStatus.Frames], numFrames);
+
+  const tailPost = processor.setPostProcess({ gain: 0.5, pcm16: true });
+  processor.getProcessorContext().reset();
+  processor.processInterleaved(input.slice(0, blockSize));
+  const tail = processor.flush();
+  const held = input.subarray(blockSize - delay * numChannels, blockSize);
+  assert.deepStrictEqual(tail, held.map((x) => x * 0.5));
+  assert.strictEqual(tailPost.status[PostStatus.Frames], delay);
+  for (let i = 0; i < tail.length; i++) {
+    assert.ok(Math.abs(tailPost.pcm16[i] - tail[i] * 32768) <= 0.5 + 1e-3);
+  }
+  const ring = new AudioRing(4 * numFrames, numChannels);
+  assert.throws(() => processor.processRing(ring, ring), /post-process/);
+  assert.throws(
+    () => new FrameAdapter(processor).push(input.slice(0, blockSize)),
+    /post-process/,
+  );
+
+  assert.strictEqual(processor.setPostProcess(null), null);
+  processor.getProcessorContext().reset();
+  const block = input.slice(0, blockSize);
+  processor.processInterleaved(block);
+  assert.deepStrictEqual(
+    block,
+    delayed(input, numChannels, delay).subarray(0, blockSize),
+  );
+  console.log("  PASSED");
+}
+
+/**
+ * Tests the signal levels of input and output, the input delayed by the mock, against
+ * levels computed in JavaScript.
+ */
+function testMockSignalMetrics() {
+  console.log("Running: testMockSignalMetrics");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const { processor, numFrames, delay } = setup(audio);
+  const blockSize = numFrames * audio.numChannels;
+  const input = wholeBlocks(audio, numFrames);
+  const output = delayed(input, audio.numChannels, delay);
+
+  function levels(samples) {
+    let energy = 0;
+    let peak = 0;
+    for (const sample of samples) {
+      energy += sample * sample;
+      peak = Math.max(peak, Math.abs(sample));
+    }
+    return { energy, peak, rms: Math.sqrt(energy / samples.length) };
+  }
+  function assertClose(actual, expected, name) {
+    const tolerance = 1e-5 * Math.max(1, Math.abs(expected));
+    assert.ok(
+      Math.abs(actual - expected) <= tolerance,
+      `${name}: ${actual} != ${expected}`,
+    );
+  }
+
+  assert.strictEqual(processor.getStats().levels, undefined);
+  processor.setSignalMetrics(true);
+  for (let offset = 0; offset < input.length; offset += blockSize) {
+    processor.processInterleaved(input.slice(offset, offset + blockSize));
+  }
+
+  const stats = processor.getStats().levels;
+  const inputLevels = levels(input);
+  const outputLevels = levels(output);
+  assert.strictEqual(stats.blocks, input.length / blockSize);
+  assertClose(stats.inputRms, inputLevels.rms, "inputRms");
+  assertClose(stats.outputRms, outputLevels.rms, "outputRms");
+  assert.strictEqual(stats.inputPeak, inputLevels.peak);
+  assert.strictEqual(stats.outputPeak, outputLevels.peak);
+  assertClose(
+    stats.energyDeltaDb,
+    10 * Math.log10(outputLevels.energy / inputLevels.energy),
+    "energyDeltaDb",
+  );
+
+  const lastBlock = input.length - blockSize;
+  const lastInput = levels(input.subarray(lastBlock));
+  const lastOutput = levels(output.subarray(lastBlock));
+  assertClose(stats.last.inputRms, lastInput.rms, "last.inputRms");
+  assertClose(stats.last.outputRms, lastOutput.rms, "last.outputRms");
+  assert.strictEqual(stats.last.outputPeak, lastOutput.peak);
+
+  processor.resetStats();
+  assert.strictEqual(processor.getStats().levels.blocks, 0);
+  processor.setSignalMetrics(false);
+  assert.strictEqual(processor.getStats().levels, undefined);
+  console.log("  PASSED");
+}
+
+/**
+ * Tests the native pipeline: a lossless 16-bit round trip with packets splitting
+ * samples, resampling around the processor, and speech events from the VAD.
+ */
+function testMockPipeline() {
+  console.log("Running: testMockPipeline");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const { numChannels } = audio;
+  const { processor, numFrames } = setup(audio, {}, { compensateDelay: true });
+
+  function run(pipeline, bytes, packetSize) {
+    const chunks = [];
+    for (let offset = 0; offset < bytes.length; offset += packetSize) {
+      const ready = pipeline.push(bytes.subarray(offset, offset + packetSize));
+      const { data } = pipeline.pull();
+      assert.strictEqual(data.length, ready);
+      chunks.push(data);
+    }
+    chunks.push(pipeline.flush().data);
+    return Buffer.concat(chunks);
+  }
+
+  // The mock returns the input, so 16-bit audio passes through unchanged
+  const pcm16 = Buffer.alloc(audio.interleavedSamples.length * 2);
+  audio.interleavedSamples.forEach((sample, i) =>
+    pcm16.writeInt16LE(Math.round(sample * 32768), i * 2),
+  );
+  const pcm16Pipeline = new Pipeline(processor, { inputFormat: "pcm16" });
+  assert.deepStrictEqual(run(pcm16Pipeline, pcm16, 777), pcm16);
+
+  // A tone at 16 kHz, upsampled to the processor's 48 kHz and back
+  const toneFrames = 16000;
+  const tone = new Float32Array(toneFrames * numChannels);
+  for (let i = 0; i < tone.length; i++) {
+    const frame = Math.floor(i / numChannels);
+    tone[i] = 0.5 * Math.sin((2 * Math.PI * 440 * frame) / 16000);
+  }
+  processor.getProcessorContext().reset();
+  const resampling = new Pipeline(processor, { inputSampleRate: 16000 });
+  const toneBytes = Buffer.from(tone.buffer);
+  const resampled = new Float32Array(
+    new Uint8Array(run(resampling, toneBytes, 1000)).buffer,
+  );
+  assert.strictEqual(resampled.length, tone.length);
+  // Away from the edges, where the kernel reaches into the padding
+  for (let i = 64 * numChannels; i < tone.length - 64 * numChannels; i++) {
+    assert.ok(Math.abs(resampled[i] - tone[i]) < 1e-3, `Sample ${i} differs`);
+  }
+
+  // Speech events at the start of the blocks of the mock's pattern
+  const vadProcessor = setup(audio, { vad_pattern: "0110" }).processor;
+  const vadPipeline = new Pipeline(vadProcessor, { vad: true });
+  const block = new Float32Array(numFrames * numChannels);
+  for (let i = 0; i < 8; i++) {
+    vadPipeline.push(block);
+  }
+  assert.deepStrictEqual(vadPipeline.pull().events, [
+    { type: "speechStart", frame: numFrames },
+    { type: "speechEnd", frame: 3 * numFrames },
+    { type: "speechStart", frame: 5 * numFrames },
+    { type: "speechEnd", frame: 7 * numFrames },
+  ]);
+
+  // Flushing ends speech that is still active, without an output delay to pad
+  const openProcessor = setup(audio, { vad_pattern: "01", delay_ms: 0 });
+  const openPipeline = new Pipeline(openProcessor.processor, { vad: true });
+  openPipeline.push(block);
+  openPipeline.push(block);
+  assert.deepStrictEqual(openPipeline.flush().events, [
+    { type: "speechStart", frame: numFrames },
+    { type: "speechEnd", frame: 2 * numFrames },
+  ]);
+  assert.deepStrictEqual(openPipeline.flush().events, []);
+  console.log("  PASSED");
+}
+
+/**
+ * Tests a client enhancing through a daemon in the same process: the output is the
+ * input delayed by the daemon processor's output delay.
+ */
+async function testMockDaemon() {
+  console.log("Running: testMockDaemon");
+
+  if (process.platform !== "linux") {
+    console.log("  SKIPPED (Linux only)");
+    return;
+  }
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const { numChannels, sampleRate } = audio;
+  const model = mockModel({ sample_rate: sampleRate });
+  const numFrames = model.getOptimalNumFrames(sampleRate);
+  const socketPath = path.join(
+    fs.mkdtempSync(path.join(os.tmpdir(), "aic-daemon-")),
+    "daemon.sock",
+  );
+
+  const daemon = new EnhancementDaemon(model, "mock-license", socketPath);
+  try {
+    const client = await DaemonClient.connect(socketPath, {
+      sampleRate,
+      numChannels,
+      numFrames,
+    });
+    const delay = client.getOutputDelay();
+    const blockSize = numFrames * numChannels;
+    const input = wholeBlocks(audio, numFrames);
+    const output = new Float32Array(input.length);
+    for (let offset = 0; offset < input.length; offset += blockSize) {
+      const block = input.slice(offset, offset + blockSize);
+      assert.strictEqual(client.process(block), numFrames);
+      output.set(block, offset);
+    }
+    assert.deepStrictEqual(output, delayed(input, numChannels, delay));
+    assert.strictEqual(daemon.getSessionCount(), 1);
+
+    client.close();
+    assert.throws(() => client.availableFrames(), /closed/);
+  } finally {
+    daemon.close();
+  }
+  assert.ok(!fs.existsSync(socketPath), "Socket file was not removed");
+  console.log("  PASSED");
+}
+
+/**
+ * Tests loading a model from a shared mapping of its file and its memory report, and
+ * that rewriting the file leaves the mapped model intact.
+ */
+function testMockMappedModel() {
+  console.log("Running: testMockMappedModel");
+
+  if (process.platform !== "linux") {
+    console.log("  SKIPPED (Linux only)");
+    return;
+  }
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const modelPath = path.join(
+    fs.mkdtempSync(path.join(os.tmpdir(), "aic-mock-")),
+    "model.aicmodel",
+  );
+  fs.writeFileSync(
+    modelPath,
+    `id = mapped\nsample_rate = ${audio.sampleRate}\n`,
+  );
+  const model = Model.fromFileMapped(modelPath);
+  assert.strictEqual(model.getId(), "mapped");
+  const usage = model.getMemoryUsage();
+  assert.strictEqual(usage.mappedBytes, fs.statSync(modelPath).size);
+  assert.ok(usage.residentBytes > 0, "Model pages should be resident");
+  assert.strictEqual(
+    usage.sharedBytes + usage.privateBytes,
+    usage.residentBytes,
+  );
+  assert.strictEqual(Model.fromFile(modelPath).getMemoryUsage(), null);
+
+  // The rewrite waits for the mapping to move to a private copy of the old file
+  const mappedBytes = usage.mappedBytes;
+  fs.writeFileSync(modelPath, `id = rewritten\n`);
+  assert.strictEqual(model.getMemoryUsage().mappedBytes, mappedBytes);
+  assert.strictEqual(Model.fromFileMapped(modelPath).getId(), "rewritten");
+
+  // A file open for writing cannot be leased and is copied instead
+  const copiedPath = path.join(path.dirname(modelPath), "copied.aicmodel");
+  fs.writeFileSync(copiedPath, `id = copied\n`);
+  const writer = fs.openSync(copiedPath, "r+");
+  try {
+    const copied = Model.fromFileMapped(copiedPath);
+    assert.strictEqual(copied.getId(), "copied");
+    assert.strictEqual(copied.getMemoryUsage().sharedBytes, 0);
+  } finally {
+    fs.closeSync(writer);
+  }
+
+  const numFrames = model.getOptimalNumFrames(audio.sampleRate);
+  const processor = new Processor(model, "mock-license");
+  processor.initialize(audio.sampleRate, audio.numChannels, numFrames, false);
+  const block = new Float32Array(numFrames * audio.numChannels);
+  assert.strictEqual(processor.processInterleaved(block), numFrames);
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that a worker thread controls a processor it has no handle to through its
+ * session ID.
+ */
+async function testMockSessionContexts() {
+  console.log("Running: testMockSessionContexts");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const { processor } = setup(audio);
+  const sessionId = `session-${process.pid}`;
+  processor.registerSession(sessionId);
+
+  const other = setup(audio).processor;
+  assert.throws(() => other.registerSession(sessionId), /already registered/);
+
+  const worker = new Worker(
+    `
+    const { parentPort, workerData } = require("worker_threads");
+    const aic = require(workerData.modulePath);
+    const context = aic.ProcessorContext.fromSession(workerData.sessionId);
+    context.setParameter(aic.ProcessorParameter.EnhancementLevel, 0.25);
+    const vad = aic.VadContext.fromSession(workerData.sessionId);
+    vad.setParameter(aic.VadParameter.Sensitivity, 9.0);
+    parentPort.postMessage(context.getOutputDelay());
+    `,
+    {
+      eval: true,
+      workerData: { modulePath: path.join(__dirname, ".."), sessionId },
+    },
+  );
+  const workerDelay = await new Promise((resolve, reject) => {
+    worker.once("message", resolve);
+    worker.once("error", reject);
+  });
+  await worker.terminate();
+
+  const context = processor.getProcessorContext();
+  assert.strictEqual(workerDelay, context.getOutputDelay());
+  assert.strictEqual(
+    context.getParameter(ProcessorParameter.EnhancementLevel),
+    0.25,
+  );
+  assert.strictEqual(
+    processor.getVadContext().getParameter(VadParameter.Sensitivity),
+    9.0,
+  );
+
+  other.unregisterSession(sessionId);
+  assert.ok(ProcessorContext.fromSession(sessionId));
+  processor.unregisterSession(sessionId);
+  assert.throws(() => VadContext.fromSession(sessionId), /No session/);
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that scheduled parameter changes are applied at the right blocks.
+ */
+function testMockScheduledParameters() {
+  console.log("Running: testMockScheduledParameters");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const { processor, numFrames } = setup(audio);
+  const context = processor.getProcessorContext();
+  const level = ProcessorParameter.EnhancementLevel;
+  const block = new Float32Array(numFrames * audio.numChannels);
+
+  context.setParameter(level, 0.0);
+  context.scheduleParameter(level, 1.0, 2 * numFrames, 4 * numFrames);
+  // Superseded by a later change at the same frame
+  context.scheduleParameter(ProcessorParameter.Bypass, 1.0, 3 * numFrames);
+  context.scheduleParameter(ProcessorParameter.Bypass, 0.5, 3 * numFrames);
+
+  const levels = [];
+  const bypass = [];
+  for (let i = 0; i < 7; i++) {
+    processor.processInterleaved(block);
+    levels.push(context.getParameter(level));
+    bypass.push(context.getParameter(ProcessorParameter.Bypass));
+  }
+  assert.deepStrictEqual(levels, [0, 0, 0.25, 0.5, 0.75, 1, 1]);
+  assert.deepStrictEqual(bypass, [0, 0, 0, 0.5, 0.5, 0.5, 0.5]);
+  assert.strictEqual(context.getStreamPosition(), 7 * numFrames);
+
+  // Changes in the past apply at the next block, partway through the ramp, and a
+  // change due inside a block applies to that block
+  context.scheduleParameter(level, 0.0, 0, 14 * numFrames);
+  const midBlock = 7 * numFrames + Math.floor(numFrames / 2);
+  context.scheduleParameter(ProcessorParameter.Bypass, 0.0, midBlock);
+  processor.processInterleaved(block);
+  assert.ok(Math.abs(context.getParameter(level) - (1 - 8 / 14)) < 1e-6);
+  assert.strictEqual(context.getParameter(ProcessorParameter.Bypass), 0);
+
+  assert.throws(() => context.scheduleParameter(level, 2.0, 0), /between/);
+  assert.throws(() => context.scheduleParameter(level, 1.0, -1), RangeError);
+
+  context.scheduleParameter(level, 0.0, 10 * numFrames);
+  processor.initialize(audio.sampleRate, audio.numChannels, numFrames, false);
+  assert.strictEqual(context.getStreamPosition(), 0);
+  for (let i = 0; i < 12; i++) {
+    processor.processInterleaved(block);
+  }
+  assert.notStrictEqual(context.getParameter(level), 0);
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that the binary given by AIC_SDK_NODE_BINARY bypasses the CPU-specific selection.
+ */
+function testMockBinaryVariant() {
+  console.log("Running: testMockBinaryVariant");
+
+  const expected = process.env.AIC_SDK_NODE_BINARY ? "custom" : "local";
+  assert.strictEqual(getBinaryVariant(), expected);
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that init() resolves with a processor ready to process and a startup report.
+ */
+async function testMockInit() {
+  console.log("Running: testMockInit");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const { numChannels, sampleRate } = audio;
+  const modelPath = path.join(
+    fs.mkdtempSync(path.join(os.tmpdir(), "aic-mock-")),
+    "model.aicmodel",
+  );
+  fs.writeFileSync(modelPath, `sample_rate = ${sampleRate}\n`);
+
+  const { model, processor, numFrames, report } = await init({
+    modelPath,
+    licenseKey: "mock-license",
+    numChannels,
+    compensateDelay: true,
+  });
+  assert.strictEqual(numFrames, model.getOptimalNumFrames(sampleRate));
+  for (const stage of ["downloadMs", "modelMs", "licenseMs", "initializeMs"]) {
+    assert.ok(report[stage] >= 0, `${stage} is not a duration`);
+  }
+  assert.ok(report.totalMs >= report.modelMs + report.initializeMs);
+  assert.strictEqual(report.binaryVariant, getBinaryVariant());
+
+  // Initialized with delay compensation like Processor.initialize()
+  const blockSize = numFrames * numChannels;
+  const input = wholeBlocks(audio, numFrames);
+  const output = [];
+  for (let offset = 0; offset < input.length; offset += blockSize) {
+    const block = input.slice(offset, offset + blockSize);
+    const validFrames = processor.processInterleaved(block);
+    output.push(...block.subarray(0, validFrames * numChannels));
+  }
+  output.push(...processor.flush());
+  assert.deepStrictEqual(Float32Array.from(output), input);
+
+  await assert.rejects(
+    init({ modelPath: `${modelPath}.missing`, licenseKey: "mock-license" }),
+  );
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that worker thread options are applied or reported as not permitted, and that
+ * workers keep processing exactly with them.
+ */
+function testMockThreadOptions() {
+  console.log("Running: testMockThreadOptions");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const model = mockModel({ sample_rate: audio.sampleRate });
+  const numFrames = model.getOptimalNumFrames(audio.sampleRate);
+  const linux = process.platform === "linux";
+  const flushes = ["x64", "arm64"].includes(process.arch);
+
+  // Raising the nice level and pinning to CPU 0 are always permitted
+  const threadOptions = { cpus: [0], nice: 5, flushDenormals: true };
+  const processor = new MultiChannelProcessor(
+    model,
+    "mock-license",
+    2,
+    null,
+    threadOptions,
+  );
+  const [report] = processor.getThreadReports();
+  assert.strictEqual(processor.getThreadReports().length, 1);
+  assert.deepStrictEqual(report.cpus, linux ? [0] : null);
+  assert.strictEqual(report.nice, linux ? 5 : null);
+  assert.strictEqual(report.flushDenormals, flushes);
+  const refused = (linux ? 0 : 2) + (flushes ? 0 : 1);
+  assert.strictEqual(report.errors.length, refused);
+
+  processor.initialize(audio.sampleRate, numFrames);
+  const delay = processor.getProcessorContext(1).getOutputDelay();
+  const mono = wholeBlocks(audio, numFrames).filter(
+    (_, i) => i % audio.numChannels === 0,
+  );
+  const input = new Float32Array(mono.length * 2);
+  for (let i = 0; i < input.length; i++) {
+    input[i] = mono[i >> 1] * (i % 2 ? -1 : 1);
+  }
+  const output = input.slice();
+  const blockSize = numFrames * 2;
+  for (let offset = 0; offset < output.length; offset += blockSize) {
+    processor.processInterleaved(output.subarray(offset, offset + blockSize));
+  }
+  assert.deepStrictEqual(output, delayed(input, 2, delay));
+
+  // A real-time priority that is not permitted falls back to the nice level
+  const ringProcessor = new Processor(model, "mock-license");
+  ringProcessor.initialize(audio.sampleRate, 1, numFrames, false);
+  const ringReport = ringProcessor.startRingWorker(
+    new AudioRing(4 * numFrames, 1),
+    new AudioRing(4 * numFrames, 1),
+    { realtimePriority: 10, nice: 5 },
+  );
+  ringProcessor.stopRingWorker();
+  if (ringReport.realtimePriority === 10) {
+    assert.strictEqual(ringReport.nice, null);
+  } else {
+    assert.match(ringReport.errors[0], /SCHED_FIFO/);
+    assert.strictEqual(ringReport.nice, linux ? 5 : null);
+  }
+
+  for (const invalid of [
+    { cpus: [] },
+    { cpus: [-1] },
+    { realtimePriority: 100 },
+    { nice: 1.5 },
+  ]) {
+    assert.throws(
+      () =>
+        new MultiChannelProcessor(model, "mock-license", 2, null, invalid),
+      RangeError,
+    );
+  }
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that initialize() throws while a ring worker runs, that the worker leaves a block
+ * that fails to process in the input ring, and that processRing() and getStats() throw
+ * its error until stopRingWorker().
+ */
+async function testMockRingWorkerError() {
+  console.log("Running: testMockRingWorkerError");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const { numChannels, sampleRate } = audio;
+  const { processor, numFrames } = setup(audio, { fail_after_blocks: 0 });
+  const input = new AudioRing(4 * numFrames, numChannels);
+  const output = new AudioRing(4 * numFrames, numChannels);
+  processor.startRingWorker(input, output);
+
+  // The worker runs with the config it was started with
+  assert.throws(
+    () => processor.initialize(sampleRate, numChannels, 2 * numFrames, false),
+    /Stop the ring worker/,
+  );
+  const block = audio.interleavedSamples.slice(0, numFrames * numChannels);
+  input.write(block);
+
+  const deadline = Date.now() + 2000;
+  let error = null;
+  while (error === null && Date.now() < deadline) {
+    await new Promise((resolve) => setTimeout(resolve, 5));
+    try {
+      processor.getStats();
+    } catch (e) {
+      error = e;
+    }
+  }
+  assert.ok(error, "Ring worker error was not surfaced");
+  assert.strictEqual(error.code, "ProcessingFailed");
+  assert.throws(
+    () => processor.processRing(input, output),
+    (e) => e.code === "ProcessingFailed",
+  );
+  assert.strictEqual(input.availableFrames(), numFrames);
+  assert.strictEqual(output.availableFrames(), 0);
+
+  assert.throws(
+    () => processor.stopRingWorker(),
+    (e) => e.code === "ProcessingFailed",
+  );
+  assert.strictEqual(processor.getStats().errors, 1);
+  processor.stopRingWorker();
+  console.log("  PASSED");
+}
+
+/**
+ * Tests that a worker thread blocked in AudioRing.waitForFrames() is woken by a block
+ * the ring worker writes, instead of running into its timeout.
+ */
+async function testMockRingWorkerWakesWaiters() {
+  console.log("Running: testMockRingWorkerWakesWaiters");
+
+  const audio = loadWavAudio(TEST_AUDIO_PATH);
+  const { numChannels } = audio;
+  const { processor, numFrames } = setup(audio);
+  const input = new AudioRing(4 * numFrames, numChannels);
+  const output = new AudioRing(4 * numFrames, numChannels);
+  processor.startRingWorker(input, output);
+
+  const worker = new Worker(
+    `
+    const { parentPort, workerData } = require("worker_threads");
+    const { AudioRing } = require(workerData.modulePath);
+    const output = AudioRing.fromSharedBuffer(workerData.output);
+    parentPort.postMessage("waiting");
+    const start = Date.now();
+    const ready = output.waitForFrames(workerData.numFrames, 10000);
+    parentPort.postMessage({ ready, elapsedMs: Date.now() - start });
+    `,
+    {
+      eval: true,
+      workerData: {
+        modulePath: path.join(__dirname, ".."),
+        output: output.sharedBuffer,
+        numFrames,
+      },
+    },
+  );
+  const block = audio.interleavedSamples.slice(0, numFrames * numChannels);
+  try {
+    const { ready, elapsedMs } = await new Promise((resolve, reject) => {
+      worker.on("message", (message) => {
+        if (message === "waiting") {
+          // Give the worker time to block before the block arrives
+          setTimeout(() => input.write(block), 50);
+        } else {
+          resolve(message);
+        }
+      });
+      worker.once("error", reject);
+    });
+    assert.ok(ready, "Waiter timed out");
+    assert.ok(elapsedMs < 5000, `Waiter woke after ${elapsedMs} ms`);
+  } finally {
+    await worker.terminate();
+    processor.stopRingWorker();
+  }
+  console.log("  PASSED");
+}
+
+// Run all tests
+async function runAllTests() {
+  if (getBackend() !== "mock") {
+    console.log(
+      "Skipping: the native module was not built with the mock backend " +
+        "(npm run build:mock)",
+    );
+    return;
+  }
+
+  console.log("Running mock backend tests...\n");
+
+  const tests = [
+    testMockLayouts,
+    testMockDelayCompensation,
+    testMockVadPattern,
+    testMockStreamAndAdapter,
+    testMockRealtimeShedding,
+    testMockTrace,
+    testMockDiagnostics,
+    testMockMultiChannel,
+    testMockModelSwap,
+    testMockPostProcess,
+    testMockSignalMetrics,
+    testMockPipeline,
+    testMockDaemon,
+    testMockMappedModel,
+    testMockSessionContexts,
+    testMockScheduledParameters,
+    testMockBinaryVariant,
+    testMockInit,
+    testMockThreadOptions,
+    testMockRingWorkerError,
+    testMockRingWorkerWakesWaiters,
+  ];
+
+  let passed = 0;
+  let failed = 0;
+
+  for (const test of tests) {
+    try {
+      await test();
+      passed++;
+    } catch (error) {
+      console.log(`  FAILED: ${error.message}`);
+      failed++;
+    }
+  }
+
+  console.log(`\nResults: ${passed} passed, ${failed} failed`);
+
+  if (failed > 0) {
+    process.exit(1);
+  }
+}
+
+runAllTests();